@@ -250,7 +250,7 @@ public:
 
 public:
     void sort(RandomAccessIter first, RandomAccessIter last) {
-        if (first <= last) {
+        if (last - first < 2) {
             return;
         }
         
@@ -483,6 +483,7 @@ private:
         RandomAccessIter cursor2 = first2; 
         RandomAccessIter dest = first1;
         //把[first1, last1)拷贝到tmp中
+        m_tmp.clear();
         m_tmp.reserve(last1 - first1);
         move_copy(first1, last1, std::back_insert_iterator(m_tmp));
         typename mini_vector<VType>::iterator cursor1 = m_tmp.begin();
@@ -592,6 +593,7 @@ private:
     void __merge_high(RandomAccessIter first1, RandomAccessIter last1, 
             RandomAccessIter first2, RandomAccessIter last2) {
         RandomAccessIter dest = last2 - 1;
+        m_tmp.clear();
         m_tmp.reserve(last2 - first2);
         move_copy(first2, last2, std::back_insert_iterator(m_tmp));
 
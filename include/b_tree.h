@@ -12,20 +12,312 @@
 #include "construct.h"
 #include "type_traits.h"
 #include "utility.h"
+#include "system.h"
+#include "algorithm.h"
+#include <bit>
+#include <vector>
+#include <stdexcept>
 
 #ifdef B_TREE_DEBUG
 #include <iostream>
 #endif //B_TREE_DEBUG
 
+#if defined(__SSE2__) || defined(_M_X64)
+#define B_TREE_SSE2
+#include <emmintrin.h>
+#endif //__SSE2__
+
+//64位整数的比较要SSE4.2
+#if defined(__SSE4_2__)
+#define B_TREE_SSE42
+#include <nmmintrin.h>
+#endif //__SSE4_2__
+
+#if defined(__AVX2__)
+#define B_TREE_AVX2
+#include <immintrin.h>
+#endif //__AVX2__
+
 namespace nano {
 
 inline constexpr degree_t DEFAULT_DEGREE = 4;
 
-//TODO: 动态增长, 不要一开始就申请很大的一块内存
+namespace b_tree_detail {
+
+enum class key_kind { SIGNED, UNSIGNED, REAL };
+
+template<typename T>
+inline constexpr key_kind kind_of = std::is_floating_point_v<T> ? key_kind::REAL :
+	(std::is_signed_v<T> ? key_kind::SIGNED : key_kind::UNSIGNED);
+
+/**
+ * @brief 4、8字节的整数和浮点数，比较器是std::less或std::greater时，节点内可以用向量比较查找
+ */
+template<typename T, typename Comp>
+inline constexpr bool simd_searchable_v = std::is_arithmetic_v<T> && !std::is_same_v<T, bool> &&
+	(sizeof(T) == 4 || sizeof(T) == 8) &&
+	(std::is_same_v<Comp, std::less<T>> || std::is_same_v<Comp, std::greater<T>> ||
+	std::is_same_v<Comp, std::less<>> || std::is_same_v<Comp, std::greater<>>);
+
+/**
+ * @brief 算术类型配std::less或std::greater时相等的值没有区别，批量建树排序不需要稳定
+ */
+template<typename T, typename Comp>
+inline constexpr bool unstable_sortable_v = std::is_arithmetic_v<T> &&
+	(std::is_same_v<Comp, std::less<T>> || std::is_same_v<Comp, std::greater<T>> ||
+	std::is_same_v<Comp, std::less<>> || std::is_same_v<Comp, std::greater<>>);
+
+template<typename Comp>
+struct is_greater : public std::false_type {};
+
+template<typename T>
+struct is_greater<std::greater<T>> : public std::true_type {};
+
+template<typename Comp>
+inline constexpr bool is_greater_v = is_greater<Comp>::value;
+
+//先二分缩小到一个cache line以内，再整段比较数个数
+template<typename T>
+inline constexpr size_t SEARCH_WINDOW = NANO_CACHE_LINE_SIZE / sizeof(T);
+
+/**
+ * @brief gt(a, b)返回a > b的lane的位掩码；无符号数异或最高位后按有符号比较
+ */
+template<size_t Size, key_kind Kind>
+struct sse_ops {
+	constexpr static bool enabled = false;
+};
+
+template<size_t Size, key_kind Kind>
+struct avx2_ops {
+	constexpr static bool enabled = false;
+};
+
+#ifdef B_TREE_SSE2
+template<>
+struct sse_ops<4, key_kind::SIGNED> {
+	constexpr static bool enabled = true;
+	constexpr static size_t lanes = 4;
+	static __m128i set1(int32_t key) noexcept { return _mm_set1_epi32(key); }
+	static __m128i load(const void* pos) noexcept {
+		return _mm_loadu_si128(static_cast<const __m128i*>(pos));
+	}
+	static unsigned gt(__m128i a, __m128i b) noexcept {
+		return _mm_movemask_ps(_mm_castsi128_ps(_mm_cmpgt_epi32(a, b)));
+	}
+};
+
+template<>
+struct sse_ops<4, key_kind::UNSIGNED> : public sse_ops<4, key_kind::SIGNED> {
+	static __m128i set1(uint32_t key) noexcept { return _mm_set1_epi32(key ^ 0x80000000U); }
+	static __m128i load(const void* pos) noexcept {
+		return _mm_xor_si128(sse_ops<4, key_kind::SIGNED>::load(pos), _mm_set1_epi32(0x80000000U));
+	}
+};
+
+template<>
+struct sse_ops<4, key_kind::REAL> {
+	constexpr static bool enabled = true;
+	constexpr static size_t lanes = 4;
+	static __m128 set1(float key) noexcept { return _mm_set1_ps(key); }
+	static __m128 load(const void* pos) noexcept { return _mm_loadu_ps(static_cast<const float*>(pos)); }
+	static unsigned gt(__m128 a, __m128 b) noexcept { return _mm_movemask_ps(_mm_cmpgt_ps(a, b)); }
+};
+
+template<>
+struct sse_ops<8, key_kind::REAL> {
+	constexpr static bool enabled = true;
+	constexpr static size_t lanes = 2;
+	static __m128d set1(double key) noexcept { return _mm_set1_pd(key); }
+	static __m128d load(const void* pos) noexcept { return _mm_loadu_pd(static_cast<const double*>(pos)); }
+	static unsigned gt(__m128d a, __m128d b) noexcept { return _mm_movemask_pd(_mm_cmpgt_pd(a, b)); }
+};
+#endif //B_TREE_SSE2
+
+#ifdef B_TREE_SSE42
+template<>
+struct sse_ops<8, key_kind::SIGNED> {
+	constexpr static bool enabled = true;
+	constexpr static size_t lanes = 2;
+	static __m128i set1(int64_t key) noexcept { return _mm_set1_epi64x(key); }
+	static __m128i load(const void* pos) noexcept {
+		return _mm_loadu_si128(static_cast<const __m128i*>(pos));
+	}
+	static unsigned gt(__m128i a, __m128i b) noexcept {
+		return _mm_movemask_pd(_mm_castsi128_pd(_mm_cmpgt_epi64(a, b)));
+	}
+};
+
+template<>
+struct sse_ops<8, key_kind::UNSIGNED> : public sse_ops<8, key_kind::SIGNED> {
+	static __m128i set1(uint64_t key) noexcept { return _mm_set1_epi64x(key ^ 0x8000000000000000ULL); }
+	static __m128i load(const void* pos) noexcept {
+		return _mm_xor_si128(sse_ops<8, key_kind::SIGNED>::load(pos),
+			_mm_set1_epi64x(0x8000000000000000ULL));
+	}
+};
+#endif //B_TREE_SSE42
+
+#ifdef B_TREE_AVX2
+template<>
+struct avx2_ops<4, key_kind::SIGNED> {
+	constexpr static bool enabled = true;
+	constexpr static size_t lanes = 8;
+	static __m256i set1(int32_t key) noexcept { return _mm256_set1_epi32(key); }
+	static __m256i load(const void* pos) noexcept {
+		return _mm256_loadu_si256(static_cast<const __m256i*>(pos));
+	}
+	static unsigned gt(__m256i a, __m256i b) noexcept {
+		return _mm256_movemask_ps(_mm256_castsi256_ps(_mm256_cmpgt_epi32(a, b)));
+	}
+};
+
+template<>
+struct avx2_ops<4, key_kind::UNSIGNED> : public avx2_ops<4, key_kind::SIGNED> {
+	static __m256i set1(uint32_t key) noexcept { return _mm256_set1_epi32(key ^ 0x80000000U); }
+	static __m256i load(const void* pos) noexcept {
+		return _mm256_xor_si256(avx2_ops<4, key_kind::SIGNED>::load(pos), _mm256_set1_epi32(0x80000000U));
+	}
+};
+
+template<>
+struct avx2_ops<8, key_kind::SIGNED> {
+	constexpr static bool enabled = true;
+	constexpr static size_t lanes = 4;
+	static __m256i set1(int64_t key) noexcept { return _mm256_set1_epi64x(key); }
+	static __m256i load(const void* pos) noexcept {
+		return _mm256_loadu_si256(static_cast<const __m256i*>(pos));
+	}
+	static unsigned gt(__m256i a, __m256i b) noexcept {
+		return _mm256_movemask_pd(_mm256_castsi256_pd(_mm256_cmpgt_epi64(a, b)));
+	}
+};
+
+template<>
+struct avx2_ops<8, key_kind::UNSIGNED> : public avx2_ops<8, key_kind::SIGNED> {
+	static __m256i set1(uint64_t key) noexcept { return _mm256_set1_epi64x(key ^ 0x8000000000000000ULL); }
+	static __m256i load(const void* pos) noexcept {
+		return _mm256_xor_si256(avx2_ops<8, key_kind::SIGNED>::load(pos),
+			_mm256_set1_epi64x(0x8000000000000000ULL));
+	}
+};
+
+template<>
+struct avx2_ops<4, key_kind::REAL> {
+	constexpr static bool enabled = true;
+	constexpr static size_t lanes = 8;
+	static __m256 set1(float key) noexcept { return _mm256_set1_ps(key); }
+	static __m256 load(const void* pos) noexcept { return _mm256_loadu_ps(static_cast<const float*>(pos)); }
+	static unsigned gt(__m256 a, __m256 b) noexcept {
+		return _mm256_movemask_ps(_mm256_cmp_ps(a, b, _CMP_GT_OQ));
+	}
+};
+
+template<>
+struct avx2_ops<8, key_kind::REAL> {
+	constexpr static bool enabled = true;
+	constexpr static size_t lanes = 4;
+	static __m256d set1(double key) noexcept { return _mm256_set1_pd(key); }
+	static __m256d load(const void* pos) noexcept { return _mm256_loadu_pd(static_cast<const double*>(pos)); }
+	static unsigned gt(__m256d a, __m256d b) noexcept {
+		return _mm256_movemask_pd(_mm256_cmp_pd(a, b, _CMP_GT_OQ));
+	}
+};
+#endif //B_TREE_AVX2
+
+/**
+ * @brief KeyFirst为true时数key > v的个数，否则数v > key的个数
+ *        一次比较一整个向量，掩码popcount累加，剩下不够一个向量的逐个比较
+ */
+template<bool KeyFirst, typename T>
+size_t count_greater(const T* first, size_t n, T key) noexcept {
+	using sse = sse_ops<sizeof(T), kind_of<T>>;
+	using avx2 = avx2_ops<sizeof(T), kind_of<T>>;
+	size_t count = 0;
+	size_t i = 0;
+	if constexpr (avx2::enabled) {
+		const auto k = avx2::set1(key);
+		for (; i + avx2::lanes <= n; i += avx2::lanes) {
+			const auto v = avx2::load(first + i);
+			count += std::popcount(KeyFirst ? avx2::gt(k, v) : avx2::gt(v, k));
+		}
+	}
+	if constexpr (sse::enabled) {
+		const auto k = sse::set1(key);
+		for (; i + sse::lanes <= n; i += sse::lanes) {
+			const auto v = sse::load(first + i);
+			count += std::popcount(KeyFirst ? sse::gt(k, v) : sse::gt(v, k));
+		}
+	}
+	for (; i < n; ++i) {
+		count += KeyFirst ? key > first[i] : first[i] > key;
+	}
+	return count;
+}
+
+/**
+ * @brief 二分写成条件传送以后没有分支预测，也就不会提前去取下一步的cache line，
+ *        节点不在cache里时先把所有key所在的cache line都预取上，多个miss可以同时进行
+ */
+template<typename T>
+void prefetch_keys(const T* first, size_t n) noexcept {
+	const char* last = reinterpret_cast<const char*>(first + n);
+	for (const char* pos = reinterpret_cast<const char*>(first); pos < last; pos += NANO_CACHE_LINE_SIZE) {
+		NANO_PREFETCH(pos);
+	}
+}
+
+/**
+ * @brief 升序时lower_bound是比key小的个数，upper_bound是n减去比key大的个数；降序反过来
+ *        二分的每一步都写成条件传送，没有分支预测失败
+ */
+template<typename Comp, typename T>
+size_t simd_lower_bound(const T* first, size_t n, T key) noexcept {
+	const T* base = first;
+	if (n > SEARCH_WINDOW<T>) {
+		prefetch_keys(first, n);
+	}
+	while (n > SEARCH_WINDOW<T>) {
+		size_t half = n / 2;
+		base = (is_greater_v<Comp> ? base[half] > key : base[half] < key) ? base + half : base;
+		n -= half;
+	}
+	return (base - first) + count_greater<!is_greater_v<Comp>>(base, n, key);
+}
+
+template<typename Comp, typename T>
+size_t simd_upper_bound(const T* first, size_t n, T key) noexcept {
+	const T* base = first;
+	if (n > SEARCH_WINDOW<T>) {
+		prefetch_keys(first, n);
+	}
+	while (n > SEARCH_WINDOW<T>) {
+		size_t half = n / 2;
+		base = (is_greater_v<Comp> ? key > base[half] : key < base[half]) ? base : base + half;
+		n -= half;
+	}
+	return (base - first) + n - count_greater<is_greater_v<Comp>>(base, n, key);
+}
+
+} //namespace b_tree_detail
+
+/**
+ * @brief 一个节点只申请一块内存: 节点头 | values[order] | children[degree]
+ *        值数组紧跟在节点头后面，偏移量只和T有关，迭代器不知道degree也能取值；
+ *        只有内部节点有孩子数组，叶子的children为nullptr
+ *        不需要单独记录values数组的长度，因为B树孩子节点 = 值个数 + 1
+ */
 template<typename T>
 struct b_tree_node : public b_tree_node_base {
-    //不需要单独记录values数组的长度，因为B数孩子节点 = 值个数 + 1
-    T* values = nullptr;    
+    constexpr static size_t VALUES_OFFSET = 
+        (sizeof(b_tree_node_base) + alignof(T) - 1) / alignof(T) * alignof(T);
+
+    T* values() noexcept { 
+        return reinterpret_cast<T*>(reinterpret_cast<char*>(this) + VALUES_OFFSET); 
+    }
+    const T* values() const noexcept { 
+        return reinterpret_cast<const T*>(reinterpret_cast<const char*>(this) + VALUES_OFFSET); 
+    }
 };
 
 template<typename T>
@@ -116,7 +408,7 @@ struct b_tree_iterator : public b_tree_iterator_base<T> {
 	}
 
 	reference operator*() const noexcept {
-		return (static_cast<node_ptr>(this->node))->values[this->index];
+		return (static_cast<node_ptr>(this->node))->values()[this->index];
 	}
 
 	pointer operator->() const noexcept {
@@ -184,7 +476,7 @@ struct b_tree_const_iterator : public b_tree_iterator_base<T> {
 	}
 
 	reference operator*() const noexcept {
-		return (static_cast<node_ptr>(this->node))->values[this->index];
+		return (static_cast<node_ptr>(this->node))->values()[this->index];
 	}
 
 	pointer operator->() const noexcept {
@@ -231,8 +523,8 @@ public:
 	iterator end() noexcept { return iterator(static_cast<node_base_ptr>(nullptr), degree, m_header); }
     reverse_iterator rbegin() noexcept { return std::reverse_iterator<iterator>(end()); }
 	reverse_iterator rend() noexcept { return std::reverse_iterator<iterator>(begin()); }
-	const_iterator begin() const noexcept { return const_iterator(m_header->children[0], degree, m_header); }
-	const_iterator end() const noexcept { return const_iterator(static_cast<node_base_ptr>(nullptr), 0, m_header); }
+	const_iterator begin() const noexcept { return const_iterator(m_header->children[0], 0, m_header); }
+	const_iterator end() const noexcept { return const_iterator(static_cast<node_base_ptr>(nullptr), degree, m_header); }
     const_reverse_iterator rbegin() const noexcept { return std::reverse_iterator<const_iterator>(end()); }
 	const_reverse_iterator rend() const noexcept { return std::reverse_iterator<const_iterator>(begin()); }
 
@@ -310,6 +602,13 @@ public:
 	template <std::input_iterator InputIter>
 	void insert_unique(InputIter first, InputIter last);
 
+	/**
+	 * @brief 批量建树，清空原有的值，自底向上一层层建，O(n)(无序输入先排序，O(nlogn))
+	 * @param fillFactor 节点的填充率，(0, 1]，想在建好后继续插入可以留点空位，少分裂
+	 */
+	template <std::input_iterator InputIter>
+	void bulk_load(InputIter first, InputIter last, double fillFactor = 1.0);
+
 	//erase
 	iterator erase(iterator hint);
   	size_type erase_multi(const key_type& key);
@@ -365,10 +664,20 @@ private:
     using node_ptr 					= b_tree_node<T>*;
 	using node_base_ptr				= b_tree_node_base*;
 
+private:
+	//节点的内存布局，见b_tree_node
+	constexpr static size_t LEAF_NODE_SIZE = b_tree_node<T>::VALUES_OFFSET + sizeof(T) * order;
+	constexpr static size_t CHILDREN_OFFSET = 
+		(LEAF_NODE_SIZE + alignof(node_base_ptr) - 1) / alignof(node_base_ptr) * alignof(node_base_ptr);
+	constexpr static size_t INTERNAL_NODE_SIZE = CHILDREN_OFFSET + sizeof(node_base_ptr) * degree;
+	constexpr static size_t NODE_ALIGN = std::max(alignof(T), alignof(b_tree_node_base));
+
 private:
 	//node operation
-	node_ptr create_node(degree_t _vsz);
-	node_base_ptr create_node_base(degree_t _vsz);
+	static void* allocate_block(size_t size);
+	static void deallocate_block(void* block) noexcept;
+	node_ptr create_node(bool leaf);
+	node_base_ptr create_node_base();
 	void deallocate_node(node_ptr node);
 	static void destroy_node(node_base_ptr node);
 	static void destroy_node_base(node_base_ptr node);
@@ -377,12 +686,17 @@ private:
 	
 private:
 	//auxiliary functions
-	iterator lbound(const key_type& key);
-	iterator ubound(const key_type& key);
+	iterator lbound(const key_type& key) const;
+	iterator ubound(const key_type& key) const;
 	iterator get_insert_multi(const key_type& key);
 	iterator insert_value(iterator iter, key_type& key);
 	iterator erase_value(key_type key);
 	std::pair<iterator, bool> get_insert_unique(const key_type& key);
+	template <typename RandomAccessIter>
+	void sort_values(RandomAccessIter first, RandomAccessIter last) const;
+	template <typename Iter>
+	void build_sorted(Iter first, size_type n, double fillFactor);
+	static size_type group_count(size_type units, size_type target);
 
 private: 
 	//other node operaion
@@ -392,13 +706,26 @@ private:
 	bool node_filled(node_ptr node) { 
 		return node ? node->vsz + 1 == degree : false; 
 	}
-	degree_t value_lbound(node_ptr node, const T& val) {
-		return std::lower_bound(node->values, node->values + node->vsz, val, m_comp) - 
-				node->values;
+	//叶子没有孩子数组
+	static node_ptr child_at(node_base_ptr node, degree_t index) noexcept {
+		return node->children ? static_cast<node_ptr>(node->children[index]) : nullptr;
+	}
+	//算术类型的key配std::less/std::greater时用向量比较，见b_tree_detail::simd_lower_bound
+	degree_t value_lbound(node_ptr node, const T& val) const {
+		if constexpr (b_tree_detail::simd_searchable_v<T, Comp>) {
+			return b_tree_detail::simd_lower_bound<Comp>(node->values(), node->vsz, val);
+		} else {
+			return std::lower_bound(node->values(), node->values() + node->vsz, val, m_comp) - 
+					node->values();
+		}
 	}
-	degree_t value_ubound(node_ptr node, const T& val) {
-		return std::upper_bound(node->values, node->values + node->vsz, val, m_comp) - 
-				node->values;
+	degree_t value_ubound(node_ptr node, const T& val) const {
+		if constexpr (b_tree_detail::simd_searchable_v<T, Comp>) {
+			return b_tree_detail::simd_upper_bound<Comp>(node->values(), node->vsz, val);
+		} else {
+			return std::upper_bound(node->values(), node->values() + node->vsz, val, m_comp) - 
+					node->values();
+		}
 	}
 
 private:
@@ -407,61 +734,75 @@ private:
     const Comp& m_comp;
 };
 
+template<typename T, typename Comp, degree_t degree>
+void* b_tree<T, Comp, degree>::allocate_block(size_t size) {
+	if constexpr (NODE_ALIGN > __STDCPP_DEFAULT_NEW_ALIGNMENT__) {
+		return ::operator new(size, std::align_val_t(NODE_ALIGN));
+	} else {
+		return ::operator new(size);
+	}
+}
+
+template<typename T, typename Comp, degree_t degree>
+void b_tree<T, Comp, degree>::deallocate_block(void* block) noexcept {
+	if constexpr (NODE_ALIGN > __STDCPP_DEFAULT_NEW_ALIGNMENT__) {
+		::operator delete(block, std::align_val_t(NODE_ALIGN));
+	} else {
+		::operator delete(block);
+	}
+}
+
 template<typename T, typename Comp, degree_t degree>
 void b_tree<T, Comp, degree>::deallocate_node(node_ptr node) {
-	::operator delete(node->children);
-	::operator delete(node->values);
-	::operator delete(node);
+	deallocate_block(node);
 }
-	
 
 template<typename T, typename Comp, degree_t degree>
 typename b_tree<T, Comp, degree>::node_ptr 
-b_tree<T, Comp, degree>::create_node(degree_t _vsz) {
-	node_ptr newNode = static_cast<node_ptr>(::operator new(sizeof(b_tree_node<T>)));
-	newNode->values = static_cast<T*>(::operator new(sizeof(T) * order));
-	newNode->children = static_cast<node_base_ptr*>(::operator new(sizeof(node_base_ptr) * degree));
-	newNode->parent = nullptr;
-	newNode->vsz = 0;
-	mem_zero(&newNode->children[0], sizeof(node_base_ptr) * degree);
-	//newNode->children[0] = nullptr;
-	static_cast<void>(_vsz);
+b_tree<T, Comp, degree>::create_node(bool leaf) {
+	void* block = allocate_block(leaf ? LEAF_NODE_SIZE : INTERNAL_NODE_SIZE);
+	node_ptr newNode = ::new(block) b_tree_node<T>;
+	if (!leaf) {
+		newNode->children = reinterpret_cast<node_base_ptr*>(static_cast<char*>(block) + CHILDREN_OFFSET);
+		mem_zero(newNode->children, sizeof(node_base_ptr) * degree);
+	}
 	return newNode;
 }
 
+/**
+ * @brief 头节点: parent是根，children[0]、children[1]是最小、最大的节点，孩子数组也放在同一块内存里
+ */
 template<typename T, typename Comp, degree_t degree>
 typename b_tree<T, Comp, degree>::node_base_ptr 
-b_tree<T, Comp, degree>::create_node_base(degree_t _vsz) {
-	node_base_ptr newNode = static_cast<node_base_ptr>(::operator new(sizeof(b_tree_node_base)));
-	newNode->children = static_cast<node_base_ptr*>(::operator new(sizeof(node_base_ptr) * 2));
-	static_cast<void>(_vsz);
+b_tree<T, Comp, degree>::create_node_base() {
+	void* block = allocate_block(sizeof(b_tree_node_base) + sizeof(node_base_ptr) * 2);
+	node_base_ptr newNode = ::new(block) b_tree_node_base;
+	newNode->children = reinterpret_cast<node_base_ptr*>(newNode + 1);
+	newNode->children[0] = newNode->children[1] = nullptr;
 	return newNode;
 }
 
 template<typename T, typename Comp, degree_t degree>
 void b_tree<T, Comp, degree>::destroy_node(node_base_ptr node) {
 	node_ptr node1 = static_cast<node_ptr>(node);
-	::operator delete(node1->children);
 	for (degree_t i = 0; i < node1->vsz; ++i) {
-		destroy(&node1->values[i]);
+		destroy(&node1->values()[i]);
 	}
-	::operator delete(node1->values);
-	::operator delete(node1);
+	deallocate_block(node1);
 }
 
 template<typename T, typename Comp, degree_t degree>
 void b_tree<T, Comp, degree>::destroy_node_base(node_base_ptr node) {
-	::operator delete(node->children);
-	::operator delete(node);
+	deallocate_block(node);
 }
 
 template<typename T, typename Comp, degree_t degree>
 typename b_tree<T, Comp, degree>::node_ptr 
 b_tree<T, Comp, degree>::copy_node(node_base_ptr node) {
 	node_ptr node1 = static_cast<node_ptr>(node);
-	node_ptr newNode = create_node(0);
+	node_ptr newNode = create_node(is_leaf(node1));
 	for (degree_t i = 0; i < node1->vsz; ++i) {
-		construct(newNode->values + i, node1->values[i]);
+		construct(newNode->values() + i, node1->values()[i]);
 	}
 	newNode->vsz = node1->vsz;
 
@@ -472,7 +813,7 @@ template<typename T, typename Comp, degree_t degree>
 void b_tree<T, Comp, degree>::clear_since(node_ptr node) {
 	if (node) {
 		for (degree_t i = 0; i < node->vsz; ++i) {
-			destroy(&node->values[i]);
+			destroy(&node->values()[i]);
 			if (!is_leaf(node)) {
 				clear_since(static_cast<node_ptr>(node->children[i]));
 			}
@@ -486,7 +827,7 @@ void b_tree<T, Comp, degree>::clear_since(node_ptr node) {
 
 template<typename T, typename Comp, degree_t degree>
 typename b_tree<T, Comp, degree>::iterator
-b_tree<T, Comp, degree>::lbound(const key_type& key) {
+b_tree<T, Comp, degree>::lbound(const key_type& key) const {
 	node_ptr root = static_cast<node_ptr>(m_header->parent);
 	node_base_ptr parent = nullptr;
 	degree_t index = 0;
@@ -495,14 +836,14 @@ b_tree<T, Comp, degree>::lbound(const key_type& key) {
 	while (root) {
 		//为了减少比较次数，可以先与root->values最后一个元素比较
 		//若root->values最后一个元素小于key, 比较次数可将比较次数从log(root->vsz)减少到1次
-		if (m_comp(root->values[root->vsz - 1], key)) {
+		if (m_comp(root->values()[root->vsz - 1], key)) {
 			index = root->vsz;
 		} else {
 			index = value_lbound(root, key); //该节点第一个大于等于key的下标, 不会为root->vsz
 			parent = root;
 			index1 = index;
 		}
-		root = static_cast<node_ptr>(root->children[index]);
+		root = child_at(root, index);
 	}
 
 	if (nullptr == parent) { //从根开始，大于所有节点的最大值, 返回end
@@ -513,7 +854,7 @@ b_tree<T, Comp, degree>::lbound(const key_type& key) {
 
 template<typename T, typename Comp, degree_t degree>
 typename b_tree<T, Comp, degree>::iterator
-b_tree<T, Comp, degree>::ubound(const key_type& key) {
+b_tree<T, Comp, degree>::ubound(const key_type& key) const {
 	node_ptr root = static_cast<node_ptr>(m_header->parent);
 	node_base_ptr parent = nullptr;
 	degree_t index = 0;
@@ -522,14 +863,14 @@ b_tree<T, Comp, degree>::ubound(const key_type& key) {
 	while (root) {
 		//为了减少比较次数，可以先与node->values最后一个元素比较
 		//如果成功，比较次数由logn次减少为1次
-		if (!m_comp(key, root->values[root->vsz - 1])) {
+		if (!m_comp(key, root->values()[root->vsz - 1])) {
 			index = root->vsz;
 		} else {
 			index = value_ubound(root, key);
 			parent = root;
 			index1 = index;
 		}
-		root = static_cast<node_ptr>(root->children[index]);
+		root = child_at(root, index);
 	}
 
 	if (nullptr == parent) {	//从根开始，大于所有节点的最大值, 返回end
@@ -544,8 +885,8 @@ void b_tree<T, Comp, degree>::split_child(node_base_ptr parent, degree_t childIn
 		split_node(parentNode);
 	}
 
-	node_ptr child2 = create_node(0);	//分裂后的右边		
 	node_ptr child1 = static_cast<node_ptr>(parentNode->children[childIndex]);
+	node_ptr child2 = create_node(is_leaf(child1));	//分裂后的右边
 	constexpr static degree_t splitValueCount = (degree - 1) / 2;
 	child2->vsz = splitValueCount;
 	degree_t n1 = child1->vsz - 1;
@@ -553,8 +894,8 @@ void b_tree<T, Comp, degree>::split_child(node_base_ptr parent, degree_t childIn
 
 	//依从从后往前拷贝后半部分的值
 	while (n2 >= 0) {
-		construct(&child2->values[n2], std::move(child1->values[n1]));
-		destroy(&child1->values[n1]);
+		construct(&child2->values()[n2], std::move(child1->values()[n1]));
+		destroy(&child1->values()[n1]);
 		if (!is_leaf(child1)) {  //如果不是叶子，还需要拷贝后半部分的孩子结点指针
 			child2->children[n2 + 1] = child1->children[n1 + 1];
 			child1->children[n1 + 1]->parent = child2;
@@ -573,17 +914,23 @@ void b_tree<T, Comp, degree>::split_child(node_base_ptr parent, degree_t childIn
 	child1->vsz -= child2->vsz;
 	//孩子结点中间值上升
 	degree_t parentVsz = parentNode->vsz;
-	//给中间节点让出位置
-	construct(&parentNode->values[parentVsz], parentNode->values[parentVsz - 1]);
-	parentNode->children[parentVsz + 1] = parentNode->children[parentVsz];
-	for (degree_t i = parentVsz - 1; i > childIndex; --i) {
-		parentNode->values[i] = std::move(parentNode->values[i - 1]);
+	T* parentValues = parentNode->values();
+	T& midValue = child1->values()[child1->vsz - 1];
+	if (childIndex == parentVsz) {	//放在最后(包括新的根)，不用让位置
+		construct(&parentValues[parentVsz], std::move(midValue));
+	} else {	//给中间节点让出位置
+		construct(&parentValues[parentVsz], std::move(parentValues[parentVsz - 1]));
+		for (degree_t i = parentVsz - 1; i > childIndex; --i) {
+			parentValues[i] = std::move(parentValues[i - 1]);
+		}
+		parentValues[childIndex] = std::move(midValue);
+	}
+	for (degree_t i = parentVsz; i > childIndex; --i) {
 		parentNode->children[i + 1] = parentNode->children[i];
 	}
-	parentNode->values[childIndex] = std::move(child1->values[child1->vsz - 1]);
 	parentNode->children[childIndex + 1] = child2;
 	child2->parent = parentNode;
-	destroy(&child1->values[child1->vsz - 1]);
+	destroy(&child1->values()[child1->vsz - 1]);
 	--child1->vsz;
 	++parentNode->vsz;
 	if (m_header->children[1] == child1 ||
@@ -596,7 +943,7 @@ template<typename T, typename Comp, degree_t degree>
 void b_tree<T, Comp, degree>::split_node(node_base_ptr node) {
 	node_ptr parent = static_cast<node_ptr>(node->parent);
 	if (nullptr == parent) { 	//分裂根节点
-		parent = create_node(0);
+		parent = create_node(false);
 		m_header->parent = parent;
 		parent->children[0] = node;
 		node->parent = parent;
@@ -616,12 +963,12 @@ b_tree<T, Comp, degree>::merge_node(node_base_ptr parent,
 	node_ptr child2 = static_cast<node_ptr>(parentNode->children[childIndex + 1]);
 	degree_t vsz1 = child1->vsz;
 	degree_t vsz2 = child2->vsz;
-	construct(&child1->values[vsz1], std::move(parentNode->values[vIndex])); //把关键字合并到child1
+	construct(&child1->values()[vsz1], std::move(parentNode->values()[vIndex])); //把关键字合并到child1
 	++vsz1; 
 	//把child2结点的值合并到child1
 	//把孩子也拷贝过去
 	for (degree_t i = 0; i < vsz2; ++i) {
-		construct(&child1->values[i + vsz1], std::move(child2->values[i]));
+		construct(&child1->values()[i + vsz1], std::move(child2->values()[i]));
 		if (!is_leaf(child1)) { //also !is_leaf(child2)
 			child1->children[i + vsz1] = child2->children[i];
 			child2->children[i]->parent = child1;
@@ -638,11 +985,11 @@ b_tree<T, Comp, degree>::merge_node(node_base_ptr parent,
 	//在父亲结点中删除关键字, 为了删除child2, 顺便把孩子结点向前覆盖
 	degree_t pvsz = parentNode->vsz;
 	for (degree_t i = vIndex; i + 1 < pvsz; ++i) {
-		parentNode->values[i] = std::move(parentNode->values[i + 1]);
+		parentNode->values()[i] = std::move(parentNode->values()[i + 1]);
 		parentNode->children[i + 1] = parentNode->children[i + 2];
 	}
 	parentNode->children[pvsz] = nullptr; //置空最后一个孩子
-	destroy(&parentNode->values[pvsz - 1]);
+	destroy(&parentNode->values()[pvsz - 1]);
 	--parentNode->vsz;
 
 	if (0 == parentNode->vsz) {
@@ -668,7 +1015,7 @@ b_tree<T, Comp, degree>::get_insert_multi(const key_type& val) {
 	//我们可以一边向下查找，一边调整
 	node_ptr curr = static_cast<node_ptr>(m_header->parent);
 	if (nullptr == curr) {
-		curr = create_node(0);
+		curr = create_node(true);
 		m_header->parent = curr;
 		m_header->children[0] = m_header->children[1] = curr;
 		return iterator(curr, 0, m_header);
@@ -684,14 +1031,14 @@ b_tree<T, Comp, degree>::get_insert_multi(const key_type& val) {
 	
 	while (curr) {
 		index = value_ubound(curr, val);
-		if (node_filled(static_cast<node_ptr>(curr->children[index]))) {
+		if (node_filled(child_at(curr, index))) {
 			split_child(curr, index);
-			if (m_comp(curr->values[index], val)) {
+			if (m_comp(curr->values()[index], val)) {
 				++index;
 			}
 		}
 		parent = curr;
-		curr = static_cast<node_ptr>(curr->children[index]);
+		curr = child_at(curr, index);
 	}
 	
 	return iterator(parent, index, m_header);
@@ -701,7 +1048,7 @@ template<typename T, typename Comp, degree_t degree>
 std::pair<typename b_tree<T, Comp, degree>::iterator, bool> 
 b_tree<T, Comp, degree>::get_insert_unique(const key_type& val) {
 	if (nullptr == m_header->parent) {
-		node_ptr node = create_node(0);
+		node_ptr node = create_node(true);
 		m_header->parent = m_header->children[0] = m_header->children[1] = node;
 		return { iterator(m_header->parent, 0, m_header), true };
 	}
@@ -713,7 +1060,7 @@ b_tree<T, Comp, degree>::get_insert_unique(const key_type& val) {
 		node1 = static_cast<node_ptr>(m_header->children[1]);
 		index1 = static_cast<node_ptr>(m_header->children[1])->vsz;
 	} else {
-		T& val1 = node1->values[index1];
+		T& val1 = node1->values()[index1];
 		//val1>=val!comp(val1, val)==true
 		if (!m_comp(val, val1)) { //val1 <= val, equal
 			return { iter, false };
@@ -740,7 +1087,7 @@ b_tree<T, Comp, degree>::insert_value(iterator iter, key_type& key) {
 		split_node(node1);
 		/*
 		degree_t chil1Index = child_index(node1->parent, node1);
-		T& midVal = static_cast<node_ptr>(node1->parent)->values[chil1Index];
+		T& midVal = static_cast<node_ptr>(node1->parent)->values()[chil1Index];
 		if (m_comp(midVal, key)) {
 			node1 = static_cast<node_ptr>(node1->parent->children[chil1Index + 1]);
 			index1 = value_ubound(node1, key, m_comp);
@@ -751,12 +1098,19 @@ b_tree<T, Comp, degree>::insert_value(iterator iter, key_type& key) {
 		index1 = iter.index;
 	}
 	
-	for (degree_t i = node1->vsz; i > index1; --i) {
-		node1->values[i] = std::move(node1->values[i - 1]);
+	//values[vsz]还没有构造，不能直接赋值
+	T* values = node1->values();
+	degree_t vsz = node1->vsz;
+	if (index1 == vsz) {
+		construct(&values[vsz], std::move(key));
+	} else {
+		construct(&values[vsz], std::move(values[vsz - 1]));
+		for (degree_t i = vsz - 1; i > index1; --i) {
+			values[i] = std::move(values[i - 1]);
+		}
+		values[index1] = std::move(key);
 	}
-	node1->values[index1] = std::move(key);
 	++node1->vsz;
-	node1->children[node1->vsz] = nullptr;
 	++m_size;
 	return iterator(node1, index1, m_header);
 }
@@ -795,16 +1149,16 @@ b_tree<T, Comp, degree>::erase_value(key_type key) {
 	while (node) {
 		/*
 		std::cout << "key=" << key
-				<< " node[0]=" << node->values[0]
+				<< " node[0]=" << node->values()[0]
 				<< " index=" << index
 				<< std::endl;
 		std::cout << serialize() << std::endl;
 		*/
-		if (is_leaf(node) && !m_comp(key, node->values[index])) { //情况一, 叶子节点，直接删除
+		if (is_leaf(node) && !m_comp(key, node->values()[index])) { //情况一, 叶子节点，直接删除
 			for (degree_t i = index; i < node->vsz - 1; ++i) {
-				node->values[i] = std::move(node->values[i + 1]);
+				node->values()[i] = std::move(node->values()[i + 1]);
 			}
-			destroy(&node->values[node->vsz - 1]);
+			destroy(&node->values()[node->vsz - 1]);
 			--node->vsz;
 			if (m_header->parent == node && 0 == node->vsz) {
 				destroy_node(m_header->parent);
@@ -812,19 +1166,19 @@ b_tree<T, Comp, degree>::erase_value(key_type key) {
 				node = nullptr;
 			}
 			break;
-		} else if (index < node->vsz && !m_comp(key, node->values[index])) {	//情况二, 要删除的值在当前节点，但当前节点不为叶子
+		} else if (index < node->vsz && !m_comp(key, node->values()[index])) {	//情况二, 要删除的值在当前节点，但当前节点不为叶子
 			if (node->children[index]->vsz > minVsz) {	//a, 左兄弟有多的值
 				std::pair<node_base_ptr, degree_t>  pre = max_node(node->children[index]);
-				key = static_cast<node_ptr>(pre.first)->values[pre.second];
+				key = static_cast<node_ptr>(pre.first)->values()[pre.second];
 				node_ptr lBrother = static_cast<node_ptr>(node->children[index]);
-				node->values[index] = key; //move? 好像不行
+				node->values()[index] = key; //move? 好像不行
 				node = lBrother;
 				index = value_lbound(node, key);
 			} else if (node->children[index + 1]->vsz > minVsz) { //b, 右兄弟有多的值
 				std::pair<node_base_ptr, degree_t>  next = min_node(node->children[index + 1]);
-				key = static_cast<node_ptr>(next.first)->values[next.second];
+				key = static_cast<node_ptr>(next.first)->values()[next.second];
 				node_ptr rBrother = static_cast<node_ptr>(node->children[index + 1]);
-				node->values[index] = key;
+				node->values()[index] = key;
 				node = rBrother;
 				index = value_lbound(node, key);
 			} else {	//c, 左右兄弟都没有多的值
@@ -834,7 +1188,7 @@ b_tree<T, Comp, degree>::erase_value(key_type key) {
 				degree_t index1 = node->children[index]->vsz;
 				node = merge_node(node, index, index);
 				index = index1; //value_lbound(node, key)
-				key = node->values[index];
+				key = node->values()[index];
 			}
 		} else { //情况三, 要删除的值在孩子节点中
 			if (node->children[index]->vsz <= minVsz) { //孩子没有多的值
@@ -844,24 +1198,28 @@ b_tree<T, Comp, degree>::erase_value(key_type key) {
 					degree_t childVsz = child->vsz;
 					degree_t lBrotherVsz = lBrother->vsz;
 
-					construct(&child->values[childVsz], std::move(child->values[childVsz - 1]));
-					child->children[childVsz + 1] = child->children[childVsz];
+					construct(&child->values()[childVsz], std::move(child->values()[childVsz - 1]));
+					if (!is_leaf(child)) {
+						child->children[childVsz + 1] = child->children[childVsz];
+					}
 					for (degree_t i = childVsz - 1; i > 0; --i) { //为父亲节点新来的值让出位置
-						child->values[i] = std::move(child->values[i - 1]);
+						child->values()[i] = std::move(child->values()[i - 1]);
 						if (!is_leaf(child)) {
 							child->children[i + 1] = child->children[i];
 						}
 					}
-					child->children[1] = child->children[0];
-					child->values[0] = std::move(node->values[index - 1]); 		//父亲节点值下来
-					node->values[index - 1] = std::move(lBrother->values[lBrotherVsz - 1]); //左兄弟节点值上升到父亲节点
+					if (!is_leaf(child)) {
+						child->children[1] = child->children[0];
+					}
+					child->values()[0] = std::move(node->values()[index - 1]); 		//父亲节点值下来
+					node->values()[index - 1] = std::move(lBrother->values()[lBrotherVsz - 1]); //左兄弟节点值上升到父亲节点
 					if (!is_leaf(child)) { //also !is_leaf(lBrother)
 						child->children[0] = lBrother->children[lBrotherVsz];
 						lBrother->children[lBrotherVsz]->parent = child;
 						lBrother->children[lBrotherVsz] = nullptr;
 					}
 					++child->vsz;
-					destroy(&lBrother->values[lBrotherVsz - 1]); //在兄弟节点中删除该值
+					destroy(&lBrother->values()[lBrotherVsz - 1]); //在兄弟节点中删除该值
 					--lBrother->vsz;
 					node = child;
 					index = value_lbound(node, key);
@@ -872,26 +1230,26 @@ b_tree<T, Comp, degree>::erase_value(key_type key) {
 					degree_t rBrotherVsz = rBrother->vsz;
 
 					//父亲节点的值下来
-					construct(&child->values[childVsz], std::move(node->values[index]));
+					construct(&child->values()[childVsz], std::move(node->values()[index]));
 					//--node->vsz
 					if (!is_leaf(child)) { //also !is_leaf(rBrother)
 						child->children[childVsz + 1] = rBrother->children[0];
 						rBrother->children[0]->parent = child;
 					}
 					++child->vsz;
-					node->values[index] = std::move(rBrother->values[0]);  //右兄弟节点的值上升到父亲节点
+					node->values()[index] = std::move(rBrother->values()[0]);  //右兄弟节点的值上升到父亲节点
 					//++node->vsz
 					for (degree_t i = 0; i + 1 < rBrotherVsz; ++i) {			//在右兄弟节点中删除该值
-						rBrother->values[i] = std::move(rBrother->values[i + 1]);
+						rBrother->values()[i] = std::move(rBrother->values()[i + 1]);
 						if (!is_leaf(rBrother)) {
 							rBrother->children[i] = rBrother->children[i + 1];
 						}
 					}
 					if (!is_leaf(rBrother)) {
 						rBrother->children[rBrotherVsz - 1] = rBrother->children[rBrotherVsz];
-						rBrother->children[rBrother->vsz + 1] = nullptr;
+						rBrother->children[rBrotherVsz] = nullptr;
 					}
-					destroy(&rBrother->values[rBrotherVsz - 1]);
+					destroy(&rBrother->values()[rBrotherVsz - 1]);
 					--rBrother->vsz;
 					node = child;
 					index = value_lbound(node, key);
@@ -915,7 +1273,7 @@ b_tree<T, Comp, degree>::erase_value(key_type key) {
 
 template<typename T, typename Comp, degree_t degree>
 b_tree<T, Comp, degree>::b_tree(const Comp& comp) :
-	m_header(create_node_base(0)),
+	m_header(create_node_base()),
 	m_size(0),
 	m_comp(comp) {
 }
@@ -923,18 +1281,22 @@ b_tree<T, Comp, degree>::b_tree(const Comp& comp) :
 template<typename T, typename Comp, degree_t degree>
 template<std::input_iterator InputIter>
 b_tree<T, Comp, degree>::b_tree(InputIter first, InputIter last, const Comp& comp) :
-		m_header(create_node_base(0)),
+		m_header(create_node_base()),
 		m_size(0),
 		m_comp(comp) {
 	static_assert(is_input_iterator_v<InputIter>, "input iterator required");
-	for (; first != last; ++first) {
-		insert_multi(first, last);
+	//构造函数抛异常时不会调用析构函数，头节点要自己释放
+	try {
+		bulk_load(first, last);
+	} catch (...) {
+		destroy_node_base(m_header);
+		throw;
 	}
 }
 
 template<typename T, typename Comp, degree_t degree>
 b_tree<T, Comp, degree>::b_tree(const b_tree& other) :
-		m_header(create_node_base(0)),
+		m_header(create_node_base()),
 		m_size(0),
 		m_comp(other.m_comp) {
 	if (other.size()) {
@@ -1037,7 +1399,7 @@ b_tree<T, Comp, degree>::emplace_unique_hint(iterator hint, Args&& ...args) {
 	degree_t index = value_ubound(hint.node, key);
 	node_ptr node1 = static_cast<node_ptr>(hint.node);
 	if (index != 0 && index != node1->vsz) {
-		if (!m_comp(node1->values[index - 1], key)) { //equal
+		if (!m_comp(node1->values()[index - 1], key)) { //equal
 			hint.index = index;
 			return { iterator(hint, index, m_header), false };
 		}
@@ -1050,11 +1412,55 @@ template<typename T, typename Comp, degree_t degree>
 template <std::input_iterator InputIter>
 void b_tree<T, Comp, degree>::insert_multi(InputIter first, InputIter last) {
 	static_assert(is_input_iterator_v<InputIter>, "input iterator required");
+	if (empty()) {
+		bulk_load(first, last);
+		return;
+	}
+	//新值不比树里的少时，合并后重建比逐个插入快
+	if constexpr (std::forward_iterator<InputIter>) {
+		if (static_cast<size_type>(std::distance(first, last)) >= m_size) {
+			//先拷贝、排序新值，再和树里的值(拷贝，不移动)合并，在另一棵树里建好以后交换，
+			//中途拷贝、比较、申请内存抛异常时树不变
+			std::vector<T> buf(first, last);
+			sort_values(buf.begin(), buf.end());
+			std::vector<T> merged;
+			merged.reserve(m_size + buf.size());
+			//相等的值树里原有的在前
+			const b_tree& self = *this;
+			std::merge(self.begin(), self.end(), std::make_move_iterator(buf.begin()),
+				std::make_move_iterator(buf.end()), std::back_inserter(merged), m_comp);
+			b_tree tmp(m_comp);
+			tmp.build_sorted(std::make_move_iterator(merged.begin()), merged.size(), 1.0);
+			swap(tmp);
+			return;
+		}
+	}
 	for (; first != last; ++first) {
 		insert_multi(*first);
 	}
 }
 
+template<typename T, typename Comp, degree_t degree>
+template <std::input_iterator InputIter>
+void b_tree<T, Comp, degree>::bulk_load(InputIter first, InputIter last, double fillFactor) {
+	static_assert(is_input_iterator_v<InputIter>, "input iterator required");
+	if (!(fillFactor > 0.0 && fillFactor <= 1.0)) {
+		throw std::invalid_argument("b_tree::bulk_load: fill factor must be in (0, 1]");
+	}
+	clear();
+	if constexpr (std::forward_iterator<InputIter>) {
+		if (std::is_sorted(first, last, m_comp)) {
+			build_sorted(first, std::distance(first, last), fillFactor);
+			return;
+		}
+	}
+	std::vector<T> buf(first, last);
+	if (!std::is_sorted(buf.begin(), buf.end(), m_comp)) {
+		sort_values(buf.begin(), buf.end());
+	}
+	build_sorted(std::make_move_iterator(buf.begin()), buf.size(), fillFactor);
+}
+
 template<typename T, typename Comp, degree_t degree>
 template <std::input_iterator InputIter>
 void b_tree<T, Comp, degree>::insert_unique(InputIter first, InputIter last) {
@@ -1073,9 +1479,9 @@ b_tree<T, Comp, degree>::erase(iterator hint) {
 		degree_t index = hint.index;
 		degree_t nvsz = node->vsz;
 		for (degree_t i = index; i < nvsz - 1; ++i) {
-			node->values[i] = std::move(node->values[i + 1]);
+			node->values()[i] = std::move(node->values()[i + 1]);
 		}
-		destroy(&node->values[nvsz - 1]);
+		destroy(&node->values()[nvsz - 1]);
 		--node->vsz;
 		--m_size;
 		return iterator(node, index, m_header);
@@ -1122,14 +1528,133 @@ void b_tree<T, Comp, degree>::erase(iterator first, iterator last) {
 template<typename T, typename Comp, degree_t degree>
 void b_tree<T, Comp, degree>::clear() {
 	clear_since(static_cast<node_ptr>(m_header->parent));
+	m_header->parent = m_header->children[0] = m_header->children[1] = nullptr;
 	m_size = 0;
 }
 
+/**
+ * @brief 相等的值保持输入顺序，和std::multiset一样用稳定的tim_sort；相等即相同的算术类型用更快的intro_sort
+ */
+template<typename T, typename Comp, degree_t degree>
+template <typename RandomAccessIter>
+void b_tree<T, Comp, degree>::sort_values(RandomAccessIter first, RandomAccessIter last) const {
+	if constexpr (b_tree_detail::unstable_sortable_v<T, Comp>) {
+		intro_sort(first, last, m_comp);
+	} else {
+		tim_sort(first, last, m_comp);
+	}
+}
+
+/**
+ * @brief 把units个单位分成几组，每组不超过target + 1个，除了只有一组(根)外不少于最小值个数 + 1个
+ * @note 叶子层一个单位是一个值或者分隔值(n个值的叶子层有n + 1个单位)，内部层一个单位是一个孩子
+ */
+template<typename T, typename Comp, degree_t degree>
+typename b_tree<T, Comp, degree>::size_type 
+b_tree<T, Comp, degree>::group_count(size_type units, size_type target) {
+	constexpr size_type minVsz = std::max(degree / 2 - 1, 1);
+	size_type count = std::min((units + target) / (target + 1), units / (minVsz + 1));
+	return std::max<size_type>(count, 1);
+}
+
+/**
+ * @brief 由n个有序的值自底向上建树：先把值依次装满叶子，两个叶子之间留一个值作为分隔值，
+ * 		  再把分隔值按同样的方式装进上一层，直到只剩一个节点(根)
+ * @note 每层的节点大小均匀分布，最小的也不少于erase要求的最小值个数
+ */
+template<typename T, typename Comp, degree_t degree>
+template <typename Iter>
+void b_tree<T, Comp, degree>::build_sorted(Iter first, size_type n, double fillFactor) {
+	if (0 == n) {
+		return;
+	}
+	constexpr size_type minVsz = std::max(degree / 2 - 1, 1);
+	size_type target = static_cast<size_type>(fillFactor * order + 0.5);
+	target = std::clamp<size_type>(target, minVsz, order);
+
+	std::vector<node_base_ptr> nodes;
+	std::vector<T> separators;
+	//建完之前节点都没挂到树上，拷贝值、申请内存抛异常时按这里的记录逐个释放。
+	//节点的vsz始终是已经构造好的值的个数
+	std::vector<node_base_ptr> built;
+	auto new_node = [this, &built](bool leaf) {
+		built.push_back(nullptr);
+		node_ptr node = create_node(leaf);
+		built.back() = node;
+		return node;
+	};
+	try {
+		//叶子层
+		size_type count = group_count(n + 1, target);
+		size_type base = (n + 1) / count;
+		size_type extra = (n + 1) % count;
+		nodes.reserve(count);
+		separators.reserve(count - 1);
+		for (size_type i = 0; i < count; ++i) {
+			degree_t vsz = static_cast<degree_t>(base + (i < extra) - 1);
+			node_ptr leaf = new_node(true);
+			for (degree_t j = 0; j < vsz; ++j, ++first) {
+				construct(leaf->values() + j, *first);
+				leaf->vsz = j + 1;
+			}
+			nodes.push_back(leaf);
+			if (i + 1 != count) {
+				separators.push_back(*first);
+				++first;
+			}
+		}
+		//内部层，分隔值来自下一层
+		while (nodes.size() > 1) {
+			size_type units = nodes.size();
+			count = group_count(units, target);
+			base = units / count;
+			extra = units % count;
+			std::vector<node_base_ptr> parents;
+			std::vector<T> upSeparators;
+			parents.reserve(count);
+			upSeparators.reserve(count - 1);
+			size_type k = 0;	//下一层的孩子和分隔值的下标
+			for (size_type i = 0; i < count; ++i) {
+				degree_t csz = static_cast<degree_t>(base + (i < extra));
+				node_ptr parent = new_node(false);
+				for (degree_t j = 0; j < csz; ++j, ++k) {
+					parent->children[j] = nodes[k];
+					nodes[k]->parent = parent;
+					if (j + 1 != csz) {
+						construct(parent->values() + j, std::move(separators[k]));
+						parent->vsz = j + 1;
+					}
+				}
+				parents.push_back(parent);
+				if (i + 1 != count) {
+					upSeparators.push_back(std::move(separators[k - 1]));
+				}
+			}
+			nodes.swap(parents);
+			separators.swap(upSeparators);
+		}
+	} catch (...) {
+		for (node_base_ptr node : built) {
+			if (node) {
+				destroy_node(node);
+			}
+		}
+		throw;
+	}
+
+	node_base_ptr root = nodes.front();
+	root->parent = nullptr;
+	m_header->parent = root;
+	m_header->children[0] = min_node(root).first;
+	m_header->children[1] = max_node(root).first;
+	m_size = n;
+}
+
 template<typename T, typename Comp, degree_t degree>
 typename b_tree<T, Comp, degree>::iterator 
 b_tree<T, Comp, degree>::find(const key_type& key) noexcept {
 	iterator iter = lbound(key);
-	if (m_comp(static_cast<node_ptr>(iter.node)->values[iter.node], key)) {
+	if (end() == iter || m_comp(key, *iter)) {
 		return end();
 	}
 
@@ -1140,11 +1665,11 @@ template<typename T, typename Comp, degree_t degree>
 typename b_tree<T, Comp, degree>::const_iterator 
 b_tree<T, Comp, degree>::find(const key_type& key) const noexcept {
 	iterator iter = lbound(key);
-	if (m_comp(*iter, key)) {
+	if (end() == iter || m_comp(key, *iter)) {
 		return end();
 	}
 
-	return const_iterator(iter.node, iter.index);
+	return const_iterator(iter.node, iter.index, iter.header);
 }
 
 template<typename T, typename Comp, degree_t degree>
@@ -1249,7 +1774,7 @@ b_tree<T, Comp, degree>::serialize() {
 				if (i != 0) {
 					str.append(1, ',');
 				}
-				str += std::to_string(root->values[i]);
+				str += std::to_string(root->values()[i]);
 				if (!is_leaf(root)) {
 					que.push(static_cast<node_ptr>(root->children[i]));
 				}
@@ -1286,7 +1811,7 @@ degree_t b_tree<T, Comp, degree>::check(b_tree_node<T>* tree) {
 			return -1;
 		}
 	}
-	if (!std::is_sorted(tree->values, tree->values + tree->vsz, m_comp)) {
+	if (!std::is_sorted(tree->values(), tree->values() + tree->vsz, m_comp)) {
 		std::cout << "node is not sorted" << std::endl;
 		return -1;
 	}
@@ -0,0 +1,951 @@
+#pragma once
+
+#include <stddef.h>
+#include <type_traits>
+#include <functional>
+#include <algorithm>
+#include <initializer_list>
+#include <iterator>
+#include <utility>
+#include "tree_node.h"
+#include "construct.h"
+#include "system.h"
+
+namespace nano {
+
+inline constexpr degree_t BPLUS_DEFAULT_DEGREE = 64;
+
+/**
+ * @brief 叶子: 节点头 | prev、next | values[degree - 1]，所有值都只放在叶子里
+ *        度数是模板参数，节点大小编译期就知道，一个节点只申请一块内存
+ */
+template<typename T, degree_t degree>
+struct bplus_tree_leaf : public bplus_tree_leaf_base {
+	T* values() noexcept { return reinterpret_cast<T*>(storage); }
+	const T* values() const noexcept { return reinterpret_cast<const T*>(storage); }
+
+	alignas(T) unsigned char storage[sizeof(T) * (degree - 1)];
+};
+
+/**
+ * @brief 内部节点只放分隔key，keys[i]不小于children[i]里的值，不大于children[i + 1]里的值
+ *        key是插入时叶子分裂出来的值的拷贝，删除值不需要改key
+ *        多留一个孩子的位置，先插入再分裂，degree是奇数时两边也能分得一样多
+ */
+template<typename T, degree_t degree>
+struct bplus_tree_inner : public bplus_tree_node_base {
+	T* keys() noexcept { return reinterpret_cast<T*>(storage); }
+	const T* keys() const noexcept { return reinterpret_cast<const T*>(storage); }
+
+	bplus_tree_node_base* children[degree + 1];
+	alignas(T) unsigned char storage[sizeof(T) * degree];
+};
+
+/**
+ * @brief 和set一样只能读，改了值会破坏顺序
+ *        end是头节点，下标为0
+ */
+template<typename T, degree_t degree>
+struct bplus_tree_iterator {
+	using iterator_category = std::bidirectional_iterator_tag;
+	using value_type 		= T;
+	using difference_type 	= ptrdiff_t;
+	using pointer 			= const T*;
+	using reference 		= const T&;
+	using leaf_base_ptr 	= bplus_tree_leaf_base*;
+	using leaf_ptr 			= const bplus_tree_leaf<T, degree>*;
+	using self 				= bplus_tree_iterator;
+
+	bplus_tree_iterator() noexcept = default;
+	bplus_tree_iterator(leaf_base_ptr _node, degree_t _index) noexcept :
+		node(_node),
+		index(_index) {
+	}
+
+	//叶子内下标加一，走到叶子末尾换下一个叶子，不用像b_tree一样回到父节点
+	self& operator++() noexcept {
+		if (++index == node->vsz) {
+			node = node->next;
+			index = 0;
+		}
+		return *this;
+	}
+
+	self operator++(int) noexcept {
+		self temp = *this;
+		++*this;
+		return temp;
+	}
+
+	self& operator--() noexcept {
+		if (0 == index) {
+			node = node->prev;
+			index = node->vsz;
+		}
+		--index;
+		return *this;
+	}
+
+	self operator--(int) noexcept {
+		self temp = *this;
+		--*this;
+		return temp;
+	}
+
+	reference operator*() const noexcept {
+		return static_cast<leaf_ptr>(node)->values()[index];
+	}
+
+	pointer operator->() const noexcept {
+		return &(operator*());
+	}
+
+	bool operator==(const self& other) const noexcept {
+		return node == other.node && index == other.index;
+	}
+	bool operator!=(const self& other) const noexcept {
+		return !(*this == other);
+	}
+
+	leaf_base_ptr node = nullptr;
+	degree_t index = 0;
+};
+
+/**
+ * @brief B+树，值都在叶子里，叶子串成双向链表，内部节点只有分隔key
+ *        顺序遍历不用回到父节点，区间扫描见scan
+ *
+ * @tparam T
+ * @tparam Comp
+ * @tparam degree 内部节点最多的孩子数，叶子最多放degree - 1个值
+ */
+template<typename T, typename Comp = std::less<T>,
+	degree_t degree = BPLUS_DEFAULT_DEGREE>
+class bplus_tree {
+	static_assert(degree >= 4, "degree at least 4");
+	static_assert(std::is_copy_constructible<T>::value, "copy constructible required");
+	static_assert(std::is_move_constructible<T>::value, "move constructible required");
+	static_assert(std::is_move_assignable<T>::value, "move assignable required");
+
+public:
+	constexpr static degree_t order = degree - 1;
+
+public:
+	using key_type 					= T;
+	using value_type 				= T;
+	using pointer 					= T*;
+	using const_pointer 			= const T*;
+	using reference 				= T&;
+	using const_reference 			= const T&;
+	using size_type 				= size_t;
+	using difference_type 			= ptrdiff_t;
+	using iterator 					= bplus_tree_iterator<T, degree>;
+	using const_iterator 			= iterator;
+	using reverse_iterator 			= std::reverse_iterator<iterator>;
+	using const_reverse_iterator 	= reverse_iterator;
+
+public:
+	iterator begin() const noexcept { return iterator(m_header.next, 0); }
+	iterator end() const noexcept { return iterator(header(), 0); }
+	reverse_iterator rbegin() const noexcept { return reverse_iterator(end()); }
+	reverse_iterator rend() const noexcept { return reverse_iterator(begin()); }
+
+public:
+	explicit bplus_tree(const Comp& comp = Comp()) :
+		m_comp(comp) {
+		reset();
+	}
+
+	bplus_tree(const std::initializer_list<T>& ilist, const Comp& comp = Comp()) :
+		bplus_tree(ilist.begin(), ilist.end(), comp) {
+	}
+
+	template<std::input_iterator InputIter>
+	bplus_tree(InputIter first, InputIter last, const Comp& comp = Comp()) :
+		bplus_tree(comp) {
+		insert_multi(first, last);
+	}
+
+	bplus_tree(const bplus_tree& other);
+
+	bplus_tree(bplus_tree&& other) noexcept :
+		m_comp(std::move(other.m_comp)) {
+		reset();
+		steal(other);
+	}
+
+	~bplus_tree() { clear(); }
+
+	bplus_tree& operator=(const bplus_tree& other);
+
+	bplus_tree& operator=(bplus_tree&& other) noexcept {
+		if (this != &other) {
+			clear();
+			m_comp = std::move(other.m_comp);
+			steal(other);
+		}
+		return *this;
+	}
+
+	//insert
+	std::pair<iterator, bool> insert_unique(const key_type& key) { return insert_unique_value(key); }
+	std::pair<iterator, bool> insert_unique(key_type&& key) { return insert_unique_value(std::move(key)); }
+	iterator insert_multi(const key_type& key) { return insert_multi_value(key); }
+	iterator insert_multi(key_type&& key) { return insert_multi_value(std::move(key)); }
+
+	template<std::input_iterator InputIter>
+	void insert_unique(InputIter first, InputIter last) {
+		for (; first != last; ++first) {
+			insert_unique(*first);
+		}
+	}
+
+	template<std::input_iterator InputIter>
+	void insert_multi(InputIter first, InputIter last) {
+		for (; first != last; ++first) {
+			insert_multi(*first);
+		}
+	}
+
+	//erase
+	iterator erase(iterator pos);
+	void erase(iterator first, iterator last);
+	size_type erase_unique(const key_type& key);
+	size_type erase_multi(const key_type& key);
+	void clear() noexcept;
+
+	//find
+	iterator find(const key_type& key) const;
+	iterator lower_bound(const key_type& key) const;
+	iterator upper_bound(const key_type& key) const;
+	std::pair<iterator, iterator> equal_range(const key_type& key) const {
+		return { lower_bound(key), upper_bound(key) };
+	}
+	size_type count(const key_type& key) const {
+		return std::distance(lower_bound(key), upper_bound(key));
+	}
+	bool contains(const key_type& key) const { return find(key) != end(); }
+
+	/**
+	 * @brief 按顺序把[lo, hi)里的值交给func，返回调用的次数
+	 *        只在第一个叶子二分一次，之后沿着叶子链表一页一页地走，
+	 *        只有最后一页需要再二分找结尾，中间的页不用逐个和hi比较
+	 * @param func 参数是const T&，返回bool时返回false就停下
+	 */
+	template<typename Func>
+	size_type scan(const key_type& lo, const key_type& hi, Func&& func) const;
+
+	//other
+	void swap(bplus_tree& rhs) noexcept;
+	size_type size() const noexcept { return m_size; }
+	bool empty() const noexcept { return 0 == m_size; }
+#ifdef BPLUS_TREE_DEBUG
+	bool verify() const;
+#endif //BPLUS_TREE_DEBUG
+
+private:
+	using node_base_ptr 			= bplus_tree_node_base*;
+	using leaf_base_ptr 			= bplus_tree_leaf_base*;
+	using leaf_type 				= bplus_tree_leaf<T, degree>;
+	using leaf_ptr 					= leaf_type*;
+	using inner_type 				= bplus_tree_inner<T, degree>;
+	using inner_ptr 				= inner_type*;
+
+	//根以外的节点最少的值、key个数，合并后不会超过order
+	constexpr static degree_t MIN_VALUES = order / 2;
+	constexpr static degree_t MIN_KEYS = (degree + 1) / 2 - 1;
+
+private:
+	//node operation
+	static leaf_ptr create_leaf() { return new leaf_type; }
+	static inner_ptr create_inner() {
+		inner_ptr node = new inner_type;
+		node->leaf = false;
+		return node;
+	}
+	static void destroy_leaf(leaf_ptr leaf) noexcept;
+	static void destroy_inner(inner_ptr node) noexcept;
+	static void destroy_subtree(node_base_ptr node) noexcept;
+	node_base_ptr copy_node(node_base_ptr node, node_base_ptr parent, leaf_base_ptr& last);
+	static degree_t child_index(inner_ptr parent, node_base_ptr child) noexcept {
+		degree_t i = 0;
+		while (parent->children[i] != child) {
+			++i;
+		}
+		return i;
+	}
+
+	//在first[0, size)的index处插入/删除，size是插入/删除前的个数
+	template<typename V>
+	static void insert_at(T* first, degree_t size, degree_t index, V&& value);
+	static void erase_at(T* first, degree_t size, degree_t index);
+
+private:
+	//auxiliary functions
+	leaf_base_ptr header() const noexcept { return const_cast<leaf_base_ptr>(&m_header); }
+	void reset() noexcept;
+	void steal(bplus_tree& other) noexcept;
+	template<bool Upper>
+	leaf_ptr find_leaf(const key_type& key) const;
+	degree_t value_lbound(const leaf_type* leaf, const key_type& key) const {
+		return std::lower_bound(leaf->values(), leaf->values() + leaf->vsz, key, m_comp) -
+			leaf->values();
+	}
+	degree_t value_ubound(const leaf_type* leaf, const key_type& key) const {
+		return std::upper_bound(leaf->values(), leaf->values() + leaf->vsz, key, m_comp) -
+			leaf->values();
+	}
+	template<typename V>
+	std::pair<iterator, bool> insert_unique_value(V&& value);
+	template<typename V>
+	iterator insert_multi_value(V&& value);
+	template<typename V>
+	iterator insert_first(V&& value);
+	template<typename V>
+	iterator insert_value(leaf_ptr leaf, degree_t index, V&& value);
+	leaf_ptr split_leaf(leaf_ptr leaf);
+	void split_inner(inner_ptr node);
+	void insert_into_parent(node_base_ptr left, const key_type& key, node_base_ptr right);
+	void rebalance_leaf(leaf_ptr& leaf, degree_t& index);
+	void rebalance_inner(inner_ptr node);
+	void merge_leaf(leaf_ptr left, leaf_ptr right);
+	void merge_inner(inner_ptr left, inner_ptr right, key_type& separator);
+	void remove_child(inner_ptr node, degree_t keyIndex);
+#ifdef BPLUS_TREE_DEBUG
+	int verify_node(node_base_ptr node, const T* lo, const T* hi, size_type& count) const;
+#endif //BPLUS_TREE_DEBUG
+
+private:
+	node_base_ptr m_root = nullptr;
+	bplus_tree_leaf_base m_header;		//叶子链表的头节点，也是end
+	size_type m_size = 0;
+	Comp m_comp;
+};
+
+template<typename T, typename Comp, degree_t degree>
+bplus_tree<T, Comp, degree>::bplus_tree(const bplus_tree& other) :
+	m_comp(other.m_comp) {
+	reset();
+	if (other.m_root) {
+		leaf_base_ptr last = &m_header;
+		m_root = copy_node(other.m_root, nullptr, last);
+		last->next = &m_header;
+		m_header.prev = last;
+		m_size = other.m_size;
+	}
+}
+
+template<typename T, typename Comp, degree_t degree>
+bplus_tree<T, Comp, degree>&
+bplus_tree<T, Comp, degree>::operator=(const bplus_tree& other) {
+	if (this != &other) {
+		bplus_tree temp(other);
+		*this = std::move(temp);
+	}
+	return *this;
+}
+
+template<typename T, typename Comp, degree_t degree>
+void bplus_tree<T, Comp, degree>::swap(bplus_tree& rhs) noexcept {
+	//头节点在对象里面，不能直接交换指针，要把首尾叶子重新挂上
+	bplus_tree temp(std::move(rhs));
+	rhs = std::move(*this);
+	*this = std::move(temp);
+}
+
+template<typename T, typename Comp, degree_t degree>
+void bplus_tree<T, Comp, degree>::reset() noexcept {
+	m_root = nullptr;
+	m_size = 0;
+	m_header.prev = m_header.next = &m_header;
+}
+
+template<typename T, typename Comp, degree_t degree>
+void bplus_tree<T, Comp, degree>::steal(bplus_tree& other) noexcept {
+	if (other.m_root) {
+		m_root = other.m_root;
+		m_size = other.m_size;
+		m_header.next = other.m_header.next;
+		m_header.prev = other.m_header.prev;
+		m_header.next->prev = &m_header;
+		m_header.prev->next = &m_header;
+	}
+	other.reset();
+}
+
+template<typename T, typename Comp, degree_t degree>
+void bplus_tree<T, Comp, degree>::destroy_leaf(leaf_ptr leaf) noexcept {
+	destroy(leaf->values(), leaf->values() + leaf->vsz);
+	delete leaf;
+}
+
+template<typename T, typename Comp, degree_t degree>
+void bplus_tree<T, Comp, degree>::destroy_inner(inner_ptr node) noexcept {
+	destroy(node->keys(), node->keys() + node->vsz);
+	delete node;
+}
+
+template<typename T, typename Comp, degree_t degree>
+void bplus_tree<T, Comp, degree>::destroy_subtree(node_base_ptr node) noexcept {
+	if (node->leaf) {
+		destroy_leaf(static_cast<leaf_ptr>(node));
+		return;
+	}
+	inner_ptr inner = static_cast<inner_ptr>(node);
+	for (degree_t i = 0; i <= inner->vsz; ++i) {
+		destroy_subtree(inner->children[i]);
+	}
+	destroy_inner(inner);
+}
+
+/**
+ * @brief 先序复制，叶子按从左到右的顺序复制出来，顺便挂到last后面
+ */
+template<typename T, typename Comp, degree_t degree>
+typename bplus_tree<T, Comp, degree>::node_base_ptr
+bplus_tree<T, Comp, degree>::copy_node(node_base_ptr node, node_base_ptr parent, leaf_base_ptr& last) {
+	if (node->leaf) {
+		leaf_ptr from = static_cast<leaf_ptr>(node);
+		leaf_ptr newNode = create_leaf();
+		for (degree_t i = 0; i < from->vsz; ++i) {
+			construct(newNode->values() + i, from->values()[i]);
+		}
+		newNode->vsz = from->vsz;
+		newNode->parent = parent;
+		newNode->prev = last;
+		last->next = newNode;
+		last = newNode;
+		return newNode;
+	}
+	inner_ptr from = static_cast<inner_ptr>(node);
+	inner_ptr newNode = create_inner();
+	for (degree_t i = 0; i < from->vsz; ++i) {
+		construct(newNode->keys() + i, from->keys()[i]);
+	}
+	newNode->vsz = from->vsz;
+	newNode->parent = parent;
+	for (degree_t i = 0; i <= from->vsz; ++i) {
+		newNode->children[i] = copy_node(from->children[i], newNode, last);
+	}
+	return newNode;
+}
+
+template<typename T, typename Comp, degree_t degree>
+template<typename V>
+void bplus_tree<T, Comp, degree>::insert_at(T* first, degree_t size, degree_t index, V&& value) {
+	if (index == size) {
+		construct(first + size, std::forward<V>(value));
+	} else {
+		construct(first + size, std::move(first[size - 1]));
+		std::move_backward(first + index, first + size - 1, first + size);
+		first[index] = std::forward<V>(value);
+	}
+}
+
+template<typename T, typename Comp, degree_t degree>
+void bplus_tree<T, Comp, degree>::erase_at(T* first, degree_t size, degree_t index) {
+	std::move(first + index + 1, first + size, first + index);
+	destroy(first + size - 1);
+}
+
+template<typename T, typename Comp, degree_t degree>
+template<bool Upper>
+typename bplus_tree<T, Comp, degree>::leaf_ptr
+bplus_tree<T, Comp, degree>::find_leaf(const key_type& key) const {
+	node_base_ptr node = m_root;
+	while (!node->leaf) {
+		inner_ptr inner = static_cast<inner_ptr>(node);
+		const T* keys = inner->keys();
+		degree_t index;
+		if constexpr (Upper) {
+			index = std::upper_bound(keys, keys + inner->vsz, key, m_comp) - keys;
+		} else {
+			index = std::lower_bound(keys, keys + inner->vsz, key, m_comp) - keys;
+		}
+		node = inner->children[index];
+	}
+	return static_cast<leaf_ptr>(node);
+}
+
+/**
+ * @brief 叶子里都比key小时，要找的是下一个叶子的第一个值
+ */
+template<typename T, typename Comp, degree_t degree>
+typename bplus_tree<T, Comp, degree>::iterator
+bplus_tree<T, Comp, degree>::lower_bound(const key_type& key) const {
+	if (nullptr == m_root) {
+		return end();
+	}
+	leaf_ptr leaf = find_leaf<false>(key);
+	degree_t index = value_lbound(leaf, key);
+	return index == leaf->vsz ? iterator(leaf->next, 0) : iterator(leaf, index);
+}
+
+template<typename T, typename Comp, degree_t degree>
+typename bplus_tree<T, Comp, degree>::iterator
+bplus_tree<T, Comp, degree>::upper_bound(const key_type& key) const {
+	if (nullptr == m_root) {
+		return end();
+	}
+	leaf_ptr leaf = find_leaf<true>(key);
+	degree_t index = value_ubound(leaf, key);
+	return index == leaf->vsz ? iterator(leaf->next, 0) : iterator(leaf, index);
+}
+
+template<typename T, typename Comp, degree_t degree>
+typename bplus_tree<T, Comp, degree>::iterator
+bplus_tree<T, Comp, degree>::find(const key_type& key) const {
+	iterator iter = lower_bound(key);
+	if (end() == iter || m_comp(key, *iter)) {
+		return end();
+	}
+	return iter;
+}
+
+template<typename T, typename Comp, degree_t degree>
+template<typename Func>
+typename bplus_tree<T, Comp, degree>::size_type
+bplus_tree<T, Comp, degree>::scan(const key_type& lo, const key_type& hi, Func&& func) const {
+	iterator first = lower_bound(lo);
+	leaf_base_ptr node = first.node;
+	degree_t index = first.index;
+	size_type n = 0;
+	while (node != &m_header) {
+		const leaf_type* leaf = static_cast<const leaf_type*>(node);
+		NANO_PREFETCH(leaf->next);
+		const T* values = leaf->values();
+		degree_t last = leaf->vsz;
+		//这一页最后一个值不小于hi，这一页就是最后一页
+		bool done = !m_comp(values[last - 1], hi);
+		if (done) {
+			last = std::lower_bound(values + index, values + last, hi, m_comp) - values;
+		}
+		for (; index < last; ++index) {
+			++n;
+			if constexpr (std::is_same_v<std::invoke_result_t<Func&, const T&>, bool>) {
+				if (!func(values[index])) {
+					return n;
+				}
+			} else {
+				func(values[index]);
+			}
+		}
+		if (done) {
+			break;
+		}
+		node = leaf->next;
+		index = 0;
+	}
+	return n;
+}
+
+template<typename T, typename Comp, degree_t degree>
+template<typename V>
+typename bplus_tree<T, Comp, degree>::iterator
+bplus_tree<T, Comp, degree>::insert_first(V&& value) {
+	leaf_ptr leaf = create_leaf();
+	construct(leaf->values(), std::forward<V>(value));
+	leaf->vsz = 1;
+	leaf->prev = leaf->next = &m_header;
+	m_header.prev = m_header.next = leaf;
+	m_root = leaf;
+	m_size = 1;
+	return iterator(leaf, 0);
+}
+
+template<typename T, typename Comp, degree_t degree>
+template<typename V>
+std::pair<typename bplus_tree<T, Comp, degree>::iterator, bool>
+bplus_tree<T, Comp, degree>::insert_unique_value(V&& value) {
+	if (nullptr == m_root) {
+		return { insert_first(std::forward<V>(value)), true };
+	}
+	leaf_ptr leaf = find_leaf<false>(value);
+	degree_t index = value_lbound(leaf, value);
+	//叶子里都比value小时，和value相等的值可能在下一个叶子的开头
+	iterator next = index == leaf->vsz ? iterator(leaf->next, 0) : iterator(leaf, index);
+	if (end() != next && !m_comp(value, *next)) {
+		return { next, false };
+	}
+	return { insert_value(leaf, index, std::forward<V>(value)), true };
+}
+
+/**
+ * @brief 相等的值插到最后面
+ */
+template<typename T, typename Comp, degree_t degree>
+template<typename V>
+typename bplus_tree<T, Comp, degree>::iterator
+bplus_tree<T, Comp, degree>::insert_multi_value(V&& value) {
+	if (nullptr == m_root) {
+		return insert_first(std::forward<V>(value));
+	}
+	leaf_ptr leaf = find_leaf<true>(value);
+	return insert_value(leaf, value_ubound(leaf, value), std::forward<V>(value));
+}
+
+/**
+ * @brief 叶子满了先分裂再插入，分裂后左边留下的个数不少于右边，index正好在分界处时插到左边末尾
+ */
+template<typename T, typename Comp, degree_t degree>
+template<typename V>
+typename bplus_tree<T, Comp, degree>::iterator
+bplus_tree<T, Comp, degree>::insert_value(leaf_ptr leaf, degree_t index, V&& value) {
+	if (order == leaf->vsz) {
+		leaf_ptr right = split_leaf(leaf);
+		if (index > leaf->vsz) {
+			index -= leaf->vsz;
+			leaf = right;
+		}
+	}
+	insert_at(leaf->values(), leaf->vsz, index, std::forward<V>(value));
+	++leaf->vsz;
+	++m_size;
+	return iterator(leaf, index);
+}
+
+template<typename T, typename Comp, degree_t degree>
+typename bplus_tree<T, Comp, degree>::leaf_ptr
+bplus_tree<T, Comp, degree>::split_leaf(leaf_ptr leaf) {
+	constexpr degree_t mid = order - order / 2;		//左边留下的个数
+	leaf_ptr right = create_leaf();
+	T* from = leaf->values();
+	T* to = right->values();
+	for (degree_t i = mid; i < order; ++i) {
+		construct(to + i - mid, std::move(from[i]));
+		destroy(from + i);
+	}
+	right->vsz = order - mid;
+	leaf->vsz = mid;
+	right->prev = leaf;
+	right->next = leaf->next;
+	leaf->next->prev = right;
+	leaf->next = right;
+	insert_into_parent(leaf, to[0], right);
+	return right;
+}
+
+/**
+ * @brief 插入后有degree + 1个孩子，左边留下一半(多的一个放左边)，中间的key提到父节点
+ */
+template<typename T, typename Comp, degree_t degree>
+void bplus_tree<T, Comp, degree>::split_inner(inner_ptr node) {
+	constexpr degree_t mid = (degree + 2) / 2;		//左边留下的孩子数
+	inner_ptr sibling = create_inner();
+	T* from = node->keys();
+	T* to = sibling->keys();
+	for (degree_t i = mid; i < degree; ++i) {
+		construct(to + i - mid, std::move(from[i]));
+		destroy(from + i);
+	}
+	for (degree_t i = mid; i <= degree; ++i) {
+		sibling->children[i - mid] = node->children[i];
+		node->children[i]->parent = sibling;
+	}
+	sibling->vsz = degree - mid;
+	T separator(std::move(from[mid - 1]));
+	destroy(from + mid - 1);
+	node->vsz = mid - 1;
+	insert_into_parent(node, separator, sibling);
+}
+
+/**
+ * @brief 把right插到left的右边，key是它们之间的分隔，父节点插满了再分裂
+ */
+template<typename T, typename Comp, degree_t degree>
+void bplus_tree<T, Comp, degree>::insert_into_parent(node_base_ptr left,
+		const key_type& key, node_base_ptr right) {
+	inner_ptr parent = static_cast<inner_ptr>(left->parent);
+	if (nullptr == parent) {
+		inner_ptr root = create_inner();
+		construct(root->keys(), key);
+		root->vsz = 1;
+		root->children[0] = left;
+		root->children[1] = right;
+		left->parent = right->parent = root;
+		m_root = root;
+		return;
+	}
+	degree_t index = child_index(parent, left);
+	insert_at(parent->keys(), parent->vsz, index, key);
+	node_base_ptr* children = parent->children;
+	std::move_backward(children + index + 1, children + parent->vsz + 1, children + parent->vsz + 2);
+	children[index + 1] = right;
+	right->parent = parent;
+	if (degree == ++parent->vsz) {
+		split_inner(parent);
+	}
+}
+
+/**
+ * @brief 删除后返回下一个值，叶子借值、合并时跟着调整下标
+ */
+template<typename T, typename Comp, degree_t degree>
+typename bplus_tree<T, Comp, degree>::iterator
+bplus_tree<T, Comp, degree>::erase(iterator pos) {
+	leaf_ptr leaf = static_cast<leaf_ptr>(pos.node);
+	degree_t index = pos.index;
+	erase_at(leaf->values(), leaf->vsz, index);
+	--leaf->vsz;
+	--m_size;
+	if (leaf == m_root) {
+		if (0 == leaf->vsz) {
+			destroy_leaf(leaf);
+			reset();
+			return end();
+		}
+	} else if (leaf->vsz < MIN_VALUES) {
+		rebalance_leaf(leaf, index);
+	}
+	return index == leaf->vsz ? iterator(leaf->next, 0) : iterator(leaf, index);
+}
+
+/**
+ * @brief 借值、合并都会让迭代器失效，按个数删
+ */
+template<typename T, typename Comp, degree_t degree>
+void bplus_tree<T, Comp, degree>::erase(iterator first, iterator last) {
+	for (difference_type n = std::distance(first, last); n > 0; --n) {
+		first = erase(first);
+	}
+}
+
+template<typename T, typename Comp, degree_t degree>
+typename bplus_tree<T, Comp, degree>::size_type
+bplus_tree<T, Comp, degree>::erase_unique(const key_type& key) {
+	iterator iter = find(key);
+	if (end() == iter) {
+		return 0;
+	}
+	erase(iter);
+	return 1;
+}
+
+template<typename T, typename Comp, degree_t degree>
+typename bplus_tree<T, Comp, degree>::size_type
+bplus_tree<T, Comp, degree>::erase_multi(const key_type& key) {
+	iterator first = lower_bound(key);
+	iterator last = upper_bound(key);
+	size_type n = std::distance(first, last);
+	erase(first, last);
+	return n;
+}
+
+template<typename T, typename Comp, degree_t degree>
+void bplus_tree<T, Comp, degree>::clear() noexcept {
+	if (m_root) {
+		destroy_subtree(m_root);
+	}
+	reset();
+}
+
+/**
+ * @brief 叶子值太少，先向左右兄弟借一个，借不到就和兄弟合并
+ *        只在同一个父节点下的兄弟间移动值，祖先的key不用改
+ */
+template<typename T, typename Comp, degree_t degree>
+void bplus_tree<T, Comp, degree>::rebalance_leaf(leaf_ptr& leaf, degree_t& index) {
+	inner_ptr parent = static_cast<inner_ptr>(leaf->parent);
+	degree_t i = child_index(parent, leaf);
+	leaf_ptr left = i > 0 ? static_cast<leaf_ptr>(parent->children[i - 1]) : nullptr;
+	leaf_ptr right = i < parent->vsz ? static_cast<leaf_ptr>(parent->children[i + 1]) : nullptr;
+	if (left && left->vsz > MIN_VALUES) {
+		T* from = left->values();
+		insert_at(leaf->values(), leaf->vsz, 0, std::move(from[left->vsz - 1]));
+		destroy(from + left->vsz - 1);
+		--left->vsz;
+		++leaf->vsz;
+		++index;
+		parent->keys()[i - 1] = leaf->values()[0];
+	} else if (right && right->vsz > MIN_VALUES) {
+		T* from = right->values();
+		construct(leaf->values() + leaf->vsz, std::move(from[0]));
+		erase_at(from, right->vsz, 0);
+		--right->vsz;
+		++leaf->vsz;
+		parent->keys()[i] = from[0];
+	} else if (left) {
+		index += left->vsz;
+		merge_leaf(left, leaf);
+		leaf = left;
+		remove_child(parent, i - 1);
+	} else {
+		merge_leaf(leaf, right);
+		remove_child(parent, i);
+	}
+}
+
+template<typename T, typename Comp, degree_t degree>
+void bplus_tree<T, Comp, degree>::merge_leaf(leaf_ptr left, leaf_ptr right) {
+	T* to = left->values() + left->vsz;
+	T* from = right->values();
+	for (degree_t i = 0; i < right->vsz; ++i) {
+		construct(to + i, std::move(from[i]));
+	}
+	left->vsz += right->vsz;
+	left->next = right->next;
+	right->next->prev = left;
+	destroy_leaf(right);
+}
+
+/**
+ * @brief 去掉keys[keyIndex]和children[keyIndex + 1]，根只剩一个孩子时树变矮
+ */
+template<typename T, typename Comp, degree_t degree>
+void bplus_tree<T, Comp, degree>::remove_child(inner_ptr node, degree_t keyIndex) {
+	erase_at(node->keys(), node->vsz, keyIndex);
+	node_base_ptr* children = node->children;
+	std::move(children + keyIndex + 2, children + node->vsz + 1, children + keyIndex + 1);
+	--node->vsz;
+	if (node == m_root) {
+		if (0 == node->vsz) {
+			m_root = children[0];
+			m_root->parent = nullptr;
+			destroy_inner(node);
+		}
+	} else if (node->vsz < MIN_KEYS) {
+		rebalance_inner(node);
+	}
+}
+
+/**
+ * @brief 向兄弟借孩子要经过父节点转一下: 父节点的key下来，兄弟的key上去
+ */
+template<typename T, typename Comp, degree_t degree>
+void bplus_tree<T, Comp, degree>::rebalance_inner(inner_ptr node) {
+	inner_ptr parent = static_cast<inner_ptr>(node->parent);
+	degree_t i = child_index(parent, node);
+	inner_ptr left = i > 0 ? static_cast<inner_ptr>(parent->children[i - 1]) : nullptr;
+	inner_ptr right = i < parent->vsz ? static_cast<inner_ptr>(parent->children[i + 1]) : nullptr;
+	if (left && left->vsz > MIN_KEYS) {
+		T* from = left->keys();
+		insert_at(node->keys(), node->vsz, 0, std::move(parent->keys()[i - 1]));
+		std::move_backward(node->children, node->children + node->vsz + 1, node->children + node->vsz + 2);
+		node->children[0] = left->children[left->vsz];
+		node->children[0]->parent = node;
+		parent->keys()[i - 1] = std::move(from[left->vsz - 1]);
+		destroy(from + left->vsz - 1);
+		--left->vsz;
+		++node->vsz;
+	} else if (right && right->vsz > MIN_KEYS) {
+		T* from = right->keys();
+		construct(node->keys() + node->vsz, std::move(parent->keys()[i]));
+		node->children[node->vsz + 1] = right->children[0];
+		node->children[node->vsz + 1]->parent = node;
+		++node->vsz;
+		parent->keys()[i] = std::move(from[0]);
+		erase_at(from, right->vsz, 0);
+		std::move(right->children + 1, right->children + right->vsz + 1, right->children);
+		--right->vsz;
+	} else if (left) {
+		merge_inner(left, node, parent->keys()[i - 1]);
+		remove_child(parent, i - 1);
+	} else {
+		merge_inner(node, right, parent->keys()[i]);
+		remove_child(parent, i);
+	}
+}
+
+/**
+ * @brief 父节点的分隔key下来放在中间，right的key和孩子接到left后面
+ */
+template<typename T, typename Comp, degree_t degree>
+void bplus_tree<T, Comp, degree>::merge_inner(inner_ptr left, inner_ptr right, key_type& separator) {
+	T* to = left->keys() + left->vsz;
+	T* from = right->keys();
+	construct(to, std::move(separator));
+	for (degree_t i = 0; i < right->vsz; ++i) {
+		construct(to + i + 1, std::move(from[i]));
+	}
+	for (degree_t i = 0; i <= right->vsz; ++i) {
+		left->children[left->vsz + 1 + i] = right->children[i];
+		right->children[i]->parent = left;
+	}
+	left->vsz += right->vsz + 1;
+	destroy_inner(right);
+}
+
+#ifdef BPLUS_TREE_DEBUG
+/**
+ * @brief 检查节点大小、key的范围、父指针、所有叶子在同一层，再正反走一遍叶子链表
+ */
+template<typename T, typename Comp, degree_t degree>
+bool bplus_tree<T, Comp, degree>::verify() const {
+	if (nullptr == m_root) {
+		return 0 == m_size && m_header.next == &m_header && m_header.prev == &m_header;
+	}
+	size_type count = 0;
+	if (m_root->parent || verify_node(m_root, nullptr, nullptr, count) < 0 || count != m_size) {
+		return false;
+	}
+	const bplus_tree_leaf_base* prev = &m_header;
+	count = 0;
+	for (const bplus_tree_leaf_base* leaf = m_header.next; leaf != &m_header; leaf = leaf->next) {
+		if (leaf->prev != prev || !leaf->leaf) {
+			return false;
+		}
+		count += leaf->vsz;
+		prev = leaf;
+	}
+	return m_header.prev == prev && count == m_size && std::is_sorted(begin(), end(), m_comp);
+}
+
+template<typename T, typename Comp, degree_t degree>
+int bplus_tree<T, Comp, degree>::verify_node(node_base_ptr node, const T* lo,
+		const T* hi, size_type& count) const {
+	const T* first;
+	if (node->leaf) {
+		first = static_cast<leaf_ptr>(node)->values();
+		if (node->vsz < (node == m_root ? 1 : MIN_VALUES) || node->vsz > order) {
+			return -1;
+		}
+	} else {
+		first = static_cast<inner_ptr>(node)->keys();
+		if (node->vsz < (node == m_root ? 1 : MIN_KEYS) || node->vsz > order) {
+			return -1;
+		}
+	}
+	const T* last = first + node->vsz;
+	if (!std::is_sorted(first, last, m_comp) ||
+			(lo && m_comp(*first, *lo)) || (hi && m_comp(*hi, last[-1]))) {
+		return -1;
+	}
+	if (node->leaf) {
+		count += node->vsz;
+		return 0;
+	}
+	inner_ptr inner = static_cast<inner_ptr>(node);
+	int depth = -1;
+	for (degree_t i = 0; i <= inner->vsz; ++i) {
+		node_base_ptr child = inner->children[i];
+		int childDepth = verify_node(child, i ? first + i - 1 : lo, i < inner->vsz ? first + i : hi, count);
+		if (child->parent != node || childDepth < 0 || (depth >= 0 && childDepth != depth)) {
+			return -1;
+		}
+		depth = childDepth;
+	}
+	return depth + 1;
+}
+#endif //BPLUS_TREE_DEBUG
+
+template<typename T, typename Comp, degree_t degree>
+bool operator==(const bplus_tree<T, Comp, degree>& lhs, const bplus_tree<T, Comp, degree>& rhs) {
+	return lhs.size() == rhs.size() && std::equal(lhs.begin(), lhs.end(), rhs.begin());
+}
+
+template<typename T, typename Comp, degree_t degree>
+bool operator!=(const bplus_tree<T, Comp, degree>& lhs, const bplus_tree<T, Comp, degree>& rhs) {
+	return !(lhs == rhs);
+}
+
+template<typename T, typename Comp, degree_t degree>
+bool operator<(const bplus_tree<T, Comp, degree>& lhs, const bplus_tree<T, Comp, degree>& rhs) {
+	return std::lexicographical_compare(lhs.begin(), lhs.end(), rhs.begin(), rhs.end());
+}
+
+template<typename T, typename Comp, degree_t degree>
+void swap(bplus_tree<T, Comp, degree>& lhs, bplus_tree<T, Comp, degree>& rhs) noexcept {
+	lhs.swap(rhs);
+}
+
+} //namespace nano
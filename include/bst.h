@@ -94,17 +94,22 @@ template<typename T, typename Comp = std::less<T>>
 std::pair<bst_node<T>*, int> bst_get_insert_unique(bst_node<T>* root, 
         const T& val, const Comp& comp = Comp()) {
     int insetrLeft = 0;
+    bst_node<T>* last = nullptr;
     while (root) {
-        if (comp(root->value, val)) {
+        last = root;
+        if (comp(val, root->value)) {
             insetrLeft = -1;
             root = left_of(root);
-        } else {
+        } else if (comp(root->value, val)) {
             insetrLeft = 1;
             root = right_of(root);
+        } else {
+            //已经有相等的了
+            return { root, 0 };
         }
     }
 
-    return { root, insetrLeft };
+    return { last, insetrLeft };
 }
 
 template<typename T, typename Comp = std::less<T>>
@@ -168,7 +173,8 @@ std::pair<bst_node<T>*, bool> bst_insert_node_unique(bst_node<T>* node,
         default:
             break;
     }
-    return { node, insertLeft != 0 };
+    //插入失败时返回已经存在的节点
+    return { insertLeft != 0 ? node : parent, insertLeft != 0 };
 }
 
 template<typename T>
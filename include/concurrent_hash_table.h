@@ -0,0 +1,291 @@
+#pragma once
+
+#include "hash_table.h"
+#include <shared_mutex>
+#include <mutex>
+#include <thread>
+#include <atomic>
+#include <vector>
+#include <memory>
+
+namespace nano {
+
+/**
+ * @brief 一个分片: 一把读写锁加一个hash_table，按cache line对齐，
+ * 		  相邻分片的锁不会落在同一个cache line上互相干扰(false sharing)
+ */
+template<typename Table>
+struct alignas(NANO_CACHE_LINE_SIZE) cht_shard {
+	template<typename... Args>
+	explicit cht_shard(Args&&... args) : table(std::forward<Args>(args)...) {
+	}
+
+	mutable std::shared_mutex lock;
+	Table table;
+};
+
+/**
+ * @brief 分片的并发哈希表
+ * 		  用hash值的高位把key分到2的幂次个互相独立的hash_table里，每个分片一把读写锁，
+ * 		  不同分片上的读写、扩容互不阻塞。分片内部的桶用的是hash_table自己的种子和低位，
+ * 		  和分片的选择无关
+ * @attention 没有迭代器，元素只能在锁内通过visit、for_each、for_each_shard访问
+ */
+template<typename T, bool cache = false, typename Hash = hash_value<T>,
+	typename Comp = std::less<T>, typename Pred = std::equal_to<T>>
+class concurrent_hash_table {
+public:
+	using table_type 		= hash_table<T, cache, Hash, Comp, Pred>;
+	using key_type 			= T;
+	using value_type 		= T;
+	using size_type 		= size_t;
+	using hasher 			= Hash;
+	using key_compare 		= Comp;
+	using key_equal 		= Pred;
+
+	///< 默认分片个数，线程数的4倍向上取2的幂次，至少16个
+	static size_type default_shard_count() {
+		size_type n = std::thread::hardware_concurrency() * 4;
+		return ceil_power_of_2(n < 16 ? 16 : n);
+	}
+
+public:
+	/**
+	 * @param shardCount 分片个数，会向上取2的幂次
+	 * @param n 总的初始桶个数，平均分到每个分片
+	 */
+	explicit concurrent_hash_table(size_type shardCount = default_shard_count(),
+			size_type n = 16,
+			const hasher& hf = hasher(),
+			const key_compare& comp = key_compare(),
+			const key_equal& eql = key_equal());
+	concurrent_hash_table(const concurrent_hash_table&) = delete;
+	concurrent_hash_table& operator=(const concurrent_hash_table&) = delete;
+
+public:
+	// 插入
+	bool insert_unique(const value_type& value) {
+		shard_type& shard = shard_of(value);
+		std::unique_lock<std::shared_mutex> guard(shard.lock);
+		return shard.table.insert_unique(value).second;
+	}
+	bool insert_unique(value_type&& value) {
+		shard_type& shard = shard_of(value);
+		std::unique_lock<std::shared_mutex> guard(shard.lock);
+		return shard.table.insert_unique(std::move(value)).second;
+	}
+	void insert_multi(const value_type& value) {
+		shard_type& shard = shard_of(value);
+		std::unique_lock<std::shared_mutex> guard(shard.lock);
+		shard.table.insert_multi(value);
+	}
+	void insert_multi(value_type&& value) {
+		shard_type& shard = shard_of(value);
+		std::unique_lock<std::shared_mutex> guard(shard.lock);
+		shard.table.insert_multi(std::move(value));
+	}
+	//要先构造出元素才知道分片，所以在锁外构造
+	template<typename... Args>
+	bool emplace_unique(Args&&... args) {
+		return insert_unique(value_type(std::forward<Args>(args)...));
+	}
+
+	// 删除
+	size_type erase_unique(const key_type& key) {
+		shard_type& shard = shard_of(key);
+		std::unique_lock<std::shared_mutex> guard(shard.lock);
+		return shard.table.erase_unique(key);
+	}
+	size_type erase_multi(const key_type& key) {
+		shard_type& shard = shard_of(key);
+		std::unique_lock<std::shared_mutex> guard(shard.lock);
+		return shard.table.erase_multi(key);
+	}
+	void clear();
+
+	// 查找
+	bool contains(const key_type& key) const {
+		const shard_type& shard = shard_of(key);
+		std::shared_lock<std::shared_mutex> guard(shard.lock);
+		return shard.table.find(key) != shard.table.end();
+	}
+	size_type count_unique(const key_type& key) const { return contains(key) ? 1 : 0; }
+	size_type count_multi(const key_type& key) const {
+		const shard_type& shard = shard_of(key);
+		std::shared_lock<std::shared_mutex> guard(shard.lock);
+		return shard.table.count_multi(key);
+	}
+	/**
+	 * @brief 找到key时在分片的读锁内调用f(const T&)
+	 * @return 有没有找到
+	 */
+	template<typename Func>
+	bool visit(const key_type& key, Func&& f) const {
+		const shard_type& shard = shard_of(key);
+		std::shared_lock<std::shared_mutex> guard(shard.lock);
+		typename table_type::const_iterator iter = shard.table.find(key);
+		if (iter == shard.table.end()) {
+			return false;
+		}
+		f(*iter);
+		return true;
+	}
+
+	// 遍历
+	/**
+	 * @brief 逐个分片加读锁，对每个元素调用f(const T&)
+	 */
+	template<typename Func>
+	void for_each(Func&& f) const {
+		for (const std::unique_ptr<shard_type>& shard : m_shards) {
+			std::shared_lock<std::shared_mutex> guard(shard->lock);
+			for (const value_type& value : shard->table) {
+				f(value);
+			}
+		}
+	}
+	/**
+	 * @brief 用threadCount个线程并行遍历，每个线程每次领一个分片，
+	 * 		  加读锁后调用f(const table_type&)，f会被多个线程同时调用
+	 */
+	template<typename Func>
+	void for_each_shard(Func&& f, size_type threadCount = std::thread::hardware_concurrency()) const;
+
+	// 容量
+	/**
+	 * @brief 逐个分片加锁求和，其他线程同时在写的话只是个近似值
+	 */
+	size_type size() const;
+	bool empty() const { return 0 == size(); }
+	size_type shard_count() const noexcept { return m_shards.size(); }
+	size_type shard_index(const key_type& key) const noexcept {
+		size_t hashVal = hash_of(key);
+		return m_shard_bits ? hashVal >> (SIZE_BITS - m_shard_bits) : 0;
+	}
+
+	// hash policy
+	/**
+	 * @brief 每个分片分别扩容，同一时刻只锁一个分片
+	 */
+	void rehash(size_type n);
+	void reserve(size_type n) { rehash(n); }
+	void max_load_factor(float mlf);
+	void incremental_rehash(bool on);
+	hasher hash_function() const { return m_hash; }
+	key_equal key_eq() const { return m_shards.front()->table.key_eq(); }
+
+private:
+	using shard_type = cht_shard<table_type>;
+	constexpr static size_type SIZE_BITS = sizeof(size_t) * 8;
+	constexpr static bool SEEDED_HASH = std::is_invocable_v<const Hash&, const T&, size_t>;
+
+	size_t hash_of(const key_type& key) const {
+		if constexpr(SEEDED_HASH) {
+			return m_hash(key, m_seed);
+		} else {
+			return m_hash(key);
+		}
+	}
+	shard_type& shard_of(const key_type& key) {
+		return *m_shards[shard_index(key)];
+	}
+	const shard_type& shard_of(const key_type& key) const {
+		return *m_shards[shard_index(key)];
+	}
+
+private:
+	std::vector<std::unique_ptr<shard_type>> m_shards;
+	size_type m_shard_bits;		///< 分片个数是2的m_shard_bits次方
+	size_t m_seed;				///< 选分片用的种子，和各个分片里hash_table的种子无关
+	hasher m_hash;
+};
+
+template<typename T, bool cache, typename Hash, typename Comp, typename Pred>
+concurrent_hash_table<T, cache, Hash, Comp, Pred>::concurrent_hash_table(size_type shardCount,
+		size_type n, const hasher& hf, const key_compare& comp, const key_equal& eql) :
+		m_shard_bits(0),
+		m_seed(random_seed()),
+		m_hash(hf) {
+	shardCount = ceil_power_of_2(shardCount ? shardCount : 1);
+	while ((size_type(1) << m_shard_bits) < shardCount) {
+		++m_shard_bits;
+	}
+	size_type perShard = n / shardCount;
+	m_shards.reserve(shardCount);
+	for (size_type i = 0; i != shardCount; ++i) {
+		m_shards.emplace_back(std::make_unique<shard_type>(perShard ? perShard : 1, hf, comp, eql));
+	}
+}
+
+template<typename T, bool cache, typename Hash, typename Comp, typename Pred>
+void concurrent_hash_table<T, cache, Hash, Comp, Pred>::clear() {
+	for (const std::unique_ptr<shard_type>& shard : m_shards) {
+		std::unique_lock<std::shared_mutex> guard(shard->lock);
+		shard->table.clear();
+	}
+}
+
+template<typename T, bool cache, typename Hash, typename Comp, typename Pred>
+template<typename Func>
+void concurrent_hash_table<T, cache, Hash, Comp, Pred>::for_each_shard(Func&& f,
+		size_type threadCount) const {
+	std::atomic<size_type> next(0);
+	auto work = [this, &next, &f]() {
+		size_type index;
+		while ((index = next.fetch_add(1, std::memory_order_relaxed)) < m_shards.size()) {
+			const shard_type& shard = *m_shards[index];
+			std::shared_lock<std::shared_mutex> guard(shard.lock);
+			f(shard.table);
+		}
+	};
+	if (threadCount > m_shards.size()) {
+		threadCount = m_shards.size();
+	}
+	std::vector<std::thread> threads;
+	for (size_type i = 1; i < threadCount; ++i) {
+		threads.emplace_back(work);
+	}
+	//当前线程也干活
+	work();
+	for (std::thread& t : threads) {
+		t.join();
+	}
+}
+
+template<typename T, bool cache, typename Hash, typename Comp, typename Pred>
+typename concurrent_hash_table<T, cache, Hash, Comp, Pred>::size_type
+concurrent_hash_table<T, cache, Hash, Comp, Pred>::size() const {
+	size_type n = 0;
+	for (const std::unique_ptr<shard_type>& shard : m_shards) {
+		std::shared_lock<std::shared_mutex> guard(shard->lock);
+		n += shard->table.size();
+	}
+	return n;
+}
+
+template<typename T, bool cache, typename Hash, typename Comp, typename Pred>
+void concurrent_hash_table<T, cache, Hash, Comp, Pred>::rehash(size_type n) {
+	size_type perShard = n / m_shards.size() + 1;
+	for (const std::unique_ptr<shard_type>& shard : m_shards) {
+		std::unique_lock<std::shared_mutex> guard(shard->lock);
+		shard->table.rehash(perShard);
+	}
+}
+
+template<typename T, bool cache, typename Hash, typename Comp, typename Pred>
+void concurrent_hash_table<T, cache, Hash, Comp, Pred>::max_load_factor(float mlf) {
+	for (const std::unique_ptr<shard_type>& shard : m_shards) {
+		std::unique_lock<std::shared_mutex> guard(shard->lock);
+		shard->table.max_load_factor(mlf);
+	}
+}
+
+template<typename T, bool cache, typename Hash, typename Comp, typename Pred>
+void concurrent_hash_table<T, cache, Hash, Comp, Pred>::incremental_rehash(bool on) {
+	for (const std::unique_ptr<shard_type>& shard : m_shards) {
+		std::unique_lock<std::shared_mutex> guard(shard->lock);
+		shard->table.incremental_rehash(on);
+	}
+}
+
+} //namespace nano
@@ -0,0 +1,192 @@
+/**
+ * @file epoch.h
+ * @brief 基于epoch的内存回收(epoch-based reclamation)
+ * 		  读者进出临界区时只写自己线程的一个计数，不加锁；写者把摘下来的
+ * 		  对象挂到退休列表上，等所有可能还看得到它的读者都离开以后再释放
+ * @date 2022-05-20
+ * @copyright Copyright (c) 2022
+ */
+#pragma once
+
+#include "system.h"
+#include <atomic>
+#include <vector>
+#include <stdint.h>
+#include <stddef.h>
+
+namespace nano {
+
+/**
+ * @brief 每个线程一个，按cache line对齐，读者之间不会互相干扰
+ */
+struct alignas(NANO_CACHE_LINE_SIZE) epoch_record {
+	std::atomic<uint64_t> epoch{0};			///< 进入临界区时看到的全局epoch，0表示不在临界区
+	std::atomic<bool> in_use{false};		///< 线程退出后记录留给后来的线程复用
+	size_t depth = 0;						///< 临界区嵌套层数，只有所属线程访问
+	epoch_record* next = nullptr;
+};
+
+///< 当前线程的记录，第一次进临界区时才分配，之后直接用，不用再调进库里
+inline thread_local epoch_record* tls_epoch_record = nullptr;
+
+/**
+ * @brief 全局epoch从1开始递增，只有所有在临界区里的读者都看到了当前epoch e，
+ * 		  才能推进到e + 1。在epoch r退休的对象，等全局epoch到了r + 2，
+ * 		  所有可能在摘下它之前就拿到它的读者都已经离开了，可以释放
+ * @attention 整个进程共用一个，见global()
+ */
+class epoch_domain {
+public:
+	static epoch_domain& global() noexcept { return s_global; }
+
+	/**
+	 * @brief 进入读临界区，可以嵌套
+	 */
+	void enter() noexcept {
+		epoch_record* rec = tls_epoch_record ? tls_epoch_record : local_record();
+		if (0 == rec->depth++) {
+			//先公布自己的epoch再读数据，和try_advance里的fence配对:
+			//写者没看到这次公布的话，之后的读一定能看到写者在那之前做的摘除
+			rec->epoch.store(m_epoch.load(std::memory_order_relaxed), std::memory_order_relaxed);
+			if (m_asymmetric) {
+				std::atomic_signal_fence(std::memory_order_seq_cst);
+			} else {
+				std::atomic_thread_fence(std::memory_order_seq_cst);
+			}
+		}
+	}
+	void leave() noexcept {
+		epoch_record* rec = tls_epoch_record;
+		if (0 == --rec->depth) {
+			rec->epoch.store(0, std::memory_order_release);
+		}
+	}
+
+	uint64_t epoch() const noexcept { return m_epoch.load(std::memory_order_seq_cst); }
+	/**
+	 * @brief 所有在临界区里的读者都看到了当前epoch时推进一步
+	 * @return 推进之后的全局epoch
+	 */
+	uint64_t try_advance() noexcept;
+	/**
+	 * @brief 在retired时退休的对象现在能不能释放
+	 */
+	bool safe(uint64_t retired) const noexcept { return retired + 2 <= epoch(); }
+
+private:
+	epoch_domain();
+	epoch_record* local_record() noexcept;
+	epoch_record* acquire_record();
+	/**
+	 * @brief 写者这边的fence，非对称时让所有正在运行的读者线程都执行一次full fence
+	 */
+	void heavy_fence() noexcept;
+
+private:
+	/**
+	 * 读者每次进临界区都执行一次full fence的话，连续查找之间的cache miss
+	 * 就不能重叠了。Linux上用membarrier把fence的开销全部挪到写者这边，
+	 * 读者只要一个编译器屏障
+	 */
+	bool m_asymmetric;
+	static epoch_domain s_global;
+	alignas(NANO_CACHE_LINE_SIZE) std::atomic<uint64_t> m_epoch{1};
+	alignas(NANO_CACHE_LINE_SIZE) std::atomic<epoch_record*> m_records{nullptr};	///< 只增不减
+};
+
+/**
+ * @brief 读临界区的RAII包装
+ */
+class epoch_guard {
+public:
+	explicit epoch_guard(epoch_domain& domain = epoch_domain::global()) noexcept :
+		m_domain(domain) {
+		m_domain.enter();
+	}
+	~epoch_guard() { m_domain.leave(); }
+	epoch_guard(const epoch_guard&) = delete;
+	epoch_guard& operator=(const epoch_guard&) = delete;
+
+private:
+	epoch_domain& m_domain;
+};
+
+/**
+ * @brief 一个写者自己的退休列表，不是线程安全的，要在写者自己的锁里用
+ * 		  对象按退休的先后排列，所以epoch也是递增的，只要从头释放到第一个不安全的
+ */
+class retire_list {
+public:
+	using deleter = void (*)(void* context, void* ptr);
+
+	///< 每退休这么多个才推进一次epoch，推进要扫所有线程的记录，非对称时还有一次系统调用
+	constexpr static size_t RECLAIM_BATCH = 64;
+
+	explicit retire_list(epoch_domain& domain = epoch_domain::global()) noexcept :
+		m_domain(domain),
+		m_head(0),
+		m_pending(0) {
+	}
+	retire_list(const retire_list&) = delete;
+	retire_list& operator=(const retire_list&) = delete;
+	~retire_list() { reclaim_all(); }
+
+	/**
+	 * @brief ptr已经从所有读者能走到的地方摘掉了
+	 */
+	void retire(void* ptr, deleter del, void* context) {
+		m_retired.push_back({ m_domain.epoch(), ptr, del, context });
+		++m_pending;
+	}
+
+	/**
+	 * @brief 攒够了就尝试推进epoch，释放已经安全的对象
+	 */
+	void reclaim() {
+		if (m_head == m_retired.size()) {
+			return;
+		}
+		if (m_pending >= RECLAIM_BATCH) {
+			m_domain.try_advance();
+			m_pending = 0;
+		}
+		while (m_head != m_retired.size() && m_domain.safe(m_retired[m_head].epoch)) {
+			retired& r = m_retired[m_head++];
+			r.del(r.context, r.ptr);
+		}
+		//一直有新对象退休时列表可能永远放不空，释放掉的超过一半就挪一次
+		if (m_head * 2 >= m_retired.size()) {
+			m_retired.erase(m_retired.begin(), m_retired.begin() + m_head);
+			m_head = 0;
+		}
+	}
+
+	/**
+	 * @brief 不管读者直接全部释放，只能在确定没有读者的时候用，比如析构
+	 */
+	void reclaim_all() {
+		for (; m_head != m_retired.size(); ++m_head) {
+			retired& r = m_retired[m_head];
+			r.del(r.context, r.ptr);
+		}
+		m_retired.clear();
+		m_head = 0;
+	}
+
+	size_t size() const noexcept { return m_retired.size() - m_head; }
+
+private:
+	struct retired {
+		uint64_t epoch;
+		void* ptr;
+		deleter del;
+		void* context;
+	};
+
+	epoch_domain& m_domain;
+	std::vector<retired> m_retired;
+	size_t m_head;		///< 之前的都已经释放了
+	size_t m_pending;	///< 上次推进epoch以后新退休的个数
+};
+
+} //namespace nano
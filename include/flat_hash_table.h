@@ -0,0 +1,696 @@
+#pragma once
+
+#include "hash.h"
+#include "construct.h"
+#include "algo.h"
+#include <iterator>
+#include <new>
+#include <bit>
+#include <stdint.h>
+#include <string.h>
+
+#if defined(__SSE2__) || defined(_M_X64)
+#define FLAT_HASH_TABLE_SSE2
+#include <emmintrin.h>
+#endif //__SSE2__
+
+namespace nano {
+
+/**
+ * @brief 每个槽一个控制字节
+ * 		  最高位为0: 槽里有元素，低7位是该元素hash值的低7位(h2)
+ * 		  最高位为1: 空、已删除(墓碑)或者末尾的哨兵
+ */
+using fht_ctrl = int8_t;
+
+inline constexpr static fht_ctrl FHT_EMPTY = -128;
+inline constexpr static fht_ctrl FHT_DELETED = -2;
+inline constexpr static fht_ctrl FHT_SENTINEL = -1;
+inline constexpr static size_t FHT_GROUP_WIDTH = 16;
+
+/**
+ * @brief 16个控制字节为一组，用SSE2一条指令比较完，结果是一个16位的掩码，
+ * 		  第i位为1表示组内第i个槽满足条件
+ */
+struct fht_group {
+#ifdef FLAT_HASH_TABLE_SSE2
+	explicit fht_group(const fht_ctrl* pos) noexcept :
+		ctrl(_mm_load_si128(reinterpret_cast<const __m128i*>(pos))) {
+	}
+
+	uint32_t match(fht_ctrl h2) const noexcept {
+		return static_cast<uint32_t>(_mm_movemask_epi8(_mm_cmpeq_epi8(_mm_set1_epi8(h2), ctrl)));
+	}
+
+	uint32_t match_empty() const noexcept {
+		return match(FHT_EMPTY);
+	}
+
+	//空和墓碑的最高位都是1，组内不会有哨兵
+	uint32_t match_empty_or_deleted() const noexcept {
+		return static_cast<uint32_t>(_mm_movemask_epi8(ctrl));
+	}
+
+	__m128i ctrl;
+#else
+	explicit fht_group(const fht_ctrl* pos) noexcept {
+		memcpy(ctrl, pos, FHT_GROUP_WIDTH);
+	}
+
+	uint32_t match(fht_ctrl h2) const noexcept {
+		uint32_t bits = 0;
+		for (size_t i = 0; i < FHT_GROUP_WIDTH; ++i) {
+			bits |= static_cast<uint32_t>(ctrl[i] == h2) << i;
+		}
+		return bits;
+	}
+
+	uint32_t match_empty() const noexcept {
+		return match(FHT_EMPTY);
+	}
+
+	uint32_t match_empty_or_deleted() const noexcept {
+		uint32_t bits = 0;
+		for (size_t i = 0; i < FHT_GROUP_WIDTH; ++i) {
+			bits |= static_cast<uint32_t>(ctrl[i] < 0) << i;
+		}
+		return bits;
+	}
+
+	fht_ctrl ctrl[FHT_GROUP_WIDTH];
+#endif //FLAT_HASH_TABLE_SSE2
+};
+
+template<typename T, typename Hash, typename Pred>
+class flat_hash_table;
+
+template<typename T>
+struct fht_iterator_base {
+	using iterator_category = std::forward_iterator_tag;
+	using difference_type   = ptrdiff_t;
+	using value_type 		= T;
+	using reference			= T&;
+	using pointer 			= T*;
+	using self              = fht_iterator_base<T>;
+
+	fht_iterator_base() noexcept = default;
+	fht_iterator_base(const fht_ctrl* _ctrl, T* _slot) noexcept :
+			ctrl(_ctrl),
+			slot(_slot) {
+	}
+
+	//跳过空槽和墓碑，停在有元素的槽或者哨兵上
+	void skip_empty() noexcept {
+		while (*ctrl < FHT_SENTINEL) {
+			++ctrl;
+			++slot;
+		}
+	}
+	void increase() noexcept {
+		++ctrl;
+		++slot;
+		skip_empty();
+	}
+	bool operator==(const self& other) const noexcept { return slot == other.slot; }
+	bool operator!=(const self& other) const noexcept { return !(*this == other); }
+	reference operator*() const noexcept { return *slot; }
+	pointer operator->() const noexcept { return slot; }
+
+	const fht_ctrl* ctrl = nullptr;	///< 控制字节
+	T* slot = nullptr;				///< 元素
+};
+
+template<typename T>
+struct fht_const_iterator;
+
+template<typename T>
+struct fht_iterator : public fht_iterator_base<T> {
+	using self = fht_iterator<T>;
+
+	fht_iterator() noexcept = default;
+	fht_iterator(const fht_ctrl* _ctrl, T* _slot) noexcept :
+			fht_iterator_base<T>(_ctrl, _slot) {
+	}
+	explicit fht_iterator(const fht_const_iterator<T>& other) noexcept :
+			fht_iterator_base<T>(other.ctrl, other.slot) {
+	}
+
+	self& operator++() noexcept {
+		this->increase();
+		return *this;
+	}
+
+	self operator++(int) noexcept {
+		self temp = *this;
+		++*this;
+		return temp;
+	}
+};
+
+template<typename T>
+struct fht_const_iterator : public fht_iterator_base<T> {
+	using reference = const T&;
+	using pointer 	= const T*;
+	using self 		= fht_const_iterator<T>;
+
+	fht_const_iterator() noexcept = default;
+	fht_const_iterator(const fht_ctrl* _ctrl, T* _slot) noexcept :
+			fht_iterator_base<T>(_ctrl, _slot) {
+	}
+	fht_const_iterator(const fht_iterator<T>& other) noexcept :
+			fht_iterator_base<T>(other.ctrl, other.slot) {
+	}
+
+	reference operator*() const noexcept { return *this->slot; }
+	pointer operator->() const noexcept { return this->slot; }
+
+	self& operator++() noexcept {
+		this->increase();
+		return *this;
+	}
+
+	self operator++(int) noexcept {
+		self temp = *this;
+		++*this;
+		return temp;
+	}
+};
+
+/**
+ * @brief 开放寻址的哈希表(Swiss table)，元素直接存放在槽数组里，
+ * 		  没有节点也没有链表。hash值的高位(h1)决定从哪一组开始找，
+ * 		  低7位(h2)存在控制字节里，一次比较16个控制字节，只有h2
+ * 		  相同的槽才会真正调用key_equal。组之间按三角数步长探测，
+ * 		  容量是2的幂时能走遍所有组。最大负载因子7/8。
+ * @tparam T 元素类型，至少要能移动构造
+ * @attention 插入可能导致扩容，扩容后所有迭代器和指针都失效
+ */
+template<typename T, typename Hash = hash_value<T>, typename Pred = std::equal_to<T>>
+class flat_hash_table {
+public:
+	using key_type 					= T;
+	using value_type                = T;
+	using pointer                   = T*;
+	using const_pointer             = const T*;
+	using reference                 = T&;
+	using const_reference           = const T&;
+	using size_type                 = size_t;
+	using difference_type           = ptrdiff_t;
+	using iterator                  = fht_iterator<value_type>;
+	using const_iterator            = fht_const_iterator<value_type>;
+	using hasher					= Hash;
+  	using key_equal 				= Pred;
+
+public:
+	iterator begin() noexcept {
+		if (0 == m_size) {
+			return end();
+		}
+		iterator iter(m_ctrl, m_slots);
+		iter.skip_empty();
+		return iter;
+	}
+	const_iterator begin() const noexcept {
+		return const_cast<flat_hash_table*>(this)->begin();
+	}
+	iterator end() noexcept { return iterator(m_ctrl + m_capacity, m_slots + m_capacity); }
+	const_iterator end() const noexcept {
+		return const_cast<flat_hash_table*>(this)->end();
+	}
+	const_iterator cbegin() const noexcept { return begin(); }
+	const_iterator cend()   const noexcept { return end(); }
+
+public:
+	// 构造、复制、移动、析构函数
+	explicit flat_hash_table(size_type n = FHT_GROUP_WIDTH,
+							const hasher& hf = hasher(),
+							const key_equal& eql = key_equal());
+
+	template <std::input_iterator InputIter>
+	flat_hash_table(InputIter first, InputIter last,
+					size_type n = FHT_GROUP_WIDTH,
+					const hasher& hf = hasher(),
+					const key_equal& eql = key_equal());
+	flat_hash_table(const flat_hash_table& other);
+	flat_hash_table(flat_hash_table&& other) noexcept;
+	flat_hash_table& operator=(const flat_hash_table& other);
+	flat_hash_table& operator=(flat_hash_table&& other) noexcept;
+	~flat_hash_table();
+
+public:
+	bool empty() const noexcept { return 0 == m_size; }
+	size_type size() const noexcept { return m_size; }
+
+	template <typename... Args>
+	std::pair<iterator, bool> emplace_unique(Args&&... args) {
+		value_type value(std::forward<Args>(args)...);
+		return insert_unique(std::move(value));
+	}
+
+	std::pair<iterator, bool> insert_unique(const value_type& value) {
+		return insert_unique_impl(value);
+	}
+	std::pair<iterator, bool> insert_unique(value_type&& value) {
+		return insert_unique_impl(std::move(value));
+	}
+
+	template <std::input_iterator InputIter>
+	void insert_unique(InputIter first, InputIter last) {
+		for (; first != last; ++first) {
+			insert_unique(*first);
+		}
+	}
+
+	void erase(const_iterator position);
+	size_type erase_unique(const key_type& key);
+	void clear();
+	void swap(flat_hash_table& other) noexcept;
+
+	size_type count_unique(const key_type& key) const {
+		return find(key) == end() ? 0 : 1;
+	}
+	iterator find(const key_type& key);
+	const_iterator find(const key_type& key) const {
+		return const_cast<flat_hash_table*>(this)->find(key);
+	}
+
+	size_type bucket_count() const noexcept { return m_capacity; }
+	float load_factor() const noexcept {
+		return m_capacity ? static_cast<float>(m_size) / m_capacity : 0.0f;
+	}
+	float max_load_factor() const noexcept { return 7.0f / 8.0f; }
+	void rehash(size_type n);
+	void reserve(size_type n) {
+		//n个元素不超过最大负载因子
+		rehash(n + n / 7);
+	}
+	hasher hash_function() const { return m_hash; }
+	size_t hash_seed() const noexcept { return m_seed; }
+	key_equal key_eq() const { return m_equal; }
+
+private:
+	constexpr static size_type NPOS = static_cast<size_type>(-1);
+	constexpr static size_type SLOT_ALIGN =
+		alignof(T) > FHT_GROUP_WIDTH ? alignof(T) : FHT_GROUP_WIDTH;
+	constexpr static bool SEEDED_HASH = std::is_invocable_v<const Hash&, const T&, size_t>;
+
+private:
+	size_t hash_of(const key_type& key) const {
+		if constexpr(SEEDED_HASH) {
+			return m_hash(key, m_seed);
+		} else {
+			return m_hash(key);
+		}
+	}
+	static size_t h1(size_t hashVal) noexcept { return hashVal >> 7; }
+	static fht_ctrl h2(size_t hashVal) noexcept { return static_cast<fht_ctrl>(hashVal & 0x7f); }
+	static size_type growth_limit(size_type capacity) noexcept { return capacity - capacity / 8; }
+	static size_type ctrl_bytes(size_type capacity) noexcept {
+		//多一个哨兵，再补齐到槽的对齐
+		return (capacity + 1 + SLOT_ALIGN - 1) & ~(SLOT_ALIGN - 1);
+	}
+	size_type group_mask() const noexcept { return m_capacity / FHT_GROUP_WIDTH - 1; }
+
+	void allocate(size_type capacity);
+	void deallocate() noexcept;
+	void destroy_slots() noexcept;
+	void set_ctrl(size_type index, fht_ctrl ctrl) noexcept { m_ctrl[index] = ctrl; }
+	iterator iterator_at(size_type index) noexcept {
+		return iterator(m_ctrl + index, m_slots + index);
+	}
+
+	size_type find_first_non_full(size_t hashVal) const noexcept;
+	std::pair<size_type, bool> find_or_prepare_insert(const key_type& key, size_t hashVal);
+	template<typename V>
+	std::pair<iterator, bool> insert_unique_impl(V&& value);
+	void resize(size_type capacity);
+	void erase_at(size_type index) noexcept;
+
+private:
+	fht_ctrl* m_ctrl;			///< 控制字节，m_capacity个，最后一个是哨兵
+	T* m_slots;					///< 槽，和控制字节在同一块内存里
+	size_type m_capacity;		///< 槽的个数，16的倍数且为2的幂
+	size_type m_size;
+	size_type m_growth_left;	///< 还能往空槽里放几个元素，墓碑也算占用
+	size_t m_seed;
+	hasher m_hash;
+	key_equal m_equal;
+};
+
+template<typename T, typename Hash, typename Pred>
+flat_hash_table<T, Hash, Pred>::flat_hash_table(size_type n,
+		const hasher& hf, const key_equal& eql) :
+	m_ctrl(nullptr),
+	m_slots(nullptr),
+	m_capacity(0),
+	m_size(0),
+	m_growth_left(0),
+	m_seed(random_seed()),
+	m_hash(hf),
+	m_equal(eql) {
+	allocate(n < FHT_GROUP_WIDTH ? FHT_GROUP_WIDTH : ceil_power_of_2(n));
+}
+
+template<typename T, typename Hash, typename Pred>
+template <std::input_iterator InputIter>
+flat_hash_table<T, Hash, Pred>::flat_hash_table(InputIter first, InputIter last,
+		size_type n, const hasher& hf, const key_equal& eql) :
+		flat_hash_table(n, hf, eql) {
+	insert_unique(first, last);
+}
+
+template<typename T, typename Hash, typename Pred>
+flat_hash_table<T, Hash, Pred>::flat_hash_table(const flat_hash_table& other) :
+	m_ctrl(nullptr),
+	m_slots(nullptr),
+	m_capacity(0),
+	m_size(0),
+	m_growth_left(0),
+	m_seed(other.m_seed),
+	m_hash(other.m_hash),
+	m_equal(other.m_equal) {
+	if (0 == other.m_capacity) {
+		return;
+	}
+	//种子相同，每个元素放在和other相同的槽里，不用重新hash
+	allocate(other.m_capacity);
+	for (size_type i = 0; i != m_capacity; ++i) {
+		if (other.m_ctrl[i] >= 0) {
+			construct(m_slots + i, other.m_slots[i]);
+			++m_size;
+		}
+		set_ctrl(i, other.m_ctrl[i]);
+	}
+	m_growth_left = other.m_growth_left;
+}
+
+template<typename T, typename Hash, typename Pred>
+flat_hash_table<T, Hash, Pred>::flat_hash_table(flat_hash_table&& other) noexcept :
+	m_ctrl(other.m_ctrl),
+	m_slots(other.m_slots),
+	m_capacity(other.m_capacity),
+	m_size(other.m_size),
+	m_growth_left(other.m_growth_left),
+	m_seed(other.m_seed),
+	m_hash(other.m_hash),
+	m_equal(other.m_equal) {
+	other.m_ctrl = nullptr;
+	other.m_slots = nullptr;
+	other.m_capacity = 0;
+	other.m_size = 0;
+	other.m_growth_left = 0;
+}
+
+template<typename T, typename Hash, typename Pred>
+flat_hash_table<T, Hash, Pred>&
+flat_hash_table<T, Hash, Pred>::operator=(const flat_hash_table& other) {
+	if (this != &other) {
+		flat_hash_table temp(other);
+		swap(temp);
+	}
+	return *this;
+}
+
+template<typename T, typename Hash, typename Pred>
+flat_hash_table<T, Hash, Pred>&
+flat_hash_table<T, Hash, Pred>::operator=(flat_hash_table&& other) noexcept {
+	if (this != &other) {
+		destroy_slots();
+		deallocate();
+		m_ctrl = other.m_ctrl;
+		m_slots = other.m_slots;
+		m_capacity = other.m_capacity;
+		m_size = other.m_size;
+		m_growth_left = other.m_growth_left;
+		m_seed = other.m_seed;
+		m_hash = other.m_hash;
+		m_equal = other.m_equal;
+		other.m_ctrl = nullptr;
+		other.m_slots = nullptr;
+		other.m_capacity = 0;
+		other.m_size = 0;
+		other.m_growth_left = 0;
+	}
+	return *this;
+}
+
+template<typename T, typename Hash, typename Pred>
+flat_hash_table<T, Hash, Pred>::~flat_hash_table() {
+	destroy_slots();
+	deallocate();
+}
+
+template<typename T, typename Hash, typename Pred>
+void flat_hash_table<T, Hash, Pred>::allocate(size_type capacity) {
+	size_type bytes = ctrl_bytes(capacity) + capacity * sizeof(T);
+	char* mem = static_cast<char*>(::operator new(bytes, std::align_val_t(SLOT_ALIGN)));
+	m_ctrl = reinterpret_cast<fht_ctrl*>(mem);
+	m_slots = reinterpret_cast<T*>(mem + ctrl_bytes(capacity));
+	m_capacity = capacity;
+	m_growth_left = growth_limit(capacity);
+	memset(m_ctrl, FHT_EMPTY, capacity);
+	m_ctrl[capacity] = FHT_SENTINEL;
+}
+
+template<typename T, typename Hash, typename Pred>
+void flat_hash_table<T, Hash, Pred>::deallocate() noexcept {
+	if (m_ctrl) {
+		::operator delete(m_ctrl, std::align_val_t(SLOT_ALIGN));
+	}
+	m_ctrl = nullptr;
+	m_slots = nullptr;
+	m_capacity = 0;
+	m_growth_left = 0;
+}
+
+template<typename T, typename Hash, typename Pred>
+void flat_hash_table<T, Hash, Pred>::destroy_slots() noexcept {
+	if constexpr(!std::is_trivially_destructible_v<T>) {
+		for (size_type i = 0; i != m_capacity; ++i) {
+			if (m_ctrl[i] >= 0) {
+				destroy(m_slots + i);
+			}
+		}
+	}
+	m_size = 0;
+}
+
+template<typename T, typename Hash, typename Pred>
+typename flat_hash_table<T, Hash, Pred>::size_type
+flat_hash_table<T, Hash, Pred>::find_first_non_full(size_t hashVal) const noexcept {
+	size_type mask = group_mask();
+	size_type group = h1(hashVal) & mask;
+	for (size_type step = 1; ; ++step) {
+		uint32_t bits = fht_group(m_ctrl + group * FHT_GROUP_WIDTH).match_empty_or_deleted();
+		if (bits) {
+			return group * FHT_GROUP_WIDTH + std::countr_zero(bits);
+		}
+		group = (group + step) & mask;
+	}
+}
+
+/**
+ * @brief 找key，找到了返回{下标, true}，否则返回{可以插入的下标, false}
+ * 		  负载因子不超过7/8，一定能遇到有空槽的组，循环一定会结束
+ */
+template<typename T, typename Hash, typename Pred>
+std::pair<typename flat_hash_table<T, Hash, Pred>::size_type, bool>
+flat_hash_table<T, Hash, Pred>::find_or_prepare_insert(const key_type& key, size_t hashVal) {
+	size_type mask = group_mask();
+	size_type group = h1(hashVal) & mask;
+	fht_ctrl tag = h2(hashVal);
+	size_type target = NPOS;
+	for (size_type step = 1; ; ++step) {
+		size_type base = group * FHT_GROUP_WIDTH;
+		fht_group g(m_ctrl + base);
+		for (uint32_t bits = g.match(tag); bits; bits &= bits - 1) {
+			size_type index = base + std::countr_zero(bits);
+			if (m_equal(m_slots[index], key)) {
+				return { index, true };
+			}
+		}
+		if (NPOS == target) {
+			uint32_t available = g.match_empty_or_deleted();
+			if (available) {
+				target = base + std::countr_zero(available);
+			}
+		}
+		if (g.match_empty()) {
+			return { target, false };
+		}
+		group = (group + step) & mask;
+	}
+}
+
+template<typename T, typename Hash, typename Pred>
+template<typename V>
+std::pair<typename flat_hash_table<T, Hash, Pred>::iterator, bool>
+flat_hash_table<T, Hash, Pred>::insert_unique_impl(V&& value) {
+	if (0 == m_capacity) {
+		//被移动过的表
+		allocate(FHT_GROUP_WIDTH);
+	}
+	size_t hashVal = hash_of(value);
+	std::pair<size_type, bool> myPair = find_or_prepare_insert(value, hashVal);
+	if (myPair.second) {
+		return { iterator_at(myPair.first), false };
+	}
+
+	size_type index = myPair.first;
+	if (0 == m_growth_left && FHT_EMPTY == m_ctrl[index]) {
+		//墓碑超过一半就原地清理，否则扩容
+		resize(m_size * 2 < growth_limit(m_capacity) ? m_capacity : m_capacity * 2);
+		index = find_first_non_full(hashVal);
+	}
+	construct(m_slots + index, std::forward<V>(value));
+	if (FHT_EMPTY == m_ctrl[index]) {
+		--m_growth_left;
+	}
+	set_ctrl(index, h2(hashVal));
+	++m_size;
+	return { iterator_at(index), true };
+}
+
+template<typename T, typename Hash, typename Pred>
+void flat_hash_table<T, Hash, Pred>::resize(size_type capacity) {
+	fht_ctrl* oldCtrl = m_ctrl;
+	T* oldSlots = m_slots;
+	size_type oldCapacity = m_capacity;
+	allocate(capacity);
+	for (size_type i = 0; i != oldCapacity; ++i) {
+		if (oldCtrl[i] >= 0) {
+			size_t hashVal = hash_of(oldSlots[i]);
+			size_type index = find_first_non_full(hashVal);
+			set_ctrl(index, h2(hashVal));
+			construct(m_slots + index, std::move(oldSlots[i]));
+			destroy(oldSlots + i);
+		}
+	}
+	m_growth_left -= m_size;
+	if (oldCtrl) {
+		::operator delete(oldCtrl, std::align_val_t(SLOT_ALIGN));
+	}
+}
+
+template<typename T, typename Hash, typename Pred>
+void flat_hash_table<T, Hash, Pred>::rehash(size_type n) {
+	size_type capacity = n < FHT_GROUP_WIDTH ? FHT_GROUP_WIDTH : ceil_power_of_2(n);
+	//至少要放得下现有的元素
+	while (growth_limit(capacity) < m_size) {
+		capacity *= 2;
+	}
+	if (capacity > m_capacity) {
+		resize(capacity);
+	}
+}
+
+template<typename T, typename Hash, typename Pred>
+typename flat_hash_table<T, Hash, Pred>::iterator
+flat_hash_table<T, Hash, Pred>::find(const key_type& key) {
+	if (0 == m_size) {
+		return end();
+	}
+	size_t hashVal = hash_of(key);
+	size_type mask = group_mask();
+	size_type group = h1(hashVal) & mask;
+	fht_ctrl tag = h2(hashVal);
+	for (size_type step = 1; ; ++step) {
+		size_type base = group * FHT_GROUP_WIDTH;
+		fht_group g(m_ctrl + base);
+		for (uint32_t bits = g.match(tag); bits; bits &= bits - 1) {
+			size_type index = base + std::countr_zero(bits);
+			if (m_equal(m_slots[index], key)) {
+				return iterator_at(index);
+			}
+		}
+		if (g.match_empty()) {
+			return end();
+		}
+		group = (group + step) & mask;
+	}
+}
+
+/**
+ * @brief 如果所在的组里还有空槽，说明没有探测序列经过这一组继续往后找，
+ * 		  可以直接置为空，否则只能留下墓碑
+ */
+template<typename T, typename Hash, typename Pred>
+void flat_hash_table<T, Hash, Pred>::erase_at(size_type index) noexcept {
+	destroy(m_slots + index);
+	fht_group g(m_ctrl + (index & ~(FHT_GROUP_WIDTH - 1)));
+	if (g.match_empty()) {
+		set_ctrl(index, FHT_EMPTY);
+		++m_growth_left;
+	} else {
+		set_ctrl(index, FHT_DELETED);
+	}
+	--m_size;
+}
+
+template<typename T, typename Hash, typename Pred>
+void flat_hash_table<T, Hash, Pred>::erase(const_iterator position) {
+	if (end() == position) {
+		return;
+	}
+	erase_at(static_cast<size_type>(position.slot - m_slots));
+}
+
+template<typename T, typename Hash, typename Pred>
+typename flat_hash_table<T, Hash, Pred>::size_type
+flat_hash_table<T, Hash, Pred>::erase_unique(const key_type& key) {
+	iterator iter = find(key);
+	if (iter != end()) {
+		erase(iter);
+		return 1;
+	}
+
+	return 0;
+}
+
+template<typename T, typename Hash, typename Pred>
+void flat_hash_table<T, Hash, Pred>::clear() {
+	destroy_slots();
+	if (m_ctrl) {
+		memset(m_ctrl, FHT_EMPTY, m_capacity);
+		m_growth_left = growth_limit(m_capacity);
+	}
+}
+
+template<typename T, typename Hash, typename Pred>
+void flat_hash_table<T, Hash, Pred>::swap(flat_hash_table& other) noexcept {
+	std::swap(m_ctrl, other.m_ctrl);
+	std::swap(m_slots, other.m_slots);
+	std::swap(m_capacity, other.m_capacity);
+	std::swap(m_size, other.m_size);
+	std::swap(m_growth_left, other.m_growth_left);
+	std::swap(m_seed, other.m_seed);
+	std::swap(m_hash, other.m_hash);
+	std::swap(m_equal, other.m_equal);
+}
+
+template<typename T, typename Hash, typename Pred>
+bool operator==(const flat_hash_table<T, Hash, Pred>& lhs,
+				const flat_hash_table<T, Hash, Pred>& rhs) {
+	if (lhs.size() != rhs.size()) {
+		return false;
+	}
+	for (const T& value : lhs) {
+		if (rhs.find(value) == rhs.end()) {
+			return false;
+		}
+	}
+	return true;
+}
+
+template<typename T, typename Hash, typename Pred>
+bool operator!=(const flat_hash_table<T, Hash, Pred>& lhs,
+				const flat_hash_table<T, Hash, Pred>& rhs) {
+	return !(lhs == rhs);
+}
+
+template<typename T, typename Hash, typename Pred>
+void swap(flat_hash_table<T, Hash, Pred>& lhs, flat_hash_table<T, Hash, Pred>& rhs) noexcept {
+	lhs.swap(rhs);
+}
+
+} //namespace nano
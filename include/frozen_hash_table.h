@@ -0,0 +1,298 @@
+#pragma once
+
+#include "hash.h"
+#include "algo.h"
+#include <array>
+#include <utility>
+#include <functional>
+#include <algorithm>
+#include <stdexcept>
+#include <stdint.h>
+
+namespace nano {
+
+struct fht_identity {
+	template<typename T>
+	constexpr const T& operator()(const T& value) const noexcept { return value; }
+};
+
+struct fht_select_first {
+	template<typename Pair>
+	constexpr const typename Pair::first_type& operator()(const Pair& value) const noexcept {
+		return value.first;
+	}
+};
+
+/**
+ * @brief 编译期建好的只读哈希表，key集合在编译时就确定了(比如HTTP头的名字、
+ * 		  字符串到枚举的映射)，不用在启动时往hash_table里插入
+ * 		  用CHD(hash and displace)构造最小完美hash: 先按hash值的低位把key分到
+ * 		  大约N / 2个桶里，从大桶开始，给每个桶找一个位移d，使桶里所有key的
+ * 		  mix(hash ^ d)都落到还空着的槽上；只有一个key的桶最后直接指定一个空槽。
+ * 		  N个元素正好放在N个槽里，查找只算一次key的hash，再比较一次
+ * @tparam KeyOfValue 从元素里取出key
+ * @attention 必须能在常量求值中计算Hash和Pred，字符串请用std::string_view做key
+ */
+template<typename Value, typename Key, typename KeyOfValue, size_t N,
+	typename Hash, typename Pred>
+class frozen_hash_table {
+	//初始化列表不能是长度为0的数组
+	static_assert(N > 0, "frozen_hash_table needs at least one element");
+
+public:
+	using key_type 			= Key;
+	using value_type 		= Value;
+	using size_type 		= size_t;
+	using difference_type 	= ptrdiff_t;
+	using const_reference 	= const value_type&;
+	using const_iterator 	= const value_type*;
+	using iterator 			= const_iterator;
+	using hasher 			= Hash;
+	using key_equal 		= Pred;
+
+public:
+	/**
+	 * @param values 所有元素，key不能重复，重复时抛std::invalid_argument(常量求值时就是编译错误)
+	 */
+	constexpr explicit frozen_hash_table(const value_type (&values)[N],
+			const hasher& hf = hasher(), const key_equal& eql = key_equal()) :
+			frozen_hash_table(values, build(values, hf, eql), hf, eql, std::make_index_sequence<N>()) {
+	}
+
+	// 遍历，顺序是槽的顺序，和构造时给的顺序无关
+	constexpr const_iterator begin() const noexcept { return m_values.data(); }
+	constexpr const_iterator end() const noexcept { return m_values.data() + N; }
+	constexpr const_iterator cbegin() const noexcept { return begin(); }
+	constexpr const_iterator cend() const noexcept { return end(); }
+
+	// 容量
+	constexpr size_type size() const noexcept { return N; }
+	constexpr bool empty() const noexcept { return 0 == N; }
+
+	// 查找
+	constexpr const_iterator find(const key_type& key) const {
+		size_t hashVal = hash_of(m_hash, key, m_seed);
+		uint32_t d = m_displacements[hashVal & (BUCKET_COUNT - 1)];
+		size_type slot = (d & DIRECT) ? (d & ~DIRECT) : slot_of(hashVal, d);
+		return m_equal(KeyOfValue()(m_values[slot]), key) ? &m_values[slot] : end();
+	}
+	constexpr bool contains(const key_type& key) const { return find(key) != end(); }
+	constexpr size_type count(const key_type& key) const { return contains(key) ? 1 : 0; }
+
+	// hash policy
+	constexpr hasher hash_function() const { return m_hash; }
+	constexpr key_equal key_eq() const { return m_equal; }
+	constexpr size_t seed() const noexcept { return m_seed; }
+
+private:
+	///< 平均每个桶两个key，位移表的大小大约是元素的一半
+	constexpr static size_type BUCKET_COUNT = ceil_power_of_2(N / 2 + 1);
+	///< 最高位为1表示低31位直接是槽的下标，只有一个key的桶用
+	constexpr static uint32_t DIRECT = 0x80000000U;
+	///< 一个桶试这么多个位移都不行就换一个种子重来
+	constexpr static uint32_t MAX_DISPLACEMENT = 1U << 16;
+	constexpr static size_type MAX_ATTEMPT = 64;
+	constexpr static bool SEEDED_HASH = std::is_invocable_v<const Hash&, const Key&, size_t>;
+
+	struct layout {
+		size_t seed = 0;
+		std::array<uint32_t, BUCKET_COUNT> displacements{};
+		std::array<size_type, N> order{};	///< 第i个槽放的是values[order[i]]
+	};
+
+	template<size_t... I>
+	constexpr frozen_hash_table(const value_type (&values)[N], const layout& lay,
+			const hasher& hf, const key_equal& eql, std::index_sequence<I...>) :
+			m_values{ values[lay.order[I]]... },
+			m_displacements(lay.displacements),
+			m_seed(lay.seed),
+			m_hash(hf),
+			m_equal(eql) {
+	}
+
+	//不能接收种子的Hash，把结果和种子再混合一次
+	constexpr static size_t hash_of(const hasher& hf, const key_type& key, size_t seed) {
+		if constexpr(SEEDED_HASH) {
+			return hf(key, seed);
+		} else {
+			return int_mixer<sizeof(size_t)>()(hf(key), seed);
+		}
+	}
+	/**
+	 * @brief 把hash和位移混合后的高32位乘以N取高位，映射到[0, N)，不用除法
+	 */
+	constexpr static size_type slot_of(size_t hashVal, uint32_t d) {
+		uint64_t r = static_cast<uint32_t>(int_mixer<sizeof(size_t)>()(hashVal, d) >>
+			(sizeof(size_t) * 8 - 32));
+		return static_cast<size_type>((r * N) >> 32);
+	}
+
+	static constexpr layout build(const value_type (&values)[N],
+			const hasher& hf, const key_equal& eql);
+	static constexpr bool try_build(const value_type (&values)[N],
+			const hasher& hf, const key_equal& eql, size_t seed, layout& lay);
+
+private:
+	std::array<value_type, N> m_values;						///< 按槽的顺序排列
+	std::array<uint32_t, BUCKET_COUNT> m_displacements;		///< 每个桶的位移
+	size_t m_seed;
+	hasher m_hash;
+	key_equal m_equal;
+};
+
+template<typename Value, typename Key, typename KeyOfValue, size_t N,
+	typename Hash, typename Pred>
+constexpr typename frozen_hash_table<Value, Key, KeyOfValue, N, Hash, Pred>::layout
+frozen_hash_table<Value, Key, KeyOfValue, N, Hash, Pred>::build(const value_type (&values)[N],
+		const hasher& hf, const key_equal& eql) {
+	layout lay;
+	for (size_type attempt = 0; attempt != MAX_ATTEMPT; ++attempt) {
+		if (try_build(values, hf, eql, static_cast<size_t>(hash_detail::splitmix64(attempt)), lay)) {
+			return lay;
+		}
+	}
+	throw std::logic_error("frozen_hash_table: no perfect hash found");
+}
+
+/**
+ * @return 这个种子下能不能构造出完美hash，两个不同的key的hash值完全相同时不能
+ */
+template<typename Value, typename Key, typename KeyOfValue, size_t N,
+	typename Hash, typename Pred>
+constexpr bool frozen_hash_table<Value, Key, KeyOfValue, N, Hash, Pred>::try_build(
+		const value_type (&values)[N], const hasher& hf, const key_equal& eql,
+		size_t seed, layout& lay) {
+	lay.seed = seed;
+	std::array<size_t, N> hashVals{};
+	for (size_type i = 0; i != N; ++i) {
+		hashVals[i] = hash_of(hf, KeyOfValue()(values[i]), seed);
+	}
+
+	//按桶做计数排序，members[first[b], first[b + 1])是第b个桶里的key
+	std::array<size_type, BUCKET_COUNT + 1> first{};
+	for (size_type i = 0; i != N; ++i) {
+		++first[(hashVals[i] & (BUCKET_COUNT - 1)) + 1];
+	}
+	for (size_type b = 0; b != BUCKET_COUNT; ++b) {
+		first[b + 1] += first[b];
+	}
+	std::array<size_type, N> members{};
+	std::array<size_type, BUCKET_COUNT> filled{};
+	for (size_type i = 0; i != N; ++i) {
+		size_type b = hashVals[i] & (BUCKET_COUNT - 1);
+		members[first[b] + filled[b]++] = i;
+	}
+	//同一个桶里hash值相同的key，要么是重复的key，要么换种子
+	for (size_type b = 0; b != BUCKET_COUNT; ++b) {
+		for (size_type i = first[b]; i != first[b + 1]; ++i) {
+			for (size_type j = i + 1; j != first[b + 1]; ++j) {
+				if (hashVals[members[i]] == hashVals[members[j]]) {
+					if (eql(KeyOfValue()(values[members[i]]), KeyOfValue()(values[members[j]]))) {
+						throw std::invalid_argument("frozen_hash_table: duplicate key");
+					}
+					return false;
+				}
+			}
+		}
+	}
+
+	//大桶先放，这时空槽多，容易找到位移
+	std::array<size_type, BUCKET_COUNT> buckets{};
+	for (size_type b = 0; b != BUCKET_COUNT; ++b) {
+		buckets[b] = b;
+	}
+	std::sort(buckets.begin(), buckets.end(), [&first](size_type lhs, size_type rhs) {
+		return first[lhs + 1] - first[lhs] > first[rhs + 1] - first[rhs];
+	});
+	std::array<bool, N> used{};
+	std::array<size_type, N> slots{};
+	size_type freeSlot = 0;
+	for (size_type b : buckets) {
+		size_type bucketSize = first[b + 1] - first[b];
+		if (0 == bucketSize) {
+			lay.displacements[b] = 0;
+		} else if (1 == bucketSize) {
+			while (used[freeSlot]) {
+				++freeSlot;
+			}
+			used[freeSlot] = true;
+			lay.displacements[b] = DIRECT | static_cast<uint32_t>(freeSlot);
+			lay.order[freeSlot] = members[first[b]];
+		} else {
+			uint32_t d = 0;
+			for (; d != MAX_DISPLACEMENT; ++d) {
+				size_type placed = 0;
+				for (; placed != bucketSize; ++placed) {
+					size_type slot = slot_of(hashVals[members[first[b] + placed]], d);
+					if (used[slot]) {
+						break;
+					}
+					used[slot] = true;
+					slots[placed] = slot;
+				}
+				if (placed == bucketSize) {
+					break;
+				}
+				//撤销这次放进去的
+				for (size_type i = 0; i != placed; ++i) {
+					used[slots[i]] = false;
+				}
+			}
+			if (MAX_DISPLACEMENT == d) {
+				return false;
+			}
+			lay.displacements[b] = d;
+			for (size_type i = 0; i != bucketSize; ++i) {
+				lay.order[slots[i]] = members[first[b] + i];
+			}
+		}
+	}
+	return true;
+}
+
+/**
+ * @brief 编译期构造的只读集合
+ * 		  constexpr auto headers = make_frozen_hash_set<std::string_view>({ "host", "accept" });
+ */
+template<typename T, size_t N, typename Hash = hash_value<T>, typename Pred = std::equal_to<T>>
+class frozen_hash_set : public frozen_hash_table<T, T, fht_identity, N, Hash, Pred> {
+public:
+	using frozen_hash_table<T, T, fht_identity, N, Hash, Pred>::frozen_hash_table;
+};
+
+/**
+ * @brief 编译期构造的只读key-value表，元素是std::pair<K, V>，value也不能改
+ */
+template<typename K, typename V, size_t N, typename Hash = hash_value<K>,
+	typename Pred = std::equal_to<K>>
+class frozen_hash_map : public frozen_hash_table<std::pair<K, V>, K, fht_select_first, N, Hash, Pred> {
+private:
+	using base = frozen_hash_table<std::pair<K, V>, K, fht_select_first, N, Hash, Pred>;
+
+public:
+	using mapped_type = V;
+	using base::base;
+
+	constexpr const mapped_type& at(const K& key) const {
+		typename base::const_iterator iter = this->find(key);
+		if (iter == this->end()) {
+			throw std::out_of_range("frozen_hash_map::at");
+		}
+		return iter->second;
+	}
+};
+
+/**
+ * @brief 只需要写出key的类型，元素个数从初始化列表推导
+ */
+template<typename T, typename Hash = hash_value<T>, typename Pred = std::equal_to<T>, size_t N>
+constexpr frozen_hash_set<T, N, Hash, Pred> make_frozen_hash_set(const T (&keys)[N]) {
+	return frozen_hash_set<T, N, Hash, Pred>(keys);
+}
+
+template<typename K, typename V, typename Hash = hash_value<K>, typename Pred = std::equal_to<K>, size_t N>
+constexpr frozen_hash_map<K, V, N, Hash, Pred> make_frozen_hash_map(const std::pair<K, V> (&items)[N]) {
+	return frozen_hash_map<K, V, N, Hash, Pred>(items);
+}
+
+} //namespace nano
@@ -1,47 +1,281 @@
 #pragma once
 
 #include <functional>
+#include <bit>
+#include <type_traits>
+#include <string>
+#include <string_view>
 #include <stdint.h>
 #include <string.h>
-#include <stdio.h>
 #include "system.h"
 
 namespace nano {
 
+/**
+ * @brief 所有特化都有第二个可选参数seed，默认为0
+ */
 template<typename T>
 struct hash_value {
 };
 
+#ifdef BIT32
+#define HASH_RESULT_TYPE uint32_t
+#else
+#define HASH_RESULT_TYPE uint64_t
+#endif //BIT32
+
 //murmurhash2
 //https://sites.google.com/site/murmurhash/
 #ifdef BIT32
 uint32_t murmurhash2 (const void* key, int len, unsigned int seed);
-
-#define HASH_FUNCTION_INTEGRAL(Type)                \
-template<>                                          \
-struct hash_value<Type> {                           \
-    uint32_t operator()(Type v) const noexcept {    \
-        char buf[4]{0};                             \
-        snprintf(buf, sizeof buf, "%u", v);         \
-        return murmurhash2(buf, sizeof buf, 0);     \
-    }                                               \
-}
 #else
 uint64_t murmurhash2(const void* key, int len, unsigned int seed);
+#endif //BIT32
+
+/**
+ * @brief 任意字节序列的hash，长输入每次处理32/64字节，运行时根据cpu
+ * 		  选择AVX2/SSE2/标量实现，三者的结果完全相同
+ * @param key 输入的起始地址
+ * @param len 输入的字节数
+ * @param seed 种子
+ */
+#ifdef BIT32
+uint32_t hash_bytes(const void* key, size_t len, size_t seed = 0);
+#else
+uint64_t hash_bytes(const void* key, size_t len, size_t seed = 0);
+#endif //BIT32
+
+/**
+ * @brief hash_bytes用到的常量和标量算法，编译期和运行期共用
+ *        算法的说明见hash.cc
+ */
+namespace hash_detail {
+
+constexpr size_t STRIPE_SIZE = 32;
+constexpr size_t STRIPE_LANES = 4;
+constexpr size_t STRIPES_PER_BLOCK = 32;
+constexpr size_t SECRET_SIZE = STRIPES_PER_BLOCK + STRIPE_LANES;
+constexpr uint64_t PRIME32 = 0x9e3779b1;
+constexpr uint64_t PRIME64 = 0xc6a4a7935bd1e995;
+///< 短输入(小于SHORT_INPUT字节)直接逐8字节串行混合
+constexpr size_t SHORT_INPUT = 4 * STRIPE_SIZE;
+
+constexpr uint64_t splitmix64(uint64_t v) {
+    v ^= v >> 30;
+    v *= 0xbf58476d1ce4e5b9ULL;
+    v ^= v >> 27;
+    v *= 0x94d049bb133111ebULL;
+    v ^= v >> 31;
+    return v;
+}
+
+struct hash_secret {
+    constexpr hash_secret() : keys() {
+        for (size_t i = 0; i < SECRET_SIZE; ++i) {
+            keys[i] = splitmix64(0x9e3779b97f4a7c15ULL * (i + 1));
+        }
+    }
+    uint64_t keys[SECRET_SIZE];
+};
+
+//第n个stripe的第i条lane使用keys[n + i]，打乱时使用keys[STRIPES_PER_BLOCK + i]
+inline constexpr hash_secret SECRET;
+
+/**
+ * @brief 编译期不能用memcpy，按小端逐字节拼出n(<= 8)个字节
+ */
+constexpr uint64_t load_le(const char* p, size_t n) {
+    uint64_t v = 0;
+    for (size_t i = 0; i != n; ++i) {
+        v |= static_cast<uint64_t>(static_cast<unsigned char>(p[i])) << (8 * i);
+    }
+    return v;
+}
+
+//逐8字节混合时第i块用keys[i]，短输入最多SHORT_INPUT / 8块
+static_assert(SHORT_INPUT / 8 <= SECRET_SIZE);
+
+/**
+ * @brief 和hash.cc里的mix_rest逐步相同
+ */
+constexpr uint64_t mix_rest_constexpr(uint64_t h, const char* data, size_t rest, uint64_t seed) {
+    for (size_t i = 0; rest >= 8; rest -= 8, data += 8, ++i) {
+        uint64_t k = load_le(data, 8) ^ SECRET.keys[i] ^ seed;
+        k *= PRIME64;
+        k ^= k >> 47;
+        k *= PRIME64;
+        h ^= k;
+        h *= PRIME64;
+    }
+    if (rest) {
+        h ^= load_le(data, rest);
+        h *= PRIME64;
+    }
+    return h;
+}
+
+/**
+ * @brief 和hash_bytes的标量实现逐步相同，只在常量求值时用
+ */
+constexpr uint64_t hash_bytes_constexpr(const char* data, size_t len, uint64_t seed) {
+    if (len < SHORT_INPUT) {
+        return splitmix64(mix_rest_constexpr(seed ^ (len * PRIME64), data, len, seed));
+    }
+    uint64_t acc[STRIPE_LANES] = {};
+    for (size_t i = 0; i != STRIPE_LANES; ++i) {
+        acc[i] = SECRET.keys[i] ^ seed;
+    }
+    size_t nstripes = len / STRIPE_SIZE;
+    for (size_t n = 0; n != nstripes; ++n) {
+        size_t k = n % STRIPES_PER_BLOCK;
+        for (size_t i = 0; i != STRIPE_LANES; ++i) {
+            uint64_t d = load_le(data + n * STRIPE_SIZE + 8 * i, 8);
+            uint64_t dk = d ^ (SECRET.keys[k + i] + seed);
+            acc[i] += d + (dk & 0xffffffff) * (dk >> 32);
+        }
+        if (STRIPES_PER_BLOCK - 1 == k) {
+            for (size_t i = 0; i != STRIPE_LANES; ++i) {
+                uint64_t v = acc[i];
+                v ^= v >> 47;
+                v ^= SECRET.keys[STRIPES_PER_BLOCK + i] + seed;
+                acc[i] = v * PRIME32;
+            }
+        }
+    }
+    uint64_t h = seed ^ (len * PRIME64);
+    uint64_t a = acc[0] ^ std::rotl(acc[1], 23);
+    uint64_t b = acc[2] ^ std::rotl(acc[3], 41);
+    h ^= (a * PRIME64) ^ std::rotl(b * 0xbf58476d1ce4e5b9ULL, 32);
+    return splitmix64(mix_rest_constexpr(h, data + nstripes * STRIPE_SIZE, len % STRIPE_SIZE, seed));
+}
 
-#define HASH_FUNCTION_INTEGRAL(Type)                \
-template<>                                          \
-struct hash_value<Type> {                           \
-    uint64_t operator()(Type v) const noexcept {    \
-        char buf[8]{0};                             \
-        unsigned long long tmp = v;                 \
-        snprintf(buf, sizeof buf, "%llu", tmp);     \
-        return murmurhash2(buf, sizeof buf, 0);     \
-    }                                               \
+#ifdef BIT32
+constexpr uint32_t fold(uint64_t h) {
+    return static_cast<uint32_t>(h ^ (h >> 32));
+}
+#else
+constexpr uint64_t fold(uint64_t h) {
+    return h;
 }
 #endif //BIT32
 
-HASH_FUNCTION_INTEGRAL(bool);
+} //namespace hash_detail
+
+/**
+ * @brief 以'\0'结尾的字符串的hash，找结尾和hash在同一遍读里完成，
+ * 		  结果与hash_bytes(str, strlen(str), seed)相同
+ */
+#ifdef BIT32
+uint32_t hash_cstr(const char* str, size_t seed = 0);
+#else
+uint64_t hash_cstr(const char* str, size_t seed = 0);
+#endif //BIT32
+
+/**
+ * @brief 取一个随机的种子，每次调用结果都不同，用来给每个哈希表
+ * 		  单独设置种子，让别人没法事先算出一组会冲突的key
+ */
+size_t random_seed();
+
+/**
+ * @brief 整数混合函数，按整数的字节宽度在编译期选择实现
+ * 		  全部是移位、异或、乘法，没有分支也不申请内存
+ * @tparam Width 整数的字节数
+ */
+template<size_t Width>
+struct int_mixer;
+
+#ifdef BIT32
+/**
+ * @brief lowbias32
+ * 		  https://nullprogram.com/blog/2018/07/31/
+ */
+template<>
+struct int_mixer<4> {
+    constexpr uint32_t operator()(uint32_t v, size_t seed = 0) const noexcept {
+        v ^= seed;
+        v ^= v >> 16;
+        v *= 0x7feb352dU;
+        v ^= v >> 15;
+        v *= 0x846ca68bU;
+        v ^= v >> 16;
+        return v;
+    }
+};
+
+/**
+ * @brief 先用splitmix64的混合函数，再把高32位折叠到低32位
+ */
+template<>
+struct int_mixer<8> {
+    constexpr uint32_t operator()(uint64_t v, size_t seed = 0) const noexcept {
+        v ^= seed;
+        v ^= v >> 30;
+        v *= 0xbf58476d1ce4e5b9ULL;
+        v ^= v >> 27;
+        v *= 0x94d049bb133111ebULL;
+        v ^= v >> 31;
+        return static_cast<uint32_t>(v ^ (v >> 32));
+    }
+};
+#else
+/**
+ * @brief 32位及以下的整数只有低32位有效，两轮乘法就能让每一位
+ * 		  都影响到结果的低位(桶下标只取低位)
+ */
+template<>
+struct int_mixer<4> {
+    constexpr uint64_t operator()(uint32_t v, size_t seed = 0) const noexcept {
+        uint64_t h = (v ^ seed) * 0x9e3779b97f4a7c15ULL;
+        h ^= h >> 32;
+        h *= 0xd6e8feb86659fd93ULL;
+        h ^= h >> 32;
+        return h;
+    }
+};
+
+/**
+ * @brief splitmix64的混合函数
+ * 		  https://prng.di.unimi.it/splitmix64.c
+ */
+template<>
+struct int_mixer<8> {
+    constexpr uint64_t operator()(uint64_t v, size_t seed = 0) const noexcept {
+        v ^= seed;
+        v ^= v >> 30;
+        v *= 0xbf58476d1ce4e5b9ULL;
+        v ^= v >> 27;
+        v *= 0x94d049bb133111ebULL;
+        v ^= v >> 31;
+        return v;
+    }
+};
+#endif //BIT32
+
+//bool、char、short都扩展成32位再混合
+template<>
+struct int_mixer<1> : public int_mixer<4> {
+};
+
+template<>
+struct int_mixer<2> : public int_mixer<4> {
+};
+
+#define HASH_FUNCTION_INTEGRAL(Type)                                            \
+template<>                                                                      \
+struct hash_value<Type> {                                                       \
+    constexpr HASH_RESULT_TYPE operator()(Type v, size_t seed = 0) const noexcept { \
+        using unsigned_type = std::make_unsigned_t<Type>;                       \
+        return int_mixer<sizeof(Type)>()(static_cast<unsigned_type>(v), seed);  \
+    }                                                                           \
+}
+
+template<>
+struct hash_value<bool> {
+    constexpr HASH_RESULT_TYPE operator()(bool v, size_t seed = 0) const noexcept {
+        return int_mixer<sizeof(bool)>()(static_cast<uint32_t>(v), seed);
+    }
+};
 
 HASH_FUNCTION_INTEGRAL(char);
 
@@ -71,65 +305,90 @@ HASH_FUNCTION_INTEGRAL(long long);
 
 HASH_FUNCTION_INTEGRAL(unsigned long long);
 
-#ifdef BIT32
-#define HASH_RESULT_TYPE uint32_t
-#else
-#define HASH_RESULT_TYPE uint64_t
-#endif //BIT32
-
+//0.0 == -0.0, 所以要保证二者的hash值相同
 template<>
 struct hash_value<float> {
-    HASH_RESULT_TYPE operator()(float v) const noexcept {
-        unsigned int tmp = *reinterpret_cast<int*>(&v);
-        return hash_value<unsigned int>()(tmp);
+    constexpr HASH_RESULT_TYPE operator()(float v, size_t seed = 0) const noexcept {
+        uint32_t bits = v == 0.0f ? 0 : std::bit_cast<uint32_t>(v);
+        return int_mixer<sizeof(float)>()(bits, seed);
     }
 };
 
 template<>
 struct hash_value<double> {
-    HASH_RESULT_TYPE operator()(double v) const noexcept {
-        unsigned long long tmp = *reinterpret_cast<unsigned long long*>(&v);
-        return hash_value<unsigned long long>()(tmp);
+    constexpr HASH_RESULT_TYPE operator()(double v, size_t seed = 0) const noexcept {
+        uint64_t bits = v == 0.0 ? 0 : std::bit_cast<uint64_t>(v);
+        return int_mixer<sizeof(double)>()(bits, seed);
     }
 };
 
 template<>
 struct hash_value<long double> {
-    HASH_RESULT_TYPE operator()(long double v) const noexcept {
-        return murmurhash2(reinterpret_cast<const char*>(&v), sizeof(v), 0);
+    HASH_RESULT_TYPE operator()(long double v, size_t seed = 0) const noexcept {
+        return murmurhash2(reinterpret_cast<const char*>(&v), sizeof(v), 
+                           static_cast<unsigned int>(seed));
     }
 };
 
+/**
+ * @brief 字符串的hash在常量求值时走hash_detail里的标量实现，结果和运行时相同，
+ *        可以用来在编译期建表(见frozen_hash_table.h)
+ */
 template<>
 struct hash_value<const char*> {
-    HASH_RESULT_TYPE operator()(const char* str) const noexcept {
-        return murmurhash2(str, strlen(str), 0);
+    constexpr HASH_RESULT_TYPE operator()(const char* str, size_t seed = 0) const noexcept {
+        if (std::is_constant_evaluated()) {
+            return hash_detail::fold(hash_detail::hash_bytes_constexpr(str, 
+                std::char_traits<char>::length(str), seed));
+        }
+        return hash_cstr(str, seed);
     };
 };
 
 template<>
 struct hash_value<const signed char*> {
-    HASH_RESULT_TYPE operator()(const signed char* str) const noexcept {
-        return hash_value<const char*>()(reinterpret_cast<const char*>(str));
+    HASH_RESULT_TYPE operator()(const signed char* str, size_t seed = 0) const noexcept {
+        return hash_value<const char*>()(reinterpret_cast<const char*>(str), seed);
     };
 };
 
 template<>
 struct hash_value<const unsigned char*> {
-    HASH_RESULT_TYPE operator()(const unsigned char* str) const noexcept {
-        return hash_value<const char*>()(reinterpret_cast<const char*>(str));
+    HASH_RESULT_TYPE operator()(const unsigned char* str, size_t seed = 0) const noexcept {
+        return hash_value<const char*>()(reinterpret_cast<const char*>(str), seed);
+    };
+};
+
+template<>
+struct hash_value<std::string_view> {
+    constexpr HASH_RESULT_TYPE operator()(std::string_view str, size_t seed = 0) const noexcept {
+        if (std::is_constant_evaluated()) {
+            return hash_detail::fold(hash_detail::hash_bytes_constexpr(str.data(), str.size(), seed));
+        }
+        return hash_bytes(str.data(), str.size(), seed);
+    };
+};
+
+/**
+ * @brief std::string和std::string_view、const char*的hash值相同，可以异构查找
+ */
+template<>
+struct hash_value<std::string> {
+    using is_transparent = void;
+    constexpr HASH_RESULT_TYPE operator()(std::string_view str, size_t seed = 0) const noexcept {
+        return hash_value<std::string_view>()(str, seed);
     };
 };
 
 template<typename T>
 struct hash_value<T*> {
-    HASH_RESULT_TYPE operator()(T* ptr) const noexcept {
+    HASH_RESULT_TYPE operator()(T* ptr, size_t seed = 0) const noexcept {
         uintptr_t addr = reinterpret_cast<uintptr_t>(ptr);
-        return hash_value<uintptr_t>()(addr);
+        return int_mixer<sizeof(uintptr_t)>()(addr, seed);
     };
 };
 
 #undef HASH_RESULT_TYPE
-#undef HASH_FUNCTION
+#undef HASH_FUNCTION_INTEGRAL
 
 } //namespace nano
\ No newline at end of file
@@ -0,0 +1,278 @@
+#pragma once
+
+#include "hash_table.h"
+#include <tuple>
+#include <stdexcept>
+#include <initializer_list>
+
+namespace nano {
+
+/**
+ * @brief hash_map的元素是std::pair<const K, V>，下面三个函数对象只看key，
+ * 		  既能比较两个元素，也能直接拿key和元素比较，查找时不用构造元素
+ */
+template<typename K, typename V, typename Hash>
+struct hm_hasher {
+	using value_type = std::pair<const K, V>;
+	using is_transparent = void;
+
+	size_t operator()(const value_type& value) const {
+		return hash(value.first);
+	}
+	//Hash能接收种子时hash_table才会传种子
+	size_t operator()(const value_type& value, size_t seed) const
+		requires std::is_invocable_v<const Hash&, const K&, size_t> {
+		return hash(value.first, seed);
+	}
+	template<typename Key> requires (!std::is_same_v<Key, value_type>)
+	size_t operator()(const Key& key) const {
+		return hash(key);
+	}
+	template<typename Key> requires (!std::is_same_v<Key, value_type>)
+	size_t operator()(const Key& key, size_t seed) const
+		requires std::is_invocable_v<const Hash&, const K&, size_t> {
+		return hash(key, seed);
+	}
+
+	Hash hash;
+};
+
+template<typename K, typename V, typename Pred>
+struct hm_key_equal {
+	using value_type = std::pair<const K, V>;
+	using is_transparent = void;
+
+	bool operator()(const value_type& lhs, const value_type& rhs) const {
+		return equal(lhs.first, rhs.first);
+	}
+	template<typename Key> requires (!std::is_same_v<Key, value_type>)
+	bool operator()(const value_type& lhs, const Key& rhs) const {
+		return equal(lhs.first, rhs);
+	}
+
+	Pred equal;
+};
+
+template<typename K, typename V, typename Comp>
+struct hm_key_compare {
+	using value_type = std::pair<const K, V>;
+
+	bool operator()(const value_type& lhs, const value_type& rhs) const {
+		return comp(lhs.first, rhs.first);
+	}
+	template<typename Key> requires (!std::is_same_v<Key, value_type>)
+	bool operator()(const value_type& lhs, const Key& rhs) const {
+		return comp(lhs.first, rhs);
+	}
+	template<typename Key> requires (!std::is_same_v<Key, value_type>)
+	bool operator()(const Key& lhs, const value_type& rhs) const {
+		return comp(lhs, rhs.first);
+	}
+
+	Comp comp;
+};
+
+/**
+ * @brief 基于hash_table的key-value容器，桶、树化、换种子、渐进式rehash都和hash_table一样
+ * @tparam Comp 桶树化之后比较key用
+ * @attention Hash和Pred都声明了is_transparent时(比如hash_value<std::string>和
+ * 			  std::equal_to<>)，可以用std::string_view之类的类型直接查找，不用构造key
+ */
+template<typename K, typename V, bool cache = false, typename Hash = hash_value<K>,
+	typename Comp = std::less<>, typename Pred = std::equal_to<>>
+class hash_map {
+private:
+	using table_type = hash_table<std::pair<const K, V>, cache, hm_hasher<K, V, Hash>,
+		hm_key_compare<K, V, Comp>, hm_key_equal<K, V, Pred>>;
+	///< 能不能用其他类型的key查找。能转成K的类型(const char*、字符串字面量)
+	///< 只要Hash能直接接收也走这里，不构造临时的K
+	template<typename Key>
+	constexpr static bool TRANSPARENT_KEY = requires {
+		typename Hash::is_transparent;
+		typename Pred::is_transparent;
+	} && !std::is_same_v<Key, K> && std::is_invocable_v<const Hash&, const Key&>;
+
+public:
+	using key_type 			= K;
+	using mapped_type 		= V;
+	using value_type 		= std::pair<const K, V>;
+	using reference 		= value_type&;
+	using const_reference 	= const value_type&;
+	using size_type 		= size_t;
+	using difference_type 	= ptrdiff_t;
+	using hasher 			= Hash;
+	using key_compare 		= Comp;
+	using key_equal 		= Pred;
+	using iterator 			= typename table_type::iterator;
+	using const_iterator 	= typename table_type::const_iterator;
+	using node_type 		= typename table_type::node_type;
+	using insert_return_type = typename table_type::insert_return_type;
+
+public:
+	explicit hash_map(size_type n = 16,
+					const hasher& hf = hasher(),
+					const key_compare& comp = key_compare(),
+					const key_equal& eql = key_equal()) :
+		m_table(n, { hf }, { comp }, { eql }) {
+	}
+	template <std::input_iterator InputIter>
+	hash_map(InputIter first, InputIter last, size_type n = 16) :
+		hash_map(n) {
+		insert(first, last);
+	}
+	hash_map(std::initializer_list<value_type> ilist, size_type n = 16) :
+		hash_map(ilist.begin(), ilist.end(), n) {
+	}
+
+	iterator begin() noexcept { return m_table.begin(); }
+	const_iterator begin() const noexcept { return m_table.begin(); }
+	iterator end() noexcept { return m_table.end(); }
+	const_iterator end() const noexcept { return m_table.end(); }
+	const_iterator cbegin() const noexcept { return begin(); }
+	const_iterator cend() const noexcept { return end(); }
+
+	bool empty() const noexcept { return m_table.empty(); }
+	size_type size() const noexcept { return m_table.size(); }
+
+	// 插入
+	std::pair<iterator, bool> insert(const value_type& value) {
+		return m_table.insert_unique(value);
+	}
+	std::pair<iterator, bool> insert(value_type&& value) {
+		return m_table.insert_unique(std::move(value));
+	}
+	template <std::input_iterator InputIter>
+	void insert(InputIter first, InputIter last) {
+		for (; first != last; ++first) {
+			insert(*first);
+		}
+	}
+	template<typename... Args>
+	std::pair<iterator, bool> emplace(Args&&... args) {
+		return m_table.emplace_unique(std::forward<Args>(args)...);
+	}
+
+	/**
+	 * @brief key已经存在时什么都不做，args不会被移动，也不会构造value
+	 */
+	template<typename... Args>
+	std::pair<iterator, bool> try_emplace(const key_type& key, Args&&... args) {
+		return m_table.try_emplace_unique(key, std::piecewise_construct,
+			std::forward_as_tuple(key), std::forward_as_tuple(std::forward<Args>(args)...));
+	}
+	template<typename... Args>
+	std::pair<iterator, bool> try_emplace(key_type&& key, Args&&... args) {
+		//查找用的是key，查找完了才会从key移动构造
+		return m_table.try_emplace_unique(key, std::piecewise_construct,
+			std::forward_as_tuple(std::move(key)), std::forward_as_tuple(std::forward<Args>(args)...));
+	}
+	template<typename M>
+	std::pair<iterator, bool> insert_or_assign(const key_type& key, M&& obj) {
+		std::pair<iterator, bool> result = try_emplace(key, std::forward<M>(obj));
+		if (!result.second) {
+			result.first->second = std::forward<M>(obj);
+		}
+		return result;
+	}
+	template<typename M>
+	std::pair<iterator, bool> insert_or_assign(key_type&& key, M&& obj) {
+		std::pair<iterator, bool> result = try_emplace(std::move(key), std::forward<M>(obj));
+		if (!result.second) {
+			result.first->second = std::forward<M>(obj);
+		}
+		return result;
+	}
+
+	mapped_type& operator[](const key_type& key) {
+		return try_emplace(key).first->second;
+	}
+	mapped_type& operator[](key_type&& key) {
+		return try_emplace(std::move(key)).first->second;
+	}
+	mapped_type& at(const key_type& key) {
+		iterator iter = find(key);
+		if (iter == end()) {
+			throw std::out_of_range("hash_map::at");
+		}
+		return iter->second;
+	}
+	const mapped_type& at(const key_type& key) const {
+		const_iterator iter = find(key);
+		if (iter == end()) {
+			throw std::out_of_range("hash_map::at");
+		}
+		return iter->second;
+	}
+
+	// 删除
+	void erase(const_iterator position) { m_table.erase(position); }
+	size_type erase(const key_type& key) { return m_table.erase_unique(key); }
+	template<typename Key> requires TRANSPARENT_KEY<Key>
+	size_type erase(const Key& key) { return m_table.erase_unique(key); }
+	void clear() { m_table.clear(); }
+	void swap(hash_map& other) noexcept { m_table.swap(other.m_table); }
+
+	// 节点
+	node_type extract(const_iterator position) { return m_table.extract(position); }
+	node_type extract(const key_type& key) { return m_table.extract(find(key)); }
+	insert_return_type insert(node_type&& node) { return m_table.insert_unique(std::move(node)); }
+	void merge(hash_map& source) { m_table.merge_unique(source.m_table); }
+	void merge(hash_map&& source) { m_table.merge_unique(source.m_table); }
+
+	// 查找
+	iterator find(const key_type& key) { return m_table.find(key); }
+	const_iterator find(const key_type& key) const { return m_table.find(key); }
+	template<typename Key> requires TRANSPARENT_KEY<Key>
+	iterator find(const Key& key) { return m_table.find(key); }
+	template<typename Key> requires TRANSPARENT_KEY<Key>
+	const_iterator find(const Key& key) const { return m_table.find(key); }
+	size_type count(const key_type& key) const { return m_table.count_unique(key); }
+	template<typename Key> requires TRANSPARENT_KEY<Key>
+	size_type count(const Key& key) const { return m_table.count_unique(key); }
+	bool contains(const key_type& key) const { return find(key) != end(); }
+	template<typename Key> requires TRANSPARENT_KEY<Key>
+	bool contains(const Key& key) const { return find(key) != end(); }
+
+	// hash policy
+	size_type bucket_count() const noexcept { return m_table.bucket_count(); }
+	float load_factor() const noexcept { return m_table.load_factor(); }
+	float max_load_factor() const noexcept { return m_table.max_load_factor(); }
+	void max_load_factor(float mlf) noexcept { m_table.max_load_factor(mlf); }
+	float min_load_factor() const noexcept { return m_table.min_load_factor(); }
+	void min_load_factor(float mlf) noexcept { m_table.min_load_factor(mlf); }
+	void shrink_to_fit() { m_table.shrink_to_fit(); }
+	void rehash(size_type n) { m_table.rehash(n); }
+	void reserve(size_type n) { m_table.reserve(n); }
+	size_t hash_seed() const noexcept { return m_table.hash_seed(); }
+	void incremental_rehash(bool on) { m_table.incremental_rehash(on); }
+	bool incremental_rehash() const noexcept { return m_table.incremental_rehash(); }
+	hasher hash_function() const { return m_table.hash_function().hash; }
+	key_equal key_eq() const { return m_table.key_eq().equal; }
+
+	friend bool operator==(const hash_map& lhs, const hash_map& rhs) {
+		if (lhs.size() != rhs.size()) {
+			return false;
+		}
+		for (const value_type& value : lhs) {
+			const_iterator iter = rhs.find(value.first);
+			if (iter == rhs.end() || !(iter->second == value.second)) {
+				return false;
+			}
+		}
+		return true;
+	}
+	friend bool operator!=(const hash_map& lhs, const hash_map& rhs) {
+		return !(lhs == rhs);
+	}
+
+private:
+	table_type m_table;
+};
+
+template<typename K, typename V, bool cache, typename Hash, typename Comp, typename Pred>
+void swap(hash_map<K, V, cache, Hash, Comp, Pred>& lhs,
+		hash_map<K, V, cache, Hash, Comp, Pred>& rhs) noexcept {
+	lhs.swap(rhs);
+}
+
+} //namespace nano
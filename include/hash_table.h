@@ -6,12 +6,24 @@
 #include "system.h"
 #include "algo.h"
 #include "hash.h"
+#include "node_pool.h"
+#include "ht_snapshot.h"
+#include "mapped_file.h"
+#include "ht_stats.h"
 #include <assert.h>
+#include <stdlib.h>
+#include <stddef.h>
+#include <string.h>
 #include <iterator>
-
-#ifdef BIT32
-#include "dynamic_bitset.h"
-#endif //BIT32
+#include <bit>
+#include <vector>
+#include <algorithm>
+#include <stdexcept>
+#include <thread>
+#include <atomic>
+#include <exception>
+#include <system_error>
+#include <memory>
 
 namespace nano {
 
@@ -64,6 +76,18 @@ list_find_first_of(ht_list_node<T, cache>* head, const T& val, const BinOp& bino
 	return static_cast<ht_list_node<T, cache>*>(list_find_first_of(headBase, val, binop));
 }
 
+/**
+ * @brief key的类型可以和T不同，binop(T, Key)判断相等
+ */
+template<typename T, bool cache, typename Key, typename BinOp>
+inline ht_list_node<T, cache>*
+ht_list_find_key(ht_list_node<T, cache>* head, const Key& key, const BinOp& binop) {
+	while (head && !binop(head->value, key)) {
+		head = next_of(head);
+	}
+	return head;
+}
+
 /**
  * @brief 
  * @tparam T 
@@ -149,17 +173,32 @@ ht_tree_insert_node_unique(ht_tree_node<T, cache>* node,
 	rb_tree_node<T>* rbRoot = *root;
 	std::pair<rb_tree_node<T>*, bool> result = rb_insert_node_unique(node, &rbRoot, comp);
 	*root = static_cast<ht_tree_node<T, cache>*>(rbRoot);
-	return { *root, result.second };
+	return { static_cast<ht_tree_node<T, cache>*>(result.first), result.second };
 }
 
+/**
+ * @return 真正从树上摘下来的节点，node有两个孩子时是node的后继，
+ * 		   后继的值已经移到了node里
+ */
 template<typename T, bool cache>
 inline ht_tree_node<T, cache>* 
 ht_tree_erase_node(ht_tree_node<T, cache>* node,
 		ht_tree_node<T, cache>** root) {
 	rb_tree_node<T>* rbRoot = *root;
-	rb_erase_node(node, &rbRoot);
+	std::pair<rb_tree_node<T>*, rb_tree_node<T>*> result = rb_erase_node(node, &rbRoot);
+	*root = static_cast<ht_tree_node<T, cache>*>(rbRoot);
+	return static_cast<ht_tree_node<T, cache>*>(result.second);
+}
+
+/**
+ * @brief 和ht_tree_erase_node一样，但是不移动元素，摘下来的一定是node本身
+ */
+template<typename T, bool cache>
+inline void ht_tree_extract_node(ht_tree_node<T, cache>* node,
+		ht_tree_node<T, cache>** root) {
+	rb_tree_node<T>* rbRoot = *root;
+	rb_erase_node<T, true>(node, &rbRoot);
 	*root = static_cast<ht_tree_node<T, cache>*>(rbRoot);
-	return *root;
 }
 
 template<typename T, bool cache, typename Comp>
@@ -168,10 +207,47 @@ ht_tree_lbound(const T& val, ht_tree_node<T, cache>* root, const Comp& comp) {
 	return static_cast<ht_tree_node<T, cache>*>(bst_lbound(val, root, comp));
 }
 
+/**
+ * @brief key的类型可以和T不同，comp(T, Key)判断小于
+ */
+template<typename T, bool cache, typename Key, typename Comp>
+inline ht_tree_node<T, cache>* 
+ht_tree_lbound_key(const Key& key, ht_tree_node<T, cache>* root, const Comp& comp) {
+	ht_tree_node<T, cache>* parent = nullptr;
+	while (root) {
+		if (!comp(root->value, key)) {
+			parent = root;
+			root = left_of(root);
+		} else {
+			root = right_of(root);
+		}
+	}
+	return parent;
+}
+
+/**
+ * @brief 同上，visited加上往下走时看过的节点个数
+ */
+template<typename T, bool cache, typename Key, typename Comp>
+inline ht_tree_node<T, cache>* 
+ht_tree_lbound_key(const Key& key, ht_tree_node<T, cache>* root, const Comp& comp, size_t& visited) {
+	ht_tree_node<T, cache>* parent = nullptr;
+	while (root) {
+		++visited;
+		if (!comp(root->value, key)) {
+			parent = root;
+			root = left_of(root);
+		} else {
+			root = right_of(root);
+		}
+	}
+	return parent;
+}
+
 template<typename T, bool cache, typename Comp>
 inline ht_tree_node<T, cache>* 
-ht_tree_rbound(const T& val, ht_tree_node<T, cache>* root, const Comp& comp) {
-	return static_cast<ht_tree_node<T, cache>*>(bst_rbound(val, root, comp));
+ht_tree_ubound(const T& val, ht_tree_node<T, cache>* root, const Comp& comp) {
+	return static_cast<ht_tree_node<T, cache>*>(bst_ubound(val, root, comp));
 }
 
 template<typename T, bool cache, typename Size, typename Comp>
@@ -187,8 +263,150 @@ ht_tree_equal_range_multi(const T& val, ht_tree_node<T, cache>* root,
     return { ht_tree_lbound(val, root, comp), ht_tree_ubound(val, root, comp) };
 }
 
+/**
+ * @brief ht_sorted_bucket的溢出桶: 一块连续内存，开头是元素个数和容量，后面是按comp
+ * 		  排好序的节点指针；T小而且能平凡复制时再跟一份元素的拷贝，二分时不用跳到节点上。
+ * 		  节点还是链表节点，按同样的顺序用next连起来，遍历时和链表桶一样
+ */
+template<typename T, bool cache>
+struct ht_sorted_array {
+	using list_node_ptr = ht_list_node<T, cache>*;
+	///< 元素拷贝放在数组里
+	constexpr static bool INLINE_KEYS = std::is_trivially_copyable_v<T> && sizeof(T) <= sizeof(void*);
+
+	size_t size;
+	size_t capacity;
+
+	list_node_ptr* nodes() noexcept {
+		return reinterpret_cast<list_node_ptr*>(this + 1);
+	}
+	T* keys() noexcept {
+		return reinterpret_cast<T*>(nodes() + capacity);
+	}
+	const T& key_at(size_t i) noexcept {
+		if constexpr(INLINE_KEYS) {
+			return keys()[i];
+		} else {
+			return nodes()[i]->value;
+		}
+	}
+
+	static size_t bytes(size_t capacity) noexcept {
+		return sizeof(ht_sorted_array) + capacity * (sizeof(list_node_ptr) + (INLINE_KEYS ? sizeof(T) : 0));
+	}
+	static ht_sorted_array* create(size_t capacity) {
+		ht_sorted_array* array = static_cast<ht_sorted_array*>(::operator new(bytes(capacity)));
+		array->size = 0;
+		array->capacity = capacity;
+		return array;
+	}
+	/**
+	 * @brief 按原来的顺序搬到一块capacity大的新内存里，释放原来的
+	 */
+	ht_sorted_array* grow(size_t newCapacity) {
+		ht_sorted_array* array = create(newCapacity);
+		array->size = size;
+		memcpy(array->nodes(), nodes(), size * sizeof(list_node_ptr));
+		if constexpr(INLINE_KEYS) {
+			memcpy(static_cast<void*>(array->keys()), keys(), size * sizeof(T));
+		}
+		::operator delete(this);
+		return array;
+	}
+	static void destroy(ht_sorted_array* array) noexcept {
+		::operator delete(array);
+	}
+
+	/**
+	 * @brief 第一个不小于key的位置，没有分支的二分，visited加上比较的次数
+	 */
+	template<typename Key, typename Comp>
+	size_t lower_bound(const Key& key, const Comp& comp, size_t& visited) noexcept {
+		size_t first = 0;
+		size_t n = size;
+		while (n > 1) {
+			size_t half = n / 2;
+			first = comp(key_at(first + half - 1), key) ? first + half : first;
+			n -= half;
+			++visited;
+		}
+		if (n == 1) {
+			first += comp(key_at(first), key);
+			++visited;
+		}
+		return first;
+	}
+	template<typename Key, typename Comp>
+	size_t lower_bound(const Key& key, const Comp& comp) noexcept {
+		size_t visited = 0;
+		return lower_bound(key, comp, visited);
+	}
+	/**
+	 * @brief 第一个大于key的位置
+	 */
+	template<typename Key, typename Comp>
+	size_t upper_bound(const Key& key, const Comp& comp) noexcept {
+		size_t first = 0;
+		size_t n = size;
+		while (n > 1) {
+			size_t half = n / 2;
+			first = comp(key, key_at(first + half - 1)) ? first : first + half;
+			n -= half;
+		}
+		if (n == 1) {
+			first += !comp(key, key_at(first));
+		}
+		return first;
+	}
+	/**
+	 * @brief 节点node在数组里的位置，node一定在里面
+	 */
+	template<typename Comp>
+	size_t position(list_node_ptr node, const Comp& comp) noexcept {
+		size_t pos = lower_bound(node->value, comp);
+		while (nodes()[pos] != node) {
+			++pos;
+		}
+		return pos;
+	}
+	/**
+	 * @brief 把node放到第pos个位置，同时挂到前一个节点后面，调用者保证容量够
+	 */
+	void insert(size_t pos, list_node_ptr node) noexcept {
+		list_node_ptr* ptrs = nodes();
+		memmove(ptrs + pos + 1, ptrs + pos, (size - pos) * sizeof(list_node_ptr));
+		ptrs[pos] = node;
+		if constexpr(INLINE_KEYS) {
+			memmove(static_cast<void*>(keys() + pos + 1), keys() + pos, (size - pos) * sizeof(T));
+			memcpy(static_cast<void*>(keys() + pos), &node->value, sizeof(T));
+		}
+		node->next = pos + 1 <= size ? ptrs[pos + 1] : nullptr;
+		if (pos) {
+			ptrs[pos - 1]->next = node;
+		}
+		++size;
+	}
+	/**
+	 * @brief 去掉第pos个节点，前一个节点接上后一个
+	 */
+	void erase(size_t pos) noexcept {
+		list_node_ptr* ptrs = nodes();
+		if (pos) {
+			ptrs[pos - 1]->next = ptrs[pos]->next;
+		}
+		--size;
+		memmove(ptrs + pos, ptrs + pos + 1, (size - pos) * sizeof(list_node_ptr));
+		if constexpr(INLINE_KEYS) {
+			memmove(static_cast<void*>(keys() + pos), keys() + pos + 1, (size - pos) * sizeof(T));
+		}
+	}
+};
+
 #ifdef BIT64
 inline constexpr static uint64_t mask = 0x8000000000000000;
+///< 次高位: ht_inline_bucket的桶自带的节点正在使用
+inline constexpr static uint64_t inline_mask = 0x4000000000000000;
+inline constexpr static uint64_t tag_mask = mask | inline_mask;
 
 /**
  * @brief 由于在64位Linux(Windows也一样)上地址最高三位在用户态下是不使用的
@@ -213,12 +431,12 @@ union ht_entry { //可以考虑使用variant.
 	}
 	ht_entry& operator=(ht_list_node<T, cache>* node) {
 		uint64_t addr = reinterpret_cast<uint64_t>(node);
-		list_node = reinterpret_cast<ht_list_node<T>*>(addr | (flag & mask));
+		list_node = reinterpret_cast<ht_list_node<T, cache>*>(addr | (flag & tag_mask));
 		return *this;
 	}
 	ht_entry& operator=(ht_tree_node<T, cache>* node) {
 		uint64_t addr = reinterpret_cast<uint64_t>(node);
-		tree_node = reinterpret_cast<ht_tree_node<T>*>(addr | (flag & mask));
+		tree_node = reinterpret_cast<ht_tree_node<T, cache>*>(addr | (flag & tag_mask));
 		return *this;
 	}
 	ht_entry& operator=(const ht_entry<T, cache>& other) {
@@ -229,15 +447,15 @@ union ht_entry { //可以考虑使用variant.
 	}
 
 	ht_list_node<T, cache>* as_list_node_ptr() const {
-		return reinterpret_cast<ht_list_node<T, cache>*>(flag & (~mask));
+		return reinterpret_cast<ht_list_node<T, cache>*>(flag & (~tag_mask));
 	}
 
 	ht_tree_node<T, cache>* as_tree_node_ptr() const {
-		return reinterpret_cast<ht_tree_node<T, cache>*>(flag & (~mask));
+		return reinterpret_cast<ht_tree_node<T, cache>*>(flag & (~tag_mask));
 	}
 
 	bool isnull() const {
-		return 0 == flag;
+		return 0 == (flag & (~tag_mask));
 	}
 
 	ht_list_node<T, cache>* list_node;	//也可以考虑用数组
@@ -283,20 +501,165 @@ union ht_entry {
 };
 #endif //BIT64
 
+/**
+ * @brief 桶的布局: 桶里只有一个指针，所有元素都在堆上的节点里
+ */
+struct ht_node_bucket {};
+
+/**
+ * @brief 桶的布局: 每个桶自带一个链表节点，和指针放在一起。负载因子在1附近时
+ * 		  大部分桶只有0、1个元素，查找时桶和元素在同一条cache line上，不用再跳到
+ * 		  堆上的节点；放不下的元素照旧挂链表、树化。自带的节点用ht_entry的次高位
+ * 		  标记是否在用，所以只支持64位，T要能平凡地移动和析构，而且最好很小，
+ * 		  空桶也要占一个节点的空间
+ */
+struct ht_inline_bucket {};
+
+/**
+ * @brief 桶的布局: 和ht_node_bucket一样，但是桶的长度达到TREEFY_THRESHOLD时
+ * 		  不转成红黑树，而是给桶配一个按comp排好序的节点指针数组(ht_sorted_array)，
+ * 		  查找时二分。一次就能建好，不用换节点，插入、删除时挪动数组，比树节点
+ * 		  省内存、对cache友好，适合一个桶里只有几十个元素的情况。碰撞成千上万时
+ * 		  插入、删除要挪动整个数组，不如红黑树
+ */
+struct ht_sorted_bucket {};
+
+/**
+ * @brief 桶的占用位图，每个桶一位，1表示桶不为空。遍历时每次看64个桶，
+ * 		  用countr_zero(tzcnt)直接跳到下一个非空桶，大量删除或者reserve
+ * 		  得很大以后，begin()和++都不用一个个地看空桶
+ * 		  32位下桶里的指针没有空闲的位，区分链表和树的标志放在同一块内存的后半部分
+ */
+class ht_bitmap {
+public:
+	using word_type = uint64_t;
+	constexpr static size_t WORD_BITS = sizeof(word_type) * 8;
+
+public:
+	ht_bitmap() noexcept = default;
+	explicit ht_bitmap(size_t n) :
+			m_bit_count(n),
+			m_word_count((n + WORD_BITS - 1) / WORD_BITS),
+			m_words(allocate(m_word_count)) {
+	}
+	ht_bitmap(const ht_bitmap& other) :
+			m_bit_count(other.m_bit_count),
+			m_word_count(other.m_word_count),
+			m_words(allocate(m_word_count)) {
+		if (m_words) {
+			::memcpy(m_words, other.m_words, allocation_words(m_word_count) * sizeof(word_type));
+		}
+	}
+	ht_bitmap(ht_bitmap&& other) noexcept :
+			m_bit_count(other.m_bit_count),
+			m_word_count(other.m_word_count),
+			m_words(other.m_words) {
+		other.m_bit_count = 0;
+		other.m_word_count = 0;
+		other.m_words = nullptr;
+	}
+	ht_bitmap& operator=(ht_bitmap other) noexcept {
+		swap(other);
+		return *this;
+	}
+	~ht_bitmap() { ::free(m_words); }
+
+	void swap(ht_bitmap& other) noexcept {
+		std::swap(m_bit_count, other.m_bit_count);
+		std::swap(m_word_count, other.m_word_count);
+		std::swap(m_words, other.m_words);
+	}
+
+	bool occupied(size_t index) const noexcept {
+		return (m_words[index / WORD_BITS] >> (index % WORD_BITS)) & 1;
+	}
+	void occupy(size_t index) noexcept {
+		m_words[index / WORD_BITS] |= word_type(1) << (index % WORD_BITS);
+	}
+	void vacate(size_t index) noexcept {
+		m_words[index / WORD_BITS] &= ~(word_type(1) << (index % WORD_BITS));
+	}
+	/**
+	 * @return [index, size())里第一个非空桶，没有的话返回size()
+	 */
+	size_t next(size_t index) const noexcept {
+		if (index >= m_bit_count) {
+			return m_bit_count;
+		}
+		size_t wordIndex = index / WORD_BITS;
+		//去掉index之前的位
+		word_type word = m_words[wordIndex] & (~word_type(0) << (index % WORD_BITS));
+		while (0 == word) {
+			if (++wordIndex == m_word_count) {
+				return m_bit_count;
+			}
+			word = m_words[wordIndex];
+		}
+		return wordIndex * WORD_BITS + std::countr_zero(word);
+	}
+	/**
+	 * @brief 所有桶都置为空(32位下连同树的标志)
+	 */
+	void reset() noexcept {
+		if (m_words) {
+			::memset(m_words, 0, allocation_words(m_word_count) * sizeof(word_type));
+		}
+	}
+	size_t size() const noexcept { return m_bit_count; }
+	size_t bytes() const noexcept { return allocation_words(m_word_count) * sizeof(word_type); }
+
+#ifdef BIT32
+	bool is_tree(size_t index) const noexcept {
+		return (m_words[m_word_count + index / WORD_BITS] >> (index % WORD_BITS)) & 1;
+	}
+	void mark(size_t index) noexcept {
+		m_words[m_word_count + index / WORD_BITS] |= word_type(1) << (index % WORD_BITS);
+	}
+	void unmark(size_t index) noexcept {
+		m_words[m_word_count + index / WORD_BITS] &= ~(word_type(1) << (index % WORD_BITS));
+	}
+#endif //BIT32
+
+private:
+	constexpr static size_t allocation_words(size_t wordCount) noexcept {
+#ifdef BIT64
+		return wordCount;
+#else
+		return 2 * wordCount;
+#endif //BIT64
+	}
+	static word_type* allocate(size_t wordCount) {
+		if (0 == wordCount) {
+			return nullptr;
+		}
+		word_type* words = static_cast<word_type*>(
+			::calloc(allocation_words(wordCount), sizeof(word_type)));
+		if (nullptr == words) {
+			throw std::bad_alloc();
+		}
+		return words;
+	}
+
+private:
+	size_t m_bit_count = 0;
+	size_t m_word_count = 0;
+	word_type* m_words = nullptr;	///< 32位下后m_word_count个字是树的标志
+};
+
 //如果一个类可以比较大小，那么一定可以加上逻辑判断来比较相等和不相等
-template<typename T, bool cache, typename Hash, typename Comp, typename Pred>
+template<typename T, bool cache, typename Hash, typename Comp, typename Pred, typename Bucket>
 class hash_table;
 
 template<typename T, bool cache = false, typename Hash = hash_value<T>, 
-	typename Comp = std::less<T>, typename Pred = std::equal_to<T>>
+	typename Comp = std::less<T>, typename Pred = std::equal_to<T>, typename Bucket = ht_node_bucket>
 struct ht_iterator_base : public std::iterator<std::forward_iterator_tag, T> {  
 	using difference_type   = ptrdiff_t;
 	using value_type 		= T;
 	using reference			= T&; 
 	using pointer 			= T*;
 	using size_type 		= size_t;
-	using self              = ht_iterator_base<T, cache, Hash, Comp, Pred>;
-    using container         = hash_table<T, cache, Hash, Comp, Pred>;
+	using self              = ht_iterator_base<T, cache, Hash, Comp, Pred, Bucket>;
+    using container         = hash_table<T, cache, Hash, Comp, Pred, Bucket>;
 	using tree_node 		= ht_tree_node<T, cache>;
 	using list_node 		= ht_list_node<T, cache>;
 	using tree_node_ptr 	= tree_node*;
@@ -316,7 +679,7 @@ struct ht_iterator_base : public std::iterator<std::forward_iterator_tag, T> {
 	}
     bool operator!=(const self& other) const noexcept { return !(*this == other); }
     reference operator*() const noexcept { 
-		if (ht->is_list(bIndex)) {
+		if (ht->holds_list_nodes(bIndex)) {
 			return entry.as_list_node_ptr()->value;
 		} else {
 			return entry.as_tree_node_ptr()->value;
@@ -329,9 +692,9 @@ struct ht_iterator_base : public std::iterator<std::forward_iterator_tag, T> {
 	container* ht;      ///< 哈希表
 };
 
-template<typename T, bool cache, typename Hash, typename Comp, typename Pred>
-void ht_iterator_base<T, cache, Hash, Comp, Pred>::increase() noexcept {
-	if (ht->is_list(bIndex)) {
+template<typename T, bool cache, typename Hash, typename Comp, typename Pred, typename Bucket>
+void ht_iterator_base<T, cache, Hash, Comp, Pred, Bucket>::increase() noexcept {
+	if (ht->holds_list_nodes(bIndex)) {
 		list_node_ptr head = entry.as_list_node_ptr();
 		head = next_of(head);
 		if (nullptr == head) {
@@ -354,43 +717,43 @@ void ht_iterator_base<T, cache, Hash, Comp, Pred>::increase() noexcept {
 	}
 }
 
-template<typename T, bool cache, typename Hash, typename Comp, typename Pred>
+template<typename T, bool cache, typename Hash, typename Comp, typename Pred, typename Bucket>
 struct ht_iterator;
 
-template<typename T, bool cache, typename Hash, typename Comp, typename Pred>
+template<typename T, bool cache, typename Hash, typename Comp, typename Pred, typename Bucket>
 struct ht_const_iterator;
 
 template<typename T, bool cache = false, typename Hash = hash_value<T>, 
-	typename Comp = std::less<T>, typename Pred = std::equal_to<T>>
-struct ht_iterator : public ht_iterator_base<T, cache, Hash, Comp, Pred> {
+	typename Comp = std::less<T>, typename Pred = std::equal_to<T>, typename Bucket = ht_node_bucket>
+struct ht_iterator : public ht_iterator_base<T, cache, Hash, Comp, Pred, Bucket> {
     using iterator_category = std::forward_iterator_tag;
 	using difference_type   = ptrdiff_t;
 	using value_type 		= T;
 	using const_reference 	= const T&;   
-    using self              = ht_iterator<T, cache, Hash, Comp, Pred>;
-	using size_type			= typename ht_iterator_base<T, cache, Hash, Comp, Pred>::size_type;
-	using pointer 			= typename ht_iterator_base<T, cache, Hash, Comp, Pred>::pointer;
-	using reference	 		= typename ht_iterator_base<T, cache, Hash, Comp, Pred>::reference;
-	using container         = typename ht_iterator_base<T, cache, Hash, Comp, Pred>::container;
-	using tree_node 		= typename ht_iterator_base<T, cache, Hash, Comp, Pred>::tree_node;
-	using list_node 		= typename ht_iterator_base<T, cache, Hash, Comp, Pred>::list_node;
-	using tree_node_ptr 	= typename ht_iterator_base<T, cache, Hash, Comp, Pred>::tree_node_ptr;
-	using list_node_ptr 	= typename ht_iterator_base<T, cache, Hash, Comp, Pred>::list_node_ptr;
-	using entry_type		= typename ht_iterator_base<T, cache, Hash, Comp, Pred>::entry_type;
+    using self              = ht_iterator<T, cache, Hash, Comp, Pred, Bucket>;
+	using size_type			= typename ht_iterator_base<T, cache, Hash, Comp, Pred, Bucket>::size_type;
+	using pointer 			= typename ht_iterator_base<T, cache, Hash, Comp, Pred, Bucket>::pointer;
+	using reference	 		= typename ht_iterator_base<T, cache, Hash, Comp, Pred, Bucket>::reference;
+	using container         = typename ht_iterator_base<T, cache, Hash, Comp, Pred, Bucket>::container;
+	using tree_node 		= typename ht_iterator_base<T, cache, Hash, Comp, Pred, Bucket>::tree_node;
+	using list_node 		= typename ht_iterator_base<T, cache, Hash, Comp, Pred, Bucket>::list_node;
+	using tree_node_ptr 	= typename ht_iterator_base<T, cache, Hash, Comp, Pred, Bucket>::tree_node_ptr;
+	using list_node_ptr 	= typename ht_iterator_base<T, cache, Hash, Comp, Pred, Bucket>::list_node_ptr;
+	using entry_type		= typename ht_iterator_base<T, cache, Hash, Comp, Pred, Bucket>::entry_type;
 
 	ht_iterator() noexcept = default;
 	ht_iterator(size_type bucketIndex,
 			entry_type _entry, container* _ht) noexcept :
-			ht_iterator_base<T, cache, Hash, Comp, Pred>(bucketIndex, _entry, _ht) {
+			ht_iterator_base<T, cache, Hash, Comp, Pred, Bucket>(bucketIndex, _entry, _ht) {
 	}
-	ht_iterator(const ht_const_iterator<T, cache, Hash, Comp, Pred>& other) noexcept :
-			ht_iterator_base<T, cache, Hash, Comp, Pred>(other.bIndex, other.entry, other.ht) {
+	ht_iterator(const ht_const_iterator<T, cache, Hash, Comp, Pred, Bucket>& other) noexcept :
+			ht_iterator_base<T, cache, Hash, Comp, Pred, Bucket>(other.bIndex, other.entry, other.ht) {
 	}
-	ht_iterator(const ht_iterator<T, cache, Hash, Comp, Pred>& other) noexcept :
-			ht_iterator_base<T, cache, Hash, Comp, Pred>(other.bIndex, other.entry, other.ht) {
+	ht_iterator(const ht_iterator<T, cache, Hash, Comp, Pred, Bucket>& other) noexcept :
+			ht_iterator_base<T, cache, Hash, Comp, Pred, Bucket>(other.bIndex, other.entry, other.ht) {
 	}
 
-	self& operator=(const ht_const_iterator<T, cache, Hash, Comp, Pred>& other) noexcept {
+	self& operator=(const ht_const_iterator<T, cache, Hash, Comp, Pred, Bucket>& other) noexcept {
 		if (this != &other) {
 			this->bIndex = other.bIndex;
 			this->entry = other.entry;
@@ -400,7 +763,7 @@ struct ht_iterator : public ht_iterator_base<T, cache, Hash, Comp, Pred> {
 		return *this;
 	}
 
-	self& operator=(const ht_iterator<T, cache, Hash, Comp, Pred>& other) noexcept {
+	self& operator=(const ht_iterator<T, cache, Hash, Comp, Pred, Bucket>& other) noexcept {
 		if (this != &other) {
 			this->bIndex = other.bIndex;
 			this->entry = other.entry;
@@ -423,38 +786,38 @@ struct ht_iterator : public ht_iterator_base<T, cache, Hash, Comp, Pred> {
 };
 
 template<typename T, bool cache = false, typename Hash = hash_value<T>, 
-	typename Comp = std::less<T>, typename Pred = std::equal_to<T>>
-struct ht_const_iterator : public ht_iterator_base<T, cache, Hash, Comp, Pred> {
+	typename Comp = std::less<T>, typename Pred = std::equal_to<T>, typename Bucket = ht_node_bucket>
+struct ht_const_iterator : public ht_iterator_base<T, cache, Hash, Comp, Pred, Bucket> {
     using iterator_category = std::forward_iterator_tag;
 	using difference_type   = ptrdiff_t;
 	using value_type 		= T;
 	using const_reference 	= const T&;   
-    using self              = ht_const_iterator<T, cache, Hash, Comp, Pred>;
-	using size_type			= typename ht_iterator_base<T, cache, Hash, Comp, Pred>::size_type;
-	using pointer 			= typename ht_iterator_base<T, cache, Hash, Comp, Pred>::pointer;
-	using reference	 		= typename ht_iterator_base<T, cache, Hash, Comp, Pred>::reference;
-	using container         = typename ht_iterator_base<T, cache, Hash, Comp, Pred>::container;
-	using tree_node 		= typename ht_iterator_base<T, cache, Hash, Comp, Pred>::tree_node;
-	using list_node 		= typename ht_iterator_base<T, cache, Hash, Comp, Pred>::list_node;
-	using tree_node_ptr 	= typename ht_iterator_base<T, cache, Hash, Comp, Pred>::tree_node_ptr;
-	using list_node_ptr 	= typename ht_iterator_base<T, cache, Hash, Comp, Pred>::list_node_ptr;
-	using entry_type		= typename ht_iterator_base<T, cache, Hash, Comp, Pred>::entry_type;
+    using self              = ht_const_iterator<T, cache, Hash, Comp, Pred, Bucket>;
+	using size_type			= typename ht_iterator_base<T, cache, Hash, Comp, Pred, Bucket>::size_type;
+	using pointer 			= typename ht_iterator_base<T, cache, Hash, Comp, Pred, Bucket>::pointer;
+	using reference	 		= typename ht_iterator_base<T, cache, Hash, Comp, Pred, Bucket>::reference;
+	using container         = typename ht_iterator_base<T, cache, Hash, Comp, Pred, Bucket>::container;
+	using tree_node 		= typename ht_iterator_base<T, cache, Hash, Comp, Pred, Bucket>::tree_node;
+	using list_node 		= typename ht_iterator_base<T, cache, Hash, Comp, Pred, Bucket>::list_node;
+	using tree_node_ptr 	= typename ht_iterator_base<T, cache, Hash, Comp, Pred, Bucket>::tree_node_ptr;
+	using list_node_ptr 	= typename ht_iterator_base<T, cache, Hash, Comp, Pred, Bucket>::list_node_ptr;
+	using entry_type		= typename ht_iterator_base<T, cache, Hash, Comp, Pred, Bucket>::entry_type;
 
 	ht_const_iterator() noexcept = default;
 	ht_const_iterator(size_type bucketIndex,
 			entry_type _entry, container* _ht) noexcept :
-			ht_iterator_base<T, cache, Hash, Comp, Pred>(bucketIndex, _entry, _ht) {
+			ht_iterator_base<T, cache, Hash, Comp, Pred, Bucket>(bucketIndex, _entry, _ht) {
 	}
 
-	ht_const_iterator(const ht_iterator<T, cache, Hash, Comp, Pred>& other) noexcept :
-			ht_iterator_base<T, cache, Hash, Comp, Pred>(other.bIndex, other.entry, other.ht) {
+	ht_const_iterator(const ht_iterator<T, cache, Hash, Comp, Pred, Bucket>& other) noexcept :
+			ht_iterator_base<T, cache, Hash, Comp, Pred, Bucket>(other.bIndex, other.entry, other.ht) {
 	}
 
-	ht_const_iterator(const ht_const_iterator<T, cache, Hash, Comp, Pred>& other) noexcept :
-			ht_iterator_base<T, cache, Hash, Comp, Pred>(other.bIndex, other.entry, other.ht) {
+	ht_const_iterator(const ht_const_iterator<T, cache, Hash, Comp, Pred, Bucket>& other) noexcept :
+			ht_iterator_base<T, cache, Hash, Comp, Pred, Bucket>(other.bIndex, other.entry, other.ht) {
 	}
 
-	self& operator=(const ht_const_iterator<T, cache, Hash, Comp, Pred>& other) noexcept {
+	self& operator=(const ht_const_iterator<T, cache, Hash, Comp, Pred, Bucket>& other) noexcept {
 		if (this != &other) {
 			this->bIndex = other.bIndex;
 			this->entry = other.entry;
@@ -464,7 +827,7 @@ struct ht_const_iterator : public ht_iterator_base<T, cache, Hash, Comp, Pred> {
 		return *this;
 	}
 
-	self& operator=(const ht_iterator<T, cache, Hash, Comp, Pred>& other) noexcept {
+	self& operator=(const ht_iterator<T, cache, Hash, Comp, Pred, Bucket>& other) noexcept {
 		if (this != &other) {
 			this->bIndex = other.bIndex;
 			this->entry = other.entry;
@@ -487,11 +850,11 @@ struct ht_const_iterator : public ht_iterator_base<T, cache, Hash, Comp, Pred> {
 };
 
 template<typename T, bool cache = false, typename Hash = hash_value<T>,
-	typename Comp = std::less<T>, typename Pred = std::equal_to<T>>
+	typename Comp = std::less<T>, typename Pred = std::equal_to<T>, typename Bucket = ht_node_bucket>
 class hash_table {
-friend struct ht_iterator_base<T, cache, Hash, Comp, Pred>;
-friend struct ht_iterator<T, cache, Hash, Comp, Pred>;
-friend struct ht_const_iterator<T, cache, Hash, Comp, Pred>;
+friend struct ht_iterator_base<T, cache, Hash, Comp, Pred, Bucket>;
+friend struct ht_iterator<T, cache, Hash, Comp, Pred, Bucket>;
+friend struct ht_const_iterator<T, cache, Hash, Comp, Pred, Bucket>;
 public:
 	using key_type 					= T;
 	using mapped_type 				= T;
@@ -502,13 +865,15 @@ public:
 	using const_reference           = const T&;
 	using size_type                 = size_t;
 	using difference_type           = ptrdiff_t;
-	using const_iterator            = ht_const_iterator<value_type>;
-	using iterator                  = ht_iterator<value_type>;
+	using const_iterator            = ht_const_iterator<value_type, cache, Hash, Comp, Pred, Bucket>;
+	using iterator                  = ht_iterator<value_type, cache, Hash, Comp, Pred, Bucket>;
 	using reverse_iterator          = const std::reverse_iterator<iterator>;
 	using const_reverse_iterator    = const std::reverse_iterator<const_iterator>;
 	using hasher					= Hash;
 	using key_compare				= Comp;
   	using key_equal 				= Pred;
+	class node_type;
+	struct insert_return_type;
 
 public:
 	iterator begin() noexcept { 
@@ -518,13 +883,13 @@ public:
 	const_iterator begin() const noexcept { 
 		std::pair<size_type, entry_type> myPair = beg();
 		return const_iterator(myPair.first, myPair.second, 
-			const_cast<hash_table<T, cache, Hash, Comp, Pred>*>(this)); 
+			const_cast<hash_table<T, cache, Hash, Comp, Pred, Bucket>*>(this)); 
 	}
 
-	iterator end() noexcept { return iterator(bucket_count(), entry_type(), this); }
+	iterator end() noexcept { return iterator(total_bucket_count(), entry_type(), this); }
 	const_iterator end() const noexcept { 
-		return const_iterator(bucket_count(), entry_type(), 
-			const_cast<hash_table<T, cache, Hash, Comp, Pred>*>(this)); 
+		return const_iterator(total_bucket_count(), entry_type(), 
+			const_cast<hash_table<T, cache, Hash, Comp, Pred, Bucket>*>(this)); 
 	}
 	const_iterator cbegin() const noexcept { return begin(); }
 	const_iterator cend()   const noexcept { return end(); }
@@ -599,14 +964,23 @@ public:
 	}
 	iterator insert_unique_use_hint(const_iterator hint, value_type&& value) { 
 		static_cast<void>(hint);
-		return insert_unique(std::move(value)); 
+		return insert_unique(std::move(value)).first; 
 	}
 
+	/**
+	 * @brief 随机访问迭代器并且元素足够多时并行插入: 多个线程各自构造节点、
+	 * 		  算hash，按桶下标的高位分区，再由每个线程把一段连续的桶挂好(要树化
+	 * 		  的桶也由它树化)。按迭代器的顺序，insert_unique保留相等元素里的第一个
+	 * @param threadCount 最多用几个线程，每个线程至少分到PARALLEL_GRAIN个元素，
+	 * 		  默认只用当前线程，调用者显式传入才会开线程
+	 * @attention 并行插入时先按size() + (last - first)扩容；
+	 * 			  Hash、Comp、Pred会被多个线程同时调用
+	 */
 	template <std::input_iterator InputIter>
-	void insert_multi(InputIter first, InputIter last);
+	void insert_multi(InputIter first, InputIter last, size_type threadCount = 1);
 	
 	template <std::input_iterator InputIter>
-	void insert_unique(InputIter first, InputIter last);
+	void insert_unique(InputIter first, InputIter last, size_type threadCount = 1);
 
 	// erase
 	void erase(const_iterator position);
@@ -617,6 +991,30 @@ public:
 	void clear();
 	void swap(hash_table& rhs) noexcept;
 
+	// 节点
+	/**
+	 * @brief 把position处的节点从表里摘下来交给返回的node_type，元素不移动、不拷贝，
+	 * 		  之后插入到同类型的任意一个表里都不用重新申请节点
+	 */
+	node_type extract(const_iterator position);
+	node_type extract(const key_type& key);
+	/**
+	 * @brief 插入extract得到的节点。cache为true并且节点来自种子相同的表时
+	 * 		  直接用节点里缓存的hash值，不重新计算
+	 * @return 已经有相等的元素时inserted为false，节点原样还在返回值的node里
+	 */
+	insert_return_type insert_unique(node_type&& node);
+	iterator insert_multi(node_type&& node);
+	/**
+	 * @brief 把source的节点逐个摘下来挂到自己的桶上，不申请节点、不移动元素。
+	 * 		  merge_unique遇到相等的元素时把节点留在source里。
+	 * 		  空表会先换成source的种子，cache为true时整个过程不计算hash
+	 */
+	void merge_unique(hash_table& source);
+	void merge_unique(hash_table&& source) { merge_unique(source); }
+	void merge_multi(hash_table& source);
+	void merge_multi(hash_table&& source) { merge_multi(source); }
+
 	// 查找相关操作
 	size_type count_multi(const key_type& key) const;
 	size_type count_unique(const key_type& key) const {
@@ -625,6 +1023,65 @@ public:
 
 	iterator find(const key_type& key);
 	const_iterator find(const key_type& key) const;
+	/**
+	 * @brief 异构查找: Hash和Pred都声明了is_transparent时，可以直接用
+	 * 		  其他类型的key查找，不用先构造一个key_type。Comp(树桶里用)
+	 * 		  也要能比较T和Key。const char*这种能转成key_type的类型，Hash能
+	 * 		  直接接收时也走这里，不构造临时的key_type
+	 */
+	template<typename Key> requires TRANSPARENT && (!std::is_same_v<Key, key_type>)
+		&& std::is_invocable_v<const Hash&, const Key&>
+	iterator find(const Key& key) {
+		size_t hashVal = hash_of(key);
+		size_type index = bucket_index(hashVal);
+		return iterator(index, find_in_bucket(index, hashVal, key), this);
+	}
+	template<typename Key> requires TRANSPARENT && (!std::is_same_v<Key, key_type>)
+		&& std::is_invocable_v<const Hash&, const Key&>
+	const_iterator find(const Key& key) const {
+		size_t hashVal = hash_of(key);
+		size_type index = bucket_index(hashVal);
+		return const_iterator(index, find_in_bucket(index, hashVal, key), 
+			const_cast<hash_table<T, cache, Hash, Comp, Pred, Bucket>*>(this));
+	}
+	template<typename Key> requires TRANSPARENT && (!std::is_same_v<Key, key_type>)
+		&& std::is_invocable_v<const Hash&, const Key&>
+	size_type count_unique(const Key& key) const {
+		return find(key) == end() ? 0 : 1;
+	}
+	template<typename Key> requires TRANSPARENT && (!std::is_same_v<Key, key_type>)
+		&& std::is_invocable_v<const Hash&, const Key&>
+	size_type erase_unique(const Key& key) {
+		if (m_old_buckets) {
+			migrate_step();
+		}
+		iterator iter = find(key);
+		if (iter != end()) {
+			size_type index = iter.bIndex;
+			erase(iter);
+			untreefy_if(index);
+			shrink_if();
+			return 1;
+		}
+		return 0;
+	}
+	/**
+	 * @brief 先用key查找，找到了直接返回，找不到才用args构造元素插入，
+	 * 		  构造出来的元素和key必须相等
+	 */
+	template<typename Key, typename... Args>
+	std::pair<iterator, bool> try_emplace_unique(const Key& key, Args&&... args);
+	/**
+	 * @brief 批量查找，out[i] = find(keys[i])
+	 * 		  每BATCH_SIZE个key一组，先把一组的hash都算出来并预取桶，
+	 * 		  再预取桶里的第一个节点，最后才比较，多个key的cache miss可以重叠
+	 */
+	void find_batch(const key_type* keys, size_type n, iterator* out);
+	void find_batch(const key_type* keys, size_type n, const_iterator* out) const;
+	/**
+	 * @brief 批量判断是否存在，out[i] = (find(keys[i]) != end())
+	 */
+	void contains_batch(const key_type* keys, size_type n, bool* out) const;
 	std::pair<iterator, iterator> equal_range_multi(const key_type& key);
 	std::pair<const_iterator, const_iterator> equal_range_multi(const key_type& key) const;
 	std::pair<iterator, iterator> equal_range_unique(const key_type& key);
@@ -638,56 +1095,200 @@ public:
 		size_type nbuckets = bucket_count();
 		return  nbuckets ? static_cast<float>(m_size) / nbuckets : 0.0f; 
 	}
-	void rehash(size_type n);
+	/**
+	 * @brief 元素足够多时用threadCount个线程: 先各自拆一段旧桶并按新桶下标分区，
+	 * 		  再各自挂一段连续的新桶，节点都不重新申请
+	 * @attention 插入时扩容、删除时缩容、reserve、换种子都只用当前线程，
+	 * 			  只有显式传入threadCount时Hash、Comp才会被多个线程同时调用
+	 */
+	void rehash(size_type n, size_type threadCount = 1);
 	void reserve(size_type n) {
 		if (n > bucket_count()) {
 			rehash(ceil_power_of_2(n));
 		}
 	}
 	hasher hash_function() const { return m_hash; }
+	size_t hash_seed() const noexcept { return m_seed; }
+	/**
+	 * @brief 换成指定的种子并重新哈希，两个表种子相同时互相merge不用重新计算hash
+	 */
+	void hash_seed(size_t seed);
 	key_equal key_eq() const { return m_equal; }
 	float max_load_factor() const noexcept { return m_mlf; }
 	void max_load_factor(float mlf) noexcept { m_mlf = mlf; }
-#ifdef HASH_TABLE_DEBUG
-	std::string show() {
-		std::string str;
-		for (size_t i = 0; i < m_bucket_count; ++i) {
-			if (!m_buckets[i].isnull()) {
-				str += "bucket" + std::to_string(i) +  " is";
-				if (is_list(i)) {
-					str += " list:";
-					list_node_ptr head = m_buckets[i].as_list_node_ptr();
-					while (head) {
-						str += " ";
-						str += std::to_string(head->value);
-						head = static_cast<list_node_ptr>(head->next);
-					}
-				} else { 
-					str += " tree:";
-					tree_node_ptr root = m_buckets[i].as_tree_node_ptr();
-					inorder(root, [&str, this](tree_node_base* node){
-						str += " ";
-						str += std::to_string(static_cast<tree_node_ptr>(node)->value);
-					});
-				}
-				str += "\n";
-			}
+	/**
+	 * @brief 按key删除、clear以后负载因子低于min_load_factor()时自动缩容，缩到负载因子
+	 * 		  不超过max_load_factor() / 2，元素再翻一倍才会扩容，不会来回扩容、缩容。
+	 * 		  实际生效的值不超过max_load_factor() / 4，默认为0，不缩容
+	 * @attention 和扩容一样，缩容时迭代器会失效；按迭代器删除不会缩容
+	 */
+	float min_load_factor() const noexcept { return m_min_lf; }
+	void min_load_factor(float mlf) noexcept { m_min_lf = mlf; }
+	/**
+	 * @brief 把桶数组缩到刚好放得下现有的元素，节点原样挂到新桶上，
+	 * 		  每个桶按新的长度决定是链表还是树。默认只用当前线程，显式传入线程数才并行
+	 */
+	void shrink_to_fit(size_type threadCount = 1);
+	/**
+	 * @brief 渐进式rehash: 扩容时只申请新的桶数组，新旧数组同时存在，
+	 * 		  之后每次插入、按key删除时搬MIGRATE_STEP个旧桶，把一次扩容的
+	 * 		  停顿分摊到后面的操作上。查找不搬桶，直接看元素在哪个数组里。
+	 * @attention 开启后插入和按key删除都可能搬动节点，迭代器会失效；
+	 * 			  按迭代器删除不会搬桶
+	 */
+	void incremental_rehash(bool on) {
+		m_incremental = on;
+		if (!on) {
+			finish_migration();
 		}
-		return str;
 	}
-#endif //HASH_TABLE_DEBUG
+	bool incremental_rehash() const noexcept { return m_incremental; }
+	bool rehashing() const noexcept { return nullptr != m_old_buckets; }
+	/**
+	 * @brief 写出一份不含指针的快照(格式见ht_snapshot.h)，hash_table_view::open
+	 * 		  直接mmap就能查找，不用重新插入。正在渐进式rehash时按新桶数组写。
+	 * 		  先写同一目录下的临时文件，fsync以后再rename成path，一个桶一个桶地编码写出
+	 * @param encoder 怎么把元素写进文件，默认原样写，要求T可以平凡复制
+	 * @throw std::length_error 元素个数超过uint32_t
+	 * @throw std::runtime_error 写文件失败，path还是原来的文件
+	 */
+	template<typename Encoder = ht_trivial_encoder<T>>
+	void save(const char* path, const Encoder& encoder = Encoder()) const;
+	/**
+	 * @brief 现算桶的分布和占用的内存，要遍历所有非空桶；定义了HASH_TABLE_STATS时
+	 * 		  再带上查找、树化、rehash的计数器，见ht_stats.h
+	 */
+	ht_stats stats() const;
 private:
 	constexpr static size_type TREEFY_THRESHOLD = 8;
 	constexpr static size_type UNTREEFY_THRESHOLD = 6;
+	constexpr static size_type MIN_BUCKET_COUNT = 16;	///< 缩容时至少留几个桶
 	constexpr static float DEFAULT_MLF = 1.0f; ///< default max load factor
+	/**
+	 * 正常情况下(负载因子为1)一个桶的长度达到TREEFY_THRESHOLD的概率
+	 * 大约是十万分之一，所以树化和往树里插入都很少见。如果自上次换种子以来
+	 * 这两者的次数超过了阈值 + 桶个数 / 1024，就认为遭到了哈希洪水攻击，
+	 * 换一个种子重新哈希。每换一次阈值翻倍，防止大量相等元素(insert_multi)
+	 * 导致反复换种子
+	 */
+	constexpr static size_type RESEED_THRESHOLD = 16;
+	constexpr static size_type MIGRATE_STEP = 8;	///< 渐进式rehash每次操作搬几个旧桶
+	constexpr static size_type BATCH_SIZE = 16;		///< 批量查找时一次预取几个key
+	constexpr static size_type PARALLEL_GRAIN = 1 << 14;	///< 并行插入、rehash时每个线程至少处理几个元素
+	constexpr static size_type BULK_PREFETCH = 8;		///< 并行挂节点时提前预取第几个节点和桶
+	///< hasher能不能接收种子
+	constexpr static bool SEEDED_HASH = std::is_invocable_v<const Hash&, const T&, size_t>;
+	///< 能不能异构查找
+	constexpr static bool TRANSPARENT = requires {
+		typename Hash::is_transparent;
+		typename Pred::is_transparent;
+	};
 
 private:
-	using tree_node 	= typename ht_iterator_base<T, cache, Hash, Comp, Pred>::tree_node;
-	using list_node 	= typename ht_iterator_base<T, cache, Hash, Comp, Pred>::list_node;
-	using tree_node_ptr = typename ht_iterator_base<T, cache, Hash, Comp, Pred>::tree_node_ptr;
-	using list_node_ptr = typename ht_iterator_base<T, cache, Hash, Comp, Pred>::list_node_ptr;
-	using entry_type	= typename ht_iterator_base<T, cache, Hash, Comp, Pred>::entry_type;
+	using tree_node 	= typename ht_iterator_base<T, cache, Hash, Comp, Pred, Bucket>::tree_node;
+	using list_node 	= typename ht_iterator_base<T, cache, Hash, Comp, Pred, Bucket>::list_node;
+	using tree_node_ptr = typename ht_iterator_base<T, cache, Hash, Comp, Pred, Bucket>::tree_node_ptr;
+	using list_node_ptr = typename ht_iterator_base<T, cache, Hash, Comp, Pred, Bucket>::list_node_ptr;
+	using entry_type	= typename ht_iterator_base<T, cache, Hash, Comp, Pred, Bucket>::entry_type;
 	using entry_ptr  	= entry_type*;
+	constexpr static bool INLINE_BUCKET = std::is_same_v<Bucket, ht_inline_bucket>;
+	constexpr static bool SORTED_BUCKET = std::is_same_v<Bucket, ht_sorted_bucket>;
+	using sorted_array	= ht_sorted_array<T, cache>;
+	using sorted_ptr	= sorted_array*;
+	struct inline_bucket {
+		entry_type entry;
+		list_node slot;		///< 桶自带的节点，entry.flag & inline_mask表示在用
+	};
+	using bucket_type	= std::conditional_t<INLINE_BUCKET, inline_bucket, entry_type>;
+	using bucket_ptr	= bucket_type*;
+#ifdef BIT64
+	static_assert(!INLINE_BUCKET || (std::is_trivially_move_constructible_v<T> && 
+		std::is_trivially_destructible_v<T> && alignof(T) <= alignof(max_align_t)),
+		"ht_inline_bucket needs a small trivially movable T");
+#else
+	static_assert(!INLINE_BUCKET, "ht_inline_bucket needs the spare high bits of 64 bit pointers");
+#endif //BIT64
+	/**
+	 * @brief 节点的内存属于申请它的池，节点换了表以后，原来的表析构、clear时
+	 * 		  不能直接释放slab。交换过节点的表和取出来的节点共用一个组，进组时把自己的池
+	 * 		  交给组，之后都从组的池里申请节点，clear、删除时节点逐个还给组的池，
+	 * 		  组里的表互相复用空闲节点，组没人用了才整块释放。两个组相遇时把一个组的池
+	 * 		  并到另一个，并用parent指向它(并查集)
+	 * @attention 同一个组里的表共用池，不能在不同线程里同时修改
+	 */
+	struct pool_group {
+		node_pool<list_node> list_pool;
+		node_pool<tree_node> tree_pool;
+		std::shared_ptr<pool_group> parent;
+	};
+	using pool_group_ptr = std::shared_ptr<pool_group>;
+	static const pool_group_ptr& group_root(const pool_group_ptr& group) noexcept {
+		const pool_group_ptr* root = &group;
+		while ((*root)->parent) {
+			root = &(*root)->parent;
+		}
+		return *root;
+	}
+
+public:
+	/**
+	 * @brief extract取出的节点，独占一个链表节点或者树节点。
+	 * 		  没有再插入到表里就在析构时销毁元素，内存还给节点所在的组
+	 */
+	class node_type {
+		friend class hash_table;
+	public:
+		node_type() noexcept = default;
+		node_type(node_type&& other) noexcept {
+			swap(other);
+		}
+		node_type& operator=(node_type&& other) noexcept {
+			if (this != &other) {
+				reset();
+				swap(other);
+			}
+			return *this;
+		}
+		~node_type() { reset(); }
+
+		bool empty() const noexcept { return nullptr == m_list && nullptr == m_tree; }
+		explicit operator bool() const noexcept { return !empty(); }
+		value_type& value() const noexcept { return m_list ? m_list->value : m_tree->value; }
+		void swap(node_type& other) noexcept {
+			std::swap(m_list, other.m_list);
+			std::swap(m_tree, other.m_tree);
+			std::swap(m_seed, other.m_seed);
+			m_group.swap(other.m_group);
+		}
+
+	private:
+		void reset() noexcept {
+			if (!empty()) {
+				pool_group* root = group_root(m_group).get();
+				if (m_list) {
+					destroy(&m_list->value);
+					root->list_pool.deallocate(m_list);
+				} else {
+					destroy(&m_tree->value);
+					root->tree_pool.deallocate(m_tree);
+				}
+				m_list = nullptr;
+				m_tree = nullptr;
+			}
+			m_group.reset();
+		}
+
+	private:
+		list_node_ptr m_list = nullptr;
+		tree_node_ptr m_tree = nullptr;
+		size_t m_seed = 0;		///< 取出时所在表的种子，缓存的hash值是用它算的
+		pool_group_ptr m_group;
+	};
+	struct insert_return_type {
+		iterator position;
+		bool inserted;
+		node_type node;
+	};
 
 private:
 	std::pair<size_type, entry_type> beg() const;
@@ -695,43 +1296,284 @@ private:
 private:
 	bool is_tree(size_type index) const {
 #ifdef BIT64	
-		return m_buckets[index].flag & mask;
+		return bucket_at(index).flag & mask;
 #else
-		return m_bitset[index];
+		return index < m_bucket_count ? m_bitmap.is_tree(index) : m_old_bitmap.is_tree(index - m_bucket_count);
 #endif //BIT64
 	}
 	bool is_list(size_type index) const {
 		return !is_tree(index);
 	}
+	/**
+	 * @brief 桶里的元素在链表节点上，迭代器里存的是链表节点。有序数组桶也是
+	 */
+	bool holds_list_nodes(size_type index) const {
+		return SORTED_BUCKET || is_list(index);
+	}
+	sorted_ptr sorted_at(size_type index) const {
+		return reinterpret_cast<sorted_ptr>(bucket_at(index).as_tree_node_ptr());
+	}
+	void set_sorted(size_type index, sorted_ptr array) {
+		bucket_at(index) = reinterpret_cast<tree_node_ptr>(array);
+	}
 	tree_node_ptr listNode2TreeNode(list_node_ptr node);
 	list_node_ptr treeNode2ListNode(tree_node_ptr node);
 	size_type get_bucket_index(size_t hashVal) const { return hashVal & (m_bucket_count - 1); }
+	/**
+	 * @brief 渐进式rehash时，下标[0, m_bucket_count)是新桶，
+	 * 		  [m_bucket_count, m_bucket_count + m_old_bucket_count)是旧桶，
+	 * 		  迭代器和所有按下标操作桶的函数都用这个统一的下标
+	 */
+	entry_type& bucket_at(size_type index) const {
+		if (index < m_bucket_count) {
+			return entry_of(m_buckets[index]);
+		}
+		return entry_of(m_old_buckets[index - m_bucket_count]);
+	}
+	static entry_type& entry_of(bucket_type& bucket) noexcept {
+		if constexpr(INLINE_BUCKET) {
+			return bucket.entry;
+		} else {
+			return bucket;
+		}
+	}
+	list_node_ptr inline_slot(size_type index) const {
+		if (index < m_bucket_count) {
+			return &m_buckets[index].slot;
+		}
+		return &m_old_buckets[index - m_bucket_count].slot;
+	}
+	/**
+	 * @return node是哪个桶自带的节点，不是桶自带的返回total_bucket_count()
+	 */
+	size_type inline_index(list_node_ptr node) const {
+		uintptr_t addr = reinterpret_cast<uintptr_t>(node);
+		uintptr_t offset = addr - reinterpret_cast<uintptr_t>(m_buckets);
+		if (offset < m_bucket_count * sizeof(bucket_type)) {
+			return offset / sizeof(bucket_type);
+		}
+		offset = addr - reinterpret_cast<uintptr_t>(m_old_buckets);
+		if (offset < m_old_bucket_count * sizeof(bucket_type)) {
+			return m_bucket_count + offset / sizeof(bucket_type);
+		}
+		return total_bucket_count();
+	}
+	/**
+	 * @brief 第index个桶自带的节点空着时，把node的元素移进去并释放node
+	 * @return 真正要挂到桶上的节点
+	 */
+	list_node_ptr to_inline(size_type index, list_node_ptr node) {
+		if constexpr(INLINE_BUCKET) {
+			entry_type& entry = bucket_at(index);
+			if (0 == (entry.flag & inline_mask)) {
+				list_node_ptr slot = inline_slot(index);
+				construct(&slot->value, std::move(node->value));
+				if constexpr(cache) {
+					slot->hash_val = node->hash_val;
+				}
+				slot->next = nullptr;
+				destroy_node(node);
+				entry.flag |= inline_mask;
+				return slot;
+			}
+		}
+		return node;
+	}
+	/**
+	 * @brief 桶自带的节点不能挂到别的桶(或者别的桶数组)上，搬桶前换成池里的节点
+	 */
+	list_node_ptr evict_inline(list_node_ptr node) {
+		if constexpr(INLINE_BUCKET) {
+			if (inline_index(node) != total_bucket_count()) {
+				return move_inline(node, list_pool().allocate());
+			}
+		}
+		return node;
+	}
+	tree_node_ptr evict_inline(tree_node_ptr node) noexcept { return node; }
+	/**
+	 * @brief 把桶自带的节点node的元素移到newNode里，清掉node在用的标志
+	 */
+	list_node_ptr move_inline(list_node_ptr node, list_node_ptr newNode) noexcept {
+		construct(&newNode->value, std::move(node->value));
+		if constexpr(cache) {
+			newNode->hash_val = node->hash_val;
+		}
+		newNode->next = nullptr;
+		destroy_node(node);
+		return newNode;
+	}
+	size_type total_bucket_count() const noexcept { return m_bucket_count + m_old_bucket_count; }
+	/**
+	 * @brief hash值对应的元素现在在哪个桶: 旧桶还没搬走就在旧桶里，
+	 * 		  否则在新桶里。同一个旧桶里的元素要么都没搬，要么都搬完了
+	 */
+	size_type bucket_index(size_t hashVal) const {
+		if (m_old_buckets) {
+			size_type oldIndex = hashVal & (m_old_bucket_count - 1);
+			if (!entry_of(m_old_buckets[oldIndex]).isnull()) {
+				return m_bucket_count + oldIndex;
+			}
+		}
+		return get_bucket_index(hashVal);
+	}
 	size_type next_bucket(size_type index);
 	void mark(size_type index) {
 #ifdef BIT64
-		m_buckets[index].flag |= mask;
+		bucket_at(index).flag |= mask;
 #else 
-		m_bitset[index] = 1;
+		if (index < m_bucket_count) {
+			m_bitmap.mark(index);
+		} else {
+			m_old_bitmap.mark(index - m_bucket_count);
+		}
 #endif //BIT64
 	}
 	void unmark(size_type index) {
 #ifdef BIT64
-		m_buckets[index].flag &= (~mask);
+		bucket_at(index).flag &= (~mask);
 #else
-		m_bitset[index] = 0;
+		if (index < m_bucket_count) {
+			m_bitmap.unmark(index);
+		} else {
+			m_old_bitmap.unmark(index - m_bucket_count);
+		}
 #endif //BIT64
 	}
-	void treefy(size_type index);
+	/**
+	 * @brief 桶从空变成非空、从非空变成空的地方都要同步占用位图
+	 */
+	void occupy(size_type index) {
+		if (index < m_bucket_count) {
+			m_bitmap.occupy(index);
+		} else {
+			m_old_bitmap.occupy(index - m_bucket_count);
+		}
+	}
+	void vacate(size_type index) {
+		if (index < m_bucket_count) {
+			m_bitmap.vacate(index);
+		} else {
+			m_old_bitmap.vacate(index - m_bucket_count);
+		}
+	}
+	/**
+	 * @return 统一下标下[index, total_bucket_count())里第一个非空桶
+	 */
+	size_type next_occupied(size_type index) const {
+		if (index < m_bucket_count) {
+			size_type nextIndex = m_bitmap.next(index);
+			if (nextIndex != m_bucket_count) {
+				return nextIndex;
+			}
+			index = m_bucket_count;
+		}
+		return m_bucket_count + m_old_bitmap.next(index - m_bucket_count);
+	}
+	/**
+	 * @brief 链表节点会换成新的树节点；ht_sorted_bucket建有序数组，节点不换
+	 * @return node换成的树节点，node为空或者ht_sorted_bucket时返回空
+	 */
+	tree_node_ptr treefy(size_type index, list_node_ptr node = nullptr);
+	/**
+	 * @brief 把第index个桶的链表节点用convert换成树节点，建成一棵树挂回桶上
+	 * @return node换成的树节点
+	 */
+	template<typename Convert>
+	tree_node_ptr build_tree(size_type index, list_node_ptr node, const Convert& convert);
+	/**
+	 * @brief 把第index个桶的链表按m_comp排好序，配上有序数组挂回桶上
+	 */
+	void build_sorted(size_type index);
+	/**
+	 * @brief 把node放进第index个有序数组桶，不改m_size
+	 * @return unique时有相等的返回{相等的节点, false}，node不动
+	 */
+	std::pair<list_node_ptr, bool> sorted_link(size_type index, list_node_ptr node, bool unique);
 	void untreefy(size_type index);
+	/**
+	 * @brief 树桶删到UNTREEFY_THRESHOLD个节点以下时退化回链表
+	 */
+	void untreefy_if(size_type index);
+	template<typename Key>
+	size_t hash_of(const Key& key) const {
+		if constexpr(SEEDED_HASH) {
+			return m_hash(key, m_seed);
+		} else {
+			return m_hash(key);
+		}
+	}
+	bool reseed_needed() const {
+		if constexpr(SEEDED_HASH) {
+			return m_collision_count > m_reseed_threshold + (m_bucket_count >> 10);
+		} else {
+			return false;
+		}
+	}
+	void reseed();
+	template<typename Node>
+	size_t hash_of_node(Node* node) const {
+		if constexpr(cache) {
+			return node->hash_val;
+		} else {
+			return hash_of(node->value);
+		}
+	}
+	/**
+	 * @brief cache为true时先比较节点里存的hash值，不同就一定不相等，
+	 * 		  链表上不相等的节点不用调用m_equal，也不用读元素的内存(比如长字符串)
+	 */
+	template<typename Node>
+	bool hash_matches(Node* node, size_t hashVal) const {
+		if constexpr(cache) {
+			return node->hash_val == hashVal;
+		} else {
+			static_cast<void>(node);
+			static_cast<void>(hashVal);
+			return true;
+		}
+	}
+	template<typename Node, typename Key>
+	bool node_equal(Node* node, size_t hashVal, const Key& key) const {
+		return hash_matches(node, hashVal) && m_equal(node->value, key);
+	}
+	/**
+	 * @brief 两个节点的元素是否相等，cache为false时新节点没有hash值，直接比较元素
+	 */
+	template<typename Node>
+	bool node_equal(Node* lhs, Node* rhs) const {
+		if constexpr(cache) {
+			return node_equal(lhs, rhs->hash_val, rhs->value);
+		} else {
+			return m_equal(lhs->value, rhs->value);
+		}
+	}
+	template<typename Func>
+	void unlink_bucket(size_type index, const Func& f);
+	template<typename Func>
+	void visit_bucket(size_type index, const Func& f) const;
+	void start_migration(size_type bucketCount);
+	void migrate_bucket(size_type oldIndex);
+	void migrate_step();
+	void finish_migration();
+	template<typename Key>
+	entry_type find_in_bucket(size_type index, size_t hashVal, const Key& key) const;
+	template<typename Func>
+	void lookup_batch(const key_type* keys, size_type n, const Func& f) const;
 	
 private:
-	entry_ptr allocate_entry(size_type n) {
-		return new entry_type[n]();
+	//calloc申请的大块内存是用mmap映射的零页，不用在扩容时一次性清零
+	bucket_ptr allocate_entry(size_type n) {
+		bucket_ptr entry = static_cast<bucket_ptr>(::calloc(n, sizeof(bucket_type)));
+		if (nullptr == entry) {
+			throw std::bad_alloc();
+		}
+		return entry;
 	}
-	void deallocate_entry(entry_ptr entry, size_type) {
-		delete[] entry;
+	void deallocate_entry(bucket_ptr entry, size_type) {
+		::free(entry);
 	}
-	void copy_entry_unchecked(entry_ptr buckets, size_type n);
+	void copy_entry_unchecked(const hash_table& other);
 	entry_type bucket_entry(size_type index) const;
 	std::pair<size_type, entry_type> next_bucket_entry(size_type index);
 	template<typename... Args>
@@ -765,44 +1607,216 @@ private:
 	std::pair<iterator, bool> insert_node_unique(size_type index, list_node_ptr node);
 	std::pair<iterator, bool> insert_node_unique(size_type index, tree_node_ptr node);
 	void rehash_if(size_type n) {
+		if (m_old_buckets) {
+			migrate_step();
+		}
 		if (static_cast<float>(m_size + n) > 
 			static_cast<float>(m_bucket_count) * max_load_factor()) {
-			rehash(m_size + n);
+			size_type count = static_cast<size_type>(
+				static_cast<float>(m_size + n) / max_load_factor()) + 1;
+			if (m_incremental) {
+				//上一次还没搬完(负载因子很小时才会出现)，先搬完
+				finish_migration();
+				start_migration(count);
+			} else {
+				rehash(count);
+			}
+		}
+		//不能在treefy里直接换种子，那时候插入还没完成
+		if (reseed_needed()) {
+			reseed();
+		}
+	}
+	void relink(size_type bucketCount, bool rehashValue, size_type threadCount = 1);
+	/**
+	 * @brief 放n个元素、负载因子不超过max_load_factor()要几个桶
+	 */
+	size_type fit_bucket_count(size_type n) const noexcept {
+		size_type count = ceil_power_of_2(static_cast<size_type>(static_cast<float>(n) / m_mlf) + 1);
+		return std::max(count, MIN_BUCKET_COUNT);
+	}
+	/**
+	 * @brief 按key删除、clear以后调用，负载因子低于min_load_factor()时缩容
+	 */
+	void shrink_if();
+	/**
+	 * @brief clear的主体，析构时也用，不缩容
+	 */
+	void destroy_all() noexcept;
+	/**
+	 * @brief 把node从第index个桶的链表上摘下来，桶空了就清掉占用标志
+	 */
+	void unlink_list_node(size_type index, list_node_ptr node);
+	/**
+	 * @brief 删除树节点以后换上新的根，树删空了就清掉树和占用标志
+	 */
+	void reset_tree_root(size_type index, tree_node_ptr root);
+
+private:
+	void ensure_pool_group() {
+		if (!m_pool_group) {
+			m_pool_group = std::make_shared<pool_group>();
+			m_pool_group->list_pool.swap(m_list_pool);
+			m_pool_group->tree_pool.swap(m_tree_pool);
+		}
+	}
+	/**
+	 * @brief 没进组时用自己的池，进组以后用组的池
+	 */
+	node_pool<list_node>& list_pool() noexcept {
+		return m_pool_group ? group_root(m_pool_group)->list_pool : m_list_pool;
+	}
+	node_pool<tree_node>& tree_pool() noexcept {
+		return m_pool_group ? group_root(m_pool_group)->tree_pool : m_tree_pool;
+	}
+	/**
+	 * @brief 要挂上group里的节点之前调用，之后两个组的节点都由同一个组管
+	 */
+	void join_pool_group(const pool_group_ptr& group);
+	/**
+	 * @brief 摘下position处的节点，桶自带的节点先换成池里的节点。调用前组要已经建好
+	 */
+	node_type take_node(const_iterator position);
+	/**
+	 * @brief 把node里的节点挂到第index个桶上，node变为空
+	 */
+	iterator link_node(node_type& node, size_type index, size_t hashVal);
+	/**
+	 * @brief 从种子为seed的表里来的节点在这个表里的hash值，能用缓存的就不重新计算
+	 */
+	template<typename Node>
+	size_t adopted_hash(Node* node, size_t seed) const {
+		if constexpr(cache) {
+			if (!SEEDED_HASH || seed == m_seed) {
+				return node->hash_val;
+			}
+		} else {
+			static_cast<void>(seed);
+		}
+		return hash_of(node->value);
+	}
+	size_t adopted_hash(const node_type& node) const {
+		return node.m_list ? adopted_hash(node.m_list, node.m_seed) : adopted_hash(node.m_tree, node.m_seed);
+	}
+	/**
+	 * @brief 空表接收节点时换成节点所在表的种子，缓存的hash值就都能直接用
+	 */
+	void adopt_seed(size_t seed) noexcept {
+		if constexpr(cache && SEEDED_HASH) {
+			if (0 == m_size) {
+				m_seed = seed;
+			}
+		} else {
+			static_cast<void>(seed);
+		}
+	}
+
+private:
+	/**
+	 * @brief 并行插入、rehash时按桶下标分区，记下桶下标，挂的时候不用再算hash，
+	 * 		  还能提前预取后面的节点和桶
+	 */
+	struct bulk_item {
+		size_type index;
+		list_node_ptr node;
+	};
+	/**
+	 * @brief 每个线程一份: 节点池不是线程安全的，线程里申请、释放节点都用自己的池，
+	 * 		  结束以后再合并到表里
+	 */
+	struct bulk_context {
+		node_pool<list_node> list_pool;
+		node_pool<tree_node> tree_pool;
+		std::vector<std::vector<bulk_item>> parts;	///< 每个分区一个数组，保持放进来的顺序
+		std::vector<size_t> hashes;		///< 并行rehash预先算好的hash值，顺序和unlink_bucket摘节点的顺序相同
+		size_type size = 0;					///< 挂上的节点个数
+		size_type collision_count = 0;
+		std::exception_ptr error;
+
+		void prepare(size_type partitions, size_type expected) {
+			parts.resize(partitions);
+			for (std::vector<bulk_item>& part : parts) {
+				part.reserve(expected + expected / 8 + 16);
+			}
 		}
+	};
+	static size_type bulk_threads(size_type n, size_type threadCount) noexcept {
+		return std::min(threadCount, n / PARALLEL_GRAIN);
 	}
+	/**
+	 * @brief 分区个数是2的幂，第k个分区是下标高位为k的一段连续的桶。
+	 * 		  每个分区至少占占用位图的一个字，不同线程不会写同一个字
+	 */
+	static size_type bulk_partitions(size_type bucketCount, size_type threads) noexcept {
+		size_type maxPartitions = std::max<size_type>(bucketCount / ht_bitmap::WORD_BITS, 1);
+		return std::min(std::bit_ceil(threads) * 4, maxPartitions);
+	}
+	/**
+	 * @brief f(0)在当前线程执行，f(1)...f(threadCount - 1)各开一个线程，
+	 * 		  开不了线程就在当前线程执行。f不能抛出异常
+	 */
+	template<typename Func>
+	static void run_parallel(size_type threadCount, const Func& f);
+	tree_node_ptr listNode2TreeNode(list_node_ptr node, bulk_context& ctx);
+	list_node_ptr treeNode2ListNode(tree_node_ptr node, bulk_context& ctx);
+	/**
+	 * @brief 和untreefy一样，节点从ctx的池里换。先把链表节点都申请好，申请失败时桶不变
+	 */
+	void untreefy(size_type index, bulk_context& ctx);
+	/**
+	 * @brief 把node挂到第index个桶上，桶只会被当前线程修改，节点从ctx的池里换
+	 */
+	void bulk_link(bulk_context& ctx, size_type index, list_node_ptr node, bool unique);
+	/**
+	 * @brief 每个线程领一个分区，按线程编号的顺序挂上各个线程放进这个分区的节点
+	 */
+	void bulk_link_all(std::vector<bulk_context>& contexts, size_type partitions, bool unique);
+	/**
+	 * @brief 合并各个线程的池，有线程出错时抛出第一个错误
+	 */
+	void bulk_finish(std::vector<bulk_context>& contexts);
+	template<std::random_access_iterator RandomIter>
+	void bulk_insert(RandomIter first, size_type n, bool unique, size_type threads);
+	void relink_parallel(size_type bucketCount, bool rehashValue, size_type threads);
 
 private:
 	size_type m_bucket_count;	///< 桶个数
-	entry_ptr m_buckets;		///< 桶数组
+	bucket_ptr m_buckets;		///< 桶数组
 	size_type m_size;			///< 有效保存了值节点个数
-#ifdef BIT32
-	dynamic_bitset m_bitset;	///< 区分链表还是树的标志
-#endif //BIT64
+	ht_bitmap m_bitmap;			///< 哪些桶不为空，32位下还有区分链表还是树的标志
 	float m_mlf;				///< max load factor
-	const hasher& m_hash;		///< hash
-	const key_compare& m_comp;	///< compare
-	const key_equal& m_equal;	///< equal
+	float m_min_lf;				///< min load factor
+	size_t m_seed;				///< 每个哈希表自己的种子
+	size_type m_collision_count;	///< 自上次换种子以来树化和插入到树里的次数
+	size_type m_reseed_threshold;
+	bucket_ptr m_old_buckets;	///< 渐进式rehash时还没搬完的旧桶数组
+	size_type m_old_bucket_count;
+	size_type m_migrate_index;	///< 下一个要搬的旧桶
+	ht_bitmap m_old_bitmap;
+	bool m_incremental;			///< 是否开启渐进式rehash
+	node_pool<list_node> m_list_pool;	///< 链表节点和树节点的内存都从池里申请
+	node_pool<tree_node> m_tree_pool;
+	pool_group_ptr m_pool_group;	///< 和别的表交换过节点以后才有
+	[[no_unique_address]] mutable ht_counters<> m_counters;	///< 查找时也要计数
+	hasher m_hash;				///< hash
+	key_compare m_comp;			///< compare
+	key_equal m_equal;			///< equal
 };
 
-template<typename T, bool cache, typename Hash, typename Comp, typename Pred>
-std::pair<typename hash_table<T, cache, Hash, Comp, Pred>::size_type, 
-		typename hash_table<T, cache, Hash, Comp, Pred>::entry_type> 
-hash_table<T, cache, Hash, Comp, Pred>::beg() const {
-	size_type index = 0;
-	for (; index != m_bucket_count; ++index) {
-		if (!m_buckets[index].isnull()) { //也可以判断tree_node
-			break;
-		}
-	}
+template<typename T, bool cache, typename Hash, typename Comp, typename Pred, typename Bucket>
+std::pair<typename hash_table<T, cache, Hash, Comp, Pred, Bucket>::size_type, 
+		typename hash_table<T, cache, Hash, Comp, Pred, Bucket>::entry_type> 
+hash_table<T, cache, Hash, Comp, Pred, Bucket>::beg() const {
+	size_type index = next_occupied(0);
 	entry_type entry = bucket_entry(index);
 
 	return { index, entry };
 }
 
-template<typename T, bool cache, typename Hash, typename Comp, typename Pred>
-typename hash_table<T, cache, Hash, Comp, Pred>::tree_node_ptr 
-hash_table<T, cache, Hash, Comp, Pred>::listNode2TreeNode(list_node_ptr node) {
-	tree_node_ptr tnode = static_cast<tree_node_ptr>(::operator new(sizeof(tree_node)));
+template<typename T, bool cache, typename Hash, typename Comp, typename Pred, typename Bucket>
+typename hash_table<T, cache, Hash, Comp, Pred, Bucket>::tree_node_ptr 
+hash_table<T, cache, Hash, Comp, Pred, Bucket>::listNode2TreeNode(list_node_ptr node) {
+	tree_node_ptr tnode = tree_pool().allocate();
 	construct(&tnode->value, std::move(node->value));
 	if constexpr(cache) {
 		tnode->hash_val = node->hash_val;
@@ -813,10 +1827,10 @@ hash_table<T, cache, Hash, Comp, Pred>::listNode2TreeNode(list_node_ptr node) {
 	return tnode;
 }
 
-template<typename T, bool cache, typename Hash, typename Comp, typename Pred>
-typename hash_table<T, cache, Hash, Comp, Pred>::list_node_ptr 
-hash_table<T, cache, Hash, Comp, Pred>::treeNode2ListNode(tree_node_ptr node) {
-	list_node_ptr lnode = static_cast<list_node_ptr>(::operator new(sizeof(list_node)));
+template<typename T, bool cache, typename Hash, typename Comp, typename Pred, typename Bucket>
+typename hash_table<T, cache, Hash, Comp, Pred, Bucket>::list_node_ptr 
+hash_table<T, cache, Hash, Comp, Pred, Bucket>::treeNode2ListNode(tree_node_ptr node) {
+	list_node_ptr lnode = list_pool().allocate();
 	construct(&lnode->value, std::move(node->value));
 	if constexpr(cache) {
 		lnode->hash_val = node->hash_val;
@@ -826,118 +1840,308 @@ hash_table<T, cache, Hash, Comp, Pred>::treeNode2ListNode(tree_node_ptr node) {
 	return lnode;
 }
 
-template<typename T, bool cache, typename Hash, typename Comp, typename Pred>
-typename hash_table<T, cache, Hash, Comp, Pred>::size_type 
-hash_table<T, cache, Hash, Comp, Pred>::next_bucket(size_type index) {
-	size_type nextIndex = index + 1;
-	for (; nextIndex != m_bucket_count; ++nextIndex) {
-		if (m_buckets[nextIndex].list_node) { //也可以判断tree_node
-			break;
-		}
+template<typename T, bool cache, typename Hash, typename Comp, typename Pred, typename Bucket>
+typename hash_table<T, cache, Hash, Comp, Pred, Bucket>::tree_node_ptr 
+hash_table<T, cache, Hash, Comp, Pred, Bucket>::listNode2TreeNode(list_node_ptr node, bulk_context& ctx) {
+	tree_node_ptr tnode = ctx.tree_pool.allocate();
+	construct(&tnode->value, std::move(node->value));
+	if constexpr(cache) {
+		tnode->hash_val = node->hash_val;
 	}
-
-	return nextIndex;
+	tnode->left = tnode->right = tnode->parent = nullptr;
+	tnode->color = NodeColor::RED;
+	destroy(&node->value);
+	ctx.list_pool.deallocate(node);
+	return tnode;
 }
 
-template<typename T, bool cache, typename Hash, typename Comp, typename Pred>
-void hash_table<T, cache, Hash, Comp, Pred>::treefy(size_type index) {
+template<typename T, bool cache, typename Hash, typename Comp, typename Pred, typename Bucket>
+typename hash_table<T, cache, Hash, Comp, Pred, Bucket>::list_node_ptr 
+hash_table<T, cache, Hash, Comp, Pred, Bucket>::treeNode2ListNode(tree_node_ptr node, bulk_context& ctx) {
+	list_node_ptr lnode = ctx.list_pool.allocate();
+	construct(&lnode->value, std::move(node->value));
+	if constexpr(cache) {
+		lnode->hash_val = node->hash_val;
+	}
+	lnode->next = nullptr;
+	destroy(&node->value);
+	ctx.tree_pool.deallocate(node);
+	return lnode;
+}
+
+template<typename T, bool cache, typename Hash, typename Comp, typename Pred, typename Bucket>
+void hash_table<T, cache, Hash, Comp, Pred, Bucket>::untreefy(size_type index, bulk_context& ctx) {
+	tree_node_ptr root = bucket_at(index).as_tree_node_ptr();
+	size_type count = 0;
+	for (tree_node_ptr node = min_node(root); node; node = successor(node)) {
+		++count;
+	}
+	ctx.list_pool.reserve(count);
+	m_counters.untreefied();
+	//按中序从大到小挂到链表头，相等的元素还是挨在一起
+	list_node_ptr head = nullptr;
+	for (tree_node_ptr node = max_node(root); node; node = precursor(node)) {
+		list_node_ptr lnode = ctx.list_pool.allocate();
+		construct(&lnode->value, std::move(node->value));
+		if constexpr(cache) {
+			lnode->hash_val = node->hash_val;
+		}
+		lnode->next = head;
+		head = lnode;
+	}
+	clear_since(root, [&ctx](tree_node_base* node) {
+		destroy(&static_cast<tree_node_ptr>(node)->value);
+		ctx.tree_pool.deallocate(static_cast<tree_node_ptr>(node));
+	});
+	bucket_at(index) = head;
+	unmark(index);
+}
+
+template<typename T, bool cache, typename Hash, typename Comp, typename Pred, typename Bucket>
+typename hash_table<T, cache, Hash, Comp, Pred, Bucket>::size_type 
+hash_table<T, cache, Hash, Comp, Pred, Bucket>::next_bucket(size_type index) {
+	return next_occupied(index + 1);
+}
+
+template<typename T, bool cache, typename Hash, typename Comp, typename Pred, typename Bucket>
+typename hash_table<T, cache, Hash, Comp, Pred, Bucket>::tree_node_ptr
+hash_table<T, cache, Hash, Comp, Pred, Bucket>::treefy(size_type index, list_node_ptr node) {
 	if (is_tree(index)) {
-		return;
+		return nullptr;
 	}
 
-	list_node_ptr head = m_buckets[index].as_list_node_ptr();
+	tree_node_ptr result = nullptr;
+	if constexpr(SORTED_BUCKET) {
+		static_cast<void>(node);
+		m_counters.treefied();
+		build_sorted(index);
+	} else {
+		result = build_tree(index, node, [this](list_node_ptr lnode) {
+			return listNode2TreeNode(lnode);
+		});
+	}
+	++m_collision_count;
+	return result;
+}
+
+template<typename T, bool cache, typename Hash, typename Comp, typename Pred, typename Bucket>
+template<typename Convert>
+typename hash_table<T, cache, Hash, Comp, Pred, Bucket>::tree_node_ptr
+hash_table<T, cache, Hash, Comp, Pred, Bucket>::build_tree(size_type index, list_node_ptr node, 
+		const Convert& convert) {
+	m_counters.treefied();
+	list_node_ptr head = bucket_at(index).as_list_node_ptr();
 	tree_node_ptr root = nullptr;
+	tree_node_ptr result = nullptr;
 	while (head->next) {
 		list_node_ptr lnode = list_unlink_after(head);
-		tree_node_ptr tnode = listNode2TreeNode(lnode);
+		bool isNode = lnode == node;
+		tree_node_ptr tnode = convert(lnode);
+		if (isNode) {
+			result = tnode;
+		}
 		ht_tree_insert_node_multi(tnode, &root, m_comp);
 	}
 	list_node_ptr lnode = head;
-	tree_node_ptr tnode = listNode2TreeNode(lnode);
+	bool isNode = lnode == node;
+	tree_node_ptr tnode = convert(lnode);
+	if (isNode) {
+		result = tnode;
+	}
 	ht_tree_insert_node_multi(tnode, &root, m_comp);
-	m_buckets[index] = root;
+	bucket_at(index) = root;
 	mark(index);
+	return result;
 }
 
-template<typename T, bool cache, typename Hash, typename Comp, typename Pred>
-void hash_table<T, cache, Hash, Comp, Pred>::untreefy(size_type index) {
-	if (is_list(m_buckets[index])) {
+template<typename T, bool cache, typename Hash, typename Comp, typename Pred, typename Bucket>
+void hash_table<T, cache, Hash, Comp, Pred, Bucket>::build_sorted(size_type index) {
+	list_node_ptr head = bucket_at(index).as_list_node_ptr();
+	size_type count = 0;
+	for (list_node_ptr node = head; node; node = next_of(node)) {
+		++count;
+	}
+	sorted_ptr array = sorted_array::create(ceil_power_of_2(std::max(count + 1, 2 * TREEFY_THRESHOLD)));
+	//插入排序，桶不长，而且相等的元素本来就挨在一起，保持原来的先后
+	list_node_ptr* nodes = array->nodes();
+	for (list_node_ptr node = head; node; node = next_of(node)) {
+		size_type i = array->size++;
+		for (; i > 0 && m_comp(node->value, nodes[i - 1]->value); --i) {
+			nodes[i] = nodes[i - 1];
+		}
+		nodes[i] = node;
+	}
+	for (size_type i = 0; i < count; ++i) {
+		nodes[i]->next = i + 1 < count ? nodes[i + 1] : nullptr;
+		if constexpr(sorted_array::INLINE_KEYS) {
+			memcpy(static_cast<void*>(array->keys() + i), &nodes[i]->value, sizeof(T));
+		}
+	}
+	set_sorted(index, array);
+	mark(index);
+}
+
+template<typename T, bool cache, typename Hash, typename Comp, typename Pred, typename Bucket>
+std::pair<typename hash_table<T, cache, Hash, Comp, Pred, Bucket>::list_node_ptr, bool>
+hash_table<T, cache, Hash, Comp, Pred, Bucket>::sorted_link(size_type index, list_node_ptr node, bool unique) {
+	sorted_ptr array = sorted_at(index);
+	size_type pos = 0;
+	if (unique) {
+		pos = array->lower_bound(node->value, m_comp);
+		if (pos != array->size && !m_comp(node->value, array->key_at(pos))) {
+			return { array->nodes()[pos], false };
+		}
+	} else {
+		//和树一样插在相等元素的后面
+		pos = array->upper_bound(node->value, m_comp);
+	}
+	if (array->size == array->capacity) {
+		array = array->grow(array->capacity * 2);
+		set_sorted(index, array);
+	}
+	array->insert(pos, node);
+	return { node, true };
+}
+
+template<typename T, bool cache, typename Hash, typename Comp, typename Pred, typename Bucket>
+void hash_table<T, cache, Hash, Comp, Pred, Bucket>::untreefy(size_type index) {
+	if (is_list(index)) {
+		return;
+	}
+	m_counters.untreefied();
+	if constexpr(SORTED_BUCKET) {
+		//节点本来就按顺序连着，扔掉数组就行
+		sorted_ptr array = sorted_at(index);
+		list_node_ptr head = array->nodes()[0];
+		sorted_array::destroy(array);
+		bucket_at(index) = head;
+		unmark(index);
 		return;
 	}
 
-	tree_node_ptr root = m_buckets[index].as_tree_node_ptr();
+	tree_node_ptr root = bucket_at(index).as_tree_node_ptr();
+	//先把节点都申请好，申请失败时桶不变
+	list_node_ptr spare = nullptr;
+	try {
+		for (tree_node_ptr node = min_node(root); node; node = successor(node)) {
+			list_node_ptr lnode = list_pool().allocate();
+			lnode->next = spare;
+			spare = lnode;
+		}
+	} catch (...) {
+		while (spare) {
+			list_node_ptr next = next_of(spare);
+			list_pool().deallocate(spare);
+			spare = next;
+		}
+		throw;
+	}
+	//按中序从大到小挂到链表头，相等的元素还是挨在一起
 	list_node_ptr head = nullptr;
-	postorder(root, [this, &head](tree_node_base* node) {
-		tree_node_base* parent = parent_of(node);
-		if (parent) {
-			if (left_of(parent) == node) {
-				parent->left = nullptr;
-			} else {
-				parent->right = nullptr;
-			}
-			node->parent = nullptr;
+	for (tree_node_ptr node = max_node(root); node; node = precursor(node)) {
+		list_node_ptr lnode = spare;
+		spare = next_of(spare);
+		construct(&lnode->value, std::move(node->value));
+		if constexpr(cache) {
+			lnode->hash_val = node->hash_val;
 		}
-		tree_node_ptr tnode = node;
-		list_node_ptr lnode = treeNode2ListNode(tnode);
-		list_link_after(lnode, &head);
+		lnode->next = head;
+		head = lnode;
+	}
+	clear_since(root, [this](tree_node_base* node) {
+		destroy_node(static_cast<tree_node_ptr>(node));
 	});
-	m_buckets[index] = head;
+	bucket_at(index) = head;
 	unmark(index);
 }
 
-template<typename T, bool cache, typename Hash, typename Comp, typename Pred>
-void hash_table<T, cache, Hash, Comp, Pred>::copy_entry_unchecked(entry_ptr buckets, size_type n) {
-	for (size_type i = 0; i != n; ++i) {
-		if (!buckets[i].isnull()) {
-			if (is_tree(i)) {
-				tree_node_base* newTree = copy_since(buckets[i].as_tree_node_ptr(), 
-					[this](tree_node_base* node){
-						tree_node_ptr tnode = static_cast<tree_node_ptr>(node);
-						return create_tree_node(tnode->value);
-				});
-				m_buckets[i] = static_cast<tree_node_ptr>(newTree);
-			} else {
-				list_node_base* newList = copy_since(buckets[i].as_list_node_ptr(), 
-					[this](list_node_base* node){
-						list_node_ptr lnode = static_cast<list_node_ptr>(node);
-						return create_list_node(lnode->value);
-				});
-				m_buckets[i] = static_cast<list_node_ptr>(newList);
+template<typename T, bool cache, typename Hash, typename Comp, typename Pred, typename Bucket>
+void hash_table<T, cache, Hash, Comp, Pred, Bucket>::untreefy_if(size_type index) {
+	if (is_list(index)) {
+		return;
+	}
+	size_type count = 0;
+	if constexpr(SORTED_BUCKET) {
+		count = sorted_at(index)->size;
+	} else {
+		tree_node_ptr node = min_node(bucket_at(index).as_tree_node_ptr());
+		for (; node && count < UNTREEFY_THRESHOLD; node = successor(node)) {
+			++count;
+		}
+	}
+	if (count < UNTREEFY_THRESHOLD) {
+		untreefy(index);
+	}
+}
+
+template<typename T, bool cache, typename Hash, typename Comp, typename Pred, typename Bucket>
+void hash_table<T, cache, Hash, Comp, Pred, Bucket>::copy_entry_unchecked(const hash_table& other) {
+	//只看other的非空桶，要看other的标志，自己的桶还是空的
+	for (size_type i = other.m_bitmap.next(0); i != other.m_bucket_count; i = other.m_bitmap.next(i + 1)) {
+		if constexpr(SORTED_BUCKET) {
+			//先按顺序复制链表，再配上数组
+			list_node_base* newList = copy_since(other.bucket_entry(i).as_list_node_ptr(), 
+				[this](list_node_base* node){
+					return create_list_node(static_cast<list_node_ptr>(node)->value);
+			});
+			bucket_at(i) = static_cast<list_node_ptr>(newList);
+			if (other.is_tree(i)) {
+				build_sorted(i);
 			}
+		} else if (other.is_tree(i)) {
+			tree_node_base* newTree = copy_since(other.bucket_at(i).as_tree_node_ptr(), 
+				[this](tree_node_base* node){
+					tree_node_ptr tnode = static_cast<tree_node_ptr>(node);
+					tree_node_ptr newNode = create_tree_node(tnode->value);
+					newNode->color = tnode->color;
+					return newNode;
+			});
+			bucket_at(i) = static_cast<tree_node_ptr>(newTree);
+			mark(i);
+		} else {
+			list_node_base* newList = copy_since(other.bucket_at(i).as_list_node_ptr(), 
+				[this](list_node_base* node){
+					list_node_ptr lnode = static_cast<list_node_ptr>(node);
+					return create_list_node(lnode->value);
+			});
+			bucket_at(i) = static_cast<list_node_ptr>(newList);
 		}
+		occupy(i);
 	}
 }
 
-template<typename T, bool cache, typename Hash, typename Comp, typename Pred>
-typename hash_table<T, cache, Hash, Comp, Pred>::entry_type 
-hash_table<T, cache, Hash, Comp, Pred>::bucket_entry(size_type index) const {
-	if (index != m_bucket_count) {
+template<typename T, bool cache, typename Hash, typename Comp, typename Pred, typename Bucket>
+typename hash_table<T, cache, Hash, Comp, Pred, Bucket>::entry_type 
+hash_table<T, cache, Hash, Comp, Pred, Bucket>::bucket_entry(size_type index) const {
+	if (index != total_bucket_count()) {
 		if (is_list(index)) {
-			return m_buckets[index];
+			return bucket_at(index).as_list_node_ptr();
+		} else if constexpr(SORTED_BUCKET) {
+			return sorted_at(index)->nodes()[0];
 		} else {
-			return min_node(m_buckets[index].as_tree_node_ptr());
+			return min_node(bucket_at(index).as_tree_node_ptr());
 		}
 	} 
 	return entry_type();
 }
 
-template<typename T, bool cache, typename Hash, typename Comp, typename Pred>
-std::pair<typename hash_table<T, cache, Hash, Comp, Pred>::size_type,
-		typename hash_table<T, cache, Hash, Comp, Pred>::entry_type>
-hash_table<T, cache, Hash, Comp, Pred>::next_bucket_entry(size_type index) {
+template<typename T, bool cache, typename Hash, typename Comp, typename Pred, typename Bucket>
+std::pair<typename hash_table<T, cache, Hash, Comp, Pred, Bucket>::size_type,
+		typename hash_table<T, cache, Hash, Comp, Pred, Bucket>::entry_type>
+hash_table<T, cache, Hash, Comp, Pred, Bucket>::next_bucket_entry(size_type index) {
 	size_type nextIndex = next_bucket(index);
 	return { nextIndex, bucket_entry(nextIndex) };
 }
 
-template<typename T, bool cache, typename Hash, typename Comp, typename Pred>
+template<typename T, bool cache, typename Hash, typename Comp, typename Pred, typename Bucket>
 template<typename... Args>
-typename hash_table<T, cache, Hash, Comp, Pred>::list_node_ptr 
-hash_table<T, cache, Hash, Comp, Pred>::create_list_node_nohash(Args&&... args) {
-	list_node_ptr newNode = static_cast<list_node_ptr>(::operator new(sizeof(list_node)));
+typename hash_table<T, cache, Hash, Comp, Pred, Bucket>::list_node_ptr 
+hash_table<T, cache, Hash, Comp, Pred, Bucket>::create_list_node_nohash(Args&&... args) {
+	list_node_ptr newNode = list_pool().allocate();
 	try {
 		construct(&newNode->value, std::forward<Args>(args)...);
 	} catch (...) {
-		::operator delete(newNode);
+		list_pool().deallocate(newNode);
 		throw;
 	}
 	newNode->next = nullptr;
@@ -945,15 +2149,15 @@ hash_table<T, cache, Hash, Comp, Pred>::create_list_node_nohash(Args&&... args)
 	return newNode;
 }
 
-template<typename T, bool cache, typename Hash, typename Comp, typename Pred>
+template<typename T, bool cache, typename Hash, typename Comp, typename Pred, typename Bucket>
 template<typename... Args>
-typename hash_table<T, cache, Hash, Comp, Pred>::tree_node_ptr 
-hash_table<T, cache, Hash, Comp, Pred>::create_tree_node_nohash(Args&&... args) {
-	tree_node_ptr newNode = static_cast<tree_node_ptr>(::operator new(sizeof(tree_node)));
+typename hash_table<T, cache, Hash, Comp, Pred, Bucket>::tree_node_ptr 
+hash_table<T, cache, Hash, Comp, Pred, Bucket>::create_tree_node_nohash(Args&&... args) {
+	tree_node_ptr newNode = tree_pool().allocate();
 	try {
 		construct(&newNode->value, std::forward<Args>(args)...);
 	} catch (...) {
-		::operator delete(newNode);
+		tree_pool().deallocate(newNode);
 		throw;
 	}
 	newNode->left = newNode->right = newNode->parent = nullptr;
@@ -962,56 +2166,79 @@ hash_table<T, cache, Hash, Comp, Pred>::create_tree_node_nohash(Args&&... args)
 	return newNode;
 }
 
-template<typename T, bool cache, typename Hash, typename Comp, typename Pred>
+template<typename T, bool cache, typename Hash, typename Comp, typename Pred, typename Bucket>
 template<typename... Args>
-typename hash_table<T, cache, Hash, Comp, Pred>::list_node_ptr
-hash_table<T, cache, Hash, Comp, Pred>::create_list_node(Args&&... args) {
+typename hash_table<T, cache, Hash, Comp, Pred, Bucket>::list_node_ptr
+hash_table<T, cache, Hash, Comp, Pred, Bucket>::create_list_node(Args&&... args) {
 	list_node_ptr newNode = create_list_node_nohash(std::forward<Args>(args)...);
 	if constexpr(cache) {
-		newNode->hash_val = m_hash(newNode->value);
+		newNode->hash_val = hash_of(newNode->value);
 	}
 
 	return newNode;
 }
 
-template<typename T, bool cache, typename Hash, typename Comp, typename Pred>
+template<typename T, bool cache, typename Hash, typename Comp, typename Pred, typename Bucket>
 template<typename... Args>
-typename hash_table<T, cache, Hash, Comp, Pred>::tree_node_ptr
-hash_table<T, cache, Hash, Comp, Pred>::create_tree_node(Args&&... args) {
+typename hash_table<T, cache, Hash, Comp, Pred, Bucket>::tree_node_ptr
+hash_table<T, cache, Hash, Comp, Pred, Bucket>::create_tree_node(Args&&... args) {
 	tree_node_ptr newNode = create_tree_node_nohash(std::forward<Args>(args)...);
 	if constexpr(cache) {
-		newNode->hash_val = m_hash(newNode->value);
+		newNode->hash_val = hash_of(newNode->value);
 	}
 	return newNode;
 }
 
-template<typename T, bool cache, typename Hash, typename Comp, typename Pred>
-void hash_table<T, cache, Hash, Comp, Pred>::destroy_node(list_node_ptr node) {
+template<typename T, bool cache, typename Hash, typename Comp, typename Pred, typename Bucket>
+void hash_table<T, cache, Hash, Comp, Pred, Bucket>::destroy_node(list_node_ptr node) {
 	destroy(&node->value);
-	::operator delete(node);
+	if constexpr(INLINE_BUCKET) {
+		//桶自带的节点只要清掉标志
+		size_type index = inline_index(node);
+		if (index != total_bucket_count()) {
+			bucket_at(index).flag &= ~inline_mask;
+			return;
+		}
+	}
+	list_pool().deallocate(node);
 }
 
-template<typename T, bool cache, typename Hash, typename Comp, typename Pred>
-void hash_table<T, cache, Hash, Comp, Pred>::destroy_node(tree_node_ptr node) {
+template<typename T, bool cache, typename Hash, typename Comp, typename Pred, typename Bucket>
+void hash_table<T, cache, Hash, Comp, Pred, Bucket>::destroy_node(tree_node_ptr node) {
 	destroy(&node->value);
-	::operator delete(node);
+	tree_pool().deallocate(node);
 }
 
-template<typename T, bool cache, typename Hash, typename Comp, typename Pred>
-typename hash_table<T, cache, Hash, Comp, Pred>::iterator 
-hash_table<T, cache, Hash, Comp, Pred>::insert_list_node_multi(size_type index, list_node_ptr node) {
-	if (m_buckets[index].isnull()) {
-		m_buckets[index] = node;
+template<typename T, bool cache, typename Hash, typename Comp, typename Pred, typename Bucket>
+typename hash_table<T, cache, Hash, Comp, Pred, Bucket>::iterator 
+hash_table<T, cache, Hash, Comp, Pred, Bucket>::insert_list_node_multi(size_type index, list_node_ptr node) {
+	if constexpr(SORTED_BUCKET) {
+		if (is_tree(index)) {
+			try {
+				sorted_link(index, node, false);
+			} catch (...) {
+				destroy_node(node);
+				throw;
+			}
+			++m_size;
+			++m_collision_count;
+			return iterator(index, node, this);
+		}
+	}
+	node = to_inline(index, node);
+	if (bucket_at(index).isnull()) {
+		bucket_at(index) = node;
+		occupy(index);
 		++m_size;
-		return iterator(index, m_buckets[index], this);
+		return iterator(index, node, this);
 	}
 
-	list_node_ptr head = m_buckets[index].as_list_node_ptr();
+	list_node_ptr head = bucket_at(index).as_list_node_ptr();
 	list_node_ptr last = head;
 	size_type nodeCount = 1;
 	//找到是否有相等的
 	while (last) {
-		if (m_equal(last->value, node->value)) {
+		if (node_equal(last, node)) {
 			break;
 		}
 		last = next_of(last);
@@ -1024,106 +2251,137 @@ hash_table<T, cache, Hash, Comp, Pred>::insert_list_node_multi(size_type index,
 		list_link_after(node, &last);
 	} else {
 		//如果为false，证明没有相等的，那就插入到链表头部
-		list_link_after(node, &head);
-		m_buckets[index] = head;
+		//不能插在head后面，否则会把head和与它相等的元素隔开
+		node->next = head;
+		bucket_at(index) = node;
 	}
 	while (last) {
 		//继续统计有多少个相等的元素
 		last = next_of(last);
 		++nodeCount;
 	}
+	++m_size;
 	if (nodeCount >= TREEFY_THRESHOLD) {
-		//达到条件转为树
-		treefy(index);
+		//达到条件转为树，新插入的节点也换成了树节点；有序数组桶的节点不换
+		tree_node_ptr tnode = treefy(index, node);
+		if constexpr(!SORTED_BUCKET) {
+			return iterator(index, tnode, this);
+		}
 	}
-	
-	++m_size;
 	return iterator(index, node, this);
 }
 
-template<typename T, bool cache, typename Hash, typename Comp, typename Pred>
-typename hash_table<T, cache, Hash, Comp, Pred>::iterator 
-hash_table<T, cache, Hash, Comp, Pred>::insert_tree_node_multi(size_type index, tree_node_ptr node) {
+template<typename T, bool cache, typename Hash, typename Comp, typename Pred, typename Bucket>
+typename hash_table<T, cache, Hash, Comp, Pred, Bucket>::iterator 
+hash_table<T, cache, Hash, Comp, Pred, Bucket>::insert_tree_node_multi(size_type index, tree_node_ptr node) {
 	//不可能为空
-	tree_node_ptr root = m_buckets[index].as_tree_node_ptr();
+	tree_node_ptr root = bucket_at(index).as_tree_node_ptr();
 	ht_tree_insert_node_multi(node, &root, m_comp);
-	m_buckets[index] = root;
+	bucket_at(index) = root;
 	++m_size;
+	++m_collision_count;
 	return iterator(index, node, this);
 }
 
-template<typename T, bool cache, typename Hash, typename Comp, typename Pred>
-typename hash_table<T, cache, Hash, Comp, Pred>::iterator 
-hash_table<T, cache, Hash, Comp, Pred>::insert_node_multi(size_type index, list_node_ptr node) {
-	if (is_list(index)) {
+template<typename T, bool cache, typename Hash, typename Comp, typename Pred, typename Bucket>
+typename hash_table<T, cache, Hash, Comp, Pred, Bucket>::iterator 
+hash_table<T, cache, Hash, Comp, Pred, Bucket>::insert_node_multi(size_type index, list_node_ptr node) {
+	if (holds_list_nodes(index)) {
 		return insert_list_node_multi(index, node);
 	}
 	tree_node_ptr tnode = listNode2TreeNode(node);
 	return insert_tree_node_multi(index, tnode);
 }
 
-template<typename T, bool cache, typename Hash, typename Comp, typename Pred>
-typename hash_table<T, cache, Hash, Comp, Pred>::iterator 
-hash_table<T, cache, Hash, Comp, Pred>::insert_node_multi(size_type index, tree_node_ptr node) {
-	if (is_list(index)) {
+template<typename T, bool cache, typename Hash, typename Comp, typename Pred, typename Bucket>
+typename hash_table<T, cache, Hash, Comp, Pred, Bucket>::iterator 
+hash_table<T, cache, Hash, Comp, Pred, Bucket>::insert_node_multi(size_type index, tree_node_ptr node) {
+	if (holds_list_nodes(index)) {
 		list_node_ptr lnode = treeNode2ListNode(node);
 		return insert_list_node_multi(index, lnode);
 	}
 	return insert_tree_node_multi(index, node);
 }
 
-template<typename T, bool cache, typename Hash, typename Comp, typename Pred>
-std::pair<typename hash_table<T, cache, Hash, Comp, Pred>::iterator, bool> 
-hash_table<T, cache, Hash, Comp, Pred>::insert_list_node_unique(size_type index, list_node_ptr node) {
-	if (m_buckets[index].isnull()) {
-		m_buckets[index] = node;
+template<typename T, bool cache, typename Hash, typename Comp, typename Pred, typename Bucket>
+std::pair<typename hash_table<T, cache, Hash, Comp, Pred, Bucket>::iterator, bool> 
+hash_table<T, cache, Hash, Comp, Pred, Bucket>::insert_list_node_unique(size_type index, list_node_ptr node) {
+	if constexpr(SORTED_BUCKET) {
+		if (is_tree(index)) {
+			std::pair<list_node_ptr, bool> result;
+			try {
+				result = sorted_link(index, node, true);
+			} catch (...) {
+				destroy_node(node);
+				throw;
+			}
+			if (result.second) {
+				++m_size;
+				++m_collision_count;
+			} else {
+				destroy_node(node);
+			}
+			return { iterator(index, result.first, this), result.second };
+		}
+	}
+	if (bucket_at(index).isnull()) {
+		node = to_inline(index, node);
+		bucket_at(index) = node;
+		occupy(index);
 		++m_size;
 		return { iterator(index, node, this), true };
 	}
 
-	list_node_ptr head = m_buckets[index].as_list_node_ptr();
+	list_node_ptr head = bucket_at(index).as_list_node_ptr();
 	list_node_ptr last = head;
 	size_type nodeCount = 1;
 	while (last) {
-		if (m_equal(last->value, node->value)) {
+		if (node_equal(last, node)) {
 			destroy_node(node);
 			return { iterator(index, last, this), false };
 		}
 		last = next_of(last);
 		++nodeCount;
 	}
+	node = to_inline(index, node);
 	list_link_after(node, &head);
-	m_buckets[index] = head;
+	bucket_at(index) = head;
 	while (last) {
 		++nodeCount;
 		last = next_of(last);
 	}
+	++m_size;
 	if (nodeCount >= TREEFY_THRESHOLD) {
-		treefy(index);
+		tree_node_ptr tnode = treefy(index, node);
+		if constexpr(!SORTED_BUCKET) {
+			return { iterator(index, tnode, this), true };
+		}
 	}
-	++m_size;
 	return { iterator(index, node, this), true };	
 }
 
-template<typename T, bool cache, typename Hash, typename Comp, typename Pred>
-std::pair<typename hash_table<T, cache, Hash, Comp, Pred>::iterator, bool> 
-hash_table<T, cache, Hash, Comp, Pred>::insert_tree_node_unique(size_type index, tree_node_ptr node) {
+template<typename T, bool cache, typename Hash, typename Comp, typename Pred, typename Bucket>
+std::pair<typename hash_table<T, cache, Hash, Comp, Pred, Bucket>::iterator, bool> 
+hash_table<T, cache, Hash, Comp, Pred, Bucket>::insert_tree_node_unique(size_type index, tree_node_ptr node) {
 	//不可能为空
-	tree_node_ptr root = m_buckets[index].as_tree_node_ptr();
+	tree_node_ptr root = bucket_at(index).as_tree_node_ptr();
 	std::pair<tree_node_ptr, bool> myPair = ht_tree_insert_node_unique(node, &root, m_comp);
 	if (!myPair.second) {
 		destroy_node(node);
 	} else {
+		//插入后可能旋转，根会变
+		bucket_at(index) = root;
 		++m_size;
+		++m_collision_count;
 	}
 
-	return { iterator(index, node, this), myPair.second };
+	return { iterator(index, myPair.first, this), myPair.second };
 }
 
-template<typename T, bool cache, typename Hash, typename Comp, typename Pred>
-std::pair<typename hash_table<T, cache, Hash, Comp, Pred>::iterator, bool> 
-hash_table<T, cache, Hash, Comp, Pred>::insert_node_unique(size_type index, tree_node_ptr node) {
-	if (is_list(index)) {
+template<typename T, bool cache, typename Hash, typename Comp, typename Pred, typename Bucket>
+std::pair<typename hash_table<T, cache, Hash, Comp, Pred, Bucket>::iterator, bool> 
+hash_table<T, cache, Hash, Comp, Pred, Bucket>::insert_node_unique(size_type index, tree_node_ptr node) {
+	if (holds_list_nodes(index)) {
 		list_node_ptr lnode = treeNode2ListNode(node);
 		return insert_list_node_unique(index, lnode);	
 	} else {
@@ -1131,10 +2389,10 @@ hash_table<T, cache, Hash, Comp, Pred>::insert_node_unique(size_type index, tree
 	}
 }
 
-template<typename T, bool cache, typename Hash, typename Comp, typename Pred>
-std::pair<typename hash_table<T, cache, Hash, Comp, Pred>::iterator, bool> 
-hash_table<T, cache, Hash, Comp, Pred>::insert_node_unique(size_type index, list_node_ptr node) {
-	if (is_list(index)) {
+template<typename T, bool cache, typename Hash, typename Comp, typename Pred, typename Bucket>
+std::pair<typename hash_table<T, cache, Hash, Comp, Pred, Bucket>::iterator, bool> 
+hash_table<T, cache, Hash, Comp, Pred, Bucket>::insert_node_unique(size_type index, list_node_ptr node) {
+	if (holds_list_nodes(index)) {
 		return insert_list_node_unique(index, node);
 	} else {
 		tree_node_ptr tnode = listNode2TreeNode(node);
@@ -1142,55 +2400,84 @@ hash_table<T, cache, Hash, Comp, Pred>::insert_node_unique(size_type index, list
 	}
 }
 
-template<typename T, bool cache, typename Hash, typename Comp, typename Pred>
-hash_table<T, cache, Hash, Comp, Pred>::hash_table(size_type n,
+template<typename T, bool cache, typename Hash, typename Comp, typename Pred, typename Bucket>
+hash_table<T, cache, Hash, Comp, Pred, Bucket>::hash_table(size_type n,
 		const hasher& hf, const key_compare& comp, const key_equal& eql) :
 	m_bucket_count(ceil_power_of_2(n)),
 	m_buckets(allocate_entry(m_bucket_count)),
 	m_size(0),
-#ifdef BIT32
-	m_bitset(m_bucket_count),
-#endif //BIT32
+	m_bitmap(m_bucket_count),
 	m_mlf(DEFAULT_MLF),
+	m_min_lf(0.0f),
+	m_seed(random_seed()),
+	m_collision_count(0),
+	m_reseed_threshold(RESEED_THRESHOLD),
+	m_old_buckets(nullptr),
+	m_old_bucket_count(0),
+	m_migrate_index(0),
+	m_incremental(false),
 	m_hash(hf),
 	m_comp(comp),
 	m_equal(eql) {
 }
 
-template<typename T, bool cache, typename Hash, typename Comp, typename Pred>
+template<typename T, bool cache, typename Hash, typename Comp, typename Pred, typename Bucket>
 template <std::input_iterator InputIter>
-hash_table<T, cache, Hash, Comp, Pred>::hash_table(InputIter first, InputIter last,
+hash_table<T, cache, Hash, Comp, Pred, Bucket>::hash_table(InputIter first, InputIter last,
 		size_type n, const hasher& hf, const key_compare& comp, const key_equal& eql) :
 		hash_table(n, hf, comp, eql) {
-	for (; first != last; ++first) {
-		emplace_multi(*first);
-	}
+	insert_multi(first, last);
 }
 
-template<typename T, bool cache, typename Hash, typename Comp, typename Pred>
-hash_table<T, cache, Hash, Comp, Pred>::hash_table(const hash_table& other) :
+template<typename T, bool cache, typename Hash, typename Comp, typename Pred, typename Bucket>
+hash_table<T, cache, Hash, Comp, Pred, Bucket>::hash_table(const hash_table& other) :
 		m_bucket_count(other.m_bucket_count),
 		m_buckets(allocate_entry(m_bucket_count)),
 		m_size(other.m_size),
-#ifdef BIT32
-		m_bitset(other.m_bitset),
-#endif //BIT32
+		m_bitmap(m_bucket_count),
 		m_mlf(other.m_mlf),
+		m_min_lf(other.m_min_lf),
+		m_seed(other.m_seed),
+		m_collision_count(other.m_collision_count),
+		m_reseed_threshold(other.m_reseed_threshold),
+		m_old_buckets(nullptr),
+		m_old_bucket_count(0),
+		m_migrate_index(0),
+		m_incremental(other.m_incremental),
 		m_hash(other.m_hash),
 		m_comp(other.m_comp),
 		m_equal(other.m_equal) {
-	copy_entry_unchecked(other.m_buckets, other.m_bucket_count);
+	if (other.rehashing() || INLINE_BUCKET) {
+		//other正在搬桶，一部分元素还在旧桶里，逐个插入到新桶
+		//桶自带节点时也逐个插入，复制出来的元素才会放进自己桶里的节点
+		m_size = 0;
+		for (const_iterator iter = other.begin(); iter != other.end(); ++iter) {
+			insert_multi_norehash(*iter);
+		}
+	} else {
+		copy_entry_unchecked(other);
+	}
 }
 
-template<typename T, bool cache, typename Hash, typename Comp, typename Pred>
-hash_table<T, cache, Hash, Comp, Pred>::hash_table(hash_table&& other) noexcept :
+template<typename T, bool cache, typename Hash, typename Comp, typename Pred, typename Bucket>
+hash_table<T, cache, Hash, Comp, Pred, Bucket>::hash_table(hash_table&& other) noexcept :
 		m_bucket_count(other.m_bucket_count),
 		m_buckets(other.m_buckets),
 		m_size(other.m_size),
-#ifdef BIT32
-		m_bitset(std::move(other.m_bitset)),
-#endif //BIT32
+		m_bitmap(std::move(other.m_bitmap)),
 		m_mlf(other.m_mlf),
+		m_min_lf(other.m_min_lf),
+		m_seed(other.m_seed),
+		m_collision_count(other.m_collision_count),
+		m_reseed_threshold(other.m_reseed_threshold),
+		m_old_buckets(other.m_old_buckets),
+		m_old_bucket_count(other.m_old_bucket_count),
+		m_migrate_index(other.m_migrate_index),
+		m_old_bitmap(std::move(other.m_old_bitmap)),
+		m_incremental(other.m_incremental),
+		m_list_pool(std::move(other.m_list_pool)),
+		m_tree_pool(std::move(other.m_tree_pool)),
+		m_pool_group(std::move(other.m_pool_group)),
 		m_hash(other.m_hash),
 		m_comp(other.m_comp),
 		m_equal(other.m_equal) {
@@ -1198,37 +2485,45 @@ hash_table<T, cache, Hash, Comp, Pred>::hash_table(hash_table&& other) noexcept
 	other.m_buckets = nullptr;
 	other.m_size = 0;
 	other.m_mlf = DEFAULT_MLF;
+	other.m_min_lf = 0.0f;
+	other.m_old_buckets = nullptr;
+	other.m_old_bucket_count = 0;
+	other.m_migrate_index = 0;
 }
 
-template<typename T, bool cache, typename Hash, typename Comp, typename Pred>
-hash_table<T, cache, Hash, Comp, Pred>&
-hash_table<T, cache, Hash, Comp, Pred>::operator=(const hash_table& other) {
+template<typename T, bool cache, typename Hash, typename Comp, typename Pred, typename Bucket>
+hash_table<T, cache, Hash, Comp, Pred, Bucket>&
+hash_table<T, cache, Hash, Comp, Pred, Bucket>::operator=(const hash_table& other) {
 	if (this != &other) {
-		clear();
-		if (m_bucket_count < other.m_bucket_count) {
-			deallocate_entry(m_buckets, m_bucket_count);
-			m_buckets = allocate_entry(other.m_bucket_count);
-		}
-		copy_entry_unchecked(other.m_buckets, other.m_bucket_count);
-		m_bucket_count = other.m_bucket_count;
-		m_size = other.m_size;
-		m_mlf = other.m_mlf;
-		m_hash = other.m_hash;
-		m_comp = other.m_comp;
-		m_equal = other.m_equal;
+		hash_table tmp(other);
+		swap(tmp);
 	}
+	return *this;
 }
 
-template<typename T, bool cache, typename Hash, typename Comp, typename Pred>
-hash_table<T, cache, Hash, Comp, Pred>& 
-hash_table<T, cache, Hash, Comp, Pred>::operator=(hash_table&& other) noexcept {
+template<typename T, bool cache, typename Hash, typename Comp, typename Pred, typename Bucket>
+hash_table<T, cache, Hash, Comp, Pred, Bucket>& 
+hash_table<T, cache, Hash, Comp, Pred, Bucket>::operator=(hash_table&& other) noexcept {
 	if (this != &other) {
-		clear();
+		destroy_all();
 		deallocate_entry(m_buckets, m_bucket_count);
 		m_bucket_count = other.m_bucket_count;
 		m_buckets = other.m_buckets;
+		m_bitmap = std::move(other.m_bitmap);
+		m_old_bitmap = std::move(other.m_old_bitmap);
 		m_size = other.m_size;
 		m_mlf = other.m_mlf;
+		m_min_lf = other.m_min_lf;
+		m_seed = other.m_seed;
+		m_collision_count = other.m_collision_count;
+		m_reseed_threshold = other.m_reseed_threshold;
+		m_old_buckets = other.m_old_buckets;
+		m_old_bucket_count = other.m_old_bucket_count;
+		m_migrate_index = other.m_migrate_index;
+		m_incremental = other.m_incremental;
+		m_list_pool = std::move(other.m_list_pool);
+		m_tree_pool = std::move(other.m_tree_pool);
+		m_pool_group = std::move(other.m_pool_group);
 		m_hash = other.m_hash;
 		m_comp = other.m_comp;
 		m_equal = other.m_equal;
@@ -1236,57 +2531,62 @@ hash_table<T, cache, Hash, Comp, Pred>::operator=(hash_table&& other) noexcept {
 		other.m_buckets = nullptr;
 		other.m_size = 0;
 		other.m_mlf = DEFAULT_MLF;
+		other.m_min_lf = 0.0f;
+		other.m_old_buckets = nullptr;
+		other.m_old_bucket_count = 0;
+		other.m_migrate_index = 0;
 	}
+	return *this;
 }
 
-template<typename T, bool cache, typename Hash, typename Comp, typename Pred>
-hash_table<T, cache, Hash, Comp, Pred>::~hash_table() {
-	//clear();
+template<typename T, bool cache, typename Hash, typename Comp, typename Pred, typename Bucket>
+hash_table<T, cache, Hash, Comp, Pred, Bucket>::~hash_table() {
+	destroy_all();
 	deallocate_entry(m_buckets, m_bucket_count);
 }
 
 // emplace
-template<typename T, bool cache, typename Hash, typename Comp, typename Pred>
+template<typename T, bool cache, typename Hash, typename Comp, typename Pred, typename Bucket>
 template <typename... Args>
-typename hash_table<T, cache, Hash, Comp, Pred>::iterator 
-hash_table<T, cache, Hash, Comp, Pred>::emplace_multi(Args&& ...args) {
+typename hash_table<T, cache, Hash, Comp, Pred, Bucket>::iterator 
+hash_table<T, cache, Hash, Comp, Pred, Bucket>::emplace_multi(Args&& ...args) {
 	rehash_if(1);
 	//就像cpu里流水线一样，预测分支
 	//这里我们预测为插入链表节点
 	list_node_ptr newNode = create_list_node(std::forward<Args>(args)...);
 	size_t hashVal = 0;
 	if constexpr(cache) {
-		hashVal = newNode->hashVal;
+		hashVal = newNode->hash_val;
 	} else {
-		hashVal = m_hash(newNode->value);
+		hashVal = hash_of(newNode->value);
 	}
-	size_type index = get_bucket_index(hashVal);
+	size_type index = bucket_index(hashVal);
 	return insert_node_multi(index, newNode);
 }
 
-template<typename T, bool cache, typename Hash, typename Comp, typename Pred>
+template<typename T, bool cache, typename Hash, typename Comp, typename Pred, typename Bucket>
 template <typename... Args>
-std::pair<typename hash_table<T, cache, Hash, Comp, Pred>::iterator, bool> 
-hash_table<T, cache, Hash, Comp, Pred>::emplace_unique(Args&& ...args) {
+std::pair<typename hash_table<T, cache, Hash, Comp, Pred, Bucket>::iterator, bool> 
+hash_table<T, cache, Hash, Comp, Pred, Bucket>::emplace_unique(Args&& ...args) {
 	rehash_if(1);
 	list_node_ptr newNode = create_list_node(std::forward<Args>(args)...);
 	size_t hashVal = 0;
 	if constexpr(cache) {
 		hashVal = newNode->hash_val;
 	} else {
-		hashVal = m_hash(newNode->value);
+		hashVal = hash_of(newNode->value);
 	}
-	size_type index = get_bucket_index(hashVal); 
+	size_type index = bucket_index(hashVal); 
 	return insert_node_unique(index, newNode);
 }
 
 // insert
-template<typename T, bool cache, typename Hash, typename Comp, typename Pred>
-typename hash_table<T, cache, Hash, Comp, Pred>::iterator 
-hash_table<T, cache, Hash, Comp, Pred>::insert_multi_norehash(const value_type& value) {
-	size_t hashVal = m_hash(value);
-	size_type index = get_bucket_index(hashVal);
-	if (is_list(index)) {
+template<typename T, bool cache, typename Hash, typename Comp, typename Pred, typename Bucket>
+typename hash_table<T, cache, Hash, Comp, Pred, Bucket>::iterator 
+hash_table<T, cache, Hash, Comp, Pred, Bucket>::insert_multi_norehash(const value_type& value) {
+	size_t hashVal = hash_of(value);
+	size_type index = bucket_index(hashVal);
+	if (holds_list_nodes(index)) {
 		list_node_ptr newNode = create_list_node_nohash(value);
 		if constexpr(cache) {
 			newNode->hash_val = hashVal;
@@ -1301,12 +2601,12 @@ hash_table<T, cache, Hash, Comp, Pred>::insert_multi_norehash(const value_type&
 	}
 }
 
-template<typename T, bool cache, typename Hash, typename Comp, typename Pred>
-typename hash_table<T, cache, Hash, Comp, Pred>::iterator 
-hash_table<T, cache, Hash, Comp, Pred>::insert_multi_norehash(value_type&& value) {
-	size_t hashVal = m_hash(value);
-	size_type index = get_bucket_index(hashVal);
-	if (is_list(index)) {
+template<typename T, bool cache, typename Hash, typename Comp, typename Pred, typename Bucket>
+typename hash_table<T, cache, Hash, Comp, Pred, Bucket>::iterator 
+hash_table<T, cache, Hash, Comp, Pred, Bucket>::insert_multi_norehash(value_type&& value) {
+	size_t hashVal = hash_of(value);
+	size_type index = bucket_index(hashVal);
+	if (holds_list_nodes(index)) {
 		list_node_ptr newNode = create_list_node_nohash(std::move(value));
 		if constexpr(cache) {
 			newNode->hash_val = hashVal;
@@ -1321,12 +2621,12 @@ hash_table<T, cache, Hash, Comp, Pred>::insert_multi_norehash(value_type&& value
 	}
 }
 
-template<typename T, bool cache, typename Hash, typename Comp, typename Pred>
-std::pair<typename hash_table<T, cache, Hash, Comp, Pred>::iterator, bool> 
-hash_table<T, cache, Hash, Comp, Pred>::insert_unique_norehash(const value_type& value) {
-	size_t hashVal = m_hash(value);
-	size_type index = get_bucket_index(hashVal);
-	if (is_list(index)) {
+template<typename T, bool cache, typename Hash, typename Comp, typename Pred, typename Bucket>
+std::pair<typename hash_table<T, cache, Hash, Comp, Pred, Bucket>::iterator, bool> 
+hash_table<T, cache, Hash, Comp, Pred, Bucket>::insert_unique_norehash(const value_type& value) {
+	size_t hashVal = hash_of(value);
+	size_type index = bucket_index(hashVal);
+	if (holds_list_nodes(index)) {
 		list_node_ptr newNode = create_list_node_nohash(value);
 		if constexpr(cache) {
 			newNode->hash_val = hashVal;
@@ -1341,12 +2641,12 @@ hash_table<T, cache, Hash, Comp, Pred>::insert_unique_norehash(const value_type&
 	}
 }
 
-template<typename T, bool cache, typename Hash, typename Comp, typename Pred>
-std::pair<typename hash_table<T, cache, Hash, Comp, Pred>::iterator, bool> 
-hash_table<T, cache, Hash, Comp, Pred>::insert_unique_norehash(value_type&& value) {
-	size_t hashVal = m_hash(value);
-	size_type index = get_bucket_index(hashVal);
-	if (is_list(index)) {
+template<typename T, bool cache, typename Hash, typename Comp, typename Pred, typename Bucket>
+std::pair<typename hash_table<T, cache, Hash, Comp, Pred, Bucket>::iterator, bool> 
+hash_table<T, cache, Hash, Comp, Pred, Bucket>::insert_unique_norehash(value_type&& value) {
+	size_t hashVal = hash_of(value);
+	size_type index = bucket_index(hashVal);
+	if (holds_list_nodes(index)) {
 		list_node_ptr newNode = create_list_node_nohash(std::move(value));
 		if constexpr(cache) {
 			newNode->hash_val = hashVal;
@@ -1361,53 +2661,75 @@ hash_table<T, cache, Hash, Comp, Pred>::insert_unique_norehash(value_type&& valu
 	}
 }
 
-template<typename T, bool cache, typename Hash, typename Comp, typename Pred>
-typename hash_table<T, cache, Hash, Comp, Pred>::iterator 
-hash_table<T, cache, Hash, Comp, Pred>::insert_multi(const value_type& value) {
+template<typename T, bool cache, typename Hash, typename Comp, typename Pred, typename Bucket>
+typename hash_table<T, cache, Hash, Comp, Pred, Bucket>::iterator 
+hash_table<T, cache, Hash, Comp, Pred, Bucket>::insert_multi(const value_type& value) {
 	rehash_if(1);
 	return insert_multi_norehash(value);
 }
 
-template<typename T, bool cache, typename Hash, typename Comp, typename Pred>
-typename hash_table<T, cache, Hash, Comp, Pred>::iterator 
-hash_table<T, cache, Hash, Comp, Pred>::insert_multi(value_type&& value) {
+template<typename T, bool cache, typename Hash, typename Comp, typename Pred, typename Bucket>
+typename hash_table<T, cache, Hash, Comp, Pred, Bucket>::iterator 
+hash_table<T, cache, Hash, Comp, Pred, Bucket>::insert_multi(value_type&& value) {
 	rehash_if(1);
 	return insert_multi_norehash(std::move(value));
 }
 
-template<typename T, bool cache, typename Hash, typename Comp, typename Pred>
-std::pair<typename hash_table<T, cache, Hash, Comp, Pred>::iterator, bool> 
-hash_table<T, cache, Hash, Comp, Pred>::insert_unique(const value_type& value) {
+template<typename T, bool cache, typename Hash, typename Comp, typename Pred, typename Bucket>
+std::pair<typename hash_table<T, cache, Hash, Comp, Pred, Bucket>::iterator, bool> 
+hash_table<T, cache, Hash, Comp, Pred, Bucket>::insert_unique(const value_type& value) {
 	rehash_if(1);
 	return insert_unique_norehash(value);
 }
 
-template<typename T, bool cache, typename Hash, typename Comp, typename Pred>
-std::pair<typename hash_table<T, cache, Hash, Comp, Pred>::iterator, bool> 
-hash_table<T, cache, Hash, Comp, Pred>::insert_unique(value_type&& value) {
+template<typename T, bool cache, typename Hash, typename Comp, typename Pred, typename Bucket>
+std::pair<typename hash_table<T, cache, Hash, Comp, Pred, Bucket>::iterator, bool> 
+hash_table<T, cache, Hash, Comp, Pred, Bucket>::insert_unique(value_type&& value) {
 	rehash_if(1);
 	return insert_unique_norehash(std::move(value));
 }
 
-template<typename T, bool cache, typename Hash, typename Comp, typename Pred>
+template<typename T, bool cache, typename Hash, typename Comp, typename Pred, typename Bucket>
 template <std::input_iterator InputIter>
-void hash_table<T, cache, Hash, Comp, Pred>::insert_multi(InputIter first, InputIter last) {
+void hash_table<T, cache, Hash, Comp, Pred, Bucket>::insert_multi(InputIter first, InputIter last,
+		size_type threadCount) {
+	if constexpr(std::random_access_iterator<InputIter> && !INLINE_BUCKET) {
+		size_type n = static_cast<size_type>(last - first);
+		size_type threads = bulk_threads(n, threadCount);
+		if (threads > 1) {
+			bulk_insert(first, n, false, threads);
+			return;
+		}
+	} else {
+		static_cast<void>(threadCount);
+	}
 	for (; first != last; ++first) {
 		insert_multi(*first);
 	}
 }
 
-template<typename T, bool cache, typename Hash, typename Comp, typename Pred>
+template<typename T, bool cache, typename Hash, typename Comp, typename Pred, typename Bucket>
 template <std::input_iterator InputIter>
-void hash_table<T, cache, Hash, Comp, Pred>::insert_unique(InputIter first, InputIter last) {
+void hash_table<T, cache, Hash, Comp, Pred, Bucket>::insert_unique(InputIter first, InputIter last,
+		size_type threadCount) {
+	if constexpr(std::random_access_iterator<InputIter> && !INLINE_BUCKET) {
+		size_type n = static_cast<size_type>(last - first);
+		size_type threads = bulk_threads(n, threadCount);
+		if (threads > 1) {
+			bulk_insert(first, n, true, threads);
+			return;
+		}
+	} else {
+		static_cast<void>(threadCount);
+	}
 	for (; first != last; ++first) {
 		insert_unique(*first);
 	}
 }
 
 // erase
-template<typename T, bool cache, typename Hash, typename Comp, typename Pred>
-void hash_table<T, cache, Hash, Comp, Pred>::erase(const_iterator position) {
+template<typename T, bool cache, typename Hash, typename Comp, typename Pred, typename Bucket>
+void hash_table<T, cache, Hash, Comp, Pred, Bucket>::erase(const_iterator position) {
 	if (end() == position) {
 		return;
 	}
@@ -1415,105 +2737,378 @@ void hash_table<T, cache, Hash, Comp, Pred>::erase(const_iterator position) {
 	size_type index = position.bIndex;
 	entry_type entry = position.entry;
 	if (!entry.isnull()) {
-		if (is_list(index)) {
-			list_node_ptr head = m_buckets[index].as_list_node_ptr();
+		if (holds_list_nodes(index)) {
 			list_node_ptr node = position.entry.as_list_node_ptr(); //可以直接position.entry.list_node
-			if (head != node) {
-				list_node_ptr prev = nullptr;
-				while (head && head != node) {
-					prev = head;
-					head = next_of(head);
-				}
-				//assert next_of(head) == node
-				list_unlink_after(prev);
-			} else {
-				m_buckets[index] = next_of(head);
-			}
+			unlink_list_node(index, node);
 			destroy_node(node);
 		} else {
-			tree_node_ptr root = m_buckets[index].as_tree_node_ptr();
+			tree_node_ptr root = bucket_at(index).as_tree_node_ptr();
 			tree_node_ptr node = position.entry.as_tree_node_ptr(); //可以直接position.entry.tree_node
-			ht_tree_erase_node(node, &root);
-			m_buckets[index] = root;
-			destroy_node(node);
+			tree_node_ptr removed = ht_tree_erase_node(node, &root);
+			if constexpr(cache) {
+				if (removed != node) {
+					node->hash_val = removed->hash_val;
+				}
+			}
+			reset_tree_root(index, root);
+			destroy_node(removed);
 		}
 		--m_size;
 	}
 }
 
-template<typename T, bool cache, typename Hash, typename Comp, typename Pred>
-void hash_table<T, cache, Hash, Comp, Pred>::erase(const_iterator first, const_iterator last) {
+template<typename T, bool cache, typename Hash, typename Comp, typename Pred, typename Bucket>
+void hash_table<T, cache, Hash, Comp, Pred, Bucket>::unlink_list_node(size_type index, list_node_ptr node) {
+	if constexpr(SORTED_BUCKET) {
+		if (is_tree(index)) {
+			sorted_ptr array = sorted_at(index);
+			array->erase(array->position(node, m_comp));
+			if (0 == array->size) {
+				sorted_array::destroy(array);
+				bucket_at(index) = entry_type();
+				unmark(index);
+				vacate(index);
+			}
+			return;
+		}
+	}
+	list_node_ptr head = bucket_at(index).as_list_node_ptr();
+	if (head != node) {
+		list_node_ptr prev = nullptr;
+		while (head && head != node) {
+			prev = head;
+			head = next_of(head);
+		}
+		//assert next_of(prev) == node
+		list_unlink_after(prev);
+	} else {
+		bucket_at(index) = next_of(head);
+		if (bucket_at(index).isnull()) {
+			vacate(index);
+		}
+	}
+}
+
+template<typename T, bool cache, typename Hash, typename Comp, typename Pred, typename Bucket>
+void hash_table<T, cache, Hash, Comp, Pred, Bucket>::reset_tree_root(size_type index, tree_node_ptr root) {
+	if (root) {
+		bucket_at(index) = root;
+	} else {
+		bucket_at(index) = entry_type();
+		unmark(index);
+		vacate(index);
+	}
+}
+
+template<typename T, bool cache, typename Hash, typename Comp, typename Pred, typename Bucket>
+void hash_table<T, cache, Hash, Comp, Pred, Bucket>::erase(const_iterator first, const_iterator last) {
 	for (; first != last; ++first) {
 		erase(first);
 	}
 }
 
-template<typename T, bool cache, typename Hash, typename Comp, typename Pred>
-typename hash_table<T, cache, Hash, Comp, Pred>::size_type 
-hash_table<T, cache, Hash, Comp, Pred>::erase_multi(const key_type& key) {
+template<typename T, bool cache, typename Hash, typename Comp, typename Pred, typename Bucket>
+typename hash_table<T, cache, Hash, Comp, Pred, Bucket>::size_type 
+hash_table<T, cache, Hash, Comp, Pred, Bucket>::erase_multi(const key_type& key) {
+	if (m_old_buckets) {
+		migrate_step();
+	}
 	size_type n = 0;
 	while (true) {
 		iterator iter = find(key);
 		if (iter != end()) {
 			++n;
+			size_type index = iter.bIndex;
 			erase(iter);
+			untreefy_if(index);
 			continue;
 		}
 		break;
 	}
+	if (n) {
+		shrink_if();
+	}
 
 	return n;
 }
 
-template<typename T, bool cache, typename Hash, typename Comp, typename Pred>
-typename hash_table<T, cache, Hash, Comp, Pred>::size_type 
-hash_table<T, cache, Hash, Comp, Pred>::erase_unique(const key_type& key) {
+template<typename T, bool cache, typename Hash, typename Comp, typename Pred, typename Bucket>
+typename hash_table<T, cache, Hash, Comp, Pred, Bucket>::size_type 
+hash_table<T, cache, Hash, Comp, Pred, Bucket>::erase_unique(const key_type& key) {
+	if (m_old_buckets) {
+		migrate_step();
+	}
 	iterator iter = find(key);
 	if (iter != end()) {
+		size_type index = iter.bIndex;
 		erase(iter);
+		untreefy_if(index);
+		shrink_if();
 		return 1;
 	}
 
 	return 0;
 }
 
-template<typename T, bool cache, typename Hash, typename Comp, typename Pred>
-void hash_table<T, cache, Hash, Comp, Pred>::clear() {
-	for (size_type i = 0; i != m_bucket_count; ++i) {
-		if (is_tree(i)) {
-			clear_since(m_buckets[i].as_tree_node_ptr(), [this](tree_node_base* node){
-				destroy_node(static_cast<tree_node_ptr>(node));
-			});
-		} else {
-			clear_since(m_buckets[i].as_list_node_ptr(), [this](list_node_base* node){
-				destroy_node(static_cast<list_node_ptr>(node));
+template<typename T, bool cache, typename Hash, typename Comp, typename Pred, typename Bucket>
+void hash_table<T, cache, Hash, Comp, Pred, Bucket>::clear() {
+	destroy_all();
+	shrink_if();
+}
+
+template<typename T, bool cache, typename Hash, typename Comp, typename Pred, typename Bucket>
+void hash_table<T, cache, Hash, Comp, Pred, Bucket>::destroy_all() noexcept {
+	//只看非空的桶
+	for (size_type i = next_occupied(0); i != total_bucket_count(); i = next_occupied(i + 1)) {
+		if (m_pool_group) {
+			//节点可能还在组里别的表申请的slab上，逐个还给组的池，留给组里的表复用
+			unlink_bucket(i, [this](auto node) {
+				destroy_node(node);
 			});
+		} else if constexpr(SORTED_BUCKET) {
+			//节点的内存最后整块释放，这里只需要析构元素
+			if constexpr(!std::is_trivially_destructible_v<T>) {
+				clear_since(bucket_entry(i).as_list_node_ptr(), [](list_node_base* node){
+					destroy(&static_cast<list_node_ptr>(node)->value);
+				});
+			}
+			if (is_tree(i)) {
+				sorted_array::destroy(sorted_at(i));
+			}
+		} else if constexpr(!std::is_trivially_destructible_v<T>) {
+			if (is_tree(i)) {
+				clear_since(bucket_at(i).as_tree_node_ptr(), [](tree_node_base* node){
+					destroy(&static_cast<tree_node_ptr>(node)->value);
+				});
+			} else {
+				clear_since(bucket_at(i).as_list_node_ptr(), [](list_node_base* node){
+					destroy(&static_cast<list_node_ptr>(node)->value);
+				});
+			}
 		}
+		bucket_at(i) = entry_type();
+		unmark(i);
+	}
+	m_bitmap.reset();
+	if (!m_pool_group) {
+		m_list_pool.release();
+		m_tree_pool.release();
+	}
+	if (m_old_buckets) {
+		deallocate_entry(m_old_buckets, m_old_bucket_count);
+		m_old_buckets = nullptr;
+		m_old_bucket_count = 0;
+		m_migrate_index = 0;
+		m_old_bitmap = ht_bitmap();
 	}
 	m_size = 0;
 }
 
-template<typename T, bool cache, typename Hash, typename Comp, typename Pred>
-void hash_table<T, cache, Hash, Comp, Pred>::swap(hash_table& other) noexcept {
+template<typename T, bool cache, typename Hash, typename Comp, typename Pred, typename Bucket>
+void hash_table<T, cache, Hash, Comp, Pred, Bucket>::swap(hash_table& other) noexcept {
 	std::swap(m_buckets, other.m_buckets);
 	std::swap(m_bucket_count, other.m_bucket_count);
-#ifdef BIT32
-	std::swap(m_bitset, other.m_bitset);
-#endif //BIT32
+	m_bitmap.swap(other.m_bitmap);
 	std::swap(m_size, other.m_size);
+	std::swap(m_seed, other.m_seed);
+	std::swap(m_collision_count, other.m_collision_count);
+	std::swap(m_reseed_threshold, other.m_reseed_threshold);
+	std::swap(m_old_buckets, other.m_old_buckets);
+	std::swap(m_old_bucket_count, other.m_old_bucket_count);
+	std::swap(m_migrate_index, other.m_migrate_index);
+	m_old_bitmap.swap(other.m_old_bitmap);
+	std::swap(m_mlf, other.m_mlf);
+	std::swap(m_min_lf, other.m_min_lf);
+	std::swap(m_incremental, other.m_incremental);
+	m_list_pool.swap(other.m_list_pool);
+	m_tree_pool.swap(other.m_tree_pool);
+	m_pool_group.swap(other.m_pool_group);
+	std::swap(m_hash, other.m_hash);
+	std::swap(m_comp, other.m_comp);
+	std::swap(m_equal, other.m_equal);
+}
+
+// 节点
+template<typename T, bool cache, typename Hash, typename Comp, typename Pred, typename Bucket>
+typename hash_table<T, cache, Hash, Comp, Pred, Bucket>::node_type
+hash_table<T, cache, Hash, Comp, Pred, Bucket>::extract(const_iterator position) {
+	if (end() == position) {
+		return node_type();
+	}
+	ensure_pool_group();
+	return take_node(position);
+}
+
+template<typename T, bool cache, typename Hash, typename Comp, typename Pred, typename Bucket>
+typename hash_table<T, cache, Hash, Comp, Pred, Bucket>::node_type
+hash_table<T, cache, Hash, Comp, Pred, Bucket>::extract(const key_type& key) {
+	return extract(find(key));
+}
+
+template<typename T, bool cache, typename Hash, typename Comp, typename Pred, typename Bucket>
+typename hash_table<T, cache, Hash, Comp, Pred, Bucket>::insert_return_type
+hash_table<T, cache, Hash, Comp, Pred, Bucket>::insert_unique(node_type&& node) {
+	if (node.empty()) {
+		return { end(), false, node_type() };
+	}
+	adopt_seed(node.m_seed);
+	rehash_if(1);
+	size_t hashVal = adopted_hash(node);
+	size_type index = bucket_index(hashVal);
+	entry_type entry = find_in_bucket(index, hashVal, node.value());
+	if (!entry.isnull()) {
+		return { iterator(index, entry, this), false, std::move(node) };
+	}
+	join_pool_group(node.m_group);
+	iterator position = link_node(node, index, hashVal);
+	return { position, true, node_type() };
+}
+
+template<typename T, bool cache, typename Hash, typename Comp, typename Pred, typename Bucket>
+typename hash_table<T, cache, Hash, Comp, Pred, Bucket>::iterator
+hash_table<T, cache, Hash, Comp, Pred, Bucket>::insert_multi(node_type&& node) {
+	if (node.empty()) {
+		return end();
+	}
+	adopt_seed(node.m_seed);
+	rehash_if(1);
+	join_pool_group(node.m_group);
+	size_t hashVal = adopted_hash(node);
+	return link_node(node, bucket_index(hashVal), hashVal);
+}
+
+template<typename T, bool cache, typename Hash, typename Comp, typename Pred, typename Bucket>
+void hash_table<T, cache, Hash, Comp, Pred, Bucket>::merge_unique(hash_table& source) {
+	if (this == &source || source.empty()) {
+		return;
+	}
+	adopt_seed(source.m_seed);
+	source.ensure_pool_group();
+	join_pool_group(source.m_pool_group);
+	const_iterator iter = source.begin();
+	while (iter != source.end()) {
+		const_iterator next = iter;
+		++next;
+		//rehash_if可能换种子，要在算hash之前
+		rehash_if(1);
+		size_t hashVal = source.holds_list_nodes(iter.bIndex) ? 
+			adopted_hash(iter.entry.as_list_node_ptr(), source.m_seed) :
+			adopted_hash(iter.entry.as_tree_node_ptr(), source.m_seed);
+		size_type index = bucket_index(hashVal);
+		if (find_in_bucket(index, hashVal, *iter).isnull()) {
+			node_type node = source.take_node(iter);
+			link_node(node, index, hashVal);
+		}
+		iter = next;
+	}
+	if (reseed_needed()) {
+		reseed();
+	}
+}
+
+template<typename T, bool cache, typename Hash, typename Comp, typename Pred, typename Bucket>
+void hash_table<T, cache, Hash, Comp, Pred, Bucket>::merge_multi(hash_table& source) {
+	if (this == &source || source.empty()) {
+		return;
+	}
+	adopt_seed(source.m_seed);
+	source.ensure_pool_group();
+	join_pool_group(source.m_pool_group);
+	rehash_if(source.size());
+	//链表桶里摘的总是第一个节点，不用往后找前驱
+	const_iterator iter = source.begin();
+	while (iter != source.end()) {
+		const_iterator next = iter;
+		++next;
+		node_type node = source.take_node(iter);
+		size_t hashVal = adopted_hash(node);
+		link_node(node, bucket_index(hashVal), hashVal);
+		iter = next;
+	}
+	if (reseed_needed()) {
+		reseed();
+	}
+}
+
+template<typename T, bool cache, typename Hash, typename Comp, typename Pred, typename Bucket>
+void hash_table<T, cache, Hash, Comp, Pred, Bucket>::join_pool_group(const pool_group_ptr& group) {
+	ensure_pool_group();
+	pool_group_ptr root = group_root(m_pool_group);
+	const pool_group_ptr& other = group_root(group);
+	if (root != other) {
+		root->list_pool.merge(other->list_pool);
+		root->tree_pool.merge(other->tree_pool);
+		other->parent = root;
+	}
+	m_pool_group = std::move(root);
 }
 
-template<typename T, bool cache, typename Hash, typename Comp, typename Pred>
-typename hash_table<T, cache, Hash, Comp, Pred>::size_type
-hash_table<T, cache, Hash, Comp, Pred>::count_multi(const key_type& key) const {
-	size_t hashVal = m_hash(key);
-	size_type index = get_bucket_index(hashVal);
+template<typename T, bool cache, typename Hash, typename Comp, typename Pred, typename Bucket>
+typename hash_table<T, cache, Hash, Comp, Pred, Bucket>::node_type
+hash_table<T, cache, Hash, Comp, Pred, Bucket>::take_node(const_iterator position) {
+	node_type result;
+	size_type index = position.bIndex;
+	if (holds_list_nodes(index)) {
+		list_node_ptr node = position.entry.as_list_node_ptr();
+		list_node_ptr spare = nullptr;
+		if constexpr(INLINE_BUCKET) {
+			//桶自带的节点带不走，摘下来之前先申请好，申请失败时表还是原样
+			if (inline_index(node) != total_bucket_count()) {
+				spare = list_pool().allocate();
+			}
+		}
+		unlink_list_node(index, node);
+		if (spare) {
+			node = move_inline(node, spare);
+		}
+		node->next = nullptr;
+		result.m_list = node;
+	} else {
+		tree_node_ptr root = bucket_at(index).as_tree_node_ptr();
+		tree_node_ptr node = position.entry.as_tree_node_ptr();
+		ht_tree_extract_node(node, &root);
+		reset_tree_root(index, root);
+		node->left = node->right = node->parent = nullptr;
+		node->color = NodeColor::RED;
+		result.m_tree = node;
+	}
+	--m_size;
+	result.m_seed = m_seed;
+	result.m_group = m_pool_group;
+	return result;
+}
+
+template<typename T, bool cache, typename Hash, typename Comp, typename Pred, typename Bucket>
+typename hash_table<T, cache, Hash, Comp, Pred, Bucket>::iterator
+hash_table<T, cache, Hash, Comp, Pred, Bucket>::link_node(node_type& node, size_type index, size_t hashVal) {
+	list_node_ptr lnode = node.m_list;
+	tree_node_ptr tnode = node.m_tree;
+	node.m_list = nullptr;
+	node.m_tree = nullptr;
+	node.m_group.reset();
+	if (lnode) {
+		if constexpr(cache) {
+			lnode->hash_val = hashVal;
+		}
+		return insert_node_multi(index, lnode);
+	}
+	if constexpr(cache) {
+		tnode->hash_val = hashVal;
+	}
+	return insert_node_multi(index, tnode);
+}
+
+template<typename T, bool cache, typename Hash, typename Comp, typename Pred, typename Bucket>
+typename hash_table<T, cache, Hash, Comp, Pred, Bucket>::size_type
+hash_table<T, cache, Hash, Comp, Pred, Bucket>::count_multi(const key_type& key) const {
+	size_t hashVal = hash_of(key);
+	size_type index = bucket_index(hashVal);
 	size_type n = 0;
 
 	if (is_list(index)) {
-		list_node_ptr head = m_buckets[index].as_list_node_ptr();
+		list_node_ptr head = bucket_at(index).as_list_node_ptr();
 		while (head) {
-			if (m_equal(head->value, key)) {
+			if (node_equal(head, hashVal, key)) {
 				++n;
 				break;
 			}
@@ -1521,71 +3116,186 @@ hash_table<T, cache, Hash, Comp, Pred>::count_multi(const key_type& key) const {
 		}
 		if (head) {
 			head = next_of(head);
-			while (head && m_equal(head->value, key)) {
+			while (head && node_equal(head, hashVal, key)) {
 				++n;
 				head = next_of(head);	
 			}
 		}
+	} else if constexpr(SORTED_BUCKET) {
+		sorted_ptr array = sorted_at(index);
+		n = array->upper_bound(key, m_comp) - array->lower_bound(key, m_comp);
 	} else {
-		tree_node_ptr root = m_buckets[index].as_tree_node_ptr();
+		tree_node_ptr root = bucket_at(index).as_tree_node_ptr();
 		n = ht_tree_count_multi<T, cache, size_type, Comp>(key, root, m_comp);
 	}
 
 	return n;
 }
 
-template<typename T, bool cache, typename Hash, typename Comp, typename Pred>
-typename hash_table<T, cache, Hash, Comp, Pred>::iterator 
-hash_table<T, cache, Hash, Comp, Pred>::find(const key_type& key) {
-	size_t hashVal = m_hash(key);
-	size_type index = get_bucket_index(hashVal);
+/**
+ * @brief 在第index个桶里找key，找不到返回空的entry
+ */
+template<typename T, bool cache, typename Hash, typename Comp, typename Pred, typename Bucket>
+template<typename Key>
+typename hash_table<T, cache, Hash, Comp, Pred, Bucket>::entry_type 
+hash_table<T, cache, Hash, Comp, Pred, Bucket>::find_in_bucket(size_type index, size_t hashVal, const Key& key) const {
+	size_t probes = 0;	///< 看了几个节点，只在统计时用
 	if (is_list(index)) {
-		forward_list_node<T>* fnode = list_find_first_of(m_buckets[index].as_list_node_ptr(), key, m_equal);
-		list_node_ptr node = static_cast<list_node_ptr>(fnode);
-		return iterator(index, node, this);
+		list_node_ptr head = bucket_at(index).as_list_node_ptr();
+		while (head && !node_equal(head, hashVal, key)) {
+			head = next_of(head);
+			if constexpr(ht_stats_enabled) {
+				++probes;
+			}
+		}
+		m_counters.found(nullptr != head, head ? probes + 1 : probes);
+		return head;
+	} else if constexpr(SORTED_BUCKET) {
+		//和树一样按m_comp找，最后确认相等时hash值不同就不用再比较
+		sorted_ptr array = sorted_at(index);
+		size_type pos = array->lower_bound(key, m_comp, probes);
+		if (pos == array->size || !hash_matches(array->nodes()[pos], hashVal) || 
+				m_comp(key, array->key_at(pos))) {
+			m_counters.found(false, probes);
+			return entry_type();
+		}
+		m_counters.found(true, probes);
+		return array->nodes()[pos];
 	} else {
-		tree_node_ptr root = m_buckets[index].as_tree_node_ptr();
-		tree_node_ptr node = ht_tree_lbound(key, root, m_comp); //node->value >= key
-		if (m_comp(key, node->value)) { //not equal
-			node = nullptr;
+		//树按m_comp排序，往下走只能用m_comp，最后确认相等时hash值不同就不用再比较
+		tree_node_ptr root = bucket_at(index).as_tree_node_ptr();
+		tree_node_ptr node = nullptr;
+		if constexpr(ht_stats_enabled) {
+			node = ht_tree_lbound_key(key, root, m_comp, probes);
+		} else {
+			node = ht_tree_lbound_key(key, root, m_comp); //node->value >= key
+		}
+		if (nullptr == node || !hash_matches(node, hashVal) || m_comp(key, node->value)) { //not equal
+			m_counters.found(false, probes);
+			return entry_type();
 		} 
-		return iterator(index, node, this);
+		m_counters.found(true, probes);
+		return node;
 	}
 }
 
-template<typename T, bool cache, typename Hash, typename Comp, typename Pred>
-typename hash_table<T, cache, Hash, Comp, Pred>::const_iterator 
-hash_table<T, cache, Hash, Comp, Pred>::find(const key_type& key) const {
-	size_t hashVal = m_hash(key);
-	size_type index = get_bucket_index(hashVal);
-	if (is_list(index)) {
-		list_node_ptr node = list_find_first_of(m_buckets[index].as_list_node_ptr(), key, m_equal);
-		return const_iterator(index, node, this);
-	} else {
-		tree_node_ptr root = m_buckets[index].as_tree_node_ptr();
-		tree_node_ptr node = ht_tree_lbound(key, root, m_comp); //node->value >= key
-		if (m_comp(key, node->value)) { //not equal
-			node = nullptr;
-		} 
-		return const_iterator(index, node, this);
+template<typename T, bool cache, typename Hash, typename Comp, typename Pred, typename Bucket>
+typename hash_table<T, cache, Hash, Comp, Pred, Bucket>::iterator 
+hash_table<T, cache, Hash, Comp, Pred, Bucket>::find(const key_type& key) {
+	size_t hashVal = hash_of(key);
+	size_type index = bucket_index(hashVal);
+	return iterator(index, find_in_bucket(index, hashVal, key), this);
+}
+
+template<typename T, bool cache, typename Hash, typename Comp, typename Pred, typename Bucket>
+typename hash_table<T, cache, Hash, Comp, Pred, Bucket>::const_iterator 
+hash_table<T, cache, Hash, Comp, Pred, Bucket>::find(const key_type& key) const {
+	size_t hashVal = hash_of(key);
+	size_type index = bucket_index(hashVal);
+	return const_iterator(index, find_in_bucket(index, hashVal, key), 
+		const_cast<hash_table<T, cache, Hash, Comp, Pred, Bucket>*>(this));
+}
+
+template<typename T, bool cache, typename Hash, typename Comp, typename Pred, typename Bucket>
+template<typename Key, typename... Args>
+std::pair<typename hash_table<T, cache, Hash, Comp, Pred, Bucket>::iterator, bool> 
+hash_table<T, cache, Hash, Comp, Pred, Bucket>::try_emplace_unique(const Key& key, Args&&... args) {
+	size_t hashVal = hash_of(key);
+	size_type index = bucket_index(hashVal);
+	entry_type entry = find_in_bucket(index, hashVal, key);
+	if (!entry.isnull()) {
+		return { iterator(index, entry, this), false };
 	}
+	//扩容或者换种子之后桶的位置变了
+	rehash_if(1);
+	hashVal = hash_of(key);
+	index = bucket_index(hashVal);
+	list_node_ptr newNode = create_list_node_nohash(std::forward<Args>(args)...);
+	if constexpr(cache) {
+		newNode->hash_val = hashVal;
+	}
+	return { insert_node_multi(index, newNode), true };
 }
 
-template<typename T, bool cache, typename Hash, typename Comp, typename Pred>
-std::pair<typename hash_table<T, cache, Hash, Comp, Pred>::iterator, 
-		typename hash_table<T, cache, Hash, Comp, Pred>::iterator> 
-hash_table<T, cache, Hash, Comp, Pred>::equal_range_multi(const key_type& key) {
-	size_t hashVal = m_hash(key);
-	size_type index = get_bucket_index(hashVal);
+/**
+ * @brief 分三步，每一步都只发出内存访问而不等结果:
+ * 		  1. 算hash，预取桶(渐进式rehash时新旧桶都预取)
+ * 		  2. 桶已经在cache里了，预取桶里的第一个节点
+ * 		  3. 逐个比较，对每个key调用f(i, index, entry)
+ */
+template<typename T, bool cache, typename Hash, typename Comp, typename Pred, typename Bucket>
+template<typename Func>
+void hash_table<T, cache, Hash, Comp, Pred, Bucket>::lookup_batch(const key_type* keys, 
+		size_type n, const Func& f) const {
+	size_t hashVals[BATCH_SIZE];
+	size_type indexes[BATCH_SIZE];
+	for (size_type first = 0; first < n; first += BATCH_SIZE) {
+		size_type count = std::min(BATCH_SIZE, n - first);
+		for (size_type i = 0; i != count; ++i) {
+			hashVals[i] = hash_of(keys[first + i]);
+			NANO_PREFETCH(m_buckets + get_bucket_index(hashVals[i]));
+			if (m_old_buckets) {
+				NANO_PREFETCH(m_old_buckets + (hashVals[i] & (m_old_bucket_count - 1)));
+			}
+		}
+		for (size_type i = 0; i != count; ++i) {
+			indexes[i] = bucket_index(hashVals[i]);
+			entry_type& entry = bucket_at(indexes[i]);
+			if (!entry.isnull()) {
+				if (is_list(indexes[i])) {
+					NANO_PREFETCH(entry.as_list_node_ptr());
+				} else {
+					NANO_PREFETCH(entry.as_tree_node_ptr());
+				}
+			}
+		}
+		for (size_type i = 0; i != count; ++i) {
+			f(first + i, indexes[i], find_in_bucket(indexes[i], hashVals[i], keys[first + i]));
+		}
+	}
+}
+
+template<typename T, bool cache, typename Hash, typename Comp, typename Pred, typename Bucket>
+void hash_table<T, cache, Hash, Comp, Pred, Bucket>::find_batch(const key_type* keys, 
+		size_type n, iterator* out) {
+	lookup_batch(keys, n, [this, out](size_type i, size_type index, entry_type entry) {
+		out[i] = iterator(index, entry, this);
+	});
+}
+
+template<typename T, bool cache, typename Hash, typename Comp, typename Pred, typename Bucket>
+void hash_table<T, cache, Hash, Comp, Pred, Bucket>::find_batch(const key_type* keys, 
+		size_type n, const_iterator* out) const {
+	lookup_batch(keys, n, [this, out](size_type i, size_type index, entry_type entry) {
+		out[i] = const_iterator(index, entry, 
+			const_cast<hash_table<T, cache, Hash, Comp, Pred, Bucket>*>(this));
+	});
+}
+
+template<typename T, bool cache, typename Hash, typename Comp, typename Pred, typename Bucket>
+void hash_table<T, cache, Hash, Comp, Pred, Bucket>::contains_batch(const key_type* keys, 
+		size_type n, bool* out) const {
+	lookup_batch(keys, n, [out](size_type i, size_type, entry_type entry) {
+		out[i] = !entry.isnull();
+	});
+}
+
+template<typename T, bool cache, typename Hash, typename Comp, typename Pred, typename Bucket>
+std::pair<typename hash_table<T, cache, Hash, Comp, Pred, Bucket>::iterator, 
+		typename hash_table<T, cache, Hash, Comp, Pred, Bucket>::iterator> 
+hash_table<T, cache, Hash, Comp, Pred, Bucket>::equal_range_multi(const key_type& key) {
+	size_t hashVal = hash_of(key);
+	size_type index = bucket_index(hashVal);
 	if (is_list(index)) {
-		list_node_ptr head = m_buckets[index].as_list_node_ptr();
+		list_node_ptr head = bucket_at(index).as_list_node_ptr();
 		while (head) {
-			if (m_equal(key, head->value)) {
+			if (node_equal(head, hashVal, key)) {
 				list_node_ptr last = next_of(head);
 				while (last) {
-					if (!m_equal(key, last->value)) { //找到不相等的位置
+					if (!node_equal(last, hashVal, key)) { //找到不相等的位置
 						return { iterator(index, head, this), iterator(index, last, this) };
 					}
+					last = next_of(last);
 				}
 				//剩余整条链表都和key相等, 找到下一个entry
 				size_type nextIndex = next_bucket(index);
@@ -1596,16 +3306,31 @@ hash_table<T, cache, Hash, Comp, Pred>::equal_range_multi(const key_type& key) {
 			}
 			head = next_of(head);
 		}
+	} else if constexpr(SORTED_BUCKET) {
+		sorted_ptr array = sorted_at(index);
+		size_type first = array->lower_bound(key, m_comp);
+		size_type last = array->upper_bound(key, m_comp);
+		if (first != last) {
+			if (last != array->size) {
+				return { iterator(index, array->nodes()[first], this),
+						iterator(index, array->nodes()[last], this) };
+			}
+			size_type nextIndex = next_occupied(index + 1);
+			return { iterator(index, array->nodes()[first], this),
+					iterator(nextIndex, bucket_entry(nextIndex), this) };
+		}
 	} else {
-		tree_node_ptr root = m_buckets[index].as_tree_node_ptr();
+		tree_node_ptr root = bucket_at(index).as_tree_node_ptr();
 		std::pair<tree_node_ptr, tree_node_ptr> myPair = ht_tree_equal_range_multi(key, root, m_comp);
-		if (myPair.first) {
+		if (myPair.first && !m_comp(key, myPair.first->value)) {
 			if (myPair.second) {
 				return { iterator(index, myPair.first, this),
 						iterator(index, myPair.second, this) };
-			} else {
-				return { iterator(index, myPair.first, this), end() };
 			}
+			//树里剩下的都和key相等，后面是下一个桶
+			size_type nextIndex = next_occupied(index + 1);
+			return { iterator(index, myPair.first, this),
+					iterator(nextIndex, bucket_entry(nextIndex), this) };
 		}
 	}
 
@@ -1613,25 +3338,26 @@ hash_table<T, cache, Hash, Comp, Pred>::equal_range_multi(const key_type& key) {
 	return { end(), end() }; 
 }
 
-template<typename T, bool cache, typename Hash, typename Comp, typename Pred>
-std::pair<typename hash_table<T, cache, Hash, Comp, Pred>::const_iterator, 
-		typename hash_table<T, cache, Hash, Comp, Pred>::const_iterator> 
-hash_table<T, cache, Hash, Comp, Pred>::equal_range_multi(const key_type& key) const {
-	size_t hashVal = m_hash(key);
-	size_type index = get_bucket_index(hashVal);
+template<typename T, bool cache, typename Hash, typename Comp, typename Pred, typename Bucket>
+std::pair<typename hash_table<T, cache, Hash, Comp, Pred, Bucket>::const_iterator, 
+		typename hash_table<T, cache, Hash, Comp, Pred, Bucket>::const_iterator> 
+hash_table<T, cache, Hash, Comp, Pred, Bucket>::equal_range_multi(const key_type& key) const {
+	size_t hashVal = hash_of(key);
+	size_type index = bucket_index(hashVal);
 	if (is_list(index)) {
-		list_node_ptr head = m_buckets[index].as_list_node_ptr();
+		list_node_ptr head = bucket_at(index).as_list_node_ptr();
 		while (head) {
-			if (m_equal(key, head->value)) {
+			if (node_equal(head, hashVal, key)) {
 				list_node_ptr last = next_of(head);
 				while (last) {
-					if (!m_equal(key, last->value)) { //找到不相等的位置
+					if (!node_equal(last, hashVal, key)) { //找到不相等的位置
 						return { const_iterator(index, head, this), 
 								const_iterator(index, last, this) };
 					}
+					last = next_of(last);
 				}
 				//剩余整条链表都和key相等, 找到下一个entry
-				size_type nextIndex = next_bucket(index);
+				size_type nextIndex = next_occupied(index + 1);
 				entry_type nextEntry = bucket_entry(nextIndex);
 				//没有后继了
 				return { const_iterator(index, head, this), 
@@ -1639,16 +3365,31 @@ hash_table<T, cache, Hash, Comp, Pred>::equal_range_multi(const key_type& key) c
 			}
 			head = next_of(head);
 		}
+	} else if constexpr(SORTED_BUCKET) {
+		sorted_ptr array = sorted_at(index);
+		size_type first = array->lower_bound(key, m_comp);
+		size_type last = array->upper_bound(key, m_comp);
+		if (first != last) {
+			if (last != array->size) {
+				return { const_iterator(index, array->nodes()[first], this),
+						const_iterator(index, array->nodes()[last], this) };
+			}
+			size_type nextIndex = next_occupied(index + 1);
+			return { const_iterator(index, array->nodes()[first], this),
+					const_iterator(nextIndex, bucket_entry(nextIndex), this) };
+		}
 	} else {
-		tree_node_ptr root = m_buckets[index].as_tree_node_ptr();
+		tree_node_ptr root = bucket_at(index).as_tree_node_ptr();
 		std::pair<tree_node_ptr, tree_node_ptr> myPair = ht_tree_equal_range_multi(key, root, m_comp);
-		if (myPair.first) {
+		if (myPair.first && !m_comp(key, myPair.first->value)) {
 			if (myPair.second) {
 				return { const_iterator(index, myPair.first, this),
 						const_iterator(index, myPair.second, this) };
-			} else {
-				return { const_iterator(index, myPair.first, this), end() };
 			}
+			//树里剩下的都和key相等，后面是下一个桶
+			size_type nextIndex = next_occupied(index + 1);
+			return { const_iterator(index, myPair.first, this),
+					const_iterator(nextIndex, bucket_entry(nextIndex), this) };
 		}
 	}
 
@@ -1656,10 +3397,10 @@ hash_table<T, cache, Hash, Comp, Pred>::equal_range_multi(const key_type& key) c
 	return { end(), end() };  
 }
 
-template<typename T, bool cache, typename Hash, typename Comp, typename Pred>
-std::pair<typename hash_table<T, cache, Hash, Comp, Pred>::iterator, 
-		typename hash_table<T, cache, Hash, Comp, Pred>::iterator> 
-hash_table<T, cache, Hash, Comp, Pred>::equal_range_unique(const key_type& key) {
+template<typename T, bool cache, typename Hash, typename Comp, typename Pred, typename Bucket>
+std::pair<typename hash_table<T, cache, Hash, Comp, Pred, Bucket>::iterator, 
+		typename hash_table<T, cache, Hash, Comp, Pred, Bucket>::iterator> 
+hash_table<T, cache, Hash, Comp, Pred, Bucket>::equal_range_unique(const key_type& key) {
 	iterator iter = lower_bound(key);
 	iterator nextIter = iter;
 	if (iter != end()) {
@@ -1669,10 +3410,10 @@ hash_table<T, cache, Hash, Comp, Pred>::equal_range_unique(const key_type& key)
 	return { iter, nextIter };
 }
 
-template<typename T, bool cache, typename Hash, typename Comp, typename Pred>
-std::pair<typename hash_table<T, cache, Hash, Comp, Pred>::const_iterator, 
-		typename hash_table<T, cache, Hash, Comp, Pred>::const_iterator> 
-hash_table<T, cache, Hash, Comp, Pred>::equal_range_unique(const key_type& key) const {
+template<typename T, bool cache, typename Hash, typename Comp, typename Pred, typename Bucket>
+std::pair<typename hash_table<T, cache, Hash, Comp, Pred, Bucket>::const_iterator, 
+		typename hash_table<T, cache, Hash, Comp, Pred, Bucket>::const_iterator> 
+hash_table<T, cache, Hash, Comp, Pred, Bucket>::equal_range_unique(const key_type& key) const {
 	const_iterator iter = lower_bound(key);
 	const_iterator nextIter = iter;
 	if (iter != end()) {
@@ -1682,98 +3423,796 @@ hash_table<T, cache, Hash, Comp, Pred>::equal_range_unique(const key_type& key)
 	return { iter, nextIter };
 }
 
-template<typename T, bool cache, typename Hash, typename Comp, typename Pred>
-typename hash_table<T, cache, Hash, Comp, Pred>::size_type 
-hash_table<T, cache, Hash, Comp, Pred>::bucket(const key_type& key) {
-	size_type hashVal = m_hash(key);
+template<typename T, bool cache, typename Hash, typename Comp, typename Pred, typename Bucket>
+typename hash_table<T, cache, Hash, Comp, Pred, Bucket>::size_type 
+hash_table<T, cache, Hash, Comp, Pred, Bucket>::bucket(const key_type& key) {
+	size_type hashVal = hash_of(key);
 	return get_bucket_index(hashVal);
 }
 
-template<typename T, bool cache, typename Hash, typename Comp, typename Pred>
-void hash_table<T, cache, Hash, Comp, Pred>::rehash(size_type count) {
-	hash_table<T, cache, Hash, Comp, Pred> other(count, m_hash, m_comp, m_equal);
-	if (other.bucket_count() <= bucket_count()) {
+template<typename T, bool cache, typename Hash, typename Comp, typename Pred, typename Bucket>
+template<typename Encoder>
+void hash_table<T, cache, Hash, Comp, Pred, Bucket>::save(const char* path, const Encoder& encoder) const {
+	using record_type = typename Encoder::record_type;
+	static_assert(std::is_trivially_copyable_v<record_type>, "records are written to the file as is");
+	if (m_size >= UINT32_MAX) {
+		throw std::length_error("hash_table::save: too many elements");
+	}
+	//按新桶数组的下标写，旧桶里还没搬走的元素也归到它在新数组里的桶。
+	//新桶b里的元素可能在旧桶b & (step - 1) + k * step里，要重新算hash挑出来
+	size_type step = std::min(m_old_bucket_count, m_bucket_count);
+	auto visit_new_bucket = [this, step](size_type b, const auto& f) {
+		visit_bucket(b, [&f](auto node) { f(&node->value); });
+		for (size_type j = b & (step - 1); j < m_old_bucket_count; j += step) {
+			visit_bucket(m_bucket_count + j, [this, b, &f](auto node) {
+				if (get_bucket_index(hash_of(node->value)) == b) {
+					f(&node->value);
+				}
+			});
+		}
+	};
+	//第一遍只数每个桶有几个元素，算出offsets
+	std::vector<uint32_t> offsets(m_bucket_count + 1, 0);
+	for (size_type b = 0; b < m_bucket_count; ++b) {
+		uint32_t count = 0;
+		visit_new_bucket(b, [&count](const_pointer) { ++count; });
+		offsets[b + 1] = offsets[b] + count;
+	}
+
+	ht_snapshot_header header{};
+	memcpy(header.magic, ht_snapshot_header::MAGIC, sizeof(header.magic));
+	header.version = ht_snapshot_header::VERSION;
+	header.byte_order = ht_snapshot_header::BYTE_ORDER_MARK;
+	header.record_size = sizeof(record_type);
+	header.sorted_threshold = TREEFY_THRESHOLD;
+	header.bucket_count = m_bucket_count;
+	header.size = m_size;
+	header.seed = m_seed;
+	header.max_load_factor = m_mlf;
+	header.offsets_offset = sizeof(header);
+	uint64_t offsetsEnd = header.offsets_offset + offsets.size() * sizeof(uint32_t);
+	//records按cache line对齐，mmap的起始地址是页对齐的
+	constexpr uint64_t align = std::max<uint64_t>(NANO_CACHE_LINE_SIZE, alignof(record_type));
+	header.records_offset = (offsetsEnd + align - 1) / align * align;
+	header.blob_offset = header.records_offset + m_size * sizeof(record_type);
+
+	//先写临时文件，写完了再换掉path，中途失败时path还是原来的文件
+	atomic_file file(path);
+	file.write_at(header.offsets_offset, offsets.data(), offsets.size() * sizeof(uint32_t));
+	const char padding[align] = {};
+	file.write_at(offsetsEnd, padding, header.records_offset - offsetsEnd);
+	//第二遍一个桶一个桶地编码，records和blob攒够一批就写出去，不把所有元素都留在内存里
+	constexpr size_t chunk = 1 << 20;
+	std::vector<const_pointer> bucketValues;
+	std::vector<record_type> records;
+	ht_blob_writer blob;
+	uint64_t recordsWritten = 0;
+	auto flush_records = [&file, &header, &records, &recordsWritten]() {
+		file.write_at(header.records_offset + recordsWritten * sizeof(record_type),
+			records.data(), records.size() * sizeof(record_type));
+		recordsWritten += records.size();
+		records.clear();
+	};
+	auto flush_blob = [&file, &header, &blob]() {
+		file.write_at(header.blob_offset + blob.size() - blob.buffer().size(),
+			blob.buffer().data(), blob.buffer().size());
+		blob.flushed();
+	};
+	for (size_type b = 0; b < m_bucket_count; ++b) {
+		if (offsets[b] == offsets[b + 1]) {
+			continue;
+		}
+		bucketValues.clear();
+		visit_new_bucket(b, [&bucketValues](const_pointer value) { bucketValues.push_back(value); });
+		//和树桶一样，长的桶排好序，查找时二分
+		if (bucketValues.size() >= TREEFY_THRESHOLD) {
+			std::sort(bucketValues.begin(), bucketValues.end(),
+				[this](const_pointer lhs, const_pointer rhs) { return m_comp(*lhs, *rhs); });
+		}
+		for (const_pointer value : bucketValues) {
+			records.push_back(encoder.encode(*value, blob));
+		}
+		if (records.size() * sizeof(record_type) >= chunk) {
+			flush_records();
+		}
+		if (blob.buffer().size() >= chunk) {
+			flush_blob();
+		}
+	}
+	flush_records();
+	flush_blob();
+	header.blob_size = blob.size();
+	//文件头最后写，之前失败的话临时文件会被删掉
+	file.write_at(0, &header, sizeof(header));
+	file.commit();
+}
+
+template<typename T, bool cache, typename Hash, typename Comp, typename Pred, typename Bucket>
+void hash_table<T, cache, Hash, Comp, Pred, Bucket>::rehash(size_type count, size_type threadCount) {
+	finish_migration();
+	count = ceil_power_of_2(count);
+	if (count <= bucket_count()) {
+		return;
+	}
+	relink(count, false, threadCount);
+}
+
+template<typename T, bool cache, typename Hash, typename Comp, typename Pred, typename Bucket>
+void hash_table<T, cache, Hash, Comp, Pred, Bucket>::shrink_to_fit(size_type threadCount) {
+	finish_migration();
+	size_type count = fit_bucket_count(m_size);
+	if (count < m_bucket_count) {
+		relink(count, false, threadCount);
+	}
+}
+
+template<typename T, bool cache, typename Hash, typename Comp, typename Pred, typename Bucket>
+void hash_table<T, cache, Hash, Comp, Pred, Bucket>::shrink_if() {
+	float minLf = std::min(m_min_lf, m_mlf / 4);
+	if (static_cast<float>(m_size) >= static_cast<float>(m_bucket_count) * minLf) {
+		return;
+	}
+	//缩到负载因子不超过一半，元素已经很少了，一次搬完
+	size_type count = fit_bucket_count(m_size * 2);
+	if (count < m_bucket_count) {
+		finish_migration();
+		relink(count, false);
+	}
+}
+
+template<typename T, bool cache, typename Hash, typename Comp, typename Pred, typename Bucket>
+void hash_table<T, cache, Hash, Comp, Pred, Bucket>::reseed() {
+	finish_migration();
+	m_seed = random_seed();
+	relink(m_bucket_count, true);
+	m_collision_count = 0;
+	m_reseed_threshold *= 2;
+}
+
+template<typename T, bool cache, typename Hash, typename Comp, typename Pred, typename Bucket>
+void hash_table<T, cache, Hash, Comp, Pred, Bucket>::hash_seed(size_t seed) {
+	if (seed == m_seed) {
+		return;
+	}
+	finish_migration();
+	m_seed = seed;
+	if (m_size) {
+		relink(m_bucket_count, true);
+	}
+}
+
+/**
+ * @brief 把第index个桶里的节点一个个摘下来交给f，摘完之后桶还要调用者清空
+ */
+template<typename T, bool cache, typename Hash, typename Comp, typename Pred, typename Bucket>
+template<typename Func>
+void hash_table<T, cache, Hash, Comp, Pred, Bucket>::unlink_bucket(size_type index, const Func& f) {
+	if (bucket_at(index).isnull()) {
+		return;
+	}
+	if (is_list(index)) {
+		list_node_ptr head = bucket_at(index).as_list_node_ptr();
+		while (next_of(head)) {
+			f(list_unlink_after(head));
+		}
+		f(head);
+	} else if constexpr(SORTED_BUCKET) {
+		sorted_ptr array = sorted_at(index);
+		list_node_ptr head = array->nodes()[0];
+		sorted_array::destroy(array);
+		while (head) {
+			list_node_ptr next = next_of(head);
+			head->next = nullptr;
+			f(head);
+			head = next;
+		}
+	} else {
+		tree_node_ptr root = bucket_at(index).as_tree_node_ptr();
+		postorder(root, [&f](tree_node_base* node) {
+			tree_node_base* parent = parent_of(node);
+			if (parent) {
+				if (node == parent->left) {
+					parent->left = nullptr;
+				} else {
+					parent->right = nullptr;
+				}
+				node->parent = nullptr;
+			}
+			//摘下来的节点当作新节点插入，不然插到别的树里时带着黑色，树会失衡
+			static_cast<tree_node_ptr>(node)->color = NodeColor::RED;
+			f(static_cast<tree_node_ptr>(node));
+		});
+	}
+}
+
+/**
+ * @brief 不摘节点，按unlink_bucket摘节点的顺序把第index个桶里的节点交给f
+ */
+template<typename T, bool cache, typename Hash, typename Comp, typename Pred, typename Bucket>
+template<typename Func>
+void hash_table<T, cache, Hash, Comp, Pred, Bucket>::visit_bucket(size_type index, const Func& f) const {
+	if (bucket_at(index).isnull()) {
 		return;
 	}
+	if (is_list(index)) {
+		list_node_ptr head = bucket_at(index).as_list_node_ptr();
+		for (list_node_ptr node = next_of(head); node; node = next_of(node)) {
+			f(node);
+		}
+		f(head);
+	} else if constexpr(SORTED_BUCKET) {
+		for (list_node_ptr node = sorted_at(index)->nodes()[0]; node; node = next_of(node)) {
+			f(node);
+		}
+	} else {
+		postorder(bucket_at(index).as_tree_node_ptr(), [&f](tree_node_base* node) {
+			f(static_cast<tree_node_ptr>(node));
+		});
+	}
+}
 
+/**
+ * @brief 把所有节点重新挂到bucketCount个桶上，不重新申请节点
+ * @param rehashValue 为true表示种子变了，要重新计算hash值(包括缓存的hash值)
+ */
+template<typename T, bool cache, typename Hash, typename Comp, typename Pred, typename Bucket>
+void hash_table<T, cache, Hash, Comp, Pred, Bucket>::relink(size_type bucketCount, bool rehashValue,
+		size_type threadCount) {
+	typename ht_counters<>::rehash_timer timer(m_counters, true);
+	if constexpr(!INLINE_BUCKET) {
+		size_type threads = bulk_threads(m_size, threadCount);
+		if (threads > 1) {
+			relink_parallel(bucketCount, rehashValue, threads);
+			return;
+		}
+	} else {
+		static_cast<void>(threadCount);
+	}
+	hash_table<T, cache, Hash, Comp, Pred, Bucket> other(bucketCount, m_hash, m_comp, m_equal);
 	other.max_load_factor(m_mlf);
+	other.m_seed = m_seed;
 
-	for (size_type i = 0; i != m_bucket_count; ++i) {
-		if (!m_buckets[i].isnull()) {
-			if (is_list(i)) {
-				list_node_ptr head = m_buckets[i].as_list_node_ptr();
-				size_t hashVal = 0;
-				size_type index = 0;
+	auto relink_node = [this, &other, rehashValue](auto* node) {
+		node = evict_inline(node);
+		if constexpr(cache) {
+			if (rehashValue) {
+				node->hash_val = hash_of(node->value);
+			}
+		} else {
+			static_cast<void>(rehashValue);
+		}
+		//这里不用担心unique的情况
+		//因为如果为unique，在rehash之前能保证容器里元素唯一
+		//insert_multi也没关系
+		other.insert_node_multi(other.get_bucket_index(hash_of_node(node)), node);
+	};
+	for (size_type i = m_bitmap.next(0); i != m_bucket_count; i = m_bitmap.next(i + 1)) {
+		unlink_bucket(i, relink_node);
+	}
+	//树化、退化时other会从自己的池里申请节点，这些节点现在归this了
+	list_pool().merge(other.m_list_pool);
+	tree_pool().merge(other.m_tree_pool);
+	m_counters.add(other.m_counters);
 
-				while (next_of(head)) {
-					list_node_ptr node = list_unlink_after(head);
-					if constexpr(cache) {
-						hashVal = node->hash_val;
-					} else {
-						hashVal = m_hash(node->value);
+	deallocate_entry(m_buckets, m_bucket_count);
+	m_buckets = other.m_buckets;
+	m_bucket_count = other.m_bucket_count;
+	m_bitmap = std::move(other.m_bitmap);
+	other.m_buckets = nullptr;
+	other.m_bucket_count = 0;
+	other.m_size = 0;
+}
+
+template<typename T, bool cache, typename Hash, typename Comp, typename Pred, typename Bucket>
+template<typename Func>
+void hash_table<T, cache, Hash, Comp, Pred, Bucket>::run_parallel(size_type threadCount, const Func& f) {
+	std::vector<std::thread> threads;
+	threads.reserve(threadCount);
+	for (size_type t = 1; t < threadCount; ++t) {
+		try {
+			threads.emplace_back([&f, t]() { f(t); });
+		} catch (const std::system_error&) {
+			f(t);
+		}
+	}
+	//当前线程也干活
+	f(0);
+	for (std::thread& thread : threads) {
+		thread.join();
+	}
+}
+
+template<typename T, bool cache, typename Hash, typename Comp, typename Pred, typename Bucket>
+void hash_table<T, cache, Hash, Comp, Pred, Bucket>::bulk_link(bulk_context& ctx, size_type index,
+		list_node_ptr node, bool unique) {
+	if (bucket_at(index).isnull()) {
+		node->next = nullptr;
+		bucket_at(index) = node;
+		occupy(index);
+		++ctx.size;
+		return;
+	}
+	if constexpr(SORTED_BUCKET) {
+		if (is_tree(index)) {
+			try {
+				if (!sorted_link(index, node, unique).second) {
+					destroy(&node->value);
+					ctx.list_pool.deallocate(node);
+					return;
+				}
+				++ctx.size;
+				++ctx.collision_count;
+				return;
+			} catch (const std::bad_alloc&) {
+				//数组扩容失败就退化成链表，节点还是挂得上
+				untreefy(index);
+			}
+		}
+	} else if (is_tree(index)) {
+		//申请不到树节点就把桶退化成链表再挂。rehash时这个线程之前把链表节点换成树节点，
+		//还回池里的链表节点一定够用；bulk_insert时也申请不到就释放node再抛出异常
+		try {
+			ctx.tree_pool.reserve(1);
+		} catch (const std::bad_alloc&) {
+			try {
+				untreefy(index, ctx);
+			} catch (...) {
+				destroy(&node->value);
+				ctx.list_pool.deallocate(node);
+				throw;
+			}
+		}
+	}
+	if (is_tree(index)) {
+		tree_node_ptr tnode = listNode2TreeNode(node, ctx);
+		tree_node_ptr root = bucket_at(index).as_tree_node_ptr();
+		if (unique) {
+			if (!ht_tree_insert_node_unique(tnode, &root, m_comp).second) {
+				destroy(&tnode->value);
+				ctx.tree_pool.deallocate(tnode);
+				return;
+			}
+		} else {
+			ht_tree_insert_node_multi(tnode, &root, m_comp);
+		}
+		bucket_at(index) = root;
+		++ctx.size;
+		++ctx.collision_count;
+		return;
+	}
+
+	//和insert_list_node_multi一样，相等的元素挨在一起
+	list_node_ptr head = bucket_at(index).as_list_node_ptr();
+	list_node_ptr last = head;
+	size_type nodeCount = 1;
+	while (last) {
+		if (node_equal(last, node)) {
+			break;
+		}
+		last = next_of(last);
+		++nodeCount;
+	}
+	if (last) {
+		if (unique) {
+			destroy(&node->value);
+			ctx.list_pool.deallocate(node);
+			return;
+		}
+		list_link_after(node, &last);
+	} else {
+		node->next = head;
+		bucket_at(index) = node;
+	}
+	while (last) {
+		last = next_of(last);
+		++nodeCount;
+	}
+	++ctx.size;
+	if (nodeCount >= TREEFY_THRESHOLD) {
+		//内存先申请好，申请失败时桶还是原来的链表，之后再挂节点时再树化
+		if constexpr(SORTED_BUCKET) {
+			try {
+				build_sorted(index);
+			} catch (const std::bad_alloc&) {
+				return;
+			}
+			m_counters.treefied();
+		} else {
+			try {
+				ctx.tree_pool.reserve(nodeCount);
+			} catch (const std::bad_alloc&) {
+				return;
+			}
+			build_tree(index, nullptr, [this, &ctx](list_node_ptr lnode) {
+				return listNode2TreeNode(lnode, ctx);
+			});
+		}
+		++ctx.collision_count;
+	}
+}
+
+template<typename T, bool cache, typename Hash, typename Comp, typename Pred, typename Bucket>
+void hash_table<T, cache, Hash, Comp, Pred, Bucket>::bulk_link_all(std::vector<bulk_context>& contexts,
+		size_type partitions, bool unique) {
+	std::atomic<size_type> next(0);
+	run_parallel(contexts.size(), [this, &contexts, &next, partitions, unique](size_type t) {
+		bulk_context& ctx = contexts[t];
+		try {
+			size_type k;
+			while ((k = next.fetch_add(1, std::memory_order_relaxed)) < partitions) {
+				for (bulk_context& from : contexts) {
+					std::vector<bulk_item>& part = from.parts[k];
+					for (size_type i = 0; i != part.size(); ++i) {
+						if (i + BULK_PREFETCH < part.size()) {
+							NANO_PREFETCH(part[i + BULK_PREFETCH].node);
+							NANO_PREFETCH(m_buckets + part[i + BULK_PREFETCH].index);
+						}
+						bulk_link(ctx, part[i].index, part[i].node, unique);
 					}
-					index = other.get_bucket_index(hashVal);
-					//这里不用担心unique的情况
-					//因为如果为unique，在rehash之前能保证容器里元素唯一
-					//insert_multi也没关系
-					other.insert_node_multi(index, node);
+					std::vector<bulk_item>().swap(part);
+				}
+			}
+		} catch (...) {
+			ctx.error = std::current_exception();
+		}
+	});
+}
+
+template<typename T, bool cache, typename Hash, typename Comp, typename Pred, typename Bucket>
+void hash_table<T, cache, Hash, Comp, Pred, Bucket>::bulk_finish(std::vector<bulk_context>& contexts) {
+	std::exception_ptr error;
+	for (bulk_context& ctx : contexts) {
+		list_pool().merge(ctx.list_pool);
+		tree_pool().merge(ctx.tree_pool);
+		if (ctx.error && !error) {
+			error = ctx.error;
+		}
+	}
+	if (error) {
+		std::rethrow_exception(error);
+	}
+}
+
+/**
+ * @brief 先并行构造节点、算hash、分区，任何一个线程出错就把构造好的节点都释放，
+ * 		  表不变；再并行把各个分区挂到桶上
+ */
+template<typename T, bool cache, typename Hash, typename Comp, typename Pred, typename Bucket>
+template<std::random_access_iterator RandomIter>
+void hash_table<T, cache, Hash, Comp, Pred, Bucket>::bulk_insert(RandomIter first, size_type n, 
+		bool unique, size_type threads) {
+	finish_migration();
+	if (static_cast<float>(m_size + n) > static_cast<float>(m_bucket_count) * max_load_factor()) {
+		rehash(static_cast<size_type>(static_cast<float>(m_size + n) / max_load_factor()) + 1, threads);
+	}
+	size_type partitions = bulk_partitions(m_bucket_count, threads);
+	int shift = std::countr_zero(m_bucket_count) - std::countr_zero(partitions);
+	std::vector<bulk_context> contexts(threads);
+	for (bulk_context& ctx : contexts) {
+		ctx.prepare(partitions, n / threads / partitions);
+	}
+
+	run_parallel(threads, [this, &contexts, first, n, threads, shift](size_type t) {
+		bulk_context& ctx = contexts[t];
+		try {
+			for (size_type i = n * t / threads, last = n * (t + 1) / threads; i != last; ++i) {
+				list_node_ptr node = ctx.list_pool.allocate();
+				bool constructed = false;
+				size_t hashVal;
+				try {
+					construct(&node->value, first[i]);
+					constructed = true;
+					hashVal = hash_of(node->value);
+					size_type index = get_bucket_index(hashVal);
+					ctx.parts[index >> shift].push_back(bulk_item{ index, node });
+				} catch (...) {
+					if (constructed) {
+						destroy(&node->value);
+					}
+					ctx.list_pool.deallocate(node);
+					throw;
 				}
-				
 				if constexpr(cache) {
-					hashVal = head->hash_val;
-				} else {
-					hashVal = m_hash(head->value);
+					node->hash_val = hashVal;
 				}
-				index = other.get_bucket_index(hashVal);
-				other.insert_node_multi(index, head);
-			} else {
-				tree_node_ptr root = m_buckets[i].as_tree_node_ptr();
-				postorder(root, [this, &other](tree_node_base* node) {
-					tree_node_base* parent = parent_of(node);
-					if (parent) {
-						if (node == parent->left) {
-							parent->left = nullptr;
-						} else {
-							parent->right = nullptr;
+			}
+		} catch (...) {
+			ctx.error = std::current_exception();
+		}
+	});
+	bool failed = false;
+	for (bulk_context& ctx : contexts) {
+		failed = failed || ctx.error;
+	}
+	if (failed) {
+		for (bulk_context& ctx : contexts) {
+			for (std::vector<bulk_item>& part : ctx.parts) {
+				for (bulk_item& item : part) {
+					destroy(&item.node->value);
+					ctx.list_pool.deallocate(item.node);
+				}
+			}
+		}
+		//合并节点池，抛出第一个错误
+		bulk_finish(contexts);
+	}
+
+	bulk_link_all(contexts, partitions, unique);
+	for (bulk_context& ctx : contexts) {
+		m_size += ctx.size;
+		m_collision_count += ctx.collision_count;
+	}
+	bulk_finish(contexts);
+	if (reseed_needed()) {
+		reseed();
+	}
+}
+
+/**
+ * @brief 和relink一样不重新申请节点(树节点换成链表节点除外)。每个线程先只读地算好一段旧桶里
+ * 		  节点的hash，链表节点直接按新桶下标分区，树节点要换的链表节点和分区数组的位置
+ * 		  也先申请好；都成功以后再拆树桶、换上新桶数组，每个线程再挂好一段新桶
+ * @attention 第一步Hash抛出异常或者申请内存失败时还没有动任何节点，表不变。之后拆树桶不再
+ * 			  申请内存；挂新桶时申请不到树节点，桶就留成链表。元素的移动构造不抛出异常
+ * 			  就一个节点也不会丢
+ */
+template<typename T, bool cache, typename Hash, typename Comp, typename Pred, typename Bucket>
+void hash_table<T, cache, Hash, Comp, Pred, Bucket>::relink_parallel(size_type bucketCount, 
+		bool rehashValue, size_type threads) {
+	size_type partitions = bulk_partitions(bucketCount, threads);
+	int shift = std::countr_zero(bucketCount) - std::countr_zero(partitions);
+	std::vector<bulk_context> contexts(threads);
+	for (bulk_context& ctx : contexts) {
+		ctx.prepare(partitions, m_size / threads / partitions);
+	}
+	//先把内存都申请好，申请失败时表不变
+	ht_bitmap bitmap(bucketCount);
+	bucket_ptr buckets = allocate_entry(bucketCount);
+	//换了种子时缓存的hash值要等都算完再写回节点
+	bool writeHash = cache && rehashValue;
+
+	run_parallel(threads, [this, &contexts, threads, bucketCount, rehashValue, writeHash, shift](size_type t) {
+		bulk_context& ctx = contexts[t];
+		try {
+			size_type last = m_bucket_count * (t + 1) / threads;
+			size_type treeNodes = 0;
+			//每个分区要放几个树节点
+			std::vector<size_type> treeParts(ctx.parts.size());
+			for (size_type i = m_bitmap.next(m_bucket_count * t / threads); i < last; i = m_bitmap.next(i + 1)) {
+				//旧桶是按顺序读的，后面桶的第一个节点可以先预取
+				if (i + BULK_PREFETCH < last) {
+					NANO_PREFETCH(bucket_at(i + BULK_PREFETCH).as_list_node_ptr());
+				}
+				visit_bucket(i, [this, &ctx, &treeNodes, &treeParts, bucketCount, rehashValue, writeHash,
+						shift](auto* node) {
+					size_t hashVal = rehashValue ? hash_of(node->value) : hash_of_node(node);
+					if constexpr(std::is_same_v<decltype(node), tree_node_ptr>) {
+						ctx.hashes.push_back(hashVal);
+						++treeParts[(hashVal & (bucketCount - 1)) >> shift];
+						++treeNodes;
+					} else {
+						if (writeHash) {
+							ctx.hashes.push_back(hashVal);
 						}
-						node->parent = nullptr;
+						size_type index = hashVal & (bucketCount - 1);
+						ctx.parts[index >> shift].push_back(bulk_item{ index, node });
 					}
-					tree_node_ptr node1 = static_cast<tree_node_ptr>(node);
-					size_t hashVal = 0;
-					if constexpr(cache) {
-						hashVal = node1->hash_val;
+				});
+			}
+			//拆树桶时分区数组不用再扩容
+			for (size_type k = 0; k != ctx.parts.size(); ++k) {
+				ctx.parts[k].reserve(ctx.parts[k].size() + treeParts[k]);
+			}
+			ctx.list_pool.reserve(treeNodes);
+		} catch (...) {
+			ctx.error = std::current_exception();
+		}
+	});
+	for (bulk_context& ctx : contexts) {
+		if (ctx.error) {
+			deallocate_entry(buckets, bucketCount);
+			std::rethrow_exception(ctx.error);
+		}
+	}
+
+	//链表节点挂的时候会重写next，不用摘；树节点换成链表节点再分区
+	run_parallel(threads, [this, &contexts, threads, bucketCount, writeHash, shift](size_type t) {
+		bulk_context& ctx = contexts[t];
+		size_type next = 0;
+		auto write_hash = [&ctx, &next](auto* node) {
+			if constexpr(cache) {
+				node->hash_val = ctx.hashes[next++];
+			}
+		};
+		try {
+			size_type last = m_bucket_count * (t + 1) / threads;
+			for (size_type i = m_bitmap.next(m_bucket_count * t / threads); i < last; i = m_bitmap.next(i + 1)) {
+				if (is_list(i) || SORTED_BUCKET) {
+					if (writeHash) {
+						visit_bucket(i, write_hash);
+					}
+					if constexpr(SORTED_BUCKET) {
+						if (!is_list(i)) {
+							sorted_array::destroy(sorted_at(i));
+						}
+					}
+					continue;
+				}
+				unlink_bucket(i, [this, &ctx, &next, bucketCount, shift](auto* node) {
+					list_node_ptr lnode;
+					if constexpr(std::is_same_v<decltype(node), tree_node_ptr>) {
+						lnode = treeNode2ListNode(node, ctx);
 					} else {
-						hashVal = m_hash(node1->value);
+						lnode = node;
 					}
-					size_type index = other.get_bucket_index(hashVal);
-					other.insert_node_multi(index, node1);
+					size_t hashVal = ctx.hashes[next++];
+					if constexpr(cache) {
+						lnode->hash_val = hashVal;
+					}
+					size_type index = hashVal & (bucketCount - 1);
+					ctx.parts[index >> shift].push_back(bulk_item{ index, lnode });
 				});
 			}
+		} catch (...) {
+			ctx.error = std::current_exception();
 		}
-	}
+		std::vector<size_t>().swap(ctx.hashes);
+	});
 
 	deallocate_entry(m_buckets, m_bucket_count);
-	m_buckets = other.m_buckets;
-	m_bucket_count = other.m_bucket_count;
-#ifdef BIT32
-	m_bitset = std::move(other.m_bitset);
-#endif //BIT32
-	other.m_buckets = nullptr;
-	other.m_bucket_count = 0;
+	m_buckets = buckets;
+	m_bucket_count = bucketCount;
+	m_bitmap = std::move(bitmap);
+	bulk_link_all(contexts, partitions, false);
+	//节点都在各个线程的池里，先合并再抛出错误
+	m_size = 0;
+	for (bulk_context& ctx : contexts) {
+		m_size += ctx.size;
+	}
+	bulk_finish(contexts);
+}
+
+/**
+ * @brief 开始渐进式rehash: 当前桶数组变成旧桶，换上bucketCount个新桶，节点一个都不动
+ */
+template<typename T, bool cache, typename Hash, typename Comp, typename Pred, typename Bucket>
+void hash_table<T, cache, Hash, Comp, Pred, Bucket>::start_migration(size_type bucketCount) {
+	bucketCount = ceil_power_of_2(bucketCount);
+	if (bucketCount <= m_bucket_count) {
+		return;
+	}
+	typename ht_counters<>::rehash_timer timer(m_counters, true);
+	//先把内存都申请好，申请失败时表不变
+	ht_bitmap bitmap(bucketCount);
+	bucket_ptr buckets = allocate_entry(bucketCount);
+	m_old_buckets = m_buckets;
+	m_old_bucket_count = m_bucket_count;
+	m_migrate_index = 0;
+	m_buckets = buckets;
+	m_bucket_count = bucketCount;
+	m_old_bitmap = std::move(m_bitmap);
+	m_bitmap = std::move(bitmap);
+}
+
+/**
+ * @brief 把第oldIndex个旧桶里的节点全部搬到新桶
+ */
+template<typename T, bool cache, typename Hash, typename Comp, typename Pred, typename Bucket>
+void hash_table<T, cache, Hash, Comp, Pred, Bucket>::migrate_bucket(size_type oldIndex) {
+	size_type index = m_bucket_count + oldIndex;
+	if (bucket_at(index).isnull()) {
+		return;
+	}
+	//insert_node_multi会修改这两个值，搬桶不是真正的插入
+	size_type size = m_size;
+	size_type collisionCount = m_collision_count;
+	unlink_bucket(index, [this](auto* node) {
+		node = evict_inline(node);
+		insert_node_multi(get_bucket_index(hash_of_node(node)), node);
+	});
+	m_size = size;
+	m_collision_count = collisionCount;
+	bucket_at(index) = entry_type();
+	unmark(index);
+	vacate(index);
+}
+
+template<typename T, bool cache, typename Hash, typename Comp, typename Pred, typename Bucket>
+void hash_table<T, cache, Hash, Comp, Pred, Bucket>::migrate_step() {
+	typename ht_counters<>::rehash_timer timer(m_counters, false);
+	size_type last = std::min(m_migrate_index + MIGRATE_STEP, m_old_bucket_count);
+	for (; m_migrate_index != last; ++m_migrate_index) {
+		migrate_bucket(m_migrate_index);
+	}
+	if (m_migrate_index == m_old_bucket_count) {
+		deallocate_entry(m_old_buckets, m_old_bucket_count);
+		m_old_buckets = nullptr;
+		m_old_bucket_count = 0;
+		m_migrate_index = 0;
+		m_old_bitmap = ht_bitmap();
+	}
+}
+
+template<typename T, bool cache, typename Hash, typename Comp, typename Pred, typename Bucket>
+void hash_table<T, cache, Hash, Comp, Pred, Bucket>::finish_migration() {
+	if (m_old_buckets) {
+		{
+			typename ht_counters<>::rehash_timer timer(m_counters, false);
+			for (; m_migrate_index != m_old_bucket_count; ++m_migrate_index) {
+				migrate_bucket(m_migrate_index);
+			}
+		}
+		migrate_step();
+	}
+}
+
+template<typename T, bool cache, typename Hash, typename Comp, typename Pred, typename Bucket>
+ht_stats hash_table<T, cache, Hash, Comp, Pred, Bucket>::stats() const {
+	ht_stats result;
+	result.size = m_size;
+	result.bucket_count = total_bucket_count();
+	result.load_factor = m_bucket_count ? load_factor() : 0.0f;
+	size_type occupied = 0;
+	size_type listNodes = 0;
+	size_type treeNodes = 0;
+	for (size_type i = next_occupied(0); i != total_bucket_count(); i = next_occupied(i + 1)) {
+		size_type length = 0;
+		if constexpr(SORTED_BUCKET) {
+			for (list_node_ptr node = bucket_entry(i).as_list_node_ptr(); node; node = next_of(node)) {
+				++length;
+			}
+			listNodes += length;
+			if (is_tree(i)) {
+				++result.tree_buckets;
+				result.bucket_bytes += sorted_array::bytes(sorted_at(i)->capacity);
+			}
+		} else if (is_list(i)) {
+			for (list_node_ptr node = bucket_at(i).as_list_node_ptr(); node; node = next_of(node)) {
+				++length;
+				if constexpr(INLINE_BUCKET) {
+					//桶自带的节点算在桶数组里
+					listNodes += inline_index(node) == total_bucket_count();
+				} else {
+					++listNodes;
+				}
+			}
+		} else {
+			inorder(bucket_at(i).as_tree_node_ptr(), [&length](tree_node_base*) {
+				++length;
+			});
+			treeNodes += length;
+			++result.tree_buckets;
+		}
+		++occupied;
+		++result.chain_histogram[std::min(length, ht_stats::HISTOGRAM_SIZE - 1)];
+		result.max_chain = std::max(result.max_chain, length);
+	}
+	result.chain_histogram[0] = total_bucket_count() - occupied;
+	result.bucket_bytes += total_bucket_count() * sizeof(bucket_type) +
+		m_bitmap.bytes() + m_old_bitmap.bytes();
+	if (m_pool_group) {
+		const pool_group& group = *group_root(m_pool_group);
+		result.node_bytes = group.list_pool.bytes() + group.tree_pool.bytes();
+	} else {
+		result.node_bytes = m_list_pool.bytes() + m_tree_pool.bytes();
+	}
+	result.live_node_bytes = listNodes * sizeof(list_node) + treeNodes * sizeof(tree_node);
+	m_counters.fill(result);
+	return result;
 }
 
-template<typename T, bool cache, typename Hash, typename Comp, typename Pred>
-bool operator==(const hash_table<T, cache, Hash, Comp, Pred>& lhs,
-		const hash_table<T, cache, Hash, Comp, Pred>& rhs) {
+template<typename T, bool cache, typename Hash, typename Comp, typename Pred, typename Bucket>
+bool operator==(const hash_table<T, cache, Hash, Comp, Pred, Bucket>& lhs,
+		const hash_table<T, cache, Hash, Comp, Pred, Bucket>& rhs) {
 	if (lhs.size() != rhs.size()) {
 		return false;
 	}
 	return std::equal(lhs.begin(), rhs.begin(), rhs.end());
 }
 
-template<typename T, bool cache, typename Hash, typename Comp, typename Pred>
-bool operator!=(const hash_table<T, cache, Hash, Comp, Pred>& lhs,
-		const hash_table<T, cache, Hash, Comp, Pred>& rhs) {
+template<typename T, bool cache, typename Hash, typename Comp, typename Pred, typename Bucket>
+bool operator!=(const hash_table<T, cache, Hash, Comp, Pred, Bucket>& lhs,
+		const hash_table<T, cache, Hash, Comp, Pred, Bucket>& rhs) {
 	return !(lhs == rhs);
 }
 
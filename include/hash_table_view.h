@@ -0,0 +1,259 @@
+/**
+ * @file hash_table_view.h
+ * @brief 只读地映射hash_table::save写出的文件，不反序列化、不申请内存，
+ * 		  打开以后第一次查找只会读到用到的那几页
+ * @date 2022-05-24
+ * @copyright Copyright (c) 2022
+ */
+#pragma once
+
+#include "ht_snapshot.h"
+#include "mapped_file.h"
+#include "hash.h"
+#include <iterator>
+#include <bit>
+#include <stdexcept>
+#include <utility>
+#include <string.h>
+
+namespace nano {
+
+/**
+ * @tparam Hash、Encoder 必须和save时hash_table用的一样
+ * @tparam Comp 和save时的Comp顺序一致，元素多的桶按它二分查找
+ * @tparam Pred 判断解码后的元素和key相等
+ */
+template<typename T, typename Hash = hash_value<T>, typename Comp = std::less<T>,
+	typename Pred = std::equal_to<T>, typename Encoder = ht_trivial_encoder<T>>
+class hash_table_view {
+public:
+	using record_type = typename Encoder::record_type;
+	using size_type = size_t;
+	using hasher = Hash;
+	using key_compare = Comp;
+	using key_equal = Pred;
+	/**
+	 * @brief 平凡的元素是文件里那个元素的引用，std::string是std::string_view
+	 */
+	using reference = decltype(std::declval<const Encoder&>().decode(
+		std::declval<const record_type&>(), static_cast<const char*>(nullptr)));
+	using value_type = std::remove_cvref_t<reference>;
+
+	class const_iterator {
+	friend class hash_table_view;
+	public:
+		using iterator_category = std::random_access_iterator_tag;
+		using value_type = hash_table_view::value_type;
+		using reference = hash_table_view::reference;
+		using difference_type = ptrdiff_t;
+		using pointer = const value_type*;
+
+		const_iterator() noexcept = default;
+		reference operator*() const { return m_view->decode(*m_record); }
+		pointer operator->() const requires std::is_lvalue_reference_v<reference> {
+			return &m_view->decode(*m_record);
+		}
+		reference operator[](difference_type n) const { return m_view->decode(m_record[n]); }
+		const_iterator& operator++() noexcept { ++m_record; return *this; }
+		const_iterator operator++(int) noexcept { const_iterator temp = *this; ++m_record; return temp; }
+		const_iterator& operator--() noexcept { --m_record; return *this; }
+		const_iterator operator--(int) noexcept { const_iterator temp = *this; --m_record; return temp; }
+		const_iterator& operator+=(difference_type n) noexcept { m_record += n; return *this; }
+		const_iterator& operator-=(difference_type n) noexcept { m_record -= n; return *this; }
+		const_iterator operator+(difference_type n) const noexcept { return const_iterator(m_record + n, m_view); }
+		const_iterator operator-(difference_type n) const noexcept { return const_iterator(m_record - n, m_view); }
+		difference_type operator-(const const_iterator& rhs) const noexcept { return m_record - rhs.m_record; }
+		bool operator==(const const_iterator& rhs) const noexcept { return m_record == rhs.m_record; }
+		auto operator<=>(const const_iterator& rhs) const noexcept { return m_record <=> rhs.m_record; }
+
+	private:
+		const_iterator(const record_type* record, const hash_table_view* view) noexcept :
+			m_record(record), m_view(view) {}
+
+	private:
+		const record_type* m_record = nullptr;
+		const hash_table_view* m_view = nullptr;
+	};
+	using iterator = const_iterator;
+
+public:
+	hash_table_view() noexcept = default;
+	hash_table_view(const hash_table_view&) = delete;
+	hash_table_view& operator=(const hash_table_view&) = delete;
+	/**
+	 * @attention 移动以后原来的迭代器失效
+	 */
+	hash_table_view(hash_table_view&&) noexcept = default;
+	hash_table_view& operator=(hash_table_view&&) noexcept = default;
+
+	/**
+	 * @brief 映射文件并检查文件头，只读文件头和offsets的最后一项。
+	 * 		  Encoder提供check时(decode要读blob)，还要读一遍所有record，检查都落在blob里
+	 * @throw std::runtime_error 打不开，不是同一种元素、同一种机器写出的快照，或者record越界
+	 */
+	static hash_table_view open(const char* path,
+								const hasher& hf = hasher(),
+								const key_compare& comp = key_compare(),
+								const key_equal& eql = key_equal(),
+								const Encoder& encoder = Encoder());
+
+public:
+	const_iterator begin() const noexcept { return const_iterator(m_records, this); }
+	const_iterator end() const noexcept { return const_iterator(m_records + m_size, this); }
+	const_iterator cbegin() const noexcept { return begin(); }
+	const_iterator cend() const noexcept { return end(); }
+
+	bool empty() const noexcept { return 0 == m_size; }
+	size_type size() const noexcept { return m_size; }
+	size_type bucket_count() const noexcept { return m_bucket_count; }
+	size_t hash_seed() const noexcept { return m_seed; }
+	float max_load_factor() const noexcept { return m_mlf; }
+
+	/**
+	 * @brief key可以是任何Hash、Comp、Pred都接受的类型
+	 */
+	template<typename Key>
+	const_iterator find(const Key& key) const;
+	template<typename Key>
+	bool contains(const Key& key) const { return find(key) != end(); }
+	template<typename Key>
+	size_type count_unique(const Key& key) const { return contains(key) ? 1 : 0; }
+
+private:
+	reference decode(const record_type& record) const { return m_encoder.decode(record, m_blob); }
+	template<typename Key>
+	size_t hash_of(const Key& key) const {
+		if constexpr(std::is_invocable_v<const Hash&, const Key&, size_t>) {
+			return m_hash(key, m_seed);
+		} else {
+			return m_hash(key);
+		}
+	}
+
+private:
+	mapped_file m_file;
+	const uint32_t* m_offsets = nullptr;	///< 第b个桶是records[offsets[b], offsets[b + 1])
+	const record_type* m_records = nullptr;
+	const char* m_blob = nullptr;
+	size_type m_bucket_count = 0;
+	size_type m_size = 0;
+	size_type m_sorted_threshold = 0;
+	size_t m_seed = 0;
+	float m_mlf = 0.0f;
+	hasher m_hash;
+	key_compare m_comp;
+	key_equal m_equal;
+	Encoder m_encoder;
+};
+
+template<typename T, typename Hash, typename Comp, typename Pred, typename Encoder>
+hash_table_view<T, Hash, Comp, Pred, Encoder>
+hash_table_view<T, Hash, Comp, Pred, Encoder>::open(const char* path, const hasher& hf,
+	const key_compare& comp, const key_equal& eql, const Encoder& encoder) {
+	hash_table_view view;
+	view.m_file = mapped_file(path);
+	const char* base = view.m_file.data();
+	size_t fileSize = view.m_file.size();
+	auto fail = [path](const char* what) {
+		throw std::runtime_error(std::string("hash_table_view: ") + path + ": " + what);
+	};
+	if (fileSize < sizeof(ht_snapshot_header)) {
+		fail("file too small");
+	}
+	ht_snapshot_header header;
+	memcpy(&header, base, sizeof(header));
+	if (memcmp(header.magic, ht_snapshot_header::MAGIC, sizeof(header.magic)) != 0) {
+		fail("bad magic");
+	}
+	if (header.version != ht_snapshot_header::VERSION) {
+		fail("unsupported version");
+	}
+	if (header.byte_order != ht_snapshot_header::BYTE_ORDER_MARK) {
+		fail("written on a machine with different byte order");
+	}
+	if (header.record_size != sizeof(record_type)) {
+		fail("record size mismatch");
+	}
+	if (0 == header.bucket_count || !std::has_single_bit(header.bucket_count)) {
+		fail("bucket count is not a power of 2");
+	}
+	//加法前先比较，避免被构造出来的大数绕回
+	if (header.offsets_offset > fileSize ||
+		(fileSize - header.offsets_offset) / sizeof(uint32_t) < header.bucket_count + 1 ||
+		header.offsets_offset % alignof(uint32_t) != 0) {
+		fail("offsets out of range");
+	}
+	if (header.records_offset > fileSize ||
+		(fileSize - header.records_offset) / sizeof(record_type) < header.size ||
+		header.records_offset % alignof(record_type) != 0) {
+		fail("records out of range");
+	}
+	if (header.blob_offset > fileSize || fileSize - header.blob_offset < header.blob_size) {
+		fail("blob out of range");
+	}
+	view.m_offsets = reinterpret_cast<const uint32_t*>(base + header.offsets_offset);
+	if (view.m_offsets[header.bucket_count] != header.size) {
+		fail("offsets do not match size");
+	}
+	view.m_records = reinterpret_cast<const record_type*>(base + header.records_offset);
+	if constexpr(requires(const record_type& record) { encoder.check(record, header.blob_size); }) {
+		for (size_type i = 0; i < header.size; ++i) {
+			if (!encoder.check(view.m_records[i], header.blob_size)) {
+				fail("record out of blob");
+			}
+		}
+	}
+	view.m_blob = base + header.blob_offset;
+	view.m_bucket_count = header.bucket_count;
+	view.m_size = header.size;
+	view.m_sorted_threshold = header.sorted_threshold;
+	view.m_seed = header.seed;
+	view.m_mlf = header.max_load_factor;
+	view.m_hash = hf;
+	view.m_comp = comp;
+	view.m_equal = eql;
+	view.m_encoder = encoder;
+	view.m_file.advise_random();
+	return view;
+}
+
+template<typename T, typename Hash, typename Comp, typename Pred, typename Encoder>
+template<typename Key>
+typename hash_table_view<T, Hash, Comp, Pred, Encoder>::const_iterator
+hash_table_view<T, Hash, Comp, Pred, Encoder>::find(const Key& key) const {
+	if (0 == m_bucket_count) {
+		return end();
+	}
+	size_type index = hash_of(key) & (m_bucket_count - 1);
+	size_type first = m_offsets[index];
+	size_type last = m_offsets[index + 1];
+	//open只检查了最后一项，损坏的文件在这里当作找不到
+	if (first > last || last > m_size) {
+		return end();
+	}
+	if (last - first >= m_sorted_threshold) {
+		//有序的桶: 找第一个不小于key的
+		size_type count = last - first;
+		while (count > 0) {
+			size_type half = count >> 1;
+			if (m_comp(decode(m_records[first + half]), key)) {
+				first += half + 1;
+				count -= half + 1;
+			} else {
+				count = half;
+			}
+		}
+		if (first != last && m_equal(decode(m_records[first]), key)) {
+			return const_iterator(m_records + first, this);
+		}
+		return end();
+	}
+	for (; first != last; ++first) {
+		if (m_equal(decode(m_records[first]), key)) {
+			return const_iterator(m_records + first, this);
+		}
+	}
+	return end();
+}
+
+} //namespace nano
@@ -0,0 +1,117 @@
+/**
+ * @file ht_snapshot.h
+ * @brief hash_table::save写出、hash_table_view::open直接mmap使用的文件格式
+ * 		  文件里只有偏移量没有指针，映射到哪个地址都能用:
+ * 		  | header | offsets[bucket_count + 1] | records[size] | blob |
+ * 		  第b个桶的元素是records[offsets[b], offsets[b + 1])，元素个数达到
+ * 		  sorted_threshold的桶按Comp排好序，查找时二分
+ * @date 2022-05-24
+ * @copyright Copyright (c) 2022
+ */
+#pragma once
+
+#include <string>
+#include <string_view>
+#include <type_traits>
+#include <stdint.h>
+#include <stddef.h>
+
+namespace nano {
+
+struct ht_snapshot_header {
+	constexpr static char MAGIC[8] = { 'n', 'a', 'n', 'o', 'h', 't', 's', '\0' };
+	constexpr static uint32_t VERSION = 1;
+	constexpr static uint32_t BYTE_ORDER_MARK = 0x01020304;
+
+	char magic[8];
+	uint32_t version;
+	uint32_t byte_order;		///< 写的时候是BYTE_ORDER_MARK，大小端不同的机器读出来不一样
+	uint32_t record_size;		///< sizeof(Encoder::record_type)
+	uint32_t sorted_threshold;	///< 元素个数不少于这个值的桶是有序的
+	uint64_t bucket_count;
+	uint64_t size;
+	uint64_t seed;
+	float max_load_factor;
+	uint32_t reserved;
+	uint64_t offsets_offset;	///< 下面都是相对文件开头的字节数
+	uint64_t records_offset;
+	uint64_t blob_offset;
+	uint64_t blob_size;
+};
+
+/**
+ * @brief save时编码器把变长数据追加到这里，攒够一批由save写进文件。
+ * 		  数据在blob里的偏移要用append的返回值，缓冲区只是还没写出去的那一段
+ */
+class ht_blob_writer {
+public:
+	/**
+	 * @return data在整个blob里的偏移
+	 */
+	uint64_t append(std::string_view data) {
+		uint64_t offset = size();
+		m_buffer.append(data);
+		return offset;
+	}
+	uint64_t size() const noexcept { return m_written + m_buffer.size(); }
+	const std::string& buffer() const noexcept { return m_buffer; }
+	/**
+	 * @brief 缓冲区里的数据已经写进文件，清空缓冲区
+	 */
+	void flushed() noexcept {
+		m_written += m_buffer.size();
+		m_buffer.clear();
+	}
+
+private:
+	std::string m_buffer;
+	uint64_t m_written = 0;
+};
+
+/**
+ * @brief 默认的编码器，可以平凡复制的元素原样写进文件，查找时直接返回文件里的元素
+ * 		  自己的编码器要提供同样的record_type、encode、decode；
+ * 		  decode要读blob的，还要提供check，hash_table_view::open时检查每个record
+ */
+template<typename T>
+struct ht_trivial_encoder {
+	static_assert(std::is_trivially_copyable_v<T>, "use an encoder for non trivially copyable types");
+	using record_type = T;
+
+	/**
+	 * @param blob 变长的数据追加到这里，record里记它在blob里的位置
+	 */
+	const record_type& encode(const T& value, ht_blob_writer& blob) const noexcept {
+		static_cast<void>(blob);
+		return value;
+	}
+	const T& decode(const record_type& record, const char* blob) const noexcept {
+		static_cast<void>(blob);
+		return record;
+	}
+};
+
+/**
+ * @brief std::string的内容放在blob里，record只记偏移和长度，查找时解码成std::string_view
+ */
+struct ht_string_encoder {
+	struct record_type {
+		uint64_t offset;
+		uint64_t length;
+	};
+
+	record_type encode(const std::string& value, ht_blob_writer& blob) const {
+		return record_type{ blob.append(value), value.size() };
+	}
+	std::string_view decode(const record_type& record, const char* blob) const noexcept {
+		return std::string_view(blob + record.offset, record.length);
+	}
+	/**
+	 * @brief record指向的数据是否整个落在blob里，损坏的文件decode会读到blob外面
+	 */
+	bool check(const record_type& record, uint64_t blobSize) const noexcept {
+		return record.offset <= blobSize && record.length <= blobSize - record.offset;
+	}
+};
+
+} //namespace nano
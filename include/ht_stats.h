@@ -0,0 +1,149 @@
+/**
+ * @file ht_stats.h
+ * @brief hash_table::stats()返回的统计信息，和查找、树化、rehash的计数器
+ * 		  桶的分布、占用的内存每次调用stats()时现算，总是有；计数器要在包含
+ * 		  hash_table.h之前定义HASH_TABLE_STATS才有，同一个程序里要一致
+ * @date 2022-06-01
+ * @copyright Copyright (c) 2022
+ */
+#pragma once
+
+#include <string>
+#include <atomic>
+#include <chrono>
+#include <stddef.h>
+
+namespace nano {
+
+#ifdef HASH_TABLE_STATS
+inline constexpr bool ht_stats_enabled = true;
+#else
+inline constexpr bool ht_stats_enabled = false;
+#endif //HASH_TABLE_STATS
+
+struct ht_stats {
+	constexpr static size_t HISTOGRAM_SIZE = 17;
+
+	size_t size = 0;
+	size_t bucket_count = 0;			///< 渐进式rehash时包括旧桶
+	float load_factor = 0.0f;
+	/**
+	 * @brief 第i格是有i个元素的桶的个数，最后一格是元素个数不少于HISTOGRAM_SIZE - 1的桶，
+	 * 		  树桶也按元素个数算
+	 */
+	size_t chain_histogram[HISTOGRAM_SIZE] = {};
+	size_t max_chain = 0;
+	size_t tree_buckets = 0;			///< 现在是树(ht_sorted_bucket是有序数组)的桶
+	size_t bucket_bytes = 0;			///< 桶数组和占用位图，包括有序数组桶的数组
+	size_t node_bytes = 0;				///< 节点池向系统申请的内存，包括空闲的节点
+	size_t live_node_bytes = 0;			///< 正在用的节点
+
+	///< 下面是计数器，没有定义HASH_TABLE_STATS时都是0
+	bool counters_enabled = ht_stats_enabled;
+	size_t treefy_count = 0;
+	size_t untreefy_count = 0;
+	size_t rehash_count = 0;			///< 包括换种子、缩容、渐进式rehash
+	double rehash_ms = 0.0;
+	size_t hit_count = 0;				///< 按key查找(find、find_batch、try_emplace等)找到了的次数
+	size_t hit_probes = 0;				///< 找到之前看了几个节点，包括找到的那个
+	size_t miss_count = 0;
+	size_t miss_probes = 0;
+
+	double avg_hit_probes() const noexcept {
+		return hit_count ? static_cast<double>(hit_probes) / hit_count : 0.0;
+	}
+	double avg_miss_probes() const noexcept {
+		return miss_count ? static_cast<double>(miss_probes) / miss_count : 0.0;
+	}
+	/**
+	 * @brief 一行JSON，键名和成员名一样，另外加上avg_hit_probes、avg_miss_probes
+	 */
+	std::string to_json() const;
+};
+
+/**
+ * @brief 没有定义HASH_TABLE_STATS时是空类，成员函数什么也不做，
+ * 		  hash_table里用[[no_unique_address]]放它，不占空间也没有开销
+ */
+template<bool enabled = ht_stats_enabled>
+struct ht_counters {
+	class rehash_timer {
+	public:
+		rehash_timer(ht_counters&, bool) noexcept {}
+	};
+
+	void treefied() noexcept {}
+	void untreefied() noexcept {}
+	void found(bool, size_t) noexcept {}
+	void add(const ht_counters&) noexcept {}
+	void fill(ht_stats&) const noexcept {}
+};
+
+/**
+ * @brief 用relaxed的原子操作计数，多个线程同时读表(比如concurrent_hash_table的读锁)
+ * 		  也不是数据竞争
+ */
+template<>
+struct ht_counters<true> {
+	/**
+	 * @brief 析构时把经过的时间加到rehash_ns上
+	 */
+	class rehash_timer {
+	public:
+		/**
+		 * @param start 是不是一次新的rehash，渐进式rehash后面搬桶的时间只计时不计数
+		 */
+		rehash_timer(ht_counters& counters, bool start) noexcept :
+				m_counters(counters),
+				m_start(std::chrono::steady_clock::now()) {
+			if (start) {
+				m_counters.rehash_count.fetch_add(1, std::memory_order_relaxed);
+			}
+		}
+		rehash_timer(const rehash_timer&) = delete;
+		rehash_timer& operator=(const rehash_timer&) = delete;
+		~rehash_timer() {
+			std::chrono::nanoseconds elapsed = std::chrono::steady_clock::now() - m_start;
+			m_counters.rehash_ns.fetch_add(elapsed.count(), std::memory_order_relaxed);
+		}
+
+	private:
+		ht_counters& m_counters;
+		std::chrono::steady_clock::time_point m_start;
+	};
+
+	void treefied() noexcept { treefy_count.fetch_add(1, std::memory_order_relaxed); }
+	void untreefied() noexcept { untreefy_count.fetch_add(1, std::memory_order_relaxed); }
+	void found(bool hit, size_t probes) noexcept {
+		(hit ? hit_count : miss_count).fetch_add(1, std::memory_order_relaxed);
+		(hit ? hit_probes : miss_probes).fetch_add(probes, std::memory_order_relaxed);
+	}
+	/**
+	 * @brief rehash时临时的表挂节点、树化的次数也算到自己头上
+	 */
+	void add(const ht_counters& other) noexcept {
+		treefy_count.fetch_add(other.treefy_count.load(std::memory_order_relaxed), std::memory_order_relaxed);
+		untreefy_count.fetch_add(other.untreefy_count.load(std::memory_order_relaxed), std::memory_order_relaxed);
+	}
+	void fill(ht_stats& stats) const noexcept {
+		stats.treefy_count = treefy_count.load(std::memory_order_relaxed);
+		stats.untreefy_count = untreefy_count.load(std::memory_order_relaxed);
+		stats.rehash_count = rehash_count.load(std::memory_order_relaxed);
+		stats.rehash_ms = static_cast<double>(rehash_ns.load(std::memory_order_relaxed)) / 1e6;
+		stats.hit_count = hit_count.load(std::memory_order_relaxed);
+		stats.hit_probes = hit_probes.load(std::memory_order_relaxed);
+		stats.miss_count = miss_count.load(std::memory_order_relaxed);
+		stats.miss_probes = miss_probes.load(std::memory_order_relaxed);
+	}
+
+	std::atomic<size_t> treefy_count{0};
+	std::atomic<size_t> untreefy_count{0};
+	std::atomic<size_t> rehash_count{0};
+	std::atomic<size_t> rehash_ns{0};
+	std::atomic<size_t> hit_count{0};
+	std::atomic<size_t> hit_probes{0};
+	std::atomic<size_t> miss_count{0};
+	std::atomic<size_t> miss_probes{0};
+};
+
+} //namespace nano
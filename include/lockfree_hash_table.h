@@ -0,0 +1,570 @@
+#pragma once
+
+#include "hash_table.h"
+#include "epoch.h"
+#include <mutex>
+#include <atomic>
+#include <optional>
+
+namespace nano {
+
+/**
+ * @brief 读不加锁的哈希表，适合读远多于写的场景(比如配置表)
+ * 		  读: find、contains、count_unique、visit、for_each只进出一次epoch临界区，
+ * 		  	  不加锁也不写任何共享的cache line
+ * 		  写: 所有写操作用一把锁串行，新节点先构造好再用release store挂到桶上；
+ * 		  	  摘下来的节点、旧的桶数组都交给retire_list，等读者都离开以后才释放
+ * 		  树化的桶不在原地旋转，每次改动都复制出一棵新树再整体替换树根，
+ * 		  rehash也是把元素复制到新的桶数组里再整体替换，读者看到的要么是旧的要么是新的
+ * @attention 元素要能拷贝构造；rehash、树桶的改动都会复制元素
+ */
+template<typename T, typename Hash = hash_value<T>,
+	typename Comp = std::less<T>, typename Pred = std::equal_to<T>>
+class lockfree_hash_table {
+public:
+	using key_type 			= T;
+	using value_type 		= T;
+	using size_type 		= size_t;
+	using hasher 			= Hash;
+	using key_compare 		= Comp;
+	using key_equal 		= Pred;
+
+public:
+	explicit lockfree_hash_table(size_type n = 16,
+			const hasher& hf = hasher(),
+			const key_compare& comp = key_compare(),
+			const key_equal& eql = key_equal());
+	lockfree_hash_table(const lockfree_hash_table&) = delete;
+	lockfree_hash_table& operator=(const lockfree_hash_table&) = delete;
+	/**
+	 * @attention 析构时不能再有读者
+	 */
+	~lockfree_hash_table();
+
+public:
+	// 插入
+	bool insert_unique(const value_type& value) { return emplace_unique(value); }
+	bool insert_unique(value_type&& value) { return emplace_unique(std::move(value)); }
+	template<typename... Args>
+	bool emplace_unique(Args&&... args);
+
+	// 删除
+	size_type erase_unique(const key_type& key);
+	void clear();
+
+	// 查找，都不加锁
+	bool contains(const key_type& key) const {
+		epoch_guard guard;
+		return nullptr != find_value(key, hash_of(key));
+	}
+	size_type count_unique(const key_type& key) const { return contains(key) ? 1 : 0; }
+	/**
+	 * @return key对应元素的拷贝
+	 */
+	std::optional<value_type> find(const key_type& key) const {
+		epoch_guard guard;
+		const value_type* value = find_value(key, hash_of(key));
+		return value ? std::optional<value_type>(*value) : std::nullopt;
+	}
+	/**
+	 * @brief 找到key时在epoch临界区内调用f(const T&)，f返回以后元素可能被释放
+	 */
+	template<typename Func>
+	bool visit(const key_type& key, Func&& f) const {
+		epoch_guard guard;
+		const value_type* value = find_value(key, hash_of(key));
+		if (value) {
+			f(*value);
+		}
+		return nullptr != value;
+	}
+	/**
+	 * @brief 遍历调用时的那个桶数组，遍历期间的插入、删除不一定看得到
+	 */
+	template<typename Func>
+	void for_each(Func&& f) const;
+
+	// 容量
+	size_type size() const noexcept { return m_size.load(std::memory_order_relaxed); }
+	bool empty() const noexcept { return 0 == size(); }
+
+	// hash policy
+	size_type bucket_count() const noexcept { return m_buckets.load(std::memory_order_acquire)->count; }
+	float max_load_factor() const noexcept { return m_mlf; }
+	void max_load_factor(float mlf) {
+		std::lock_guard<std::mutex> guard(m_write_lock);
+		m_mlf = mlf;
+	}
+	void rehash(size_type n);
+	void reserve(size_type n) { rehash(static_cast<size_type>(static_cast<float>(n) / m_mlf) + 1); }
+	hasher hash_function() const { return m_hash; }
+	key_equal key_eq() const { return m_pred; }
+	/**
+	 * @brief 已经退休还没释放的对象个数
+	 */
+	size_type retired_count() const {
+		std::lock_guard<std::mutex> guard(m_write_lock);
+		return m_retired.size();
+	}
+
+private:
+	using list_node_type 	= ht_list_node<T, true>;
+	using tree_node_type 	= ht_tree_node<T, true>;
+	using list_node_ptr 	= list_node_type*;
+	using tree_node_ptr 	= tree_node_type*;
+	using entry_type 		= uintptr_t;
+
+	/**
+	 * @brief 桶数组和桶个数一起分配，读者只要一次acquire load就能拿到一致的两者
+	 */
+	struct bucket_array {
+		size_type count;
+		std::atomic<entry_type> entries[1];
+	};
+
+#ifdef BIT64
+	///< 和hash_table一样用地址最高位标记树桶
+	constexpr static entry_type TREE_FLAG = mask;
+#else
+	///< 32位上地址最高位有效，桶又要能一次原子地读出来，节点都是自己分配的，
+	///< 至少按指针对齐，这里用最低位标记树桶
+	constexpr static entry_type TREE_FLAG = 1;
+#endif //BIT64
+	constexpr static size_type TREEFY_THRESHOLD = 8;
+	constexpr static size_type UNTREEFY_THRESHOLD = 6;
+	constexpr static float DEFAULT_MLF = 1.0f;
+	constexpr static bool SEEDED_HASH = std::is_invocable_v<const Hash&, const T&, size_t>;
+
+	static bool is_tree(entry_type entry) noexcept { return entry & TREE_FLAG; }
+	static list_node_ptr as_list(entry_type entry) noexcept {
+		return reinterpret_cast<list_node_ptr>(entry);
+	}
+	static tree_node_ptr as_tree(entry_type entry) noexcept {
+		return reinterpret_cast<tree_node_ptr>(entry & ~TREE_FLAG);
+	}
+	static entry_type make_entry(list_node_ptr node) noexcept {
+		return reinterpret_cast<entry_type>(node);
+	}
+	static entry_type make_entry(tree_node_ptr node) noexcept {
+		return node ? (reinterpret_cast<entry_type>(node) | TREE_FLAG) : 0;
+	}
+	static list_node_ptr load_next(list_node_ptr node) noexcept {
+		return static_cast<list_node_ptr>(
+			std::atomic_ref<list_node_base*>(node->next).load(std::memory_order_acquire));
+	}
+	static void store_next(list_node_ptr node, list_node_ptr next) noexcept {
+		std::atomic_ref<list_node_base*>(node->next).store(next, std::memory_order_release);
+	}
+
+	size_t hash_of(const key_type& key) const {
+		if constexpr(SEEDED_HASH) {
+			return m_hash(key, m_seed);
+		} else {
+			return m_hash(key);
+		}
+	}
+	const value_type* find_value(const key_type& key, size_t hashVal) const;
+	template<typename Func>
+	static void for_each_in(entry_type entry, Func&& f);
+
+	// 节点和桶数组，只有写者调用
+	static bucket_array* allocate_buckets(size_type n);
+	template<typename... Args>
+	list_node_ptr create_list_node(size_t hashVal, Args&&... args);
+	tree_node_ptr create_tree_node(const value_type& value, size_t hashVal);
+	void destroy_node(list_node_ptr node);
+	void destroy_node(tree_node_ptr node);
+	void destroy_list(list_node_ptr head);
+	void destroy_tree(tree_node_ptr root);
+	void destroy_entry(entry_type entry);
+	void destroy_buckets(bucket_array* buckets);
+	/**
+	 * @brief 把entry里除skip以外的元素复制成一棵新树，node不为空时也挂上去
+	 */
+	tree_node_ptr copy_to_tree(entry_type entry, const value_type* skip, list_node_ptr node);
+	list_node_ptr copy_to_list(entry_type entry, const value_type* skip);
+
+	// 退休
+	static void retire_list_node(void* context, void* ptr) {
+		static_cast<lockfree_hash_table*>(context)->destroy_node(static_cast<list_node_ptr>(ptr));
+	}
+	static void retire_entry(void* context, void* ptr) {
+		static_cast<lockfree_hash_table*>(context)->destroy_entry(reinterpret_cast<entry_type>(ptr));
+	}
+	static void retire_buckets(void* context, void* ptr) {
+		static_cast<lockfree_hash_table*>(context)->destroy_buckets(static_cast<bucket_array*>(ptr));
+	}
+
+	void rehash_unlocked(size_type n);
+	void rehash_if(size_type n);
+
+private:
+	alignas(NANO_CACHE_LINE_SIZE) std::atomic<bucket_array*> m_buckets;
+	size_t m_seed;
+	hasher m_hash;
+	key_compare m_comp;
+	key_equal m_pred;
+	// 下面的只有写者访问，和读者用的成员分开放
+	alignas(NANO_CACHE_LINE_SIZE) mutable std::mutex m_write_lock;
+	std::atomic<size_type> m_size;
+	float m_mlf;
+	node_pool<list_node_type> m_list_pool;
+	node_pool<tree_node_type> m_tree_pool;
+	retire_list m_retired;
+};
+
+template<typename T, typename Hash, typename Comp, typename Pred>
+lockfree_hash_table<T, Hash, Comp, Pred>::lockfree_hash_table(size_type n,
+		const hasher& hf, const key_compare& comp, const key_equal& eql) :
+		m_buckets(allocate_buckets(ceil_power_of_2(n ? n : 1))),
+		m_seed(random_seed()),
+		m_hash(hf),
+		m_comp(comp),
+		m_pred(eql),
+		m_size(0),
+		m_mlf(DEFAULT_MLF) {
+}
+
+template<typename T, typename Hash, typename Comp, typename Pred>
+lockfree_hash_table<T, Hash, Comp, Pred>::~lockfree_hash_table() {
+	m_retired.reclaim_all();
+	destroy_buckets(m_buckets.load(std::memory_order_relaxed));
+}
+
+template<typename T, typename Hash, typename Comp, typename Pred>
+const typename lockfree_hash_table<T, Hash, Comp, Pred>::value_type*
+lockfree_hash_table<T, Hash, Comp, Pred>::find_value(const key_type& key, size_t hashVal) const {
+	const bucket_array* buckets = m_buckets.load(std::memory_order_acquire);
+	entry_type entry = buckets->entries[hashVal & (buckets->count - 1)].load(std::memory_order_acquire);
+	if (is_tree(entry)) {
+		//树发布以后不会再改，普通的读就行
+		tree_node_ptr node = ht_tree_lbound_key(key, as_tree(entry), m_comp);
+		return node && m_pred(node->value, key) ? &node->value : nullptr;
+	}
+	for (list_node_ptr node = as_list(entry); node; node = load_next(node)) {
+		if (node->hash_val == hashVal && m_pred(node->value, key)) {
+			return &node->value;
+		}
+	}
+	return nullptr;
+}
+
+template<typename T, typename Hash, typename Comp, typename Pred>
+template<typename Func>
+void lockfree_hash_table<T, Hash, Comp, Pred>::for_each_in(entry_type entry, Func&& f) {
+	if (is_tree(entry)) {
+		tree_node_ptr root = as_tree(entry);
+		for (tree_node_ptr node = root ? min_node(root) : nullptr; node; node = successor(node)) {
+			f(node);
+		}
+	} else {
+		for (list_node_ptr node = as_list(entry); node; node = load_next(node)) {
+			f(node);
+		}
+	}
+}
+
+template<typename T, typename Hash, typename Comp, typename Pred>
+template<typename Func>
+void lockfree_hash_table<T, Hash, Comp, Pred>::for_each(Func&& f) const {
+	epoch_guard guard;
+	const bucket_array* buckets = m_buckets.load(std::memory_order_acquire);
+	for (size_type i = 0; i != buckets->count; ++i) {
+		for_each_in(buckets->entries[i].load(std::memory_order_acquire), [&f](auto* node) {
+			f(static_cast<const value_type&>(node->value));
+		});
+	}
+}
+
+template<typename T, typename Hash, typename Comp, typename Pred>
+typename lockfree_hash_table<T, Hash, Comp, Pred>::bucket_array*
+lockfree_hash_table<T, Hash, Comp, Pred>::allocate_buckets(size_type n) {
+	void* mem = ::calloc(1, sizeof(bucket_array) + (n - 1) * sizeof(std::atomic<entry_type>));
+	if (nullptr == mem) {
+		throw std::bad_alloc();
+	}
+	bucket_array* buckets = static_cast<bucket_array*>(mem);
+	buckets->count = n;
+	return buckets;
+}
+
+template<typename T, typename Hash, typename Comp, typename Pred>
+template<typename... Args>
+typename lockfree_hash_table<T, Hash, Comp, Pred>::list_node_ptr
+lockfree_hash_table<T, Hash, Comp, Pred>::create_list_node(size_t hashVal, Args&&... args) {
+	list_node_ptr newNode = m_list_pool.allocate();
+	try {
+		construct(&newNode->value, std::forward<Args>(args)...);
+	} catch (...) {
+		m_list_pool.deallocate(newNode);
+		throw;
+	}
+	newNode->next = nullptr;
+	newNode->hash_val = hashVal;
+	return newNode;
+}
+
+template<typename T, typename Hash, typename Comp, typename Pred>
+typename lockfree_hash_table<T, Hash, Comp, Pred>::tree_node_ptr
+lockfree_hash_table<T, Hash, Comp, Pred>::create_tree_node(const value_type& value, size_t hashVal) {
+	tree_node_ptr newNode = m_tree_pool.allocate();
+	try {
+		construct(&newNode->value, value);
+	} catch (...) {
+		m_tree_pool.deallocate(newNode);
+		throw;
+	}
+	newNode->left = newNode->right = newNode->parent = nullptr;
+	newNode->color = NodeColor::RED;
+	newNode->hash_val = hashVal;
+	return newNode;
+}
+
+template<typename T, typename Hash, typename Comp, typename Pred>
+void lockfree_hash_table<T, Hash, Comp, Pred>::destroy_node(list_node_ptr node) {
+	destroy(&node->value);
+	m_list_pool.deallocate(node);
+}
+
+template<typename T, typename Hash, typename Comp, typename Pred>
+void lockfree_hash_table<T, Hash, Comp, Pred>::destroy_node(tree_node_ptr node) {
+	destroy(&node->value);
+	m_tree_pool.deallocate(node);
+}
+
+template<typename T, typename Hash, typename Comp, typename Pred>
+void lockfree_hash_table<T, Hash, Comp, Pred>::destroy_list(list_node_ptr head) {
+	while (head) {
+		list_node_ptr next = next_of(head);
+		destroy_node(head);
+		head = next;
+	}
+}
+
+template<typename T, typename Hash, typename Comp, typename Pred>
+void lockfree_hash_table<T, Hash, Comp, Pred>::destroy_tree(tree_node_ptr root) {
+	clear_since(root, [this](tree_node_base* node) {
+		this->destroy_node(static_cast<tree_node_ptr>(node));
+	});
+}
+
+template<typename T, typename Hash, typename Comp, typename Pred>
+void lockfree_hash_table<T, Hash, Comp, Pred>::destroy_entry(entry_type entry) {
+	if (is_tree(entry)) {
+		destroy_tree(as_tree(entry));
+	} else {
+		destroy_list(as_list(entry));
+	}
+}
+
+template<typename T, typename Hash, typename Comp, typename Pred>
+void lockfree_hash_table<T, Hash, Comp, Pred>::destroy_buckets(bucket_array* buckets) {
+	for (size_type i = 0; i != buckets->count; ++i) {
+		destroy_entry(buckets->entries[i].load(std::memory_order_relaxed));
+	}
+	::free(buckets);
+}
+
+template<typename T, typename Hash, typename Comp, typename Pred>
+typename lockfree_hash_table<T, Hash, Comp, Pred>::tree_node_ptr
+lockfree_hash_table<T, Hash, Comp, Pred>::copy_to_tree(entry_type entry,
+		const value_type* skip, list_node_ptr node) {
+	tree_node_ptr root = nullptr;
+	try {
+		for_each_in(entry, [this, &root, skip](auto* from) {
+			if (&from->value != skip) {
+				ht_tree_insert_node_multi(create_tree_node(from->value, from->hash_val), &root, m_comp);
+			}
+		});
+		if (node) {
+			ht_tree_insert_node_multi(create_tree_node(node->value, node->hash_val), &root, m_comp);
+		}
+	} catch (...) {
+		destroy_tree(root);
+		throw;
+	}
+	return root;
+}
+
+template<typename T, typename Hash, typename Comp, typename Pred>
+typename lockfree_hash_table<T, Hash, Comp, Pred>::list_node_ptr
+lockfree_hash_table<T, Hash, Comp, Pred>::copy_to_list(entry_type entry, const value_type* skip) {
+	list_node_ptr head = nullptr;
+	try {
+		for_each_in(entry, [this, &head, skip](auto* from) {
+			if (&from->value != skip) {
+				list_node_ptr newNode = create_list_node(from->hash_val, from->value);
+				newNode->next = head;
+				head = newNode;
+			}
+		});
+	} catch (...) {
+		destroy_list(head);
+		throw;
+	}
+	return head;
+}
+
+template<typename T, typename Hash, typename Comp, typename Pred>
+template<typename... Args>
+bool lockfree_hash_table<T, Hash, Comp, Pred>::emplace_unique(Args&&... args) {
+	std::lock_guard<std::mutex> guard(m_write_lock);
+	//要先构造出元素才能算hash，已经存在时再销毁
+	list_node_ptr newNode = create_list_node(0, std::forward<Args>(args)...);
+	newNode->hash_val = hash_of(newNode->value);
+	if (find_value(newNode->value, newNode->hash_val)) {
+		destroy_node(newNode);
+		return false;
+	}
+	try {
+		rehash_if(1);
+	} catch (...) {
+		destroy_node(newNode);
+		throw;
+	}
+
+	bucket_array* buckets = m_buckets.load(std::memory_order_relaxed);
+	std::atomic<entry_type>& bucket = buckets->entries[newNode->hash_val & (buckets->count - 1)];
+	entry_type entry = bucket.load(std::memory_order_relaxed);
+	size_type nodeCount = 0;
+	if (!is_tree(entry)) {
+		for (list_node_ptr node = as_list(entry); node; node = next_of(node)) {
+			++nodeCount;
+		}
+	}
+	if (is_tree(entry) || nodeCount + 1 >= TREEFY_THRESHOLD) {
+		//整棵树复制一份再替换，读者不会看到旋转到一半的树
+		tree_node_ptr root;
+		try {
+			root = copy_to_tree(entry, nullptr, newNode);
+		} catch (...) {
+			destroy_node(newNode);
+			throw;
+		}
+		destroy_node(newNode);
+		bucket.store(make_entry(root), std::memory_order_release);
+		m_retired.retire(reinterpret_cast<void*>(entry), &retire_entry, this);
+	} else {
+		newNode->next = as_list(entry);
+		bucket.store(make_entry(newNode), std::memory_order_release);
+	}
+	m_size.fetch_add(1, std::memory_order_relaxed);
+	m_retired.reclaim();
+	return true;
+}
+
+template<typename T, typename Hash, typename Comp, typename Pred>
+typename lockfree_hash_table<T, Hash, Comp, Pred>::size_type
+lockfree_hash_table<T, Hash, Comp, Pred>::erase_unique(const key_type& key) {
+	std::lock_guard<std::mutex> guard(m_write_lock);
+	size_t hashVal = hash_of(key);
+	bucket_array* buckets = m_buckets.load(std::memory_order_relaxed);
+	std::atomic<entry_type>& bucket = buckets->entries[hashVal & (buckets->count - 1)];
+	entry_type entry = bucket.load(std::memory_order_relaxed);
+	if (is_tree(entry)) {
+		const value_type* value = find_value(key, hashVal);
+		if (nullptr == value) {
+			return 0;
+		}
+		//树桶删完以后太小就变回链表
+		entry_type newEntry;
+		size_type nodeCount = 0;
+		for_each_in(entry, [&nodeCount](auto*) { ++nodeCount; });
+		if (nodeCount - 1 < UNTREEFY_THRESHOLD) {
+			newEntry = make_entry(copy_to_list(entry, value));
+		} else {
+			newEntry = make_entry(copy_to_tree(entry, value, nullptr));
+		}
+		bucket.store(newEntry, std::memory_order_release);
+		m_retired.retire(reinterpret_cast<void*>(entry), &retire_entry, this);
+	} else {
+		list_node_ptr prev = nullptr;
+		list_node_ptr node = as_list(entry);
+		while (node && !(node->hash_val == hashVal && m_pred(node->value, key))) {
+			prev = node;
+			node = next_of(node);
+		}
+		if (nullptr == node) {
+			return 0;
+		}
+		//node自己的next不动，正停在node上的读者还能接着往下走
+		if (prev) {
+			store_next(prev, next_of(node));
+		} else {
+			bucket.store(make_entry(next_of(node)), std::memory_order_release);
+		}
+		m_retired.retire(node, &retire_list_node, this);
+	}
+	m_size.fetch_sub(1, std::memory_order_relaxed);
+	m_retired.reclaim();
+	return 1;
+}
+
+template<typename T, typename Hash, typename Comp, typename Pred>
+void lockfree_hash_table<T, Hash, Comp, Pred>::clear() {
+	std::lock_guard<std::mutex> guard(m_write_lock);
+	bucket_array* oldBuckets = m_buckets.load(std::memory_order_relaxed);
+	m_buckets.store(allocate_buckets(oldBuckets->count), std::memory_order_release);
+	m_retired.retire(oldBuckets, &retire_buckets, this);
+	m_size.store(0, std::memory_order_relaxed);
+	m_retired.reclaim();
+}
+
+template<typename T, typename Hash, typename Comp, typename Pred>
+void lockfree_hash_table<T, Hash, Comp, Pred>::rehash(size_type n) {
+	std::lock_guard<std::mutex> guard(m_write_lock);
+	if (n > m_buckets.load(std::memory_order_relaxed)->count) {
+		rehash_unlocked(ceil_power_of_2(n));
+		m_retired.reclaim();
+	}
+}
+
+template<typename T, typename Hash, typename Comp, typename Pred>
+void lockfree_hash_table<T, Hash, Comp, Pred>::rehash_if(size_type n) {
+	size_type count = m_buckets.load(std::memory_order_relaxed)->count;
+	size_type size = m_size.load(std::memory_order_relaxed);
+	if (static_cast<float>(size + n) > static_cast<float>(count) * m_mlf) {
+		size_type required = static_cast<size_type>(static_cast<float>(size + n) / m_mlf) + 1;
+		rehash_unlocked(ceil_power_of_2(required > count * 2 ? required : count * 2));
+	}
+}
+
+/**
+ * @brief 元素全部复制到新的桶数组里，先按链表挂好，长的桶再转成树，
+ * 		  新数组在发布之前只有写者看得到，可以随便改
+ */
+template<typename T, typename Hash, typename Comp, typename Pred>
+void lockfree_hash_table<T, Hash, Comp, Pred>::rehash_unlocked(size_type n) {
+	bucket_array* oldBuckets = m_buckets.load(std::memory_order_relaxed);
+	bucket_array* newBuckets = allocate_buckets(n);
+	try {
+		for (size_type i = 0; i != oldBuckets->count; ++i) {
+			for_each_in(oldBuckets->entries[i].load(std::memory_order_relaxed),
+				[this, newBuckets, n](auto* from) {
+				std::atomic<entry_type>& bucket = newBuckets->entries[from->hash_val & (n - 1)];
+				list_node_ptr newNode = create_list_node(from->hash_val, from->value);
+				newNode->next = as_list(bucket.load(std::memory_order_relaxed));
+				bucket.store(make_entry(newNode), std::memory_order_relaxed);
+			});
+		}
+		for (size_type i = 0; i != n; ++i) {
+			entry_type entry = newBuckets->entries[i].load(std::memory_order_relaxed);
+			size_type nodeCount = 0;
+			for (list_node_ptr node = as_list(entry); node; node = next_of(node)) {
+				++nodeCount;
+			}
+			if (nodeCount >= TREEFY_THRESHOLD) {
+				newBuckets->entries[i].store(make_entry(copy_to_tree(entry, nullptr, nullptr)),
+					std::memory_order_relaxed);
+				destroy_list(as_list(entry));
+			}
+		}
+	} catch (...) {
+		destroy_buckets(newBuckets);
+		throw;
+	}
+	m_buckets.store(newBuckets, std::memory_order_release);
+	m_retired.retire(oldBuckets, &retire_buckets, this);
+}
+
+} //namespace nano
@@ -0,0 +1,78 @@
+/**
+ * @file mapped_file.h
+ * @brief 只读地映射整个文件，析构时解除映射；原子地写出整个文件
+ * @date 2022-05-24
+ * @copyright Copyright (c) 2022
+ */
+#pragma once
+
+#include <string>
+#include <stddef.h>
+#include <stdint.h>
+
+namespace nano {
+
+class mapped_file {
+public:
+	mapped_file() noexcept = default;
+	/**
+	 * @throw std::runtime_error 打不开或者映射失败
+	 */
+	explicit mapped_file(const char* path);
+	mapped_file(const mapped_file&) = delete;
+	mapped_file& operator=(const mapped_file&) = delete;
+	mapped_file(mapped_file&& other) noexcept;
+	mapped_file& operator=(mapped_file&& other) noexcept;
+	~mapped_file();
+
+	const char* data() const noexcept { return m_data; }
+	size_t size() const noexcept { return m_size; }
+	/**
+	 * @brief 提示内核查找是随机访问，不要预读太多
+	 */
+	void advise_random() const noexcept;
+
+private:
+	void unmap() noexcept;
+
+private:
+	const char* m_data = nullptr;
+	size_t m_size = 0;
+};
+
+/**
+ * @brief 先写目标文件所在目录里的临时文件，commit时刷到磁盘再rename成目标文件。
+ * 		  写到一半出错或者没有commit就析构时删掉临时文件，
+ * 		  目标文件要么是原来的，要么是完整的新文件
+ */
+class atomic_file {
+public:
+	/**
+	 * @throw std::runtime_error 建不了临时文件
+	 */
+	explicit atomic_file(const char* path);
+	atomic_file(const atomic_file&) = delete;
+	atomic_file& operator=(const atomic_file&) = delete;
+	~atomic_file();
+
+	/**
+	 * @brief 写到文件的offset处，可以不按顺序写，没写到的地方是0
+	 * @throw std::runtime_error 写失败
+	 */
+	void write_at(uint64_t offset, const void* data, size_t bytes);
+	/**
+	 * @brief fsync以后rename成目标文件
+	 * @throw std::runtime_error 刷盘或者rename失败，目标文件不变
+	 */
+	void commit();
+
+private:
+	[[noreturn]] void fail(const char* what, const std::string& path, int err);
+
+private:
+	std::string m_path;
+	std::string m_temp;
+	int m_fd = -1;
+};
+
+} //namespace nano
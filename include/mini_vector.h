@@ -196,7 +196,9 @@ void mini_vector<T>::reserve(size_type n) {
 
     pointer newStart = static_cast<pointer>(::operator new(sizeof(T) * newSize));
     if constexpr(std::is_pod<T>::value) {
-        memcpy(newStart, m_start, oldSize);
+        if (oldSize) {
+            memcpy(newStart, m_start, sizeof(T) * oldSize);
+        }
     } else {
         pointer p = m_start;
         pointer p2 = newStart;
@@ -0,0 +1,202 @@
+/**
+ * @file node_pool.h
+ * @brief 定长节点的内存池，按块(slab)向系统申请内存，释放的节点挂在空闲链表上复用
+ * @date 2022-05-02
+ * @copyright Copyright (c) 2022
+ */
+#pragma once
+
+#include <new>
+#include <utility>
+#include <stddef.h>
+
+namespace nano {
+
+/**
+ * @brief 只负责Node大小的原始内存，不构造也不析构Node
+ * 		  申请: 先从空闲链表拿，再从最新的slab里顺序切，都没有就申请一个新slab
+ * 		  释放: 挂到空闲链表头，不还给系统，release()时整块整块地还
+ * 		  slab的容量从MIN_SLAB个节点开始翻倍，最大MAX_SLAB个节点
+ */
+template<typename Node>
+class node_pool {
+public:
+	constexpr static size_t MIN_SLAB = 16;
+	constexpr static size_t MAX_SLAB = 65536;
+
+	node_pool() noexcept :
+		m_free(nullptr),
+		m_slabs(nullptr),
+		m_bump(nullptr),
+		m_bump_end(nullptr),
+		m_next_capacity(MIN_SLAB),
+		m_slab_count(0),
+		m_capacity(0) {
+	}
+	node_pool(const node_pool&) = delete;
+	node_pool(node_pool&& other) noexcept : node_pool() {
+		swap(other);
+	}
+	node_pool& operator=(const node_pool&) = delete;
+	node_pool& operator=(node_pool&& other) noexcept {
+		if (this != &other) {
+			release();
+			swap(other);
+		}
+		return *this;
+	}
+	~node_pool() { release(); }
+
+	Node* allocate() {
+		if (m_free) {
+			block* b = m_free;
+			m_free = b->next;
+			return reinterpret_cast<Node*>(b->storage);
+		}
+		if (m_bump == m_bump_end) {
+			new_slab();
+		}
+		return reinterpret_cast<Node*>((m_bump++)->storage);
+	}
+
+	void deallocate(Node* node) noexcept {
+		block* b = reinterpret_cast<block*>(node);
+		b->next = m_free;
+		m_free = b;
+	}
+
+	/**
+	 * @brief 保证之后n次allocate都不会申请内存，申请失败时抛出异常，已经申请到的节点
+	 * 		  挂回空闲链表
+	 */
+	void reserve(size_t n) {
+		block* reserved = nullptr;
+		try {
+			for (; n; --n) {
+				block* b = reinterpret_cast<block*>(allocate());
+				b->next = reserved;
+				reserved = b;
+			}
+		} catch (...) {
+			give_back(reserved);
+			throw;
+		}
+		give_back(reserved);
+	}
+
+	/**
+	 * @brief 把所有slab还给系统，池里申请出去的节点全部失效
+	 */
+	void release() noexcept {
+		while (m_slabs) {
+			slab* next = m_slabs->next;
+			::operator delete(static_cast<void*>(m_slabs), std::align_val_t(SLAB_ALIGN));
+			m_slabs = next;
+		}
+		m_free = nullptr;
+		m_bump = m_bump_end = nullptr;
+		m_next_capacity = MIN_SLAB;
+		m_slab_count = 0;
+		m_capacity = 0;
+	}
+
+	/**
+	 * @brief 接管other的所有slab和空闲节点，other从中申请出去的节点之后归this管
+	 */
+	void merge(node_pool& other) noexcept {
+		if (this == &other) {
+			return;
+		}
+		while (other.m_free) {
+			block* b = other.m_free;
+			other.m_free = b->next;
+			b->next = m_free;
+			m_free = b;
+		}
+		//other的slab挂到自己的slab链表后面，最新的slab还是自己的
+		if (other.m_slabs) {
+			slab** tail = &m_slabs;
+			while (*tail) {
+				tail = &(*tail)->next;
+			}
+			*tail = other.m_slabs;
+		}
+		//other最新的slab里还没切的部分丢掉，release时一起还
+		if (m_bump == m_bump_end) {
+			m_bump = other.m_bump;
+			m_bump_end = other.m_bump_end;
+		}
+		if (m_next_capacity < other.m_next_capacity) {
+			m_next_capacity = other.m_next_capacity;
+		}
+		m_slab_count += other.m_slab_count;
+		m_capacity += other.m_capacity;
+		other.m_slabs = nullptr;
+		other.m_bump = other.m_bump_end = nullptr;
+		other.m_next_capacity = MIN_SLAB;
+		other.m_slab_count = 0;
+		other.m_capacity = 0;
+	}
+
+	void swap(node_pool& other) noexcept {
+		std::swap(m_free, other.m_free);
+		std::swap(m_slabs, other.m_slabs);
+		std::swap(m_bump, other.m_bump);
+		std::swap(m_bump_end, other.m_bump_end);
+		std::swap(m_next_capacity, other.m_next_capacity);
+		std::swap(m_slab_count, other.m_slab_count);
+		std::swap(m_capacity, other.m_capacity);
+	}
+
+	size_t slab_count() const noexcept { return m_slab_count; }
+	///< 所有slab一共向系统申请了多少字节
+	size_t bytes() const noexcept { return m_slab_count * HEADER_SIZE + m_capacity * sizeof(block); }
+
+private:
+	union block {
+		block* next;
+		alignas(Node) unsigned char storage[sizeof(Node)];
+	};
+	struct slab {
+		slab* next;
+	};
+
+	constexpr static size_t SLAB_ALIGN = alignof(block) > alignof(slab) ? alignof(block) : alignof(slab);
+	///< slab头后面紧跟着节点数组
+	constexpr static size_t HEADER_SIZE = (sizeof(slab) + alignof(block) - 1) / alignof(block) * alignof(block);
+
+	void give_back(block* chain) noexcept {
+		while (chain) {
+			block* next = chain->next;
+			chain->next = m_free;
+			m_free = chain;
+			chain = next;
+		}
+	}
+
+	void new_slab() {
+		size_t capacity = m_next_capacity;
+		void* mem = ::operator new(HEADER_SIZE + capacity * sizeof(block), std::align_val_t(SLAB_ALIGN));
+		slab* s = static_cast<slab*>(mem);
+		s->next = m_slabs;
+		m_slabs = s;
+		m_bump = reinterpret_cast<block*>(static_cast<unsigned char*>(mem) + HEADER_SIZE);
+		m_bump_end = m_bump + capacity;
+		if (m_next_capacity < MAX_SLAB) {
+			m_next_capacity *= 2;
+		}
+		++m_slab_count;
+		m_capacity += capacity;
+	}
+
+private:
+	block* m_free;				///< 空闲链表
+	slab* m_slabs;				///< 所有slab，最新的在最前面
+	block* m_bump;				///< 最新slab里下一个没用过的节点
+	block* m_bump_end;
+	size_t m_next_capacity;		///< 下一个slab能放几个节点
+	size_t m_slab_count;
+	size_t m_capacity;			///< 所有slab一共能放几个节点
+};
+
+} //namespace nano
@@ -205,12 +205,12 @@ void rb_erase_fixup(rb_tree_node<T>* node, rb_tree_node<T>** root) {
 				brother = right_of(parent_of(node));
 			} else if (NodeColor::BLACK == color_of(brother) &&
 				NodeColor::BLACK == color_of(left_of(brother)) && 
-                NodeColor::BLACK == color_of(right_of(node))) {
+                NodeColor::BLACK == color_of(right_of(brother))) {
 				set_color(brother, NodeColor::RED);
 				node = parent_of(node);
 			} else if (NodeColor::BLACK == color_of(brother) &&
 				(NodeColor::RED == color_of(left_of(brother)) || 
-                NodeColor::RED == color_of(right_of(node)))) {
+                NodeColor::RED == color_of(right_of(brother)))) {
 				if (NodeColor::BLACK == color_of(right_of(brother))) {
 					set_color(brother, NodeColor::RED);
 					set_color(left_of(brother), NodeColor::BLACK);
@@ -232,12 +232,12 @@ void rb_erase_fixup(rb_tree_node<T>* node, rb_tree_node<T>** root) {
 				brother = left_of(parent_of(node));
 			} else if (NodeColor::BLACK == color_of(brother) &&
 				NodeColor::BLACK == color_of(left_of(brother)) && 
-                NodeColor::BLACK == color_of(right_of(node))) {
+                NodeColor::BLACK == color_of(right_of(brother))) {
 				set_color(brother, NodeColor::RED);
 				node = parent_of(node);
 			} else if (NodeColor::BLACK == color_of(brother) &&
 				(NodeColor::RED == color_of(left_of(brother)) || 
-                NodeColor::RED == color_of(right_of(node)))) {
+                NodeColor::RED == color_of(right_of(brother)))) {
 				if (NodeColor::BLACK == color_of(left_of(brother))) {
 					set_color(brother, NodeColor::RED);
 					set_color(right_of(brother), NodeColor::BLACK);
@@ -287,9 +287,10 @@ std::pair<rb_tree_node<T>*, bool> rb_insert_node_unique(rb_tree_node<T>* node,
  * @tparam T 
  * @param node 
  * @param root 
+ * @tparam keepNode 为true时不移动元素，真正删掉的一定是node本身(节点要交给别人时用)
  * @return rb_tree_node<T>* 目标删除节点的后继节点，以及被删除的节点
  */
-template<typename T>
+template<typename T, bool keepNode = false>
 std::pair<rb_tree_node<T>*, rb_tree_node<T>*>
 rb_erase_node(rb_tree_node<T>* node, rb_tree_node<T>** root) {
 	NodeColor ncolor = color_of(node);
@@ -299,12 +300,14 @@ rb_erase_node(rb_tree_node<T>* node, rb_tree_node<T>** root) {
     // 交换要删除的节点和后继节点的位置
     // 转化为只有右孩子的情况
     if (left_of(node) && right_of(node)) { 
-		if constexpr(std::is_move_assignable_v<T>) {
+		if constexpr(std::is_move_assignable_v<T> && !keepNode) {
 			node->value = std::move(nsuccessor->value);
 			//交换node和nsuccessor, 或者写std::swap(node, nsuccessor);
 			repNode = nsuccessor;
 			nsuccessor = node;
 			node = repNode;
+			//真正删掉的是后继节点，要按它的颜色调整
+			ncolor = color_of(node);
 		} else {
 			rb_tree_node<T>* sparent = parent_of(nsuccessor);
 			rb_tree_node<T>* srchild = right_of(nsuccessor);
@@ -330,6 +333,11 @@ rb_erase_node(rb_tree_node<T>* node, rb_tree_node<T>** root) {
 					srchild->parent = node;
 				}
 			}
+			//位置换了，颜色也要跟着位置换，真正删掉的还是node
+			NodeColor scolor = color_of(nsuccessor);
+			set_color(nsuccessor, ncolor);
+			set_color(node, scolor);
+			ncolor = scolor;
 		}
     }
 	/**
@@ -0,0 +1,779 @@
+/**
+ * @file sketch.h
+ * @brief 概率数据结构: 分块布隆过滤器、cuckoo过滤器、HyperLogLog、Count-Min sketch
+ * 		  都用hash_value<T>(或者自定义的Hash)算一个64位的hash，参数和种子相同的两个
+ * 		  sketch可以合并，也可以序列化成字符串再读回来
+ * 		  序列化的格式是固定长度的头部加上原样拷贝的数组，只能在字节序相同的机器上读
+ * @date 2022-06-08
+ * @copyright Copyright (c) 2022
+ */
+#pragma once
+
+#include "hash.h"
+#include "system.h"
+#include <vector>
+#include <string>
+#include <string_view>
+#include <stdexcept>
+#include <algorithm>
+#include <bit>
+#include <cmath>
+#include <stdint.h>
+#include <string.h>
+
+#if defined(__AVX2__)
+#define SKETCH_AVX2
+#include <immintrin.h>
+#endif //__AVX2__
+
+namespace nano {
+
+/**
+ * @brief 不依赖元素类型的部分，非内联的函数在sketch.cc里
+ */
+namespace sketch_detail {
+
+enum class sketch_kind : uint32_t {
+	bloom = 1,
+	cuckoo = 2,
+	hyperloglog = 3,
+	count_min = 4,
+};
+
+/**
+ * @brief 序列化的头部，后面紧跟payload_size字节的数组
+ */
+struct sketch_header {
+	constexpr static size_t PARAM_COUNT = 4;
+
+	char magic[8];
+	uint32_t version;
+	uint32_t kind;
+	uint64_t params[PARAM_COUNT];		///< 每种sketch自己解释
+	uint64_t seed;
+	uint64_t payload_size;
+};
+
+/**
+ * @brief 把头部和数组追加到out后面
+ */
+void write_sketch(std::string& out, sketch_kind kind, const uint64_t* params,
+		uint64_t seed, const void* payload, size_t size);
+/**
+ * @brief 检查头部，返回头部后面的数组
+ * @throw std::invalid_argument 魔数、版本、种类不对，或者长度和头部里记的不一致
+ */
+std::string_view read_sketch(std::string_view in, sketch_kind kind, sketch_header& header);
+
+/**
+ * @brief 下面三个用来合并，运行时根据cpu选择AVX2/SSE2/标量实现
+ * 		  dst[i] |= src[i]
+ */
+void or_words(uint64_t* dst, const uint64_t* src, size_t n) noexcept;
+/**
+ * @brief dst[i] = max(dst[i], src[i])
+ */
+void max_bytes(uint8_t* dst, const uint8_t* src, size_t n) noexcept;
+/**
+ * @brief dst[i] += src[i]，溢出时停在UINT32_MAX
+ */
+void add_saturate(uint32_t* dst, const uint32_t* src, size_t n) noexcept;
+
+/**
+ * @brief 插入expectedCount个元素以后误判率不超过fpp需要多少个块，至少一个
+ * @throw std::invalid_argument fpp不在(0, 1)里
+ */
+size_t bloom_block_count(size_t expectedCount, double fpp);
+/**
+ * @brief 批量检查，out[i]为true表示blocks[i]里key[i]的8位都是1，AVX2时一次检查一个块
+ */
+void bloom_check_batch(const uint32_t* const* blocks, const uint32_t* keys,
+		size_t n, bool* out) noexcept;
+/**
+ * @brief HyperLogLog的估计值，小范围用线性计数修正
+ * 		  hash是64位的，不需要大范围修正
+ */
+double hll_estimate(const uint8_t* registers, unsigned precision) noexcept;
+
+/**
+ * @brief sketch要用到hash值的高位和低位，32位平台上hash_value只有32位，再混合一次扩展成64位
+ */
+template<typename T, typename Hash>
+inline uint64_t sketch_hash(const T& value, uint64_t seed) noexcept {
+#ifdef BIT32
+	return hash_detail::splitmix64(Hash()(value, static_cast<size_t>(seed)) ^ (seed << 32));
+#else
+	return Hash()(value, seed);
+#endif //BIT32
+}
+
+/**
+ * @brief 把x均匀地映射到[0, n)，比取模快，只用x的低32位
+ */
+inline size_t fast_range(uint64_t x, size_t n) noexcept {
+	return static_cast<size_t>(((x & 0xffffffffULL) * n) >> 32);
+}
+
+/**
+ * @brief 一个块256位，8个32位的字，插入时每个字置一位，
+ * 		  第i个字的位是key * BLOOM_SALT[i]的高5位
+ * 		  https://github.com/apache/parquet-format/blob/master/BloomFilter.md
+ */
+struct alignas(32) bloom_block {
+	uint32_t words[8];
+};
+
+alignas(32) inline constexpr uint32_t BLOOM_SALT[8] = {
+	0x47b6137bU, 0x44974d91U, 0x8824ad5bU, 0xa2b7289dU,
+	0x705495c7U, 0x2df1424bU, 0x9efc4947U, 0x5c6bfb31U
+};
+
+#ifdef SKETCH_AVX2
+inline __m256i bloom_mask(uint32_t key) noexcept {
+	const __m256i salt = _mm256_load_si256(reinterpret_cast<const __m256i*>(BLOOM_SALT));
+	__m256i bits = _mm256_srli_epi32(_mm256_mullo_epi32(_mm256_set1_epi32(key), salt), 27);
+	return _mm256_sllv_epi32(_mm256_set1_epi32(1), bits);
+}
+#endif //SKETCH_AVX2
+
+inline void bloom_set(bloom_block& block, uint32_t key) noexcept {
+#ifdef SKETCH_AVX2
+	__m256i* words = reinterpret_cast<__m256i*>(block.words);
+	_mm256_store_si256(words, _mm256_or_si256(_mm256_load_si256(words), bloom_mask(key)));
+#else
+	for (size_t i = 0; i != 8; ++i) {
+		block.words[i] |= 1U << ((key * BLOOM_SALT[i]) >> 27);
+	}
+#endif //SKETCH_AVX2
+}
+
+inline bool bloom_check(const bloom_block& block, uint32_t key) noexcept {
+#ifdef SKETCH_AVX2
+	__m256i words = _mm256_load_si256(reinterpret_cast<const __m256i*>(block.words));
+	return _mm256_testc_si256(words, bloom_mask(key));
+#else
+	//没有分支，8个字都看完
+	uint32_t missing = 0;
+	for (size_t i = 0; i != 8; ++i) {
+		missing |= ~block.words[i] & (1U << ((key * BLOOM_SALT[i]) >> 27));
+	}
+	return !missing;
+#endif //SKETCH_AVX2
+}
+
+} //namespace sketch_detail
+
+/**
+ * @brief 分块布隆过滤器(split block bloom filter)
+ * 		  hash的高32位选一个32字节的块，低32位在块里的8个字各置一位，
+ * 		  插入、查找都只碰一个cache line，比标准布隆过滤器多一点误判
+ * 		  只能插入不能删除
+ */
+template<typename T, typename Hash = hash_value<T>>
+class blocked_bloom_filter {
+public:
+	using value_type = T;
+	using hasher = Hash;
+	using size_type = size_t;
+
+	/**
+	 * @param expectedCount 预计插入的元素个数
+	 * @param fpp 插入expectedCount个元素以后期望的误判率
+	 * @throw std::invalid_argument fpp不在(0, 1)里
+	 */
+	explicit blocked_bloom_filter(size_type expectedCount, double fpp = 0.01, uint64_t seed = 0) :
+			m_blocks(sketch_detail::bloom_block_count(expectedCount, fpp)),
+			m_seed(seed) {
+		clear();
+	}
+
+	void insert(const value_type& value) noexcept {
+		uint64_t h = sketch_detail::sketch_hash<T, Hash>(value, m_seed);
+		sketch_detail::bloom_set(m_blocks[block_index(h)], static_cast<uint32_t>(h));
+	}
+	/**
+	 * @return false表示一定没有插入过，true表示可能插入过
+	 */
+	bool contains(const value_type& value) const noexcept {
+		uint64_t h = sketch_detail::sketch_hash<T, Hash>(value, m_seed);
+		return sketch_detail::bloom_check(m_blocks[block_index(h)], static_cast<uint32_t>(h));
+	}
+	/**
+	 * @brief 批量查找，out[i] = contains(values[i])
+	 * 		  每BATCH_SIZE个一组，先算hash并预取块，再一起检查
+	 */
+	void contains_batch(const value_type* values, size_type n, bool* out) const noexcept;
+	/**
+	 * @brief 按位或，之后包含两边插入过的所有元素
+	 * @throw std::invalid_argument 块数或者种子不同
+	 */
+	void merge(const blocked_bloom_filter& other);
+	void clear() noexcept {
+		memset(m_blocks.data(), 0, bytes());
+	}
+
+	size_type block_count() const noexcept { return m_blocks.size(); }
+	size_type bytes() const noexcept { return m_blocks.size() * sizeof(sketch_detail::bloom_block); }
+	uint64_t seed() const noexcept { return m_seed; }
+
+	std::string serialize() const;
+	/**
+	 * @throw std::invalid_argument 格式不对
+	 */
+	static blocked_bloom_filter deserialize(std::string_view data);
+
+private:
+	constexpr static size_type BATCH_SIZE = 16;
+
+	blocked_bloom_filter(std::vector<sketch_detail::bloom_block>&& blocks, uint64_t seed) noexcept :
+			m_blocks(std::move(blocks)),
+			m_seed(seed) {
+	}
+
+	size_type block_index(uint64_t h) const noexcept {
+		return sketch_detail::fast_range(h >> 32, m_blocks.size());
+	}
+
+	std::vector<sketch_detail::bloom_block> m_blocks;
+	uint64_t m_seed;
+};
+
+template<typename T, typename Hash>
+void blocked_bloom_filter<T, Hash>::contains_batch(const value_type* values, size_type n,
+		bool* out) const noexcept {
+	const uint32_t* blocks[BATCH_SIZE];
+	uint32_t keys[BATCH_SIZE];
+	for (size_type first = 0; first < n; first += BATCH_SIZE) {
+		size_type count = std::min(BATCH_SIZE, n - first);
+		for (size_type i = 0; i != count; ++i) {
+			uint64_t h = sketch_detail::sketch_hash<T, Hash>(values[first + i], m_seed);
+			blocks[i] = m_blocks[block_index(h)].words;
+			keys[i] = static_cast<uint32_t>(h);
+			NANO_PREFETCH(blocks[i]);
+		}
+		sketch_detail::bloom_check_batch(blocks, keys, count, out + first);
+	}
+}
+
+template<typename T, typename Hash>
+void blocked_bloom_filter<T, Hash>::merge(const blocked_bloom_filter& other) {
+	if (m_blocks.size() != other.m_blocks.size() || m_seed != other.m_seed) {
+		throw std::invalid_argument("blocked_bloom_filter::merge: size or seed mismatch");
+	}
+	sketch_detail::or_words(reinterpret_cast<uint64_t*>(m_blocks.data()),
+		reinterpret_cast<const uint64_t*>(other.m_blocks.data()), bytes() / sizeof(uint64_t));
+}
+
+template<typename T, typename Hash>
+std::string blocked_bloom_filter<T, Hash>::serialize() const {
+	uint64_t params[sketch_detail::sketch_header::PARAM_COUNT] = { m_blocks.size() };
+	std::string out;
+	sketch_detail::write_sketch(out, sketch_detail::sketch_kind::bloom, params, m_seed,
+		m_blocks.data(), bytes());
+	return out;
+}
+
+template<typename T, typename Hash>
+blocked_bloom_filter<T, Hash> blocked_bloom_filter<T, Hash>::deserialize(std::string_view data) {
+	sketch_detail::sketch_header header;
+	std::string_view payload = sketch_detail::read_sketch(data, sketch_detail::sketch_kind::bloom, header);
+	//用除法比较，块数乘出来溢出时也对不上
+	if (header.params[0] == 0 || payload.size() % sizeof(sketch_detail::bloom_block) != 0
+			|| payload.size() / sizeof(sketch_detail::bloom_block) != header.params[0]) {
+		throw std::invalid_argument("blocked_bloom_filter::deserialize: bad block count");
+	}
+	std::vector<sketch_detail::bloom_block> blocks(header.params[0]);
+	memcpy(blocks.data(), payload.data(), payload.size());
+	return blocked_bloom_filter(std::move(blocks), header.seed);
+}
+
+/**
+ * @brief cuckoo过滤器，每个桶4个16位的指纹，可以删除
+ * 		  指纹取hash的高16位，两个候选桶i2 = i1 ^ hash(指纹)，只凭指纹就能算出另一个桶，
+ * 		  所以搬动指纹不需要原来的元素；一个桶的4个指纹放在一个64位整数里，一次比较完
+ * 		  桶都满了时最多踢MAX_KICKS次，还放不下就把最后被踢出来的指纹存在victim里，
+ * 		  之后的插入都返回false，已经插入的元素不会查不到
+ * 		  误判率约为8 / 2^16；同一个元素最多插入8次(两个桶的槽数)，只能删除插入过的元素
+ */
+template<typename T, typename Hash = hash_value<T>>
+class cuckoo_filter {
+public:
+	using value_type = T;
+	using hasher = Hash;
+	using size_type = size_t;
+
+	/**
+	 * @param expectedCount 预计插入的元素个数，按95%的装载率分配桶
+	 */
+	explicit cuckoo_filter(size_type expectedCount, uint64_t seed = 0) :
+			cuckoo_filter(std::bit_ceil(std::max<size_type>(1,
+				static_cast<size_type>(expectedCount / (SLOTS * 0.95)) + 1)), seed, 0) {
+	}
+
+	/**
+	 * @return false表示过滤器满了，这时元素没有插入
+	 */
+	bool insert(const value_type& value) noexcept {
+		if (m_victim_fp) {
+			return false;
+		}
+		uint64_t h = sketch_detail::sketch_hash<T, Hash>(value, m_seed);
+		add(static_cast<size_type>(h) & m_mask, fingerprint(h));
+		return true;
+	}
+	bool contains(const value_type& value) const noexcept {
+		uint64_t h = sketch_detail::sketch_hash<T, Hash>(value, m_seed);
+		uint16_t fp = fingerprint(h);
+		size_type i1 = static_cast<size_type>(h) & m_mask;
+		size_type i2 = alt_index(i1, fp);
+		return match(m_buckets[i1], fp) | match(m_buckets[i2], fp)
+			| (m_victim_fp == fp && (m_victim_index == i1 || m_victim_index == i2));
+	}
+	/**
+	 * @brief 删除一个指纹，元素必须插入过，不然可能删掉别的元素的指纹
+	 * @return 找到并删除了返回true
+	 */
+	bool erase(const value_type& value) noexcept;
+	/**
+	 * @brief 把other的指纹都插进来
+	 * @throw std::invalid_argument 桶数或者种子不同
+	 * @throw std::length_error 放不下，这时已经插入了一部分
+	 */
+	void merge(const cuckoo_filter& other);
+	void clear() noexcept {
+		std::fill(m_buckets.begin(), m_buckets.end(), 0);
+		m_size = 0;
+		m_victim_fp = 0;
+		m_victim_index = 0;
+	}
+
+	size_type size() const noexcept { return m_size; }
+	bool empty() const noexcept { return 0 == m_size; }
+	size_type bucket_count() const noexcept { return m_buckets.size(); }
+	size_type capacity() const noexcept { return m_buckets.size() * SLOTS; }
+	float load_factor() const noexcept { return static_cast<float>(m_size) / capacity(); }
+	size_type bytes() const noexcept { return m_buckets.size() * sizeof(uint64_t); }
+	uint64_t seed() const noexcept { return m_seed; }
+
+	std::string serialize() const;
+	/**
+	 * @throw std::invalid_argument 格式不对
+	 */
+	static cuckoo_filter deserialize(std::string_view data);
+
+private:
+	constexpr static size_type SLOTS = 4;
+	constexpr static size_type MAX_KICKS = 500;
+	constexpr static uint64_t LOW_BITS = 0x0001000100010001ULL;
+	constexpr static uint64_t HIGH_BITS = 0x8000800080008000ULL;
+
+	cuckoo_filter(size_type bucketCount, uint64_t seed, int) :
+			m_buckets(bucketCount, 0),
+			m_mask(bucketCount - 1),
+			m_size(0),
+			m_seed(seed),
+			m_rng(seed ^ 0x9e3779b97f4a7c15ULL),
+			m_victim_index(0),
+			m_victim_fp(0) {
+	}
+
+	//0表示空槽
+	static uint16_t fingerprint(uint64_t h) noexcept {
+		uint16_t fp = static_cast<uint16_t>(h >> 48);
+		return fp + (fp == 0);
+	}
+	size_type alt_index(size_type index, uint16_t fp) const noexcept {
+		return (index ^ static_cast<size_type>(fp * 0x5bd1e995U)) & m_mask;
+	}
+	/**
+	 * @brief 每个等于fp的槽的最高位为1，最低的那个是准的，更高的可能被借位误报，
+	 * 		  只用来判断有没有和找第一个
+	 */
+	static uint64_t match(uint64_t bucket, uint16_t fp) noexcept {
+		uint64_t v = bucket ^ (LOW_BITS * fp);
+		return (v - LOW_BITS) & ~v & HIGH_BITS;
+	}
+	static uint16_t slot(uint64_t bucket, size_type i) noexcept {
+		return static_cast<uint16_t>(bucket >> (i * 16));
+	}
+	static void set_slot(uint64_t& bucket, size_type i, uint16_t fp) noexcept {
+		bucket = (bucket & ~(0xffffULL << (i * 16))) | (static_cast<uint64_t>(fp) << (i * 16));
+	}
+	bool try_add(size_type index, uint16_t fp) noexcept {
+		uint64_t empty = match(m_buckets[index], 0);
+		if (!empty) {
+			return false;
+		}
+		set_slot(m_buckets[index], std::countr_zero(empty) / 16, fp);
+		return true;
+	}
+	bool try_remove(size_type index, uint16_t fp) noexcept {
+		uint64_t found = match(m_buckets[index], fp);
+		if (!found) {
+			return false;
+		}
+		set_slot(m_buckets[index], std::countr_zero(found) / 16, 0);
+		return true;
+	}
+	uint64_t next_random() noexcept {
+		//xorshift64
+		m_rng ^= m_rng << 13;
+		m_rng ^= m_rng >> 7;
+		m_rng ^= m_rng << 17;
+		return m_rng;
+	}
+	/**
+	 * @brief 调用前m_victim_fp必须是0
+	 */
+	void add(size_type index, uint16_t fp) noexcept;
+
+	std::vector<uint64_t> m_buckets;
+	size_type m_mask;
+	size_type m_size;
+	uint64_t m_seed;
+	uint64_t m_rng;						///< 踢哪个槽
+	size_type m_victim_index;
+	uint16_t m_victim_fp;				///< 放不下的指纹，0表示没有
+};
+
+template<typename T, typename Hash>
+void cuckoo_filter<T, Hash>::add(size_type index, uint16_t fp) noexcept {
+	++m_size;
+	if (try_add(index, fp)) {
+		return;
+	}
+	index = alt_index(index, fp);
+	for (size_type kick = 0; kick != MAX_KICKS; ++kick) {
+		if (try_add(index, fp)) {
+			return;
+		}
+		//随机踢出一个，被踢的指纹去它的另一个桶
+		size_type i = next_random() % SLOTS;
+		uint16_t victim = slot(m_buckets[index], i);
+		set_slot(m_buckets[index], i, fp);
+		fp = victim;
+		index = alt_index(index, fp);
+	}
+	m_victim_index = index;
+	m_victim_fp = fp;
+}
+
+template<typename T, typename Hash>
+bool cuckoo_filter<T, Hash>::erase(const value_type& value) noexcept {
+	uint64_t h = sketch_detail::sketch_hash<T, Hash>(value, m_seed);
+	uint16_t fp = fingerprint(h);
+	size_type i1 = static_cast<size_type>(h) & m_mask;
+	size_type i2 = alt_index(i1, fp);
+	if (m_victim_fp == fp && (m_victim_index == i1 || m_victim_index == i2)) {
+		m_victim_fp = 0;
+		--m_size;
+		return true;
+	}
+	if (!try_remove(i1, fp) && !try_remove(i2, fp)) {
+		return false;
+	}
+	--m_size;
+	//空出了一个槽，把victim放回去
+	if (m_victim_fp) {
+		uint16_t victim = m_victim_fp;
+		m_victim_fp = 0;
+		--m_size;
+		add(m_victim_index, victim);
+	}
+	return true;
+}
+
+template<typename T, typename Hash>
+void cuckoo_filter<T, Hash>::merge(const cuckoo_filter& other) {
+	if (m_buckets.size() != other.m_buckets.size() || m_seed != other.m_seed) {
+		throw std::invalid_argument("cuckoo_filter::merge: size or seed mismatch");
+	}
+	auto merge_one = [this](size_type index, uint16_t fp) {
+		if (m_victim_fp) {
+			throw std::length_error("cuckoo_filter::merge: filter is full");
+		}
+		add(index, fp);
+	};
+	for (size_type index = 0; index != other.m_buckets.size(); ++index) {
+		for (size_type i = 0; i != SLOTS; ++i) {
+			if (uint16_t fp = slot(other.m_buckets[index], i)) {
+				merge_one(index, fp);
+			}
+		}
+	}
+	if (other.m_victim_fp) {
+		merge_one(other.m_victim_index, other.m_victim_fp);
+	}
+}
+
+template<typename T, typename Hash>
+std::string cuckoo_filter<T, Hash>::serialize() const {
+	uint64_t params[sketch_detail::sketch_header::PARAM_COUNT] = {
+		m_buckets.size(), m_size, m_victim_index, m_victim_fp
+	};
+	std::string out;
+	sketch_detail::write_sketch(out, sketch_detail::sketch_kind::cuckoo, params, m_seed,
+		m_buckets.data(), bytes());
+	return out;
+}
+
+template<typename T, typename Hash>
+cuckoo_filter<T, Hash> cuckoo_filter<T, Hash>::deserialize(std::string_view data) {
+	sketch_detail::sketch_header header;
+	std::string_view payload = sketch_detail::read_sketch(data, sketch_detail::sketch_kind::cuckoo, header);
+	uint64_t bucketCount = header.params[0];
+	//先核对数据长度，后面乘SLOTS就不会溢出
+	if (!std::has_single_bit(bucketCount) || payload.size() % sizeof(uint64_t) != 0
+			|| payload.size() / sizeof(uint64_t) != bucketCount
+			|| header.params[1] > bucketCount * SLOTS + 1
+			|| header.params[2] >= bucketCount || header.params[3] > 0xffff) {
+		throw std::invalid_argument("cuckoo_filter::deserialize: bad parameters");
+	}
+	cuckoo_filter filter(bucketCount, header.seed, 0);
+	memcpy(filter.m_buckets.data(), payload.data(), payload.size());
+	filter.m_size = header.params[1];
+	filter.m_victim_index = header.params[2];
+	filter.m_victim_fp = static_cast<uint16_t>(header.params[3]);
+	return filter;
+}
+
+/**
+ * @brief HyperLogLog基数估计，2^precision个8位的寄存器
+ * 		  hash的高precision位选寄存器，剩下的位里第一个1的位置(从1开始)取最大值
+ * 		  标准误差约为1.04 / sqrt(2^precision)，precision = 14时0.81%，占16KB
+ */
+template<typename T, typename Hash = hash_value<T>>
+class hyperloglog {
+public:
+	using value_type = T;
+	using hasher = Hash;
+	using size_type = size_t;
+
+	constexpr static unsigned MIN_PRECISION = 4;
+	constexpr static unsigned MAX_PRECISION = 18;
+
+	/**
+	 * @throw std::invalid_argument precision不在[MIN_PRECISION, MAX_PRECISION]里
+	 */
+	explicit hyperloglog(unsigned precision = 14, uint64_t seed = 0) :
+			m_registers(checked_size(precision), 0),
+			m_precision(precision),
+			m_seed(seed) {
+	}
+
+	void insert(const value_type& value) noexcept {
+		uint64_t h = sketch_detail::sketch_hash<T, Hash>(value, m_seed);
+		size_type index = static_cast<size_type>(h >> (64 - m_precision));
+		//最后补一个1，全0时rank最大是64 - precision + 1
+		uint64_t rest = (h << m_precision) | (1ULL << (m_precision - 1));
+		uint8_t rank = static_cast<uint8_t>(std::countl_zero(rest) + 1);
+		m_registers[index] = std::max(m_registers[index], rank);
+	}
+	double estimate() const noexcept {
+		return sketch_detail::hll_estimate(m_registers.data(), m_precision);
+	}
+	/**
+	 * @brief 寄存器逐个取最大值，之后估计的是两边的并集
+	 * @throw std::invalid_argument 精度或者种子不同
+	 */
+	void merge(const hyperloglog& other) {
+		if (m_precision != other.m_precision || m_seed != other.m_seed) {
+			throw std::invalid_argument("hyperloglog::merge: precision or seed mismatch");
+		}
+		sketch_detail::max_bytes(m_registers.data(), other.m_registers.data(), m_registers.size());
+	}
+	void clear() noexcept {
+		std::fill(m_registers.begin(), m_registers.end(), 0);
+	}
+
+	unsigned precision() const noexcept { return m_precision; }
+	size_type bytes() const noexcept { return m_registers.size(); }
+	uint64_t seed() const noexcept { return m_seed; }
+
+	std::string serialize() const {
+		uint64_t params[sketch_detail::sketch_header::PARAM_COUNT] = { m_precision };
+		std::string out;
+		sketch_detail::write_sketch(out, sketch_detail::sketch_kind::hyperloglog, params, m_seed,
+			m_registers.data(), bytes());
+		return out;
+	}
+	/**
+	 * @throw std::invalid_argument 格式不对
+	 */
+	static hyperloglog deserialize(std::string_view data) {
+		sketch_detail::sketch_header header;
+		std::string_view payload = sketch_detail::read_sketch(data,
+			sketch_detail::sketch_kind::hyperloglog, header);
+		if (header.params[0] > MAX_PRECISION) {
+			throw std::invalid_argument("hyperloglog::deserialize: bad precision");
+		}
+		hyperloglog hll(static_cast<unsigned>(header.params[0]), header.seed);
+		if (payload.size() != hll.bytes()) {
+			throw std::invalid_argument("hyperloglog::deserialize: bad register count");
+		}
+		memcpy(hll.m_registers.data(), payload.data(), payload.size());
+		return hll;
+	}
+
+private:
+	static size_type checked_size(unsigned precision) {
+		if (precision < MIN_PRECISION || precision > MAX_PRECISION) {
+			throw std::invalid_argument("hyperloglog: precision out of range");
+		}
+		return size_type(1) << precision;
+	}
+
+	std::vector<uint8_t> m_registers;
+	unsigned m_precision;
+	uint64_t m_seed;
+};
+
+/**
+ * @brief Count-Min sketch，depth行、每行width个32位计数器
+ * 		  每行用h1 + i * h2选一个计数器，估计值取各行的最小值，只会多估不会少估，
+ * 		  多估的部分以1 - (1/e)^depth的概率不超过total() * e / width
+ */
+template<typename T, typename Hash = hash_value<T>>
+class count_min_sketch {
+public:
+	using value_type = T;
+	using hasher = Hash;
+	using size_type = size_t;
+
+	/**
+	 * @param width 每行的计数器个数，不超过2^32
+	 * @throw std::invalid_argument width或者depth为0，或者width太大
+	 */
+	count_min_sketch(size_type width, size_type depth, uint64_t seed = 0) :
+			m_counters(checked_size(width, depth), 0),
+			m_width(width),
+			m_depth(depth),
+			m_total(0),
+			m_seed(seed) {
+	}
+	/**
+	 * @brief 按误差要求选宽度和行数: width = e / epsilon, depth = ln(1 / delta)
+	 * @param epsilon 多估的部分不超过total() * epsilon
+	 * @param delta 超过的概率
+	 */
+	static count_min_sketch from_error(double epsilon, double delta, uint64_t seed = 0);
+
+	void insert(const value_type& value, uint32_t count = 1) noexcept;
+	uint32_t estimate(const value_type& value) const noexcept;
+	/**
+	 * @brief 计数器逐个相加
+	 * @throw std::invalid_argument 宽度、行数或者种子不同
+	 */
+	void merge(const count_min_sketch& other);
+	void clear() noexcept {
+		std::fill(m_counters.begin(), m_counters.end(), 0);
+		m_total = 0;
+	}
+
+	size_type width() const noexcept { return m_width; }
+	size_type depth() const noexcept { return m_depth; }
+	///< 所有insert的count之和
+	uint64_t total() const noexcept { return m_total; }
+	size_type bytes() const noexcept { return m_counters.size() * sizeof(uint32_t); }
+	uint64_t seed() const noexcept { return m_seed; }
+
+	std::string serialize() const;
+	/**
+	 * @throw std::invalid_argument 格式不对
+	 */
+	static count_min_sketch deserialize(std::string_view data);
+
+private:
+	constexpr static size_type MAX_WIDTH = size_type(1) << 32;
+
+	static size_type checked_size(size_type width, size_type depth) {
+		if (0 == width || 0 == depth || width > MAX_WIDTH || depth > MAX_WIDTH / width) {
+			throw std::invalid_argument("count_min_sketch: bad width or depth");
+		}
+		return width * depth;
+	}
+
+	/**
+	 * @brief 对value的hash依次调用f(第i行的计数器)
+	 */
+	template<typename Func>
+	void for_each_row(const value_type& value, const Func& f) const noexcept {
+		uint64_t h1 = sketch_detail::sketch_hash<T, Hash>(value, m_seed);
+		uint64_t h2 = hash_detail::splitmix64(h1) | 1;
+		for (size_type i = 0; i != m_depth; ++i, h1 += h2) {
+			f(i * m_width + sketch_detail::fast_range(h1, m_width));
+		}
+	}
+
+	std::vector<uint32_t> m_counters;
+	size_type m_width;
+	size_type m_depth;
+	uint64_t m_total;
+	uint64_t m_seed;
+};
+
+template<typename T, typename Hash>
+count_min_sketch<T, Hash> count_min_sketch<T, Hash>::from_error(double epsilon, double delta,
+		uint64_t seed) {
+	if (!(epsilon > 0.0 && epsilon < 1.0) || !(delta > 0.0 && delta < 1.0)) {
+		throw std::invalid_argument("count_min_sketch::from_error: epsilon and delta must be in (0, 1)");
+	}
+	constexpr double E = 2.718281828459045;
+	return count_min_sketch(static_cast<size_type>(std::ceil(E / epsilon)),
+		static_cast<size_type>(std::ceil(std::log(1.0 / delta))), seed);
+}
+
+template<typename T, typename Hash>
+void count_min_sketch<T, Hash>::insert(const value_type& value, uint32_t count) noexcept {
+	m_total += count;
+	uint32_t* counters = m_counters.data();
+	for_each_row(value, [counters, count](size_type index) {
+		uint32_t sum = counters[index] + count;
+		counters[index] = sum < count ? UINT32_MAX : sum;
+	});
+}
+
+template<typename T, typename Hash>
+uint32_t count_min_sketch<T, Hash>::estimate(const value_type& value) const noexcept {
+	uint32_t result = UINT32_MAX;
+	const uint32_t* counters = m_counters.data();
+	for_each_row(value, [counters, &result](size_type index) {
+		result = std::min(result, counters[index]);
+	});
+	return result;
+}
+
+template<typename T, typename Hash>
+void count_min_sketch<T, Hash>::merge(const count_min_sketch& other) {
+	if (m_width != other.m_width || m_depth != other.m_depth || m_seed != other.m_seed) {
+		throw std::invalid_argument("count_min_sketch::merge: size or seed mismatch");
+	}
+	sketch_detail::add_saturate(m_counters.data(), other.m_counters.data(), m_counters.size());
+	m_total += other.m_total;
+}
+
+template<typename T, typename Hash>
+std::string count_min_sketch<T, Hash>::serialize() const {
+	uint64_t params[sketch_detail::sketch_header::PARAM_COUNT] = { m_width, m_depth, m_total };
+	std::string out;
+	sketch_detail::write_sketch(out, sketch_detail::sketch_kind::count_min, params, m_seed,
+		m_counters.data(), bytes());
+	return out;
+}
+
+template<typename T, typename Hash>
+count_min_sketch<T, Hash> count_min_sketch<T, Hash>::deserialize(std::string_view data) {
+	sketch_detail::sketch_header header;
+	std::string_view payload = sketch_detail::read_sketch(data, sketch_detail::sketch_kind::count_min, header);
+	//头部是不可信的，先和数据长度核对再申请计数器
+	size_type counters = checked_size(header.params[0], header.params[1]);
+	if (payload.size() % sizeof(uint32_t) != 0 || payload.size() / sizeof(uint32_t) != counters) {
+		throw std::invalid_argument("count_min_sketch::deserialize: bad counter count");
+	}
+	count_min_sketch sketch(header.params[0], header.params[1], header.seed);
+	memcpy(sketch.m_counters.data(), payload.data(), payload.size());
+	sketch.m_total = header.params[2];
+	return sketch;
+}
+
+} //namespace nano
@@ -20,4 +20,17 @@
 #define BIT64
 #else
 #define BIT32
-#endif //BIT_SIZE
\ No newline at end of file
+#endif //BIT_SIZE
+
+//提前把addr所在的cache line读到cache里，不阻塞
+#if defined(__GNUC__) || defined(__clang__)
+#define NANO_PREFETCH(addr) __builtin_prefetch(addr)
+#elif defined(_MSC_VER)
+#include <xmmintrin.h>
+#define NANO_PREFETCH(addr) _mm_prefetch(reinterpret_cast<const char*>(addr), _MM_HINT_T0)
+#else
+#define NANO_PREFETCH(addr)
+#endif //__GNUC__
+
+//按cache line对齐可以避免不同线程写的数据落在同一个cache line上(false sharing)
+#define NANO_CACHE_LINE_SIZE 64
@@ -361,9 +361,10 @@ b_tree_node_base* __copy_since(b_tree_node_base* node1,
 	if (node1) {
 		newNode = f(node1);
 		newNode->parent = node2;
-		std::cout << "here" << std::endl;
-		for (degree_t i = 0; i < node1->vsz + 1; ++i) {
-			newNode->children[i] = __copy_since(node1->children[i], newNode, f);
+		if (!is_leaf(node1)) {	//叶子没有孩子数组
+			for (degree_t i = 0; i < node1->vsz + 1; ++i) {
+				newNode->children[i] = __copy_since(node1->children[i], newNode, f);
+			}
 		}
 	}
 	return newNode;
@@ -73,4 +73,19 @@ struct b_tree_node_base : public node {
     }
 };
 
+/**
+ * @brief B+树节点头，叶子的vsz是值的个数，内部节点的vsz是分隔key的个数(孩子数 = vsz + 1)
+ */
+struct bplus_tree_node_base : public node {
+    bplus_tree_node_base* parent = nullptr;
+    degree_t vsz = 0;
+    bool leaf = true;
+};
+
+//叶子串成带头节点的双向循环链表，头节点只有这一部分
+struct bplus_tree_leaf_base : public bplus_tree_node_base {
+    bplus_tree_leaf_base* prev = nullptr;
+    bplus_tree_leaf_base* next = nullptr;
+};
+
 } //namespace nano
\ No newline at end of file
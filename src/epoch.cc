@@ -0,0 +1,92 @@
+#include "epoch.h"
+
+#ifdef __linux__
+#include <linux/membarrier.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#endif //__linux__
+
+namespace nano {
+
+epoch_domain::epoch_domain() :
+	m_asymmetric(false) {
+#if defined(__linux__) && defined(__NR_membarrier)
+	//老内核没有MEMBARRIER_CMD_PRIVATE_EXPEDITED，注册失败就退回两边都用fence
+	m_asymmetric = 0 == syscall(__NR_membarrier, MEMBARRIER_CMD_REGISTER_PRIVATE_EXPEDITED, 0, 0);
+#endif //__linux__
+}
+
+epoch_domain epoch_domain::s_global;
+
+namespace {
+
+/**
+ * @brief 线程退出时把记录还回去，留给之后的线程
+ */
+struct record_holder {
+	~record_holder() {
+		if (record) {
+			tls_epoch_record = nullptr;
+			record->epoch.store(0, std::memory_order_release);
+			record->in_use.store(false, std::memory_order_release);
+		}
+	}
+
+	epoch_record* record = nullptr;
+};
+
+} //namespace
+
+epoch_record* epoch_domain::local_record() noexcept {
+	thread_local record_holder holder;
+	if (nullptr == holder.record) {
+		holder.record = acquire_record();
+	}
+	tls_epoch_record = holder.record;
+	return holder.record;
+}
+
+epoch_record* epoch_domain::acquire_record() {
+	//先找已经退出的线程留下的记录
+	for (epoch_record* rec = m_records.load(std::memory_order_acquire); rec; rec = rec->next) {
+		bool expected = false;
+		if (!rec->in_use.load(std::memory_order_relaxed) &&
+				rec->in_use.compare_exchange_strong(expected, true, std::memory_order_acq_rel)) {
+			rec->depth = 0;
+			return rec;
+		}
+	}
+	epoch_record* rec = new epoch_record;
+	rec->in_use.store(true, std::memory_order_relaxed);
+	epoch_record* head = m_records.load(std::memory_order_relaxed);
+	do {
+		rec->next = head;
+	} while (!m_records.compare_exchange_weak(head, rec,
+		std::memory_order_release, std::memory_order_relaxed));
+	return rec;
+}
+
+uint64_t epoch_domain::try_advance() noexcept {
+	uint64_t current = m_epoch.load(std::memory_order_seq_cst);
+	//和enter里的fence配对
+	heavy_fence();
+	for (epoch_record* rec = m_records.load(std::memory_order_acquire); rec; rec = rec->next) {
+		uint64_t e = rec->epoch.load(std::memory_order_seq_cst);
+		if (0 != e && e != current) {
+			return current;
+		}
+	}
+	m_epoch.compare_exchange_strong(current, current + 1, std::memory_order_seq_cst);
+	return m_epoch.load(std::memory_order_seq_cst);
+}
+
+void epoch_domain::heavy_fence() noexcept {
+	std::atomic_thread_fence(std::memory_order_seq_cst);
+#if defined(__linux__) && defined(__NR_membarrier)
+	if (m_asymmetric) {
+		syscall(__NR_membarrier, MEMBARRIER_CMD_PRIVATE_EXPEDITED, 0, 0);
+	}
+#endif //__linux__
+}
+
+} //namespace nano
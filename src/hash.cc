@@ -1,4 +1,11 @@
 #include "hash.h"
+#include <random>
+#include <chrono>
+
+#if (defined(__GNUC__) || defined(__clang__)) && (defined(__x86_64__) || defined(__i386__))
+#define HASH_BYTES_X86
+#include <immintrin.h>
+#endif //x86
 
 namespace nano {
 
@@ -45,15 +52,6 @@ uint32_t murmurhash2 (const void* key, int len, unsigned int seed) {
 
 	return h;
 } 
-#define HASH_FUNCTION_INTEGRAL(Type)                \
-template<>                                          \
-struct hash_value<Type> {                           \
-    uint32_t operator()(Type v) const noexcept {    \
-        char buf[4]{0};                             \
-        snprintf(buf, sizeof buf, "%u", v);         \
-        return murmurhash2(buf, sizeof buf, 0);     \
-    }                                               \
-}
 #else
 uint64_t murmurhash2(const void* key, int len, unsigned int seed) {
 	const uint64_t m = 0xc6a4a7935bd1e995;
@@ -96,4 +94,405 @@ uint64_t murmurhash2(const void* key, int len, unsigned int seed) {
 } 
 #endif //BIT32
 
-} //namespace nano
\ No newline at end of file
+
+/**
+ * 长输入的hash: 每32字节(一个stripe)为一步，分成4条64位的lane独立累加，
+ * 每条lane做 acc += d + lo32(d ^ key) * hi32(d ^ key)，这只需要32x32->64的
+ * 乘法，SSE2/AVX2都能直接做，标量版本也能算出完全一样的结果。
+ * 每32个stripe(一个block, 1KB)把累加器打乱一次，让高位参与进来。
+ * 不足32字节的尾部用murmurhash2的方式逐8字节混合，第i块先异或keys[i] ^ seed。
+ */
+namespace {
+
+//常量、SECRET和splitmix64在hash.h里，编译期版本也要用
+using namespace hash_detail;
+
+inline uint64_t read64(const unsigned char* p) {
+	uint64_t v;
+	memcpy(&v, p, sizeof v);
+	return v;
+}
+
+//hash_cstr在不跨页的前提下会读到'\0'后面，这是故意的，不让AddressSanitizer报错
+#if defined(__GNUC__) || defined(__clang__)
+#define NO_SANITIZE_ADDRESS __attribute__((no_sanitize_address))
+#else
+#define NO_SANITIZE_ADDRESS
+#endif //__GNUC__
+
+//找'\0'时用，可能读到字符串结尾后面
+NO_SANITIZE_ADDRESS
+inline uint64_t read64_unchecked(const unsigned char* p) {
+	uint64_t v;
+	memcpy(&v, p, sizeof v);
+	return v;
+}
+
+//从p开始读32字节会不会跨页，跨页的话读到字符串结尾后面可能会访问到未映射的页
+inline bool stripe_in_page(const unsigned char* p) {
+	return (reinterpret_cast<uintptr_t>(p) & 4095) <= 4096 - STRIPE_SIZE;
+}
+
+inline void accumulate_lane(uint64_t* acc, uint64_t d, uint64_t key) {
+	uint64_t dk = d ^ key;
+	*acc += d + (dk & 0xffffffff) * (dk >> 32);
+}
+
+inline void scramble_lane(uint64_t* acc, uint64_t key) {
+	uint64_t v = *acc;
+	v ^= v >> 47;
+	v ^= key;
+	*acc = v * PRIME32;
+}
+
+/**
+ * @brief 累加[first, first + nstripes * 32)，stripe是整个输入中第stripe个stripe
+ * @return 下一个stripe的序号
+ */
+using accumulate_func = size_t (*)(uint64_t* acc, const unsigned char* first, 
+		size_t nstripes, size_t stripe, uint64_t seed);
+
+/**
+ * @brief 从first开始一个个stripe地累加，直到遇到包含'\0'的stripe
+ * @return 第一个包含'\0'的stripe的地址
+ */
+using scan_func = const unsigned char* (*)(uint64_t* acc, const unsigned char* first, 
+		size_t* stripe, uint64_t seed);
+
+size_t accumulate_scalar(uint64_t* acc, const unsigned char* first, 
+		size_t nstripes, size_t stripe, uint64_t seed) {
+	for (size_t n = 0; n != nstripes; ++n, ++stripe, first += STRIPE_SIZE) {
+		size_t k = stripe % STRIPES_PER_BLOCK;
+		for (size_t i = 0; i != STRIPE_LANES; ++i) {
+			accumulate_lane(&acc[i], read64(first + 8 * i), SECRET.keys[k + i] + seed);
+		}
+		if (STRIPES_PER_BLOCK - 1 == k) {
+			for (size_t i = 0; i != STRIPE_LANES; ++i) {
+				scramble_lane(&acc[i], SECRET.keys[STRIPES_PER_BLOCK + i] + seed);
+			}
+		}
+	}
+	return stripe;
+}
+
+inline bool has_zero_byte(uint64_t v) {
+	return (v - 0x0101010101010101ULL) & ~v & 0x8080808080808080ULL;
+}
+
+//p开始的32字节里有没有'\0'
+NO_SANITIZE_ADDRESS
+inline bool stripe_has_zero(const unsigned char* p) {
+	if (stripe_in_page(p)) {
+		return has_zero_byte(read64_unchecked(p)) | has_zero_byte(read64_unchecked(p + 8)) | 
+			   has_zero_byte(read64_unchecked(p + 16)) | has_zero_byte(read64_unchecked(p + 24));
+	}
+	return nullptr != memchr(p, 0, STRIPE_SIZE);
+}
+
+NO_SANITIZE_ADDRESS
+const unsigned char* scan_scalar(uint64_t* acc, const unsigned char* first, 
+		size_t* stripe, uint64_t seed) {
+	while (!stripe_has_zero(first)) {
+		*stripe = accumulate_scalar(acc, first, 1, *stripe, seed);
+		first += STRIPE_SIZE;
+	}
+	return first;
+}
+
+#ifdef HASH_BYTES_X86
+/**
+ * @brief SSE2版本，一个stripe用两个128位寄存器
+ */
+__attribute__((target("sse2")))
+inline void accumulate_stripe_sse2(__m128i* acc, __m128i d0, __m128i d1, 
+		const uint64_t* keys, __m128i seed) {
+	__m128i k0 = _mm_add_epi64(_mm_loadu_si128(reinterpret_cast<const __m128i*>(keys)), seed);
+	__m128i k1 = _mm_add_epi64(_mm_loadu_si128(reinterpret_cast<const __m128i*>(keys + 2)), seed);
+	__m128i dk0 = _mm_xor_si128(d0, k0);
+	__m128i dk1 = _mm_xor_si128(d1, k1);
+	__m128i p0 = _mm_mul_epu32(dk0, _mm_srli_epi64(dk0, 32));
+	__m128i p1 = _mm_mul_epu32(dk1, _mm_srli_epi64(dk1, 32));
+	acc[0] = _mm_add_epi64(acc[0], _mm_add_epi64(d0, p0));
+	acc[1] = _mm_add_epi64(acc[1], _mm_add_epi64(d1, p1));
+}
+
+__attribute__((target("sse2")))
+inline __m128i scramble_sse2(__m128i acc, const uint64_t* keys, __m128i seed) {
+	__m128i k = _mm_add_epi64(_mm_loadu_si128(reinterpret_cast<const __m128i*>(keys)), seed);
+	__m128i prime = _mm_set1_epi32(static_cast<int>(PRIME32));
+	acc = _mm_xor_si128(acc, _mm_srli_epi64(acc, 47));
+	acc = _mm_xor_si128(acc, k);
+	//acc * PRIME32 = lo32(acc) * PRIME32 + (hi32(acc) * PRIME32) << 32
+	__m128i lo = _mm_mul_epu32(acc, prime);
+	__m128i hi = _mm_mul_epu32(_mm_srli_epi64(acc, 32), prime);
+	return _mm_add_epi64(lo, _mm_slli_epi64(hi, 32));
+}
+
+__attribute__((target("sse2")))
+size_t accumulate_sse2(uint64_t* acc, const unsigned char* first, 
+		size_t nstripes, size_t stripe, uint64_t seed) {
+	__m128i a[2] = { _mm_loadu_si128(reinterpret_cast<const __m128i*>(acc)),
+					 _mm_loadu_si128(reinterpret_cast<const __m128i*>(acc + 2)) };
+	__m128i vseed = _mm_set1_epi64x(static_cast<long long>(seed));
+	for (size_t n = 0; n != nstripes; ++n, ++stripe, first += STRIPE_SIZE) {
+		size_t k = stripe % STRIPES_PER_BLOCK;
+		__m128i d0 = _mm_loadu_si128(reinterpret_cast<const __m128i*>(first));
+		__m128i d1 = _mm_loadu_si128(reinterpret_cast<const __m128i*>(first + 16));
+		accumulate_stripe_sse2(a, d0, d1, SECRET.keys + k, vseed);
+		if (STRIPES_PER_BLOCK - 1 == k) {
+			a[0] = scramble_sse2(a[0], SECRET.keys + STRIPES_PER_BLOCK, vseed);
+			a[1] = scramble_sse2(a[1], SECRET.keys + STRIPES_PER_BLOCK + 2, vseed);
+		}
+	}
+	_mm_storeu_si128(reinterpret_cast<__m128i*>(acc), a[0]);
+	_mm_storeu_si128(reinterpret_cast<__m128i*>(acc + 2), a[1]);
+	return stripe;
+}
+
+__attribute__((target("sse2"))) NO_SANITIZE_ADDRESS
+const unsigned char* scan_sse2(uint64_t* acc, const unsigned char* first, 
+		size_t* stripe, uint64_t seed) {
+	__m128i a[2] = { _mm_loadu_si128(reinterpret_cast<const __m128i*>(acc)),
+					 _mm_loadu_si128(reinterpret_cast<const __m128i*>(acc + 2)) };
+	__m128i vseed = _mm_set1_epi64x(static_cast<long long>(seed));
+	__m128i zero = _mm_setzero_si128();
+	size_t n = *stripe;
+	while (true) {
+		if (!stripe_in_page(first) && memchr(first, 0, STRIPE_SIZE)) {
+			break;
+		}
+		//不跨页，或者跨页但这32字节都不是'\0'(都属于字符串)，都可以直接读
+		__m128i d0 = _mm_loadu_si128(reinterpret_cast<const __m128i*>(first));
+		__m128i d1 = _mm_loadu_si128(reinterpret_cast<const __m128i*>(first + 16));
+		__m128i z = _mm_or_si128(_mm_cmpeq_epi8(d0, zero), _mm_cmpeq_epi8(d1, zero));
+		if (_mm_movemask_epi8(z)) {
+			break;
+		}
+		size_t k = n % STRIPES_PER_BLOCK;
+		accumulate_stripe_sse2(a, d0, d1, SECRET.keys + k, vseed);
+		if (STRIPES_PER_BLOCK - 1 == k) {
+			a[0] = scramble_sse2(a[0], SECRET.keys + STRIPES_PER_BLOCK, vseed);
+			a[1] = scramble_sse2(a[1], SECRET.keys + STRIPES_PER_BLOCK + 2, vseed);
+		}
+		++n;
+		first += STRIPE_SIZE;
+	}
+	_mm_storeu_si128(reinterpret_cast<__m128i*>(acc), a[0]);
+	_mm_storeu_si128(reinterpret_cast<__m128i*>(acc + 2), a[1]);
+	*stripe = n;
+	return first;
+}
+
+/**
+ * @brief AVX2版本，一个stripe正好一个256位寄存器，每次循环处理两个stripe(64字节)
+ */
+__attribute__((target("avx2")))
+inline __m256i accumulate_stripe_avx2(__m256i acc, __m256i d, 
+		const uint64_t* keys, __m256i seed) {
+	__m256i k = _mm256_add_epi64(_mm256_loadu_si256(reinterpret_cast<const __m256i*>(keys)), seed);
+	__m256i dk = _mm256_xor_si256(d, k);
+	__m256i p = _mm256_mul_epu32(dk, _mm256_srli_epi64(dk, 32));
+	return _mm256_add_epi64(acc, _mm256_add_epi64(d, p));
+}
+
+__attribute__((target("avx2")))
+inline __m256i scramble_avx2(__m256i acc, __m256i seed) {
+	__m256i k = _mm256_add_epi64(_mm256_loadu_si256(
+		reinterpret_cast<const __m256i*>(SECRET.keys + STRIPES_PER_BLOCK)), seed);
+	__m256i prime = _mm256_set1_epi32(static_cast<int>(PRIME32));
+	acc = _mm256_xor_si256(acc, _mm256_srli_epi64(acc, 47));
+	acc = _mm256_xor_si256(acc, k);
+	__m256i lo = _mm256_mul_epu32(acc, prime);
+	__m256i hi = _mm256_mul_epu32(_mm256_srli_epi64(acc, 32), prime);
+	return _mm256_add_epi64(lo, _mm256_slli_epi64(hi, 32));
+}
+
+__attribute__((target("avx2")))
+size_t accumulate_avx2(uint64_t* acc, const unsigned char* first, 
+		size_t nstripes, size_t stripe, uint64_t seed) {
+	__m256i a = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(acc));
+	__m256i vseed = _mm256_set1_epi64x(static_cast<long long>(seed));
+	size_t n = 0;
+	//只要两个stripe不跨block就可以一起做
+	for (; n + 2 <= nstripes; n += 2, stripe += 2, first += 2 * STRIPE_SIZE) {
+		size_t k = stripe % STRIPES_PER_BLOCK;
+		__m256i d0 = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(first));
+		__m256i d1 = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(first + STRIPE_SIZE));
+		a = accumulate_stripe_avx2(a, d0, SECRET.keys + k, vseed);
+		if (STRIPES_PER_BLOCK - 1 == k) {
+			a = scramble_avx2(a, vseed);
+			k = 0;
+		} else {
+			++k;
+		}
+		a = accumulate_stripe_avx2(a, d1, SECRET.keys + k, vseed);
+		if (STRIPES_PER_BLOCK - 1 == k) {
+			a = scramble_avx2(a, vseed);
+		}
+	}
+	if (n != nstripes) {
+		size_t k = stripe % STRIPES_PER_BLOCK;
+		__m256i d = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(first));
+		a = accumulate_stripe_avx2(a, d, SECRET.keys + k, vseed);
+		if (STRIPES_PER_BLOCK - 1 == k) {
+			a = scramble_avx2(a, vseed);
+		}
+		++stripe;
+	}
+	_mm256_storeu_si256(reinterpret_cast<__m256i*>(acc), a);
+	return stripe;
+}
+
+__attribute__((target("avx2"))) NO_SANITIZE_ADDRESS
+const unsigned char* scan_avx2(uint64_t* acc, const unsigned char* first, 
+		size_t* stripe, uint64_t seed) {
+	__m256i a = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(acc));
+	__m256i vseed = _mm256_set1_epi64x(static_cast<long long>(seed));
+	__m256i zero = _mm256_setzero_si256();
+	size_t n = *stripe;
+	while (true) {
+		if (!stripe_in_page(first) && memchr(first, 0, STRIPE_SIZE)) {
+			break;
+		}
+		__m256i d = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(first));
+		if (_mm256_movemask_epi8(_mm256_cmpeq_epi8(d, zero))) {
+			break;
+		}
+		size_t k = n % STRIPES_PER_BLOCK;
+		a = accumulate_stripe_avx2(a, d, SECRET.keys + k, vseed);
+		if (STRIPES_PER_BLOCK - 1 == k) {
+			a = scramble_avx2(a, vseed);
+		}
+		++n;
+		first += STRIPE_SIZE;
+	}
+	_mm256_storeu_si256(reinterpret_cast<__m256i*>(acc), a);
+	*stripe = n;
+	return first;
+}
+#endif //HASH_BYTES_X86
+
+struct hash_kernel {
+	accumulate_func accumulate;
+	scan_func scan;
+};
+
+hash_kernel select_kernel() {
+#ifdef HASH_BYTES_X86
+	__builtin_cpu_init();
+	if (__builtin_cpu_supports("avx2")) {
+		return { accumulate_avx2, scan_avx2 };
+	}
+	if (__builtin_cpu_supports("sse2")) {
+		return { accumulate_sse2, scan_sse2 };
+	}
+#endif //HASH_BYTES_X86
+	return { accumulate_scalar, scan_scalar };
+}
+
+//第一次调用时根据cpu支持的指令集选择实现
+inline const hash_kernel& kernel() {
+	static const hash_kernel k = select_kernel();
+	return k;
+}
+
+inline void init_acc(uint64_t* acc, uint64_t seed) {
+	for (size_t i = 0; i != STRIPE_LANES; ++i) {
+		acc[i] = SECRET.keys[i] ^ seed;
+	}
+}
+
+//短输入(小于SHORT_INPUT字节)直接逐8字节串行混合，
+//累加器的初始化和合并的开销比省下来的多。块的混合是与种子无关的双射时，
+//相邻两块混合后的第63位同时翻转，hash值在任何种子下都相同，所以每块先异或keys[i] ^ seed
+inline uint64_t mix_rest(uint64_t h, const unsigned char* data, size_t rest, uint64_t seed) {
+	for (size_t i = 0; rest >= 8; rest -= 8, data += 8, ++i) {
+		uint64_t k = read64(data) ^ SECRET.keys[i] ^ seed;
+		k *= PRIME64;
+		k ^= k >> 47;
+		k *= PRIME64;
+		h ^= k;
+		h *= PRIME64;
+	}
+	if (rest) {
+		uint64_t k = 0;
+		memcpy(&k, data, rest);
+		h ^= k;
+		h *= PRIME64;
+	}
+	return h;
+}
+
+inline uint64_t hash_short(const unsigned char* data, size_t len, uint64_t seed) {
+	return splitmix64(mix_rest(seed ^ (len * PRIME64), data, len, seed));
+}
+
+/**
+ * @brief 合并累加器并混合尾部不足32字节的部分
+ * @param tail 尾部的起始地址
+ * @param len 整个输入的长度
+ */
+inline uint64_t hash_long(const uint64_t* acc, const unsigned char* tail, 
+		size_t len, uint64_t seed) {
+	uint64_t h = seed ^ (len * PRIME64);
+	//两两合并，两个乘法可以并行
+	uint64_t a = acc[0] ^ std::rotl(acc[1], 23);
+	uint64_t b = acc[2] ^ std::rotl(acc[3], 41);
+	h ^= (a * PRIME64) ^ std::rotl(b * 0xbf58476d1ce4e5b9ULL, 32);
+	return splitmix64(mix_rest(h, tail, len % STRIPE_SIZE, seed));
+}
+
+} //namespace
+
+size_t random_seed() {
+	//每个线程只读一次random_device，之后用splitmix64生成，不用加锁
+	thread_local uint64_t state = (static_cast<uint64_t>(std::random_device()()) << 32) ^
+		static_cast<uint64_t>(std::chrono::steady_clock::now().time_since_epoch().count());
+	state += 0x9e3779b97f4a7c15ULL;
+	return static_cast<size_t>(splitmix64(state));
+}
+
+#ifdef BIT32
+uint32_t hash_bytes(const void* key, size_t len, size_t seed) {
+#else
+uint64_t hash_bytes(const void* key, size_t len, size_t seed) {
+#endif //BIT32
+	const unsigned char* data = static_cast<const unsigned char*>(key);
+	if (len < SHORT_INPUT) {
+		return fold(hash_short(data, len, seed));
+	}
+	size_t nstripes = len / STRIPE_SIZE;
+	uint64_t acc[STRIPE_LANES];
+	init_acc(acc, seed);
+	kernel().accumulate(acc, data, nstripes, 0, seed);
+	return fold(hash_long(acc, data + nstripes * STRIPE_SIZE, len, seed));
+}
+
+#ifdef BIT32
+uint32_t hash_cstr(const char* str, size_t seed) {
+#else
+uint64_t hash_cstr(const char* str, size_t seed) {
+#endif //BIT32
+	const unsigned char* first = reinterpret_cast<const unsigned char*>(str);
+	//先只找'\0'，看是不是短输入
+	const unsigned char* last = first;
+	while (last != first + SHORT_INPUT) {
+		if (stripe_has_zero(last)) {
+			size_t len = (last - first) + strlen(reinterpret_cast<const char*>(last));
+			return fold(hash_short(first, len, seed));
+		}
+		last += STRIPE_SIZE;
+	}
+
+	//长输入，前面几个stripe刚读过还在cache里；后面找'\0'和累加是同一遍读
+	const hash_kernel& k = kernel();
+	uint64_t acc[STRIPE_LANES];
+	size_t nstripes = SHORT_INPUT / STRIPE_SIZE;
+	init_acc(acc, seed);
+	k.accumulate(acc, first, nstripes, 0, seed);
+	const unsigned char* tail = k.scan(acc, last, &nstripes, seed);
+	size_t len = (tail - first) + strlen(reinterpret_cast<const char*>(tail));
+	return fold(hash_long(acc, tail, len, seed));
+}
+
+} //namespace nano
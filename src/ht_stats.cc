@@ -0,0 +1,59 @@
+#include "ht_stats.h"
+#include <stdio.h>
+
+namespace nano {
+
+namespace {
+
+void append_field(std::string& json, const char* name, size_t value) {
+	json += '"';
+	json += name;
+	json += "\":";
+	json += std::to_string(value);
+	json += ',';
+}
+
+void append_field(std::string& json, const char* name, double value) {
+	char buf[64];
+	::snprintf(buf, sizeof(buf), "\"%s\":%.6g,", name, value);
+	json += buf;
+}
+
+} //namespace
+
+std::string ht_stats::to_json() const {
+	std::string json = "{";
+	append_field(json, "size", size);
+	append_field(json, "bucket_count", bucket_count);
+	append_field(json, "load_factor", static_cast<double>(load_factor));
+	json += "\"chain_histogram\":[";
+	for (size_t i = 0; i < HISTOGRAM_SIZE; ++i) {
+		if (i) {
+			json += ',';
+		}
+		json += std::to_string(chain_histogram[i]);
+	}
+	json += "],";
+	append_field(json, "max_chain", max_chain);
+	append_field(json, "tree_buckets", tree_buckets);
+	append_field(json, "bucket_bytes", bucket_bytes);
+	append_field(json, "node_bytes", node_bytes);
+	append_field(json, "live_node_bytes", live_node_bytes);
+	json += "\"counters_enabled\":";
+	json += counters_enabled ? "true," : "false,";
+	append_field(json, "treefy_count", treefy_count);
+	append_field(json, "untreefy_count", untreefy_count);
+	append_field(json, "rehash_count", rehash_count);
+	append_field(json, "rehash_ms", rehash_ms);
+	append_field(json, "hit_count", hit_count);
+	append_field(json, "hit_probes", hit_probes);
+	append_field(json, "miss_count", miss_count);
+	append_field(json, "miss_probes", miss_probes);
+	append_field(json, "avg_hit_probes", avg_hit_probes());
+	append_field(json, "avg_miss_probes", avg_miss_probes());
+	//去掉最后一个逗号
+	json.back() = '}';
+	return json;
+}
+
+} //namespace nano
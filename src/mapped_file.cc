@@ -0,0 +1,167 @@
+#include "mapped_file.h"
+#include <stdexcept>
+#include <string>
+#include <utility>
+#include <atomic>
+#include <string.h>
+
+#if defined(__unix__) || defined(__APPLE__)
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <errno.h>
+#include <string.h>
+#define NANO_HAS_MMAP
+#endif //__unix__
+
+namespace nano {
+
+mapped_file::mapped_file(const char* path) {
+#ifdef NANO_HAS_MMAP
+	int fd = ::open(path, O_RDONLY);
+	if (fd < 0) {
+		throw std::runtime_error(std::string("mapped_file: cannot open ") + path + ": " + strerror(errno));
+	}
+	struct stat st;
+	if (::fstat(fd, &st) != 0) {
+		int err = errno;
+		::close(fd);
+		throw std::runtime_error(std::string("mapped_file: cannot stat ") + path + ": " + strerror(err));
+	}
+	m_size = static_cast<size_t>(st.st_size);
+	if (m_size) {
+		void* addr = ::mmap(nullptr, m_size, PROT_READ, MAP_PRIVATE, fd, 0);
+		if (MAP_FAILED == addr) {
+			int err = errno;
+			::close(fd);
+			throw std::runtime_error(std::string("mapped_file: cannot map ") + path + ": " + strerror(err));
+		}
+		m_data = static_cast<const char*>(addr);
+	}
+	//映射建立以后文件描述符就不需要了
+	::close(fd);
+#else
+	static_cast<void>(path);
+	throw std::runtime_error("mapped_file: mmap is not supported on this platform");
+#endif //NANO_HAS_MMAP
+}
+
+mapped_file::mapped_file(mapped_file&& other) noexcept :
+		m_data(other.m_data),
+		m_size(other.m_size) {
+	other.m_data = nullptr;
+	other.m_size = 0;
+}
+
+mapped_file& mapped_file::operator=(mapped_file&& other) noexcept {
+	if (this != &other) {
+		unmap();
+		m_data = std::exchange(other.m_data, nullptr);
+		m_size = std::exchange(other.m_size, 0);
+	}
+	return *this;
+}
+
+mapped_file::~mapped_file() {
+	unmap();
+}
+
+void mapped_file::advise_random() const noexcept {
+#ifdef NANO_HAS_MMAP
+	if (m_data) {
+		::madvise(const_cast<char*>(m_data), m_size, MADV_RANDOM);
+	}
+#endif //NANO_HAS_MMAP
+}
+
+void mapped_file::unmap() noexcept {
+#ifdef NANO_HAS_MMAP
+	if (m_data) {
+		::munmap(const_cast<char*>(m_data), m_size);
+	}
+#endif //NANO_HAS_MMAP
+	m_data = nullptr;
+	m_size = 0;
+}
+
+atomic_file::atomic_file(const char* path) : m_path(path) {
+#ifdef NANO_HAS_MMAP
+	//同一个目录里才能rename，名字带上进程号和计数，O_EXCL保证不会写到别人的文件
+	static std::atomic<unsigned> counter(0);
+	for (int attempt = 0; m_fd < 0; ++attempt) {
+		m_temp = m_path + ".tmp." + std::to_string(::getpid()) + "." + std::to_string(counter++);
+		m_fd = ::open(m_temp.c_str(), O_WRONLY | O_CREAT | O_EXCL | O_CLOEXEC, 0666);
+		if (m_fd < 0 && (errno != EEXIST || attempt >= 100)) {
+			fail("cannot create", m_temp, errno);
+		}
+	}
+#else
+	throw std::runtime_error("atomic_file: not supported on this platform");
+#endif //NANO_HAS_MMAP
+}
+
+atomic_file::~atomic_file() {
+#ifdef NANO_HAS_MMAP
+	if (m_fd >= 0) {
+		::close(m_fd);
+		::unlink(m_temp.c_str());
+	}
+#endif //NANO_HAS_MMAP
+}
+
+void atomic_file::write_at(uint64_t offset, const void* data, size_t bytes) {
+#ifdef NANO_HAS_MMAP
+	const char* p = static_cast<const char*>(data);
+	while (bytes) {
+		ssize_t n = ::pwrite(m_fd, p, bytes, static_cast<off_t>(offset));
+		if (n < 0) {
+			if (EINTR == errno) {
+				continue;
+			}
+			fail("cannot write", m_temp, errno);
+		}
+		p += n;
+		offset += static_cast<uint64_t>(n);
+		bytes -= static_cast<size_t>(n);
+	}
+#else
+	static_cast<void>(offset);
+	static_cast<void>(data);
+	static_cast<void>(bytes);
+#endif //NANO_HAS_MMAP
+}
+
+void atomic_file::commit() {
+#ifdef NANO_HAS_MMAP
+	if (::fsync(m_fd) != 0) {
+		fail("cannot sync", m_temp, errno);
+	}
+	int fd = m_fd;
+	m_fd = -1;
+	if (::close(fd) != 0) {
+		int err = errno;
+		::unlink(m_temp.c_str());
+		fail("cannot close", m_temp, err);
+	}
+	if (::rename(m_temp.c_str(), m_path.c_str()) != 0) {
+		int err = errno;
+		::unlink(m_temp.c_str());
+		fail("cannot rename to", m_path, err);
+	}
+	//rename本身也要落盘，目录打不开时(有的文件系统不允许)就算了
+	size_t slash = m_path.find_last_of('/');
+	std::string dir = std::string::npos == slash ? "." : m_path.substr(0, slash + (0 == slash));
+	int dirFd = ::open(dir.c_str(), O_RDONLY | O_CLOEXEC);
+	if (dirFd >= 0) {
+		::fsync(dirFd);
+		::close(dirFd);
+	}
+#endif //NANO_HAS_MMAP
+}
+
+void atomic_file::fail(const char* what, const std::string& path, int err) {
+	throw std::runtime_error(std::string("atomic_file: ") + what + " " + path + ": " + strerror(err));
+}
+
+} //namespace nano
@@ -0,0 +1,250 @@
+#include "sketch.h"
+#include <math.h>
+
+#if (defined(__GNUC__) || defined(__clang__)) && (defined(__x86_64__) || defined(__i386__))
+#define SKETCH_X86
+#include <immintrin.h>
+#endif //x86
+
+namespace nano {
+
+namespace sketch_detail {
+
+namespace {
+
+constexpr char MAGIC[8] = { 'N', 'A', 'N', 'O', 'S', 'K', 'T', '\0' };
+constexpr uint32_t VERSION = 1;
+
+void or_words_scalar(uint64_t* dst, const uint64_t* src, size_t n) noexcept {
+	for (size_t i = 0; i != n; ++i) {
+		dst[i] |= src[i];
+	}
+}
+
+void max_bytes_scalar(uint8_t* dst, const uint8_t* src, size_t n) noexcept {
+	for (size_t i = 0; i != n; ++i) {
+		dst[i] = std::max(dst[i], src[i]);
+	}
+}
+
+void bloom_check_batch_scalar(const uint32_t* const* blocks, const uint32_t* keys,
+		size_t n, bool* out) noexcept {
+	for (size_t i = 0; i != n; ++i) {
+		uint32_t missing = 0;
+		for (size_t j = 0; j != 8; ++j) {
+			missing |= ~blocks[i][j] & (1U << ((keys[i] * BLOOM_SALT[j]) >> 27));
+		}
+		out[i] = !missing;
+	}
+}
+
+#ifdef SKETCH_X86
+//SSE2是x86-64的基本指令集，不用检查
+__attribute__((target("sse2")))
+void or_words_sse2(uint64_t* dst, const uint64_t* src, size_t n) noexcept {
+	size_t i = 0;
+	for (; i + 2 <= n; i += 2) {
+		__m128i* d = reinterpret_cast<__m128i*>(dst + i);
+		__m128i s = _mm_loadu_si128(reinterpret_cast<const __m128i*>(src + i));
+		_mm_storeu_si128(d, _mm_or_si128(_mm_loadu_si128(d), s));
+	}
+	or_words_scalar(dst + i, src + i, n - i);
+}
+
+__attribute__((target("avx2")))
+void or_words_avx2(uint64_t* dst, const uint64_t* src, size_t n) noexcept {
+	size_t i = 0;
+	for (; i + 4 <= n; i += 4) {
+		__m256i* d = reinterpret_cast<__m256i*>(dst + i);
+		__m256i s = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(src + i));
+		_mm256_storeu_si256(d, _mm256_or_si256(_mm256_loadu_si256(d), s));
+	}
+	or_words_scalar(dst + i, src + i, n - i);
+}
+
+__attribute__((target("sse2")))
+void max_bytes_sse2(uint8_t* dst, const uint8_t* src, size_t n) noexcept {
+	size_t i = 0;
+	for (; i + 16 <= n; i += 16) {
+		__m128i* d = reinterpret_cast<__m128i*>(dst + i);
+		__m128i s = _mm_loadu_si128(reinterpret_cast<const __m128i*>(src + i));
+		_mm_storeu_si128(d, _mm_max_epu8(_mm_loadu_si128(d), s));
+	}
+	max_bytes_scalar(dst + i, src + i, n - i);
+}
+
+__attribute__((target("avx2")))
+void max_bytes_avx2(uint8_t* dst, const uint8_t* src, size_t n) noexcept {
+	size_t i = 0;
+	for (; i + 32 <= n; i += 32) {
+		__m256i* d = reinterpret_cast<__m256i*>(dst + i);
+		__m256i s = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(src + i));
+		_mm256_storeu_si256(d, _mm256_max_epu8(_mm256_loadu_si256(d), s));
+	}
+	max_bytes_scalar(dst + i, src + i, n - i);
+}
+
+/**
+ * @brief 8个salt一次乘完、移位，和块做testc，一个key一共几条指令
+ */
+__attribute__((target("avx2")))
+void bloom_check_batch_avx2(const uint32_t* const* blocks, const uint32_t* keys,
+		size_t n, bool* out) noexcept {
+	const __m256i salt = _mm256_load_si256(reinterpret_cast<const __m256i*>(BLOOM_SALT));
+	const __m256i one = _mm256_set1_epi32(1);
+	for (size_t i = 0; i != n; ++i) {
+		__m256i bits = _mm256_srli_epi32(_mm256_mullo_epi32(_mm256_set1_epi32(keys[i]), salt), 27);
+		__m256i mask = _mm256_sllv_epi32(one, bits);
+		__m256i words = _mm256_load_si256(reinterpret_cast<const __m256i*>(blocks[i]));
+		out[i] = _mm256_testc_si256(words, mask);
+	}
+}
+#endif //SKETCH_X86
+
+struct sketch_kernel {
+	void (*or_words)(uint64_t*, const uint64_t*, size_t) noexcept;
+	void (*max_bytes)(uint8_t*, const uint8_t*, size_t) noexcept;
+	void (*bloom_check_batch)(const uint32_t* const*, const uint32_t*, size_t, bool*) noexcept;
+};
+
+sketch_kernel select_kernel() {
+#ifdef SKETCH_X86
+	__builtin_cpu_init();
+	if (__builtin_cpu_supports("avx2")) {
+		return { or_words_avx2, max_bytes_avx2, bloom_check_batch_avx2 };
+	}
+	if (__builtin_cpu_supports("sse2")) {
+		return { or_words_sse2, max_bytes_sse2, bloom_check_batch_scalar };
+	}
+#endif //SKETCH_X86
+	return { or_words_scalar, max_bytes_scalar, bloom_check_batch_scalar };
+}
+
+//第一次调用时根据cpu支持的指令集选择实现
+inline const sketch_kernel& kernel() {
+	static const sketch_kernel k = select_kernel();
+	return k;
+}
+
+/**
+ * @brief 平均每块有load个元素时的误判率
+ * 		  一个块里的元素个数近似服从泊松分布，有j个元素时一个字里某一位为1的概率是
+ * 		  1 - (31/32)^j，8个字都命中才误判
+ */
+double bloom_false_positive(double load) noexcept {
+	double p = ::exp(-load);		//块里有j个元素的概率
+	double result = 0.0;
+	size_t last = static_cast<size_t>(load + 10 * ::sqrt(load) + 20);
+	for (size_t j = 0; j <= last; ++j) {
+		if (j) {
+			p *= load / static_cast<double>(j);
+		}
+		result += p * ::pow(1.0 - ::pow(31.0 / 32.0, static_cast<double>(j)), 8.0);
+	}
+	return result;
+}
+
+} //namespace
+
+void write_sketch(std::string& out, sketch_kind kind, const uint64_t* params,
+		uint64_t seed, const void* payload, size_t size) {
+	sketch_header header;
+	memcpy(header.magic, MAGIC, sizeof(MAGIC));
+	header.version = VERSION;
+	header.kind = static_cast<uint32_t>(kind);
+	memcpy(header.params, params, sizeof(header.params));
+	header.seed = seed;
+	header.payload_size = size;
+	out.reserve(out.size() + sizeof(header) + size);
+	out.append(reinterpret_cast<const char*>(&header), sizeof(header));
+	out.append(static_cast<const char*>(payload), size);
+}
+
+std::string_view read_sketch(std::string_view in, sketch_kind kind, sketch_header& header) {
+	if (in.size() < sizeof(header)) {
+		throw std::invalid_argument("sketch: input too short");
+	}
+	memcpy(&header, in.data(), sizeof(header));
+	if (memcmp(header.magic, MAGIC, sizeof(MAGIC)) != 0 || header.version != VERSION) {
+		throw std::invalid_argument("sketch: bad magic or version");
+	}
+	if (header.kind != static_cast<uint32_t>(kind)) {
+		throw std::invalid_argument("sketch: kind mismatch");
+	}
+	if (header.payload_size != in.size() - sizeof(header)) {
+		throw std::invalid_argument("sketch: payload size mismatch");
+	}
+	return in.substr(sizeof(header));
+}
+
+void or_words(uint64_t* dst, const uint64_t* src, size_t n) noexcept {
+	kernel().or_words(dst, src, n);
+}
+
+void max_bytes(uint8_t* dst, const uint8_t* src, size_t n) noexcept {
+	kernel().max_bytes(dst, src, n);
+}
+
+void add_saturate(uint32_t* dst, const uint32_t* src, size_t n) noexcept {
+	//没有分支，编译器可以自动向量化
+	for (size_t i = 0; i != n; ++i) {
+		uint32_t sum = dst[i] + src[i];
+		dst[i] = sum | -static_cast<uint32_t>(sum < src[i]);
+	}
+}
+
+size_t bloom_block_count(size_t expectedCount, double fpp) {
+	if (!(fpp > 0.0 && fpp < 1.0)) {
+		throw std::invalid_argument("blocked_bloom_filter: fpp must be in (0, 1)");
+	}
+	//先按k = 8的标准布隆过滤器估一个下界: m = -k * n / ln(1 - fpp^(1/k))
+	constexpr double K = 8.0;
+	constexpr double BLOCK_BITS = sizeof(bloom_block) * 8;
+	double n = static_cast<double>(expectedCount);
+	double blocks = std::max(1.0, ::ceil(-K * n / ::log(1.0 - ::pow(fpp, 1.0 / K)) / BLOCK_BITS));
+	//每个块里的元素个数不均匀，误判率要高一些，每次多加1/64直到够用
+	while (bloom_false_positive(n / blocks) > fpp) {
+		blocks = ::ceil(blocks * (1.0 + 1.0 / 64));
+	}
+	return static_cast<size_t>(blocks);
+}
+
+void bloom_check_batch(const uint32_t* const* blocks, const uint32_t* keys,
+		size_t n, bool* out) noexcept {
+	kernel().bloom_check_batch(blocks, keys, n, out);
+}
+
+double hll_estimate(const uint8_t* registers, unsigned precision) noexcept {
+	size_t m = size_t(1) << precision;
+	double sum = 0.0;
+	size_t zeros = 0;
+	for (size_t i = 0; i != m; ++i) {
+		sum += ::ldexp(1.0, -static_cast<int>(registers[i]));
+		zeros += registers[i] == 0;
+	}
+	double alpha;
+	switch (m) {
+	case 16:
+		alpha = 0.673;
+		break;
+	case 32:
+		alpha = 0.697;
+		break;
+	case 64:
+		alpha = 0.709;
+		break;
+	default:
+		alpha = 0.7213 / (1.0 + 1.079 / static_cast<double>(m));
+		break;
+	}
+	double dm = static_cast<double>(m);
+	double estimate = alpha * dm * dm / sum;
+	if (estimate <= 2.5 * dm && zeros) {
+		estimate = dm * ::log(dm / static_cast<double>(zeros));
+	}
+	return estimate;
+}
+
+} //namespace sketch_detail
+
+} //namespace nano
@@ -7,8 +7,13 @@
 #include <string>
 #include <time.h>
 #include <set>
+#include <algorithm>
 #include <unordered_set>
 #include <limits.h>
+#include <list>
+#include <sstream>
+#include <iterator>
+#include <stdexcept>
 
 constexpr static int N = 10;
 
@@ -34,11 +39,61 @@ bool is_multi();
  * multiset: 3490.5ms   3553.32ms   3689.82ms
  */
 void bench();
+/**
+ * @brief 1 << 20个随机int insert_unique，再打乱顺序全部find一遍, -O2, 单位ms,
+ *        单核机器上跑了6次取中位数
+ *                      insert          find
+ * degree = 4
+ *   一个节点三次申请      2627            2964
+ *   一个节点一次申请      1965            2354
+ * degree = 16
+ *   一个节点三次申请      1327            1227
+ *   一个节点一次申请       814             929
+ * degree = 64
+ *   一个节点三次申请       717             805
+ *   一个节点一次申请       536             625
+ *        三次申请是节点头、values、children各申请一次，每下一层多跳两次指针
+ */
+void bench_find_insert();
+void test_node_search();
+/**
+ * @brief 1 << 20个随机key insert_unique，再打乱顺序全部find一遍, 单位百万次find/秒,
+ *        -O2, 单核机器上跑了6次取中位数
+ *        plain_less和std::less一样，只是换了类型，走std::lower_bound
+ *                          8     16     32     64    128    256
+ * int32_t
+ *   std::lower_bound     1.05   1.43   1.70   2.02   2.47   2.74
+ *   SSE2                 1.25   1.69   2.15   2.63   3.34   4.42
+ *   AVX2(-mavx2)         1.17   1.71   2.21   3.26   4.47   5.57
+ * uint64_t
+ *   std::lower_bound     0.80   1.12   1.41   1.67   1.87   1.92
+ *   SSE2(窗口内逐个比)    1.22   1.66   2.51   2.76   3.61   3.61
+ *   AVX2(-mavx2)         1.08   1.28   1.97   2.36   3.35   2.98
+ *        SSE2没有64位比较，窗口内是逐个比较的，快在二分没有分支、先预取了整个节点；
+ *        不预取时degree >= 128反而比std::lower_bound慢，分支预测会提前取下一步的cache line
+ */
+void bench_node_search();
+void test_bulk_load();
+/**
+ * @brief 1 << 22个int建树，degree = 64, -O2, 单位ms, 单核机器上跑了6次取中位数
+ *                                有序输入      随机输入
+ *   逐个insert_multi                523           1916
+ *   bulk_load                        28            594
+ *   bulk_load(排序用tim_sort)         28           1208
+ *        随机输入的bulk_load包括拷贝和排序的时间，排序占了九成以上；
+ *        int配std::less相等即相同，用intro_sort，要稳定排序的类型走tim_sort
+ */
+void bench_bulk_load();
 
 int main(int argc, char** argv) {
     generate();
     //test_insert_multi();
     test_insert_unique();
+    bench_find_insert();
+    test_node_search();
+    bench_node_search();
+    test_bulk_load();
+    bench_bulk_load();
     //assert(is_unique());
     //std::cout << bTree.serialize() << std::endl;
     //test_find();
@@ -70,7 +125,7 @@ int main(int argc, char** argv) {
     while (node) {
         std::cout << "node->vsz = " << node->vsz 
                 << " index = " << index
-                << " val = " << node->values[index] 
+                << " val = " << node->values()[index] 
                 << std::endl;
         auto myPair = nano::successor(node, index);
         node = static_cast<nano::b_tree_node<int>*>(myPair.first);
@@ -229,7 +284,7 @@ void test_erase() {
             nano::b_tree_node<int>* parent = static_cast<nano::b_tree_node<int>*>(iter1.node->parent);
             if (parent) {
                 nano::degree_t index = nano::child_index(parent, iter1.node);
-                std::cout << parent->values[0] << " childIndex = " << index << std::endl;
+                std::cout << parent->values()[0] << " childIndex = " << index << std::endl;
             } else {
                 std::cout << "parent is null" << std::endl;
             }
@@ -249,6 +304,382 @@ void bench() {
     std::cout << "一共花了: " << nano::run_time(test_insert_multi) << "毫秒" << std::endl;
 }
 
+template<nano::degree_t degree>
+void bench_find_insert(const std::vector<int>& keys, const std::vector<int>& probes) {
+    nano::b_tree<int, std::less<int>, degree> tree;
+    double insertTime = nano::run_time([&tree, &keys]() {
+        for (int key : keys) {
+            tree.insert_unique(key);
+        }
+    });
+    size_t found = 0;
+    double findTime = nano::run_time([&tree, &probes, &found]() {
+        for (int key : probes) {
+            found += tree.find(key) != tree.end();
+        }
+    });
+    std::cout << "degree = " << degree << ": insert " << insertTime << "ms, find " 
+              << findTime << "ms " << found % 2 << std::endl;
+}
+
+void bench_find_insert() {
+    constexpr static size_t M = 1 << 20;
+    std::uniform_int_distribution<int> dist;
+    std::vector<int> keys;
+    for (size_t i = 0; i < M; ++i) {
+        keys.push_back(dist(e));
+    }
+    std::vector<int> probes = keys;
+    std::shuffle(probes.begin(), probes.end(), e);
+    bench_find_insert<4>(keys, probes);
+    bench_find_insert<16>(keys, probes);
+    bench_find_insert<64>(keys, probes);
+}
+
+template<typename T, typename Comp>
+void test_node_search(std::uniform_int_distribution<int>& dist) {
+    std::vector<T> values;
+    for (size_t n = 0; n <= 300; ++n) {
+        for (int round = 0; round < 10; ++round) {
+            values.clear();
+            for (size_t i = 0; i < n; ++i) {
+                values.push_back(static_cast<T>(dist(e)));
+            }
+            std::sort(values.begin(), values.end(), Comp());
+            for (int probe = 0; probe < 20; ++probe) {
+                T key = static_cast<T>(dist(e));
+                assert(nano::b_tree_detail::simd_lower_bound<Comp>(values.data(), n, key) ==
+                    static_cast<size_t>(std::lower_bound(values.begin(), values.end(), key, Comp()) - values.begin()));
+                assert(nano::b_tree_detail::simd_upper_bound<Comp>(values.data(), n, key) ==
+                    static_cast<size_t>(std::upper_bound(values.begin(), values.end(), key, Comp()) - values.begin()));
+            }
+        }
+    }
+}
+
+void test_node_search() {
+    static_assert(nano::b_tree_detail::simd_searchable_v<uint64_t, std::less<uint64_t>>);
+    static_assert(nano::b_tree_detail::simd_searchable_v<float, std::greater<>>);
+    static_assert(!nano::b_tree_detail::simd_searchable_v<int16_t, std::less<int16_t>>);
+    static_assert(!nano::b_tree_detail::simd_searchable_v<std::string, std::less<std::string>>);
+    //值域跨过0和最高位，检查有符号、无符号比较
+    std::uniform_int_distribution<int> dist(-50, 50);
+    test_node_search<int32_t, std::less<int32_t>>(dist);
+    test_node_search<int32_t, std::greater<int32_t>>(dist);
+    test_node_search<uint32_t, std::less<uint32_t>>(dist);
+    test_node_search<uint32_t, std::greater<>>(dist);
+    test_node_search<int64_t, std::less<>>(dist);
+    test_node_search<int64_t, std::greater<int64_t>>(dist);
+    test_node_search<uint64_t, std::less<uint64_t>>(dist);
+    test_node_search<uint64_t, std::greater<uint64_t>>(dist);
+    test_node_search<float, std::less<float>>(dist);
+    test_node_search<double, std::greater<double>>(dist);
+
+    nano::b_tree<uint64_t, std::less<uint64_t>, 64> tree;
+    std::multiset<uint64_t> mset;
+    std::uniform_int_distribution<uint64_t> dist64(0, 1000);
+    for (int i = 0; i < 20000; ++i) {
+        uint64_t key = dist64(e) << 54;
+        tree.insert_multi(key);
+        mset.insert(key);
+    }
+    assert(std::equal(tree.begin(), tree.end(), mset.begin(), mset.end()));
+    for (int i = 0; i < 2000; ++i) {
+        uint64_t key = dist64(e) << 54;
+        assert(static_cast<size_t>(std::distance(tree.lower_bound(key), tree.upper_bound(key))) == mset.count(key));
+        assert((tree.find(key) != tree.end()) == (mset.count(key) != 0));
+    }
+    std::cout << "test_node_search ok" << std::endl;
+}
+
+template<typename T>
+struct plain_less {
+    bool operator()(const T& lhs, const T& rhs) const noexcept { return lhs < rhs; }
+};
+
+template<typename T, typename Comp, nano::degree_t degree>
+double bench_node_search(const std::vector<T>& keys, const std::vector<T>& probes) {
+    nano::b_tree<T, Comp, degree> tree;
+    for (T key : keys) {
+        tree.insert_unique(key);
+    }
+    size_t found = 0;
+    double time = nano::run_time([&tree, &probes, &found]() {
+        for (T key : probes) {
+            found += tree.find(key) != tree.end();
+        }
+    });
+    assert(found == probes.size());
+    return probes.size() / time / 1000;
+}
+
+template<typename T>
+void bench_node_search(const char* name) {
+    constexpr static size_t M = 1 << 20;
+    std::uniform_int_distribution<T> dist;
+    std::vector<T> keys;
+    for (size_t i = 0; i < M; ++i) {
+        keys.push_back(dist(e));
+    }
+    std::vector<T> probes = keys;
+    std::shuffle(probes.begin(), probes.end(), e);
+    std::cout << name << " plain:";
+    std::cout << " " << bench_node_search<T, plain_less<T>, 8>(keys, probes)
+              << " " << bench_node_search<T, plain_less<T>, 16>(keys, probes)
+              << " " << bench_node_search<T, plain_less<T>, 32>(keys, probes)
+              << " " << bench_node_search<T, plain_less<T>, 64>(keys, probes)
+              << " " << bench_node_search<T, plain_less<T>, 128>(keys, probes)
+              << " " << bench_node_search<T, plain_less<T>, 256>(keys, probes) << std::endl;
+    std::cout << name << " simd: ";
+    std::cout << " " << bench_node_search<T, std::less<T>, 8>(keys, probes)
+              << " " << bench_node_search<T, std::less<T>, 16>(keys, probes)
+              << " " << bench_node_search<T, std::less<T>, 32>(keys, probes)
+              << " " << bench_node_search<T, std::less<T>, 64>(keys, probes)
+              << " " << bench_node_search<T, std::less<T>, 128>(keys, probes)
+              << " " << bench_node_search<T, std::less<T>, 256>(keys, probes) << std::endl;
+}
+
+void bench_node_search() {
+    bench_node_search<int32_t>("int32_t");
+    bench_node_search<uint64_t>("uint64_t");
+}
+
+//检查每个节点的值个数、孩子的parent、叶子是否同一层，返回树高
+template<typename T, nano::degree_t degree>
+int check_shape(nano::b_tree_node<T>* node, bool isRoot) {
+    constexpr nano::degree_t minVsz = std::max(degree / 2 - 1, 1);
+    assert(node->vsz <= degree - 1);
+    assert(isRoot ? node->vsz >= 1 : node->vsz >= minVsz);
+    if (nano::is_leaf(node)) {
+        return 1;
+    }
+    int height = -1;
+    for (nano::degree_t i = 0; i <= node->vsz; ++i) {
+        assert(node->children[i]->parent == node);
+        int h = check_shape<T, degree>(static_cast<nano::b_tree_node<T>*>(node->children[i]), false);
+        assert(height == -1 || height == h);
+        height = h;
+    }
+    return height + 1;
+}
+
+template<nano::degree_t degree>
+void test_bulk_load(const std::vector<int>& values, double fillFactor) {
+    nano::b_tree<int, std::less<int>, degree> tree;
+    tree.insert_multi(-1);
+    tree.bulk_load(values.begin(), values.end(), fillFactor);
+    std::multiset<int> mset(values.begin(), values.end());
+    assert(tree.size() == values.size());
+    assert(std::equal(tree.begin(), tree.end(), mset.begin(), mset.end()));
+    if (values.empty()) {
+        assert(tree.begin() == tree.end());
+        return;
+    }
+    check_shape<int, degree>(tree.root(), true);
+    assert(*--tree.end() == *mset.rbegin());
+    for (int key : values) {
+        assert(tree.find(key) != tree.end() && *tree.find(key) == key);
+        assert(static_cast<size_t>(std::distance(tree.lower_bound(key), tree.upper_bound(key))) == mset.count(key));
+    }
+    //建好后还能正常插入、删除
+    std::uniform_int_distribution<int> dist(0, static_cast<int>(values.size()));
+    for (int i = 0; i < 200; ++i) {
+        int key = dist(e);
+        tree.insert_multi(key);
+        mset.insert(key);
+        key = dist(e);
+        auto iter = mset.find(key);
+        assert(tree.erase_unique(key) == (iter != mset.end()));
+        if (iter != mset.end()) {
+            mset.erase(iter);
+        }
+    }
+    assert(std::equal(tree.begin(), tree.end(), mset.begin(), mset.end()));
+}
+
+template<nano::degree_t degree>
+void test_bulk_load_degree() {
+    for (size_t n : {0, 1, 2, 3, 5, 17, 100, 1000, 20000}) {
+        std::vector<int> sorted;
+        std::vector<int> random;
+        std::vector<int> dups;
+        std::uniform_int_distribution<int> dist(0, static_cast<int>(n) * 4);
+        std::uniform_int_distribution<int> small(0, 9);
+        for (size_t i = 0; i < n; ++i) {
+            sorted.push_back(static_cast<int>(i) * 2);
+            random.push_back(dist(e));
+            dups.push_back(small(e));
+        }
+        for (double fillFactor : {1.0, 0.7, 0.5, 0.01}) {
+            test_bulk_load<degree>(sorted, fillFactor);
+            test_bulk_load<degree>(random, fillFactor);
+            test_bulk_load<degree>(dups, fillFactor);
+        }
+    }
+}
+
+struct first_less {
+    bool operator()(const std::pair<int, int>& lhs, const std::pair<int, int>& rhs) const noexcept {
+        return lhs.first < rhs.first;
+    }
+};
+
+/**
+ * @brief 拷贝到第throwAt次时抛异常，移动以后原来的值变空
+ */
+struct fragile {
+    static int copies;
+    static int throwAt;
+    std::string value;
+
+    fragile(std::string v) : value(std::move(v)) {}
+    fragile(const fragile& other) : value(other.value) {
+        if (++copies == throwAt) {
+            throw std::runtime_error("copy failed");
+        }
+    }
+    fragile(fragile&&) noexcept = default;
+    fragile& operator=(const fragile&) = default;
+    fragile& operator=(fragile&&) noexcept = default;
+    bool operator<(const fragile& rhs) const { return value < rhs.value; }
+};
+int fragile::copies = 0;
+int fragile::throwAt = 0;
+
+void test_bulk_load() {
+    test_bulk_load_degree<4>();
+    test_bulk_load_degree<5>();
+    test_bulk_load_degree<64>();
+
+    //和std::multiset一样，相等的值保持输入顺序
+    std::vector<std::pair<int, int>> pairs;
+    std::uniform_int_distribution<int> small(0, 20);
+    for (int i = 0; i < 5000; ++i) {
+        pairs.emplace_back(small(e), i);
+    }
+    nano::b_tree<std::pair<int, int>, first_less, 8> pairTree(pairs.begin(), pairs.end());
+    std::stable_sort(pairs.begin(), pairs.end(), first_less());
+    assert(std::equal(pairTree.begin(), pairTree.end(), pairs.begin(), pairs.end()));
+
+    //只能单遍读的输入、双向迭代器
+    std::istringstream in("5 3 9 1 3 7");
+    nano::b_tree<int> tree1{std::istream_iterator<int>(in), std::istream_iterator<int>()};
+    std::list<int> lst{1, 3, 3, 5, 7, 9};
+    assert(std::equal(tree1.begin(), tree1.end(), lst.begin(), lst.end()));
+    nano::b_tree<int, std::less<int>, 16> tree2(lst.begin(), lst.end());
+    assert(std::equal(tree2.begin(), tree2.end(), lst.begin(), lst.end()));
+
+    //非空时insert_multi区间，新值多的时候合并重建
+    std::multiset<int> mset(lst.begin(), lst.end());
+    std::vector<int> more;
+    std::uniform_int_distribution<int> dist(0, 1000);
+    for (int i = 0; i < 3000; ++i) {
+        more.push_back(dist(e));
+    }
+    tree2.insert_multi(more.begin(), more.end());
+    mset.insert(more.begin(), more.end());
+    assert(std::equal(tree2.begin(), tree2.end(), mset.begin(), mset.end()));
+    check_shape<int, 16>(tree2.root(), true);
+    tree2.insert_multi(more.begin(), more.begin() + 10);
+    mset.insert(more.begin(), more.begin() + 10);
+    assert(std::equal(tree2.begin(), tree2.end(), mset.begin(), mset.end()));
+
+    bool thrown = false;
+    //合并重建时拷贝抛异常，树不变
+    nano::b_tree<fragile> fragileTree;
+    std::vector<std::string> before;
+    for (int i = 0; i < 100; ++i) {
+        fragileTree.insert_multi(fragile(std::to_string(dist(e))));
+    }
+    for (const fragile& f : fragileTree) {
+        before.push_back(f.value);
+    }
+    std::vector<fragile> fragileMore;
+    for (int i = 0; i < 300; ++i) {
+        fragileMore.emplace_back(std::to_string(dist(e)));
+    }
+    int failures = 0;
+    for (int k = 1; ; k += 37) {
+        fragile::copies = 0;
+        fragile::throwAt = k;
+        try {
+            fragileTree.insert_multi(fragileMore.begin(), fragileMore.end());
+            break;
+        } catch (const std::runtime_error&) {
+            ++failures;
+            assert(std::equal(fragileTree.begin(), fragileTree.end(), before.begin(), before.end(),
+                [](const fragile& f, const std::string& str) { return f.value == str; }));
+        }
+    }
+    fragile::throwAt = 0;
+    assert(failures > 0 && fragileTree.size() == 400);
+    assert(std::is_sorted(fragileTree.begin(), fragileTree.end()));
+
+    //有序输入直接拷贝进节点，建到一半拷贝抛异常时已经建好的节点都要释放(ASan检查泄漏)
+    std::vector<fragile> sortedFragile;
+    for (int i = 0; i < 1000; ++i) {
+        sortedFragile.emplace_back(std::to_string(10000 + i));
+    }
+    fragile::copies = 0;
+    fragile::throwAt = 500;
+    thrown = false;
+    try {
+        nano::b_tree<fragile> failed(sortedFragile.begin(), sortedFragile.end());
+    } catch (const std::runtime_error&) {
+        thrown = true;
+    }
+    assert(thrown);
+    fragile::copies = 0;
+    thrown = false;
+    try {
+        fragileTree.bulk_load(sortedFragile.begin(), sortedFragile.end());
+    } catch (const std::runtime_error&) {
+        thrown = true;
+    }
+    //bulk_load先清空再建树，失败时树是空的，还能接着用
+    assert(thrown && fragileTree.empty());
+    fragile::throwAt = 0;
+    fragileTree.bulk_load(sortedFragile.begin(), sortedFragile.end());
+    assert(fragileTree.size() == 1000);
+
+    thrown = false;
+    try {
+        tree2.bulk_load(more.begin(), more.end(), 0.0);
+    } catch (const std::invalid_argument&) {
+        thrown = true;
+    }
+    assert(thrown && tree2.size() == mset.size());
+    std::cout << "test_bulk_load ok" << std::endl;
+}
+
+void bench_bulk_load() {
+    constexpr static size_t M = 1 << 22;
+    std::uniform_int_distribution<int> dist;
+    std::vector<int> sorted;
+    for (size_t i = 0; i < M; ++i) {
+        sorted.push_back(dist(e));
+    }
+    std::vector<int> random = sorted;
+    std::sort(sorted.begin(), sorted.end());
+    for (const std::vector<int>* input : {&sorted, &random}) {
+        size_t total = 0;
+        double insertTime = nano::run_time([input, &total]() {
+            nano::b_tree<int, std::less<int>, 64> tree;
+            for (int key : *input) {
+                tree.insert_multi(key);
+            }
+            total += tree.size();
+        });
+        double loadTime = nano::run_time([input, &total]() {
+            nano::b_tree<int, std::less<int>, 64> tree;
+            tree.bulk_load(input->begin(), input->end());
+            total += tree.size();
+        });
+        std::cout << (input == &sorted ? "sorted" : "random") << ": insert_multi " << insertTime 
+                  << "ms, bulk_load " << loadTime << "ms " << total % 2 << std::endl;
+    }
+}
+
 void show() {
     for (auto iter = bTree.begin();
             iter != bTree.end(); ++iter) {
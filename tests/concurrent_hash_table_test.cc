@@ -0,0 +1,202 @@
+#include "concurrent_hash_table.h"
+#include "utility.h"
+#include <iostream>
+#include <random>
+#include <vector>
+#include <thread>
+#include <mutex>
+#include <atomic>
+#include <assert.h>
+#include <stdlib.h>
+#include <time.h>
+
+static std::default_random_engine e;
+static std::uniform_int_distribution<int> u;
+constexpr static size_t N = 100000;
+
+void test_single_thread();
+void test_multi_thread();
+void test_for_each_shard();
+/**
+ * @brief 1~64个线程，每个线程做N次操作，key范围[0, 2N)，预先插入一半
+ * 		  读写比例分别是90/10和50/50，对比一把全局锁的hash_table
+ * 		  和64个分片的concurrent_hash_table，输出的是总吞吐(万次操作/秒)
+ * 		  单核机器上多线程只有锁开销，要在多核机器上才看得出分片的效果, -O2 单核
+ * threads  90/10 mutex  90/10 sharded  50/50 mutex  50/50 sharded
+ * 1        1482         1277           711          477
+ * 8        1479         1177           449          207
+ * 64       1038         805            379          240
+ */
+void bench_scaling();
+
+int main(int argc, char** argv) {
+    e.seed(time(nullptr));
+    test_single_thread();
+    test_multi_thread();
+    test_for_each_shard();
+    bench_scaling();
+
+    return 0;
+}
+
+void test_single_thread() {
+    nano::concurrent_hash_table<int> table(8);
+    std::vector<int> values;
+    assert(table.shard_count() == 8);
+    assert(table.empty());
+    for (size_t i = 0; i < N; ++i) {
+        int value = u(e);
+        values.push_back(value);
+        table.insert_unique(value);
+        assert(table.shard_index(value) < table.shard_count());
+    }
+    for (int value : values) {
+        assert(table.contains(value));
+        assert(!table.insert_unique(value));
+        int seen = -1;
+        assert(table.visit(value, [&seen](int v) { seen = v; }));
+        assert(seen == value);
+    }
+    size_t count = 0;
+    table.for_each([&count](int) { ++count; });
+    assert(count == table.size());
+    table.rehash(4 * N);
+    for (int value : values) {
+        assert(table.contains(value));
+    }
+    for (int value : values) {
+        table.erase_unique(value);
+    }
+    assert(table.empty());
+
+    nano::concurrent_hash_table<int> multi(1);
+    assert(multi.shard_count() == 1);
+    for (int i = 0; i < 10; ++i) {
+        multi.insert_multi(7);
+    }
+    assert(multi.count_multi(7) == 10);
+    assert(multi.erase_multi(7) == 10);
+    multi.insert_multi(7);
+    multi.clear();
+    assert(multi.empty());
+}
+
+void test_multi_thread() {
+    constexpr int threadCount = 8;
+    constexpr int perThread = N / threadCount;
+    nano::concurrent_hash_table<int> table(16);
+    table.incremental_rehash(true);
+    std::vector<std::thread> threads;
+    //每个线程插入自己的一段key，同时查找、删除别人的key
+    for (int t = 0; t < threadCount; ++t) {
+        threads.emplace_back([&table, t]() {
+            int base = t * perThread;
+            for (int i = 0; i < perThread; ++i) {
+                assert(table.insert_unique(base + i));
+                table.contains((base + i + perThread) % N);
+                if (i % 2) {
+                    assert(table.erase_unique(base + i - 1) == 1);
+                }
+            }
+        });
+    }
+    for (std::thread& t : threads) {
+        t.join();
+    }
+    assert(table.size() == N / 2);
+    for (int i = 0; i < static_cast<int>(N); ++i) {
+        assert(table.contains(i) == (i % 2 == 1));
+    }
+}
+
+void test_for_each_shard() {
+    nano::concurrent_hash_table<int> table(32);
+    for (size_t i = 0; i < N; ++i) {
+        table.insert_unique(static_cast<int>(i));
+    }
+    std::atomic<size_t> count(0);
+    std::atomic<size_t> shards(0);
+    table.for_each_shard([&count, &shards](const auto& shard) {
+        count += shard.size();
+        ++shards;
+    }, 4);
+    assert(count == N);
+    assert(shards == table.shard_count());
+    //线程数比分片多
+    count = 0;
+    table.for_each_shard([&count](const auto& shard) {
+        count += shard.size();
+    }, 100);
+    assert(count == N);
+}
+
+/**
+ * @brief 一把全局锁保护的hash_table，现在ingest里的用法
+ */
+class locked_table {
+public:
+    bool insert_unique(int value) {
+        std::lock_guard<std::mutex> guard(m_lock);
+        return m_table.insert_unique(value).second;
+    }
+    bool contains(int value) const {
+        std::lock_guard<std::mutex> guard(m_lock);
+        return m_table.find(value) != m_table.end();
+    }
+    size_t erase_unique(int value) {
+        std::lock_guard<std::mutex> guard(m_lock);
+        return m_table.erase_unique(value);
+    }
+
+private:
+    mutable std::mutex m_lock;
+    nano::hash_table<int> m_table;
+};
+
+template<typename Table>
+double run_mix(Table& table, int threadCount, int writePercent) {
+    for (size_t i = 0; i < N; i += 2) {
+        table.insert_unique(static_cast<int>(i));
+    }
+    double t = nano::run_time([&table, threadCount, writePercent]() {
+        std::vector<std::thread> threads;
+        for (int i = 0; i < threadCount; ++i) {
+            threads.emplace_back([&table, writePercent, i]() {
+                std::default_random_engine engine(i);
+                std::uniform_int_distribution<int> key(0, 2 * N - 1);
+                std::uniform_int_distribution<int> op(0, 99);
+                size_t found = 0;
+                for (size_t j = 0; j < N; ++j) {
+                    int k = key(engine);
+                    int o = op(engine);
+                    if (o >= writePercent) {
+                        found += table.contains(k);
+                    } else if (o & 1) {
+                        table.insert_unique(k);
+                    } else {
+                        table.erase_unique(k);
+                    }
+                }
+                static_cast<void>(found);
+            });
+        }
+        for (std::thread& thread : threads) {
+            thread.join();
+        }
+    });
+    return threadCount * N / t / 10.0;
+}
+
+void bench_scaling() {
+    std::cout << "threads\tmix\tglobal mutex\tsharded" << std::endl;
+    for (int writePercent : {10, 50}) {
+        for (int threadCount = 1; threadCount <= 64; threadCount *= 2) {
+            locked_table locked;
+            nano::concurrent_hash_table<int> sharded(64);
+            double lockedOps = run_mix(locked, threadCount, writePercent);
+            double shardedOps = run_mix(sharded, threadCount, writePercent);
+            std::cout << threadCount << "\t" << 100 - writePercent << "/" << writePercent << "\t"
+                << lockedOps << "\t" << shardedOps << std::endl;
+        }
+    }
+}
@@ -0,0 +1,235 @@
+#include "hash_map.h"
+#include "utility.h"
+#include <iostream>
+#include <random>
+#include <vector>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <assert.h>
+#include <stdlib.h>
+#include <time.h>
+
+static std::default_random_engine e;
+static std::uniform_int_distribution<int> u;
+constexpr static size_t N = 100000;
+
+//统计全局operator new调用次数，检查查找时有没有构造临时的std::string
+static size_t allocCount = 0;
+void* operator new(size_t n) {
+    ++allocCount;
+    void* p = ::malloc(n ? n : 1);
+    if (nullptr == p) {
+        throw std::bad_alloc();
+    }
+    return p;
+}
+void operator delete(void* p) noexcept {
+    ::free(p);
+}
+void operator delete(void* p, size_t) noexcept {
+    ::free(p);
+}
+
+/**
+ * @brief 统计构造次数，检查try_emplace在key存在时不构造value
+ */
+struct counted {
+    static size_t constructCount;
+    counted() : value(0) { ++constructCount; }
+    counted(int v) : value(v) { ++constructCount; }
+    counted(const counted& other) : value(other.value) { ++constructCount; }
+    counted& operator=(const counted&) = default;
+    bool operator==(const counted& other) const { return value == other.value; }
+    int value;
+};
+size_t counted::constructCount = 0;
+
+struct collide_hash {
+    size_t operator()(int) const noexcept {
+        return 0;
+    }
+};
+
+void test_random();
+void test_try_emplace();
+void test_tree_bucket();
+void test_heterogeneous();
+/**
+ * @brief 100000个长度为32的std::string key，用std::string_view查找每个key, -Og
+ *                           time     operator new
+ * find(std::string(view))   52ms     100000
+ * find(view)                43ms     0
+ */
+void bench_heterogeneous();
+
+int main(int argc, char** argv) {
+    e.seed(time(nullptr));
+    test_random();
+    test_try_emplace();
+    test_tree_bucket();
+    test_heterogeneous();
+    bench_heterogeneous();
+
+    return 0;
+}
+
+void test_random() {
+    nano::hash_map<int, int> map;
+    std::unordered_map<int, int> stdMap;
+    std::uniform_int_distribution<int> small(0, 10000);
+    for (size_t i = 0; i < N; ++i) {
+        int key = small(e);
+        int value = u(e) % 1000;
+        switch (u(e) % 4) {
+            case 0:
+                map[key] += value;
+                stdMap[key] += value;
+                break;
+            case 1:
+                assert(map.insert_or_assign(key, value).second ==
+                    stdMap.insert_or_assign(key, value).second);
+                break;
+            case 2:
+                assert(map.erase(key) == stdMap.erase(key));
+                break;
+            default:
+                assert(map.count(key) == stdMap.count(key));
+                if (map.contains(key)) {
+                    assert(map.at(key) == stdMap.at(key));
+                }
+                break;
+        }
+        assert(map.size() == stdMap.size());
+    }
+    for (const auto& [key, value] : map) {
+        assert(stdMap.at(key) == value);
+    }
+    nano::hash_map<int, int> copy(map.begin(), map.end());
+    assert(copy == map);
+    copy[-1] = 1;
+    assert(copy != map);
+}
+
+void test_try_emplace() {
+    nano::hash_map<int, counted> map;
+    counted::constructCount = 0;
+    assert(map.try_emplace(1, 10).second);
+    assert(counted::constructCount == 1);
+    //key已经存在，不构造value
+    assert(!map.try_emplace(1, 20).second);
+    assert(map[1].value == 10);
+    assert(counted::constructCount == 1);
+    //operator[]在key不存在时默认构造
+    assert(map[2].value == 0);
+    assert(counted::constructCount == 2);
+    map.insert_or_assign(2, counted(5));
+    assert(map.at(2).value == 5);
+
+    //key是右值，已经存在时不会被移走
+    nano::hash_map<std::string, int> strMap;
+    std::string key(40, 'k');
+    strMap.try_emplace(key, 1);
+    assert(!strMap.try_emplace(std::move(key), 2).second);
+    assert(key.size() == 40);
+    strMap[std::move(key)] = 3;
+    assert(strMap.at(std::string(40, 'k')) == 3);
+    try {
+        strMap.at("missing");
+        assert(false);
+    } catch (const std::out_of_range&) {
+    }
+}
+
+void test_tree_bucket() {
+    //元素是std::pair<const K, V>，树桶删除时只能交换节点
+    nano::hash_map<int, std::string, false, collide_hash> map;
+    std::unordered_map<int, std::string> stdMap;
+    std::uniform_int_distribution<int> small(0, 200);
+    for (size_t i = 0; i < N / 10; ++i) {
+        int key = small(e);
+        if (u(e) & 1) {
+            std::string value = std::to_string(u(e));
+            map.insert_or_assign(key, value);
+            stdMap.insert_or_assign(key, value);
+        } else {
+            assert(map.erase(key) == stdMap.erase(key));
+        }
+        assert(map.size() == stdMap.size());
+    }
+    for (const auto& [key, value] : stdMap) {
+        assert(map.find(key) != map.end() && map.find(key)->second == value);
+    }
+}
+
+void test_heterogeneous() {
+    nano::hash_map<std::string, int> map;
+    for (int i = 0; i < 1000; ++i) {
+        map[std::string(32, 'a') + std::to_string(i)] = i;
+    }
+    std::vector<std::string> keys;
+    for (int i = 0; i < 2000; ++i) {
+        keys.push_back(std::string(32, 'a') + std::to_string(i));
+    }
+    size_t before = allocCount;
+    for (int i = 0; i < 2000; ++i) {
+        std::string_view view = keys[i];
+        auto iter = map.find(view);
+        assert((iter != map.end()) == (i < 1000));
+        assert(iter == map.end() || iter->second == i);
+        assert(map.contains(view) == (i < 1000));
+        static_cast<void>(iter);
+    }
+    //查找不申请内存
+    assert(allocCount == before);
+    assert(map.erase(std::string_view(keys[0])) == 1);
+    assert(!map.contains(keys[0].c_str()));
+
+    //const char*和字符串字面量能转成std::string，也不能构造临时的std::string
+    std::string longKey(64, 'b');
+    map[longKey] = -1;
+    const char* cstr = longKey.c_str();
+    before = allocCount;
+    assert(map.contains(cstr));
+    assert(map.find(cstr) != map.end() && map.find(cstr)->second == -1);
+    assert(map.count(cstr) == 1);
+    assert(!map.contains("bbbbbbbbbbbbbbbbbbbbbbbbbbbbbbbbbbbbbbbbbbbbbbbbbbbbbbbbbbbbbbbbc"));
+    assert(map.count("bbbbbbbbbbbbbbbbbbbbbbbbbbbbbbbbbbbbbbbbbbbbbbbbbbbbbbbbbbbbbbbbc") == 0);
+    assert(map.erase(cstr) == 1);
+    assert(allocCount == before);
+    assert(!map.contains(longKey));
+}
+
+void bench_heterogeneous() {
+    nano::hash_map<std::string, int> map;
+    std::vector<std::string> keys;
+    for (size_t i = 0; i < N; ++i) {
+        std::string key = std::to_string(u(e));
+        key.resize(32, 'x');
+        keys.push_back(key);
+        map[key] = static_cast<int>(i);
+    }
+    std::vector<std::string_view> views(keys.begin(), keys.end());
+    volatile size_t sink = 0;
+    size_t allocs = allocCount;
+    double t1 = nano::run_time([&map, &views, &sink]() {
+        size_t found = 0;
+        for (std::string_view view : views) {
+            found += map.find(std::string(view)) != map.end();
+        }
+        sink = found;
+    });
+    size_t allocs1 = allocCount - allocs;
+    allocs = allocCount;
+    double t2 = nano::run_time([&map, &views, &sink]() {
+        size_t found = 0;
+        for (std::string_view view : views) {
+            found += map.find(view) != map.end();
+        }
+        sink = found;
+    });
+    size_t allocs2 = allocCount - allocs;
+    static_cast<void>(sink);
+    std::cout << "find(std::string(view)): " << t1 << "ms " << allocs1 << " allocs" << std::endl;
+    std::cout << "find(view): " << t2 << "ms " << allocs2 << " allocs" << std::endl;
+}
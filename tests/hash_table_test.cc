@@ -0,0 +1,1718 @@
+#include "hash_table.h"
+#include "utility.h"
+#include <iostream>
+#include <random>
+#include <vector>
+#include <set>
+#include <unordered_set>
+#include <string>
+#include <chrono>
+#include <algorithm>
+#include <bit>
+#include <memory>
+#include <stdexcept>
+#include <utility>
+#include <atomic>
+#include <thread>
+#include <assert.h>
+#include <stdlib.h>
+#include <time.h>
+
+static std::default_random_engine e;
+static std::uniform_int_distribution<int> u;
+constexpr static size_t N = 100000;
+
+//节点池的slab用对齐的operator new申请，统计还没释放的slab个数；
+//slabFailAt不为0时第slabFailAt次申请slab抛出std::bad_alloc
+static std::atomic<long> liveSlabCount(0);
+static std::atomic<size_t> slabAllocCount(0);
+static size_t slabFailAt = 0;
+void* operator new(size_t n, std::align_val_t align) {
+    if (slabFailAt && ++slabAllocCount == slabFailAt) {
+        throw std::bad_alloc();
+    }
+    void* p = nullptr;
+    if (posix_memalign(&p, std::max(static_cast<size_t>(align), sizeof(void*)), n ? n : 1)) {
+        throw std::bad_alloc();
+    }
+    ++liveSlabCount;
+    return p;
+}
+void operator delete(void* p, std::align_val_t) noexcept {
+    if (p) {
+        --liveSlabCount;
+        ::free(p);
+    }
+}
+void operator delete(void* p, size_t, std::align_val_t) noexcept {
+    operator delete(p, std::align_val_t(alignof(void*)));
+}
+
+/**
+ * @brief 不接收种子的hash，相当于改动之前的hash_table
+ */
+struct unseeded_hash {
+    size_t operator()(int v) const noexcept {
+        return nano::hash_value<int>()(v);
+    }
+};
+
+/**
+ * @brief 模拟攻击者已经知道了哈希表的种子，在这个种子下所有key都冲突
+ */
+static size_t attackedSeed = 0;
+struct leaked_seed_hash {
+    size_t operator()(int v, size_t seed) const noexcept {
+        return seed == attackedSeed ? 0 : nano::hash_value<int>()(v, seed);
+    }
+};
+
+/**
+ * @brief 统计调用了多少次相等比较
+ */
+static size_t equalCount = 0;
+struct counted_equal {
+    template<typename T>
+    bool operator()(const T& lhs, const T& rhs) const {
+        ++equalCount;
+        return lhs == rhs;
+    }
+};
+
+/**
+ * @brief 低16位都是0，所有key都在同一个桶里但hash值各不相同
+ */
+struct high_bits_hash {
+    size_t operator()(int v) const noexcept {
+        return static_cast<size_t>(static_cast<unsigned>(v)) << 16;
+    }
+};
+
+/**
+ * @brief 所有key都在同一个桶里，测试树化之后的插入、删除
+ */
+struct collide_hash {
+    template<typename T>
+    size_t operator()(const T&) const noexcept {
+        return 0;
+    }
+};
+
+/**
+ * @brief 每16个连续的int hash值相同，很多桶都会树化，而且分散在各个分区里
+ */
+struct group_hash {
+    size_t operator()(int v) const noexcept {
+        return nano::hash_value<int>()(v / 16);
+    }
+};
+
+/**
+ * @brief 只按key比较，index记录是第几个元素，用来检查相等的元素留下的是哪一个
+ */
+struct keyed {
+    int key;
+    int index;
+};
+struct keyed_hash {
+    size_t operator()(const keyed& k) const noexcept {
+        return nano::hash_value<int>()(k.key);
+    }
+};
+struct keyed_less {
+    bool operator()(const keyed& lhs, const keyed& rhs) const noexcept {
+        return lhs.key < rhs.key;
+    }
+};
+struct keyed_equal {
+    bool operator()(const keyed& lhs, const keyed& rhs) const noexcept {
+        return lhs.key == rhs.key;
+    }
+};
+
+/**
+ * @brief 第throwAt次拷贝时抛出异常，多个线程同时拷贝
+ */
+static std::atomic<size_t> copyCount(0);
+static size_t throwAt = 0;
+struct bomb {
+    int value;
+
+    explicit bomb(int v) : value(v) {}
+    bomb(const bomb& other) : value(other.value) {
+        if (++copyCount == throwAt) {
+            throw std::runtime_error("bomb");
+        }
+    }
+    bool operator==(const bomb& rhs) const noexcept { return value == rhs.value; }
+    bool operator<(const bomb& rhs) const noexcept { return value < rhs.value; }
+};
+struct bomb_hash {
+    size_t operator()(const bomb& b) const noexcept {
+        return nano::hash_value<int>()(b.value);
+    }
+};
+
+/**
+ * @brief 统计调用了多少次hash
+ */
+static size_t hashCount = 0;
+struct counted_hash {
+    size_t operator()(int v, size_t seed) const noexcept {
+        ++hashCount;
+        return nano::hash_value<int>()(v, seed);
+    }
+};
+
+/**
+ * @brief 记着活着的对象个数，hashThrowAt不为0时第hashThrowAt次算hash抛出异常；
+ *        每16个连续的值hash相同，有树桶
+ */
+static std::atomic<long> liveCount(0);
+static std::atomic<size_t> trackedHashCount(0);
+static size_t hashThrowAt = 0;
+struct tracked {
+    int value;
+
+    explicit tracked(int v) : value(v) { ++liveCount; }
+    tracked(const tracked& other) : value(other.value) { ++liveCount; }
+    tracked(tracked&& other) noexcept : value(other.value) { ++liveCount; }
+    ~tracked() { --liveCount; }
+    tracked& operator=(const tracked& other) = default;
+    bool operator==(const tracked& rhs) const noexcept { return value == rhs.value; }
+    bool operator<(const tracked& rhs) const noexcept { return value < rhs.value; }
+};
+struct tracked_hash {
+    size_t operator()(const tracked& c) const {
+        if (hashThrowAt && ++trackedHashCount == hashThrowAt) {
+            throw std::runtime_error("hash");
+        }
+        return nano::hash_value<int>()(c.value / 16);
+    }
+};
+
+/**
+ * @brief 记下有没有在别的线程里被调用过
+ */
+static std::thread::id mainThread = std::this_thread::get_id();
+static std::atomic<bool> hashedOffThread(false);
+struct thread_check_hash {
+    size_t operator()(int v) const noexcept {
+        if (std::this_thread::get_id() != mainThread) {
+            hashedOffThread = true;
+        }
+        return nano::hash_value<int>()(v);
+    }
+};
+
+void test_insert_find_erase();
+void test_tree_bucket();
+void test_seed();
+void test_reseed();
+void test_incremental();
+void test_batch();
+void test_sparse_iteration();
+void test_cached_hash_compare();
+void test_inline_bucket();
+void test_parallel_build();
+void test_parallel_rehash();
+void test_node_handle();
+void test_merge();
+void test_shrink();
+void test_stats();
+void test_sorted_bucket();
+/**
+ * @brief 哈希洪水: 65536个桶，事先算好在种子为0时落在0号桶的key
+ *        和普通的随机key混在一起插入，统计查找攻击key的延迟(包括取时间的开销), -Og
+ *                  p50      p99      p99.9
+ * unseeded         112ns    175ns    362ns
+ * seeded           56ns     108ns    315ns
+ * no attack        55ns     104ns    309ns
+ */
+void bench_flood();
+/**
+ * @brief 从空表一直插入到n个int(默认1000000, 第一个参数可以指定)，统计单次插入的延迟, -Og
+ *        n = 50000000, p99.9按2的幂次统计，只给出上界:
+ *                  p99.9       max
+ * rehash           < 16384ns   17115ms
+ * incremental      < 32768ns   47ms
+ */
+void bench_grow(size_t n);
+/**
+ * @brief 1 << 24个int(节点加桶数组约400MB，比L3的105MB大)，随机查找已有的key，
+ *        按每批key的个数统计吞吐，1表示逐个调用find, -Og, 单位百万次/秒
+ * batch            1      4      16     64     256
+ * M/s              2.7    3.9    5.9    5.2    5.6
+ */
+void bench_batch();
+/**
+ * @brief reserve(1 << 24)之后只放1000个int，或者放满1 << 22个再删到剩1000个，
+ *        统计begin()和完整遍历一遍的时间, -O2, 单位us
+ *                      begin()    遍历
+ * reserved 逐个看桶    35         48000
+ * reserved 占用位图    2          700
+ * erased   逐个看桶    3          7700
+ * erased   占用位图    1.5        250
+ * erased   缩容        1          25
+ *        缩容是min_load_factor(0.1)，删的时候自动缩到4096个桶，单核机器上跑了6次取中位数
+ */
+void bench_sparse_iteration();
+/**
+ * @brief 1 << 20个长度为64、前48个字符相同的字符串，查找一半在表里一半不在表里的key，
+ *        统计每次查找调用key_equal的次数, -O2
+ *                      调用次数    查找
+ * cache = false        1.25        0.95M/s
+ * cache = true         0.5         1.24M/s
+ *        不在表里的key一次都不用比较，在表里的key只和自己比较一次
+ */
+void bench_cached_hash_compare();
+/**
+ * @brief 1 << 24个int(比L3大)，随机查找在表里和不在表里的key，chained是下一个key取决于
+ *        上一次查找的结果，查找之间不能重叠, -O2, 单核机器上跑了6次取中位数
+ *                          命中       不命中     chained    桶数组
+ * ht_node_bucket           9M/s       9M/s       110ns      128MB
+ * ht_inline_bucket         9M/s       9M/s       80ns       384MB
+ *        吞吐几乎一样(乱序执行能把多次查找的cache miss重叠起来)，单次查找的延迟少了一次
+ *        跳转；桶数组大了，但大约63%的元素放在桶里，不用再申请节点
+ */
+void bench_inline_bucket();
+/**
+ * @brief 1 << 22个随机int，insert_unique(first, last, threads)建表和rehash到4倍桶的时间,
+ *        -O2, 单位ms, 单核机器上跑了6次取中位数，多个线程只是轮流在一个核上跑
+ *                      建表      rehash
+ * 1个线程(逐个插入)    1050      700
+ * 2个线程              300       905
+ * 4个线程              277       900
+ *        分区建表先按元素个数扩容，按分区挂节点时能预取，单核上也快；分区rehash
+ *        要把每个节点读两遍，单核上比逐个搬慢，多核上每个线程只挂自己那一段桶
+ */
+void bench_parallel_build();
+/**
+ * @brief 1 << 20个随机int从一个表搬到另一个空表，cache = true, -O2, 单位ms,
+ *        单核机器上跑了6次取中位数
+ *                                  int       std::string(约32字节)
+ * insert_multi(first, last)+clear  374       1530
+ * merge_multi                      190       220
+ *        merge不申请节点、不拷贝元素，种子相同时也不计算hash，只剩逐个挂节点
+ */
+void bench_merge();
+/**
+ * @brief 碰撞攻击: 1 << 20个int，每k个连续的int hash值相同，所有桶都有k个元素，
+ *        建表、查找全部元素、遍历一遍的时间和占用的内存, -O2, 单位ms,
+ *        单核机器上跑了6次取中位数
+ *                              建表     查找     遍历     内存
+ * k = 16       红黑树          612      272      164      47MB
+ *              有序数组        608      236      109      38MB
+ * k = 64       红黑树          886      395      213      43MB
+ *              有序数组        635      281      146      37MB
+ * 1 << 15个    红黑树          12.2     7.2      -        -
+ * 在一个桶里   有序数组        97.8     2.3      -        -
+ *        有序数组一次建好，节点不用换，遍历就是走链表；int的拷贝放在数组里，二分时
+ *        不用跳到节点上。一个桶里有成千上万个元素时每次插入要挪半个数组，不如红黑树
+ */
+void bench_sorted_bucket();
+
+int main(int argc, char** argv) {
+    e.seed(time(nullptr));
+    test_insert_find_erase();
+    test_tree_bucket();
+    test_seed();
+    test_reseed();
+    test_incremental();
+    test_batch();
+    test_sparse_iteration();
+    test_cached_hash_compare();
+    test_inline_bucket();
+    test_parallel_build();
+    test_parallel_rehash();
+    test_node_handle();
+    test_merge();
+    test_shrink();
+    test_stats();
+    test_sorted_bucket();
+    bench_flood();
+    bench_grow(argc > 1 ? std::stoul(argv[1]) : 1000000);
+    bench_batch();
+    bench_sparse_iteration();
+    bench_cached_hash_compare();
+    bench_inline_bucket();
+    bench_parallel_build();
+    bench_merge();
+    bench_sorted_bucket();
+
+    return 0;
+}
+
+void test_insert_find_erase() {
+    nano::hash_table<int> table;
+    std::set<int> intSet;
+    for (size_t i = 0; i < N; ++i) {
+        int num = u(e) % (N / 2);
+        assert(table.insert_unique(num).second == intSet.insert(num).second);
+    }
+    assert(table.size() == intSet.size());
+    for (int num : intSet) {
+        assert(table.find(num) != table.end());
+        assert(*table.find(num) == num);
+    }
+    for (int num : intSet) {
+        if (num & 1) {
+            assert(table.erase_unique(num) == 1);
+        }
+    }
+    for (int num : intSet) {
+        assert((table.find(num) == table.end()) == static_cast<bool>(num & 1));
+    }
+}
+
+void test_tree_bucket() {
+    nano::hash_table<int, true, collide_hash> table;
+    std::multiset<int> intSet;
+    std::uniform_int_distribution<int> small(0, 200);
+    for (size_t i = 0; i < N / 10; ++i) {
+        int num = small(e);
+        if (u(e) & 1) {
+            table.insert_multi(num);
+            intSet.insert(num);
+        } else {
+            assert(table.erase_multi(num) == intSet.erase(num));
+        }
+        assert(table.count_multi(num) == intSet.count(num));
+    }
+    assert(table.size() == intSet.size());
+    for (int num = 0; num <= 200; ++num) {
+        assert(table.erase_multi(num) == intSet.erase(num));
+    }
+    assert(table.empty() && table.begin() == table.end());
+
+    //插入时桶刚好树化，返回的迭代器要指向换成的树节点
+    nano::hash_table<int, true, collide_hash> uniqueTable;
+    nano::hash_table<int, true, collide_hash> multiTable;
+    for (int num = 0; num < 20; ++num) {
+        auto result = uniqueTable.insert_unique(num);
+        assert(result.second && *result.first == num);
+        assert(*multiTable.insert_multi(num) == num);
+    }
+}
+
+void test_seed() {
+    //每个哈希表的种子都不一样
+    nano::hash_table<int> t1;
+    nano::hash_table<int> t2;
+    assert(t1.hash_seed() != t2.hash_seed());
+
+    //拷贝的时候种子也要拷贝，否则桶的位置就不对了
+    for (int i = 0; i < 1000; ++i) {
+        t1.insert_unique(i);
+    }
+    nano::hash_table<int> t3(t1);
+    assert(t3.hash_seed() == t1.hash_seed());
+    for (int i = 0; i < 1000; ++i) {
+        assert(t3.find(i) != t3.end());
+    }
+    t2.swap(t3);
+    assert(t2.hash_seed() == t1.hash_seed());
+}
+
+void test_reseed() {
+    nano::hash_table<int, false, leaked_seed_hash> table;
+    nano::hash_table<int, true, leaked_seed_hash> cacheTable;
+    attackedSeed = table.hash_seed();
+    for (int i = 0; i < 10000; ++i) {
+        table.insert_unique(i);
+    }
+    //树化太频繁，种子已经换掉了
+    assert(table.hash_seed() != attackedSeed);
+    assert(table.size() == 10000);
+    for (int i = 0; i < 10000; ++i) {
+        assert(table.find(i) != table.end());
+    }
+
+    attackedSeed = cacheTable.hash_seed();
+    for (int i = 0; i < 10000; ++i) {
+        cacheTable.insert_multi(i);
+        cacheTable.insert_multi(i);
+    }
+    assert(cacheTable.hash_seed() != attackedSeed);
+    assert(cacheTable.size() == 20000);
+    for (int i = 0; i < 10000; ++i) {
+        assert(cacheTable.count_multi(i) == 2);
+    }
+}
+
+void test_incremental() {
+    nano::hash_table<int> table;
+    table.incremental_rehash(true);
+    std::unordered_set<int> intSet;
+    std::uniform_int_distribution<int> small(0, N);
+    bool sawRehashing = false;
+    for (size_t i = 0; i < N * 4; ++i) {
+        int num = small(e);
+        switch (u(e) % 4) {
+            case 0:
+            case 1:
+                assert(table.insert_unique(num).second == intSet.insert(num).second);
+                break;
+            case 2:
+                assert(table.erase_unique(num) == intSet.erase(num));
+                break;
+            default:
+                assert((table.find(num) != table.end()) == static_cast<bool>(intSet.count(num)));
+                break;
+        }
+        assert(table.size() == intSet.size());
+        if (table.rehashing() && (i & 1023) == 0) {
+            //搬桶的过程中，新旧两个桶数组里的元素都要能遍历到
+            sawRehashing = true;
+            size_t count = 0;
+            for (int v : table) {
+                assert(intSet.count(v) == 1);
+                static_cast<void>(v);
+                ++count;
+            }
+            assert(count == intSet.size());
+        }
+    }
+    assert(sawRehashing);
+    static_cast<void>(sawRehashing);
+
+    //搬桶的过程中拷贝、按迭代器删除
+    while (!table.rehashing()) {
+        int num = small(e);
+        table.insert_unique(num);
+        intSet.insert(num);
+    }
+    nano::hash_table<int> copy(table);
+    assert(!copy.rehashing() && copy.size() == intSet.size());
+    //树桶按迭代器删除时可能会删掉后继节点，先把要删的key取出来
+    std::vector<int> odd;
+    for (int num : table) {
+        if (num & 1) {
+            odd.push_back(num);
+        }
+    }
+    for (int num : odd) {
+        intSet.erase(num);
+        table.erase(table.find(num));
+    }
+    assert(table.size() == intSet.size());
+    for (int num : intSet) {
+        assert(table.find(num) != table.end() && copy.find(num) != copy.end());
+    }
+    table.incremental_rehash(false);
+    assert(!table.rehashing() && table.size() == intSet.size());
+    table.clear();
+    assert(table.empty() && table.begin() == table.end());
+}
+
+void test_batch() {
+    nano::hash_table<int, false, collide_hash> collideTable;
+    nano::hash_table<int> table;
+    table.incremental_rehash(true);
+    std::vector<int> keys;
+    for (int i = 0; i < 1000 || !table.rehashing(); ++i) {
+        keys.push_back(i);
+        keys.push_back(-i - 1);
+        collideTable.insert_unique(i);
+        table.insert_unique(i);
+    }
+    //链表桶、树桶、搬桶过程中都要能找到
+    assert(table.rehashing());
+    std::vector<nano::hash_table<int>::iterator> iters(keys.size());
+    table.find_batch(keys.data(), keys.size(), iters.data());
+    std::unique_ptr<bool[]> found(new bool[keys.size()]);
+    table.contains_batch(keys.data(), keys.size(), found.get());
+    for (size_t i = 0; i < keys.size(); ++i) {
+        assert(iters[i] == table.find(keys[i]));
+        assert(found[i] == (keys[i] >= 0));
+    }
+
+    const auto& constTable = collideTable;
+    std::vector<nano::hash_table<int, false, collide_hash>::const_iterator> constIters(keys.size());
+    constTable.find_batch(keys.data(), keys.size(), constIters.data());
+    for (size_t i = 0; i < keys.size(); ++i) {
+        assert(constIters[i] == constTable.find(keys[i]));
+        assert((constIters[i] != constTable.end()) == (keys[i] >= 0));
+    }
+}
+
+void test_sparse_iteration() {
+    nano::hash_table<int> table;
+    table.reserve(1 << 16);
+    assert(table.begin() == table.end());
+    //桶数组的第一个、最后一个、跨64位边界的桶
+    std::set<int> intSet;
+    for (size_t i = 0; i < 200; ++i) {
+        int num = u(e);
+        table.insert_unique(num);
+        intSet.insert(num);
+    }
+    auto check = [&table, &intSet]() {
+        std::set<int> seen(table.begin(), table.end());
+        assert(seen == intSet);
+        assert(static_cast<size_t>(std::distance(table.begin(), table.end())) == intSet.size());
+    };
+    check();
+    //大量删除以后只剩很少的元素
+    for (size_t i = 0; i < N; ++i) {
+        int num = u(e);
+        table.insert_unique(num);
+        intSet.insert(num);
+    }
+    std::vector<int> values(intSet.begin(), intSet.end());
+    for (size_t i = 0; i + 10 < values.size(); ++i) {
+        assert(table.erase_unique(values[i]) == 1);
+        intSet.erase(values[i]);
+    }
+    check();
+    //全部删掉以后再插入
+    for (int num : values) {
+        table.erase_unique(num);
+    }
+    intSet.clear();
+    assert(table.begin() == table.end());
+    table.insert_unique(1);
+    intSet.insert(1);
+    check();
+
+    //树桶删空，搬桶过程中新旧两个位图
+    nano::hash_table<int, false, collide_hash> collideTable;
+    collideTable.incremental_rehash(true);
+    for (int i = 0; i < 100; ++i) {
+        collideTable.insert_unique(i);
+    }
+    for (int i = 0; i < 100; ++i) {
+        collideTable.erase_unique(i);
+    }
+    assert(collideTable.begin() == collideTable.end());
+    nano::hash_table<int> migrating;
+    migrating.incremental_rehash(true);
+    intSet.clear();
+    for (int i = 0; !migrating.rehashing(); ++i) {
+        migrating.insert_unique(i);
+        intSet.insert(i);
+    }
+    std::set<int> seen(migrating.begin(), migrating.end());
+    assert(seen == intSet);
+    nano::hash_table<int> copy(migrating);
+    assert(std::distance(copy.begin(), copy.end()) == std::distance(migrating.begin(), migrating.end()));
+    migrating.clear();
+    assert(migrating.begin() == migrating.end());
+}
+
+template<typename Table>
+void flood(const std::string& name, const std::vector<int>& attackKeys,
+        const std::vector<int>& normalKeys, size_t bucketCount) {
+    Table table;
+    table.reserve(bucketCount);
+    for (size_t i = 0; i < normalKeys.size(); ++i) {
+        table.insert_unique(normalKeys[i]);
+        if (i < attackKeys.size()) {
+            table.insert_unique(attackKeys[i]);
+        }
+    }
+
+    std::vector<double> latency;
+    latency.reserve(attackKeys.size() * 16);
+    for (int r = 0; r < 16; ++r) {
+        for (int key : attackKeys) {
+            auto start = std::chrono::steady_clock::now();
+            auto iter = table.find(key);
+            auto end = std::chrono::steady_clock::now();
+            assert(iter != table.end());
+            static_cast<void>(iter);
+            latency.push_back(std::chrono::duration<double, std::nano>(end - start).count());
+        }
+    }
+    std::sort(latency.begin(), latency.end());
+    auto percentile = [&latency](double p) {
+        return latency[static_cast<size_t>(p * (latency.size() - 1))];
+    };
+    std::cout << name << ": p50 " << percentile(0.5) << "ns"
+            << " p99 " << percentile(0.99) << "ns"
+            << " p99.9 " << percentile(0.999) << "ns" << std::endl;
+}
+
+void bench_flood() {
+    constexpr static size_t bucketCount = 65536;
+    constexpr static size_t attackCount = 4096;
+    std::vector<int> attackKeys;
+    for (int key = 0; attackKeys.size() < attackCount; ++key) {
+        if ((nano::hash_value<int>()(key) & (bucketCount - 1)) == 0) {
+            attackKeys.push_back(key);
+        }
+    }
+    std::vector<int> normalKeys;
+    for (size_t i = 0; i < bucketCount / 2; ++i) {
+        normalKeys.push_back(-u(e) - 1);
+    }
+    //对照组: 没有攻击时的延迟
+    std::vector<int> randomKeys;
+    for (size_t i = 0; i < attackCount; ++i) {
+        randomKeys.push_back(u(e));
+    }
+
+    flood<nano::hash_table<int, false, unseeded_hash>>("unseeded",
+        attackKeys, normalKeys, bucketCount);
+    flood<nano::hash_table<int>>("seeded", attackKeys, normalKeys, bucketCount);
+    flood<nano::hash_table<int>>("no attack", randomKeys, normalKeys, bucketCount);
+}
+
+void grow(const std::string& name, size_t n, bool incremental) {
+    //上一个表释放的大量小块内存会在下一次申请大块内存时被malloc合并，
+    //可能要几秒钟，不能算到插入延迟里。volatile防止申请和释放被编译器优化掉
+    void* volatile warmup = ::malloc(4096);
+    ::free(warmup);
+    nano::hash_table<int> table;
+    table.incremental_rehash(incremental);
+    //按2的幂次统计延迟，第i个格子是[2^i, 2^(i+1))ns
+    std::vector<size_t> histogram(64);
+    double maxLatency = 0;
+    for (size_t i = 0; i < n; ++i) {
+        int key = static_cast<int>(i);
+        auto start = std::chrono::steady_clock::now();
+        table.insert_unique(key);
+        auto end = std::chrono::steady_clock::now();
+        double latency = std::chrono::duration<double, std::nano>(end - start).count();
+        maxLatency = std::max(maxLatency, latency);
+        ++histogram[std::bit_width(static_cast<size_t>(latency))];
+    }
+    size_t rank = n - n / 1000;
+    size_t bucket = 0;
+    for (size_t count = 0; bucket < histogram.size(); ++bucket) {
+        count += histogram[bucket];
+        if (count >= rank) {
+            break;
+        }
+    }
+    std::cout << name << ": p99.9 < " << (size_t(1) << bucket) << "ns"
+            << " max " << maxLatency / 1000000 << "ms" << std::endl;
+}
+
+void bench_grow(size_t n) {
+    grow("rehash", n, false);
+    grow("incremental", n, true);
+}
+
+void bench_batch() {
+    constexpr static size_t n = 1 << 24;
+    constexpr static size_t lookupCount = 1 << 22;
+    nano::hash_table<int> table;
+    table.reserve(n);
+    for (size_t i = 0; i < n; ++i) {
+        table.insert_unique(static_cast<int>(i));
+    }
+    std::vector<int> keys;
+    keys.reserve(lookupCount);
+    for (size_t i = 0; i < lookupCount; ++i) {
+        keys.push_back(u(e) % n);
+    }
+    std::unique_ptr<bool[]> found(new bool[lookupCount]);
+    for (size_t batch : {1, 4, 16, 64, 256}) {
+        double t = nano::run_time([&table, &keys, &found, batch]() {
+            if (batch == 1) {
+                for (size_t i = 0; i < lookupCount; ++i) {
+                    found[i] = table.find(keys[i]) != table.end();
+                }
+            } else {
+                for (size_t i = 0; i < lookupCount; i += batch) {
+                    table.contains_batch(keys.data() + i, batch, found.get() + i);
+                }
+            }
+        });
+        assert(std::all_of(found.get(), found.get() + lookupCount, [](bool b) { return b; }));
+        std::cout << "batch " << batch << ": " << lookupCount / t / 1000 << "M/s" << std::endl;
+    }
+}
+
+void bench_sparse_iteration() {
+    nano::hash_table<int> reserved;
+    reserved.reserve(1 << 24);
+    for (int i = 0; i < 1000; ++i) {
+        reserved.insert_unique(u(e));
+    }
+    nano::hash_table<int> erased;
+    for (int i = 0; i < (1 << 22); ++i) {
+        erased.insert_unique(i);
+    }
+    for (int i = 1000; i < (1 << 22); ++i) {
+        erased.erase_unique(i);
+    }
+    nano::hash_table<int> shrunk;
+    shrunk.min_load_factor(0.1f);
+    for (int i = 0; i < (1 << 22); ++i) {
+        shrunk.insert_unique(i);
+    }
+    double eraseTime = nano::run_time([&shrunk]() {
+        for (int i = 1000; i < (1 << 22); ++i) {
+            shrunk.erase_unique(i);
+        }
+    });
+    std::cout << "min_load_factor(0.1) erase " << eraseTime << "ms, " 
+        << shrunk.bucket_count() << " buckets" << std::endl;
+    for (nano::hash_table<int>* table : { &reserved, &erased, &shrunk }) {
+        size_t count = 0;
+        double begin = nano::run_time([table, &count]() {
+            count += *table->begin();
+        });
+        double all = nano::run_time([table, &count]() {
+            for (int v : *table) {
+                count += v;
+            }
+        });
+        std::cout << (table == &reserved ? "reserved" : table == &erased ? "erased" : "shrunk") << " begin() "
+            << begin * 1000 << "us, iterate " << all * 1000 << "us " << count % 2 << std::endl;
+    }
+}
+
+void test_cached_hash_compare() {
+    //少于TREEFY_THRESHOLD个，链表里hash值不同的节点不用比较
+    nano::hash_table<int, true, high_bits_hash, std::less<int>, counted_equal> table;
+    for (int i = 1; i <= 6; ++i) {
+        table.insert_unique(i);
+    }
+    equalCount = 0;
+    for (int i = 7; i < 1000; ++i) {
+        assert(table.find(i) == table.end());
+        assert(table.count_multi(i) == 0);
+    }
+    assert(0 == equalCount);
+    for (int i = 1; i <= 6; ++i) {
+        assert(*table.find(i) == i);
+        assert(table.count_unique(i) == 1);
+    }
+    //每次查找只和自己比较一次
+    assert(12 == equalCount);
+    assert(!table.insert_unique(3).second);
+    assert(13 == equalCount);
+    assert(table.erase_unique(3) == 1 && table.find(3) == table.end());
+
+    //multi: 相等的元素放在一起，hash不同的不用比较
+    table.insert_multi(2);
+    table.insert_multi(2);
+    assert(table.count_multi(2) == 3);
+
+    //cache为false时每个节点都要比较
+    nano::hash_table<int, false, high_bits_hash, std::less<int>, counted_equal> uncached;
+    for (int i = 1; i <= 6; ++i) {
+        uncached.insert_unique(i);
+    }
+    equalCount = 0;
+    assert(uncached.find(7) == uncached.end());
+    assert(6 == equalCount);
+}
+
+void bench_cached_hash_compare() {
+    constexpr static size_t M = 1 << 20;
+    std::vector<std::string> keys;
+    for (size_t i = 0; i < M * 2; ++i) {
+        std::string str(48, 'k');
+        str += std::to_string(1000000000000000ULL + i);
+        keys.push_back(std::move(str));
+    }
+    std::vector<size_t> lookups(M);
+    for (size_t& i : lookups) {
+        i = static_cast<size_t>(u(e)) % keys.size();
+    }
+    auto run = [&keys, &lookups](auto& table, const char* name) {
+        for (size_t i = 0; i < M; ++i) {
+            table.insert_unique(keys[i * 2]);
+        }
+        size_t found = 0;
+        equalCount = 0;
+        double t = nano::run_time([&table, &keys, &lookups, &found]() {
+            for (size_t i : lookups) {
+                found += table.find(keys[i]) != table.end();
+            }
+        });
+        std::cout << name << " " << static_cast<double>(equalCount) / M << " equal per lookup, "
+            << M / t / 1000 << "M/s " << found % 2 << std::endl;
+    };
+    nano::hash_table<std::string, false, nano::hash_value<std::string>, 
+        std::less<std::string>, counted_equal> uncached;
+    nano::hash_table<std::string, true, nano::hash_value<std::string>, 
+        std::less<std::string>, counted_equal> cached;
+    run(uncached, "cache = false");
+    run(cached, "cache = true");
+}
+
+template<typename Table>
+void check_inline_unique(Table& table, size_t n) {
+    std::unordered_set<int> intSet;
+    std::uniform_int_distribution<int> small(0, static_cast<int>(n));
+    for (size_t i = 0; i < n * 4; ++i) {
+        int num = small(e);
+        switch (u(e) % 5) {
+            case 0:
+            case 1:
+                assert(table.insert_unique(num).second == intSet.insert(num).second);
+                break;
+            case 2:
+                assert(table.erase_unique(num) == intSet.erase(num));
+                break;
+            case 3: {
+                //按迭代器删除，桶自带的节点空出来以后还能再用
+                auto iter = table.find(num);
+                assert((iter != table.end()) == static_cast<bool>(intSet.count(num)));
+                if (iter != table.end()) {
+                    table.erase(iter);
+                    intSet.erase(num);
+                }
+                break;
+            }
+            default:
+                assert((table.find(num) != table.end()) == static_cast<bool>(intSet.count(num)));
+        }
+    }
+    assert(table.size() == intSet.size());
+    size_t count = 0;
+    for (int v : table) {
+        assert(intSet.count(v));
+        ++count;
+    }
+    assert(count == intSet.size());
+}
+
+void test_inline_bucket() {
+    using inline_table = nano::hash_table<int, false, nano::hash_value<int>,
+        std::less<int>, std::equal_to<int>, nano::ht_inline_bucket>;
+    inline_table table;
+    check_inline_unique(table, N);
+    inline_table incremental;
+    incremental.incremental_rehash(true);
+    check_inline_unique(incremental, N);
+
+    //拷贝、移动以后元素都在
+    inline_table copy(table);
+    assert(copy.size() == table.size());
+    for (int v : table) {
+        assert(copy.find(v) != copy.end());
+    }
+    inline_table moved(std::move(copy));
+    assert(moved.size() == table.size() && copy.empty());
+    for (int v : table) {
+        assert(moved.count_unique(v) == 1);
+    }
+    moved.clear();
+    assert(moved.empty() && moved.begin() == moved.end());
+    moved.insert_unique(1);
+    assert(*moved.begin() == 1);
+
+    //桶自带的节点也会和链表一起树化、退化
+    nano::hash_table<int, true, collide_hash, std::less<int>, std::equal_to<int>,
+        nano::ht_inline_bucket> tree;
+    std::multiset<int> intSet;
+    std::uniform_int_distribution<int> small(0, 50);
+    for (size_t i = 0; i < N / 10; ++i) {
+        int num = small(e);
+        if (u(e) % 3) {
+            tree.insert_multi(num);
+            intSet.insert(num);
+        } else {
+            assert(tree.erase_multi(num) == intSet.erase(num));
+        }
+        assert(tree.count_multi(num) == intSet.count(num));
+    }
+    assert(tree.size() == intSet.size());
+    assert(std::multiset<int>(tree.begin(), tree.end()) == intSet);
+
+    //换种子要把桶自带的节点搬到新的桶数组
+    nano::hash_table<int, true, leaked_seed_hash, std::less<int>, std::equal_to<int>,
+        nano::ht_inline_bucket> reseeded;
+    attackedSeed = reseeded.hash_seed();
+    for (int i = 0; i < 10000; ++i) {
+        reseeded.insert_unique(i);
+    }
+    assert(reseeded.hash_seed() != attackedSeed);
+    for (int i = 0; i < 10000; ++i) {
+        assert(*reseeded.find(i) == i);
+    }
+}
+
+template<typename Table>
+void run_inline_bucket(const char* name, const std::vector<int>& keys, const std::vector<int>& misses) {
+    Table table;
+    for (int key : keys) {
+        table.insert_unique(key);
+    }
+    std::vector<int> lookups(1 << 22);
+    for (int& key : lookups) {
+        key = keys[u(e) % keys.size()];
+    }
+    size_t found = 0;
+    double hit = nano::run_time([&table, &lookups, &found]() {
+        for (int key : lookups) {
+            found += table.find(key) != table.end();
+        }
+    });
+    double miss = nano::run_time([&table, &misses, &found]() {
+        for (int key : misses) {
+            found += table.find(key) != table.end();
+        }
+    });
+    //下一个key取决于上一次查找的结果，查找之间不能重叠，测的是单次查找的延迟
+    double chained = nano::run_time([&table, &lookups, &found]() {
+        size_t index = 0;
+        for (size_t i = 0; i < lookups.size(); ++i) {
+            index = (index + *table.find(lookups[index])) & (lookups.size() - 1);
+        }
+        found += index;
+    });
+    std::cout << name << " hit " << lookups.size() / hit / 1000 << "M/s, miss "
+        << misses.size() / miss / 1000 << "M/s, chained " 
+        << chained * 1000000 / lookups.size() << "ns " << found % 2 << std::endl;
+}
+
+void bench_inline_bucket() {
+    //偶数在表里，奇数不在
+    std::vector<int> keys(1 << 24);
+    std::vector<int> misses(1 << 22);
+    for (int& key : keys) {
+        key = (u(e) & ~1);
+    }
+    for (int& key : misses) {
+        key = (u(e) | 1);
+    }
+    run_inline_bucket<nano::hash_table<int>>("ht_node_bucket", keys, misses);
+    run_inline_bucket<nano::hash_table<int, false, nano::hash_value<int>, std::less<int>,
+        std::equal_to<int>, nano::ht_inline_bucket>>("ht_inline_bucket", keys, misses);
+}
+
+void test_parallel_build() {
+    constexpr size_t threads = 4;
+    //有重复的key，insert_unique只留一个
+    std::vector<int> keys(N);
+    for (int& key : keys) {
+        key = u(e) % (N / 2);
+    }
+    nano::hash_table<int> table;
+    table.insert_unique(keys.begin(), keys.end(), threads);
+    std::set<int> intSet(keys.begin(), keys.end());
+    assert(table.size() == intSet.size());
+    assert(std::set<int>(table.begin(), table.end()) == intSet);
+    for (int num : intSet) {
+        assert(*table.find(num) == num);
+    }
+    //表里已经有的元素不会重复插入
+    keys.push_back(-1);
+    table.insert_unique(keys.begin(), keys.end(), threads);
+    assert(table.size() == intSet.size() + 1);
+
+    nano::hash_table<int, true> multiTable;
+    multiTable.insert_multi(keys.begin(), keys.end(), threads);
+    std::multiset<int> intMultiset(keys.begin(), keys.end());
+    assert(multiTable.size() == keys.size());
+    for (size_t i = 0; i < 1000; ++i) {
+        int num = keys[u(e) % keys.size()];
+        assert(multiTable.count_multi(num) == intMultiset.count(num));
+    }
+
+    //相等的元素里留下第一个
+    std::vector<keyed> keyeds(N);
+    for (size_t i = 0; i < N; ++i) {
+        keyeds[i] = keyed{ static_cast<int>(i % 1000), static_cast<int>(i) };
+    }
+    nano::hash_table<keyed, false, keyed_hash, keyed_less, keyed_equal> keyedTable;
+    keyedTable.insert_unique(keyeds.begin(), keyeds.end(), threads);
+    assert(keyedTable.size() == 1000);
+    for (const keyed& k : keyedTable) {
+        assert(k.key == k.index);
+    }
+
+    //每个线程树化自己那一段里的桶，已经是树的桶再往树里插
+    std::vector<int> grouped(N);
+    for (size_t i = 0; i < N; ++i) {
+        grouped[i] = static_cast<int>(i);
+    }
+    nano::hash_table<int, true, group_hash> treeTable;
+    treeTable.insert_multi(grouped.begin(), grouped.end(), threads);
+    treeTable.insert_multi(grouped.begin(), grouped.end(), threads);
+    treeTable.insert_unique(grouped.begin(), grouped.end(), threads);
+    assert(treeTable.size() == 2 * N);
+    for (size_t i = 0; i < N; i += 7) {
+        assert(treeTable.count_multi(static_cast<int>(i)) == 2);
+    }
+
+    //构造元素时抛出异常，表不变
+    std::vector<bomb> bombs;
+    for (size_t i = 0; i < N; ++i) {
+        bombs.emplace_back(static_cast<int>(i));
+    }
+    nano::hash_table<bomb, false, bomb_hash> bombTable;
+    bombTable.insert_unique(bomb(-1));
+    copyCount = 0;
+    throwAt = N / 2;
+    bool thrown = false;
+    try {
+        bombTable.insert_unique(bombs.begin(), bombs.end(), threads);
+    } catch (const std::runtime_error&) {
+        thrown = true;
+    }
+    throwAt = 0;
+    assert(thrown && bombTable.size() == 1);
+    assert(bombTable.find(bomb(-1)) != bombTable.end());
+    static_cast<void>(thrown);
+    bombTable.insert_unique(bombs.begin(), bombs.end(), threads);
+    assert(bombTable.size() == N + 1);
+}
+
+void test_parallel_rehash() {
+    constexpr size_t threads = 4;
+    nano::hash_table<int, true> table;
+    std::multiset<int> intSet;
+    for (size_t i = 0; i < N; ++i) {
+        int num = u(e) % N;
+        table.insert_multi(num);
+        intSet.insert(num);
+    }
+    table.rehash(table.bucket_count() * 8, threads);
+    assert(table.size() == intSet.size());
+    assert(std::multiset<int>(table.begin(), table.end()) == intSet);
+    for (size_t i = 0; i < 1000; ++i) {
+        int num = u(e) % N;
+        assert(table.count_multi(num) == intSet.count(num));
+    }
+
+    //树桶的节点换成链表节点，在新桶里再树化
+    nano::hash_table<int, false, group_hash> treeTable;
+    for (size_t i = 0; i < N; ++i) {
+        treeTable.insert_unique(static_cast<int>(i));
+    }
+    treeTable.rehash(treeTable.bucket_count() * 4, threads);
+    assert(treeTable.size() == N);
+    for (size_t i = 0; i < N; ++i) {
+        assert(*treeTable.find(static_cast<int>(i)) == static_cast<int>(i));
+    }
+
+    //渐进式rehash搬到一半时，先搬完再并行rehash
+    nano::hash_table<int> incremental;
+    incremental.incremental_rehash(true);
+    std::set<int> incrementalSet;
+    while (!incremental.rehashing() || incrementalSet.size() < 2 * (size_t(1) << 15)) {
+        int num = u(e);
+        incremental.insert_unique(num);
+        incrementalSet.insert(num);
+    }
+    incremental.rehash(incremental.bucket_count() * 2, threads);
+    assert(!incremental.rehashing());
+    assert(std::set<int>(incremental.begin(), incremental.end()) == incrementalSet);
+
+    //不传线程数时插入扩容、reserve、区间插入都只在当前线程里调用Hash
+    nano::hash_table<int, false, thread_check_hash> implicitTable;
+    std::vector<int> nums(N);
+    for (size_t i = 0; i < N; ++i) {
+        nums[i] = static_cast<int>(i);
+        implicitTable.insert_unique(static_cast<int>(i));
+    }
+    implicitTable.reserve(implicitTable.bucket_count() * 4);
+    implicitTable.rehash(implicitTable.bucket_count() * 2);
+    implicitTable.insert_multi(nums.begin(), nums.end());
+    implicitTable.hash_seed(implicitTable.hash_seed() + 1);
+    assert(implicitTable.size() == 2 * N && !hashedOffThread);
+    //删除后自动缩容、shrink_to_fit也不开线程
+    implicitTable.min_load_factor(0.25f);
+    for (size_t i = 0; i < N; ++i) {
+        implicitTable.erase_unique(static_cast<int>(i));
+    }
+    implicitTable.shrink_to_fit();
+    assert(implicitTable.size() == N && !hashedOffThread);
+
+    //Hash在并行rehash中途抛出异常，表不变，元素一个不少
+    {
+        nano::hash_table<tracked, false, tracked_hash> throwTable;
+        for (size_t i = 0; i < N; ++i) {
+            throwTable.insert_unique(tracked(static_cast<int>(i)));
+        }
+        size_t bucketCount = throwTable.bucket_count();
+        trackedHashCount = 0;
+        hashThrowAt = N / 2;
+        bool thrown = false;
+        try {
+            throwTable.rehash(bucketCount * 4, threads);
+        } catch (const std::runtime_error&) {
+            thrown = true;
+        }
+        hashThrowAt = 0;
+        assert(thrown && throwTable.size() == N && throwTable.bucket_count() == bucketCount);
+        assert(liveCount == static_cast<long>(N));
+        for (size_t i = 0; i < N; ++i) {
+            assert(throwTable.find(tracked(static_cast<int>(i))) != throwTable.end());
+        }
+        assert(static_cast<size_t>(std::distance(throwTable.begin(), throwTable.end())) == N);
+        static_cast<void>(thrown);
+        throwTable.rehash(bucketCount * 4, threads);
+        assert(throwTable.size() == N && throwTable.bucket_count() == bucketCount * 4);
+    }
+    assert(liveCount == 0);
+
+    //rehash中途申请slab失败，元素一个不少。先失败的是第一步，表不变；
+    //之后是挂新桶时申请树节点，桶留成链表或者退化成链表，rehash照样完成
+    for (size_t failAt = 1, completed = 0; completed < 8; ++failAt) {
+        //每个桶10到11个节点，slab的边界有时落在树化的时候，有时落在往树里插的时候
+        nano::hash_table<tracked, false, tracked_hash> allocTable;
+        for (size_t i = 0; i < N; ++i) {
+            if (i % 3) {
+                allocTable.insert_unique(tracked(static_cast<int>(i)));
+            }
+        }
+        size_t size = allocTable.size();
+        size_t bucketCount = allocTable.bucket_count();
+        slabAllocCount = 0;
+        slabFailAt = failAt;
+        bool thrown = false;
+        try {
+            allocTable.rehash(bucketCount * 2, threads);
+        } catch (const std::bad_alloc&) {
+            thrown = true;
+        }
+        slabFailAt = 0;
+        assert(allocTable.size() == size && liveCount == static_cast<long>(size));
+        assert(allocTable.bucket_count() == (thrown ? bucketCount : bucketCount * 2));
+        assert(static_cast<size_t>(std::distance(allocTable.begin(), allocTable.end())) == size);
+        for (size_t i = 0; i < N; ++i) {
+            assert((allocTable.find(tracked(static_cast<int>(i))) != allocTable.end()) == (i % 3 != 0));
+        }
+        if (!thrown) {
+            ++completed;
+        }
+    }
+    assert(liveCount == 0);
+}
+
+void bench_parallel_build() {
+    std::vector<int> keys(1 << 22);
+    for (int& key : keys) {
+        key = u(e);
+    }
+    for (size_t threads : { 1, 2, 4 }) {
+        nano::hash_table<int> table;
+        double buildTime = nano::run_time([&table, &keys, threads]() {
+            table.insert_unique(keys.begin(), keys.end(), threads);
+        });
+        double rehashTime = nano::run_time([&table, threads]() {
+            table.rehash(table.bucket_count() * 4, threads);
+        });
+        std::cout << threads << " threads: build " << buildTime << "ms, rehash " 
+                  << rehashTime << "ms " << table.size() % 2 << std::endl;
+    }
+}
+
+void test_node_handle() {
+    using table_type = nano::hash_table<int, true, counted_hash>;
+    table_type source;
+    for (int i = 0; i < 1000; ++i) {
+        source.insert_unique(i);
+    }
+    table_type target;
+    table_type::node_type node = source.extract(5);
+    assert(node && node.value() == 5);
+    assert(source.size() == 999 && source.find(5) == source.end());
+    assert(source.extract(5).empty());
+    //空表换成source的种子，插入时不计算hash
+    const int* addr = &node.value();
+    hashCount = 0;
+    table_type::insert_return_type result = target.insert_unique(std::move(node));
+    assert(0 == hashCount);
+    assert(result.inserted && !result.node && *result.position == 5);
+    assert(&*target.find(5) == addr);
+    assert(target.hash_seed() == source.hash_seed());
+
+    //有相等的元素时节点原样还回来
+    target.insert_unique(6);
+    result = target.insert_unique(source.extract(source.find(6)));
+    assert(!result.inserted && result.node && result.node.value() == 6 && *result.position == 6);
+    assert(target.size() == 2);
+    target.insert_multi(std::move(result.node));
+    assert(target.count_multi(6) == 2 && target.size() == 3);
+
+    //种子不同时重新计算hash
+    table_type other;
+    other.insert_unique(-1);
+    hashCount = 0;
+    assert(other.insert_unique(source.extract(7)).inserted);
+    assert(hashCount > 0 && other.find(7) != other.end());
+
+    //树化的桶里取出、插入
+    nano::hash_table<int, false, collide_hash> treeSource;
+    nano::hash_table<int, false, collide_hash> treeTarget;
+    for (int i = 0; i < 20; ++i) {
+        treeSource.insert_unique(i);
+        treeTarget.insert_unique(i + 100);
+    }
+    for (int i = 0; i < 20; i += 2) {
+        auto treeNode = treeSource.extract(i);
+        assert(treeNode.value() == i);
+        assert(treeTarget.insert_unique(std::move(treeNode)).inserted);
+    }
+    for (int i = 0; i < 20; ++i) {
+        assert((treeSource.find(i) != treeSource.end()) == (i % 2 == 1));
+        assert((treeTarget.find(i) != treeTarget.end()) == (i % 2 == 0));
+    }
+    assert(treeSource.size() == 10 && treeTarget.size() == 30);
+
+    //桶自带的节点取出来以后换成池里的节点
+    using inline_table = nano::hash_table<int, false, nano::hash_value<int>,
+        std::less<int>, std::equal_to<int>, nano::ht_inline_bucket>;
+    inline_table inlineSource;
+    inline_table inlineTarget;
+    for (int i = 0; i < 1000; ++i) {
+        inlineSource.insert_unique(i);
+    }
+    for (int i = 0; i < 1000; i += 3) {
+        inlineTarget.insert_unique(inlineSource.extract(i));
+    }
+    for (int i = 0; i < 1000; ++i) {
+        assert((inlineSource.find(i) != inlineSource.end()) == (i % 3 != 0));
+        assert((inlineTarget.find(i) != inlineTarget.end()) == (i % 3 == 0));
+    }
+
+    //取出的节点比原来的表活得久
+    nano::hash_table<std::string>::node_type strNode;
+    nano::hash_table<std::string> strTarget;
+    {
+        nano::hash_table<std::string> strSource;
+        for (int i = 0; i < 100; ++i) {
+            strSource.insert_unique(std::string(32, 'a') + std::to_string(i));
+        }
+        strNode = strSource.extract(strSource.begin());
+        strTarget.insert_unique(strSource.extract(strSource.begin()));
+    }
+    assert(strNode.value().size() > 32);
+    assert(strTarget.size() == 1 && strTarget.begin()->size() > 32);
+    strTarget.clear();
+    strTarget.insert_unique(std::string("b"));
+
+    //热表每一代重新插入，挑一部分挪到冷表，冷表只留最近一代。
+    //clear、删除的节点留在组里复用，组的内存不随代数增长
+    nano::hash_table<int> hot;
+    nano::hash_table<int> cold;
+    long baseSlabs = liveSlabCount;
+    long warmSlabs = 0;
+    for (int gen = 0; gen < 50; ++gen) {
+        for (int i = 0; i < 1000; ++i) {
+            hot.insert_unique(gen * 1000 + i);
+        }
+        for (int i = 0; i < 1000; i += 10) {
+            cold.insert_unique(hot.extract(gen * 1000 + i));
+            cold.erase_unique((gen - 1) * 1000 + i);
+        }
+        hot.clear();
+        assert(cold.size() == 100);
+        if (2 == gen) {
+            warmSlabs = liveSlabCount - baseSlabs;
+        }
+    }
+    assert(hot.stats().node_bytes == cold.stats().node_bytes);
+    //随机种子下偶尔有桶树化，多出几个树节点的slab
+    assert(liveSlabCount - baseSlabs <= warmSlabs * 2);
+}
+
+void test_merge() {
+    using table_type = nano::hash_table<int, true, counted_hash>;
+    table_type source;
+    table_type target;
+    std::set<int> sourceSet;
+    std::set<int> targetSet;
+    for (size_t i = 0; i < N; ++i) {
+        int num = u(e) % static_cast<int>(N * 4);
+        if (source.insert_unique(num).second) {
+            sourceSet.insert(num);
+        }
+        num = u(e) % static_cast<int>(N * 4);
+        if (target.insert_unique(num).second) {
+            targetSet.insert(num);
+        }
+    }
+    std::vector<const int*> addrs;
+    for (const int& v : source) {
+        if (!targetSet.count(v)) {
+            addrs.push_back(&v);
+        }
+    }
+    //种子相同时整个merge不计算hash，节点原样挂过去
+    target.hash_seed(source.hash_seed());
+    hashCount = 0;
+    target.merge_unique(source);
+    assert(0 == hashCount);
+    std::set<int> dups;
+    std::set_intersection(sourceSet.begin(), sourceSet.end(), targetSet.begin(), targetSet.end(),
+        std::inserter(dups, dups.begin()));
+    assert(std::set<int>(source.begin(), source.end()) == dups);
+    targetSet.insert(sourceSet.begin(), sourceSet.end());
+    assert(std::set<int>(target.begin(), target.end()) == targetSet);
+    //只有挂上去以后树化了的桶里的节点会换成树节点
+    size_t moved = 0;
+    for (const int* addr : addrs) {
+        moved += &*target.find(*addr) != addr;
+    }
+    assert(moved * 100 < addrs.size());
+
+    //multi: 相等的也搬过去，source最后是空的
+    size_t total = target.size() + source.size();
+    target.merge_multi(source);
+    assert(source.empty() && target.size() == total);
+    for (int v : dups) {
+        assert(target.count_multi(v) == 2);
+    }
+
+    //source析构以后节点还在target里
+    {
+        table_type temp;
+        for (int i = 0; i < 1000; ++i) {
+            temp.insert_multi(-i - 1);
+        }
+        target.merge_multi(std::move(temp));
+    }
+    assert(target.size() == total + 1000);
+    for (int i = 0; i < 1000; ++i) {
+        assert(target.count_multi(-i - 1) == 1);
+    }
+    //删掉的节点从池里再分出去
+    for (int i = 0; i < 1000; ++i) {
+        assert(target.erase_multi(-i - 1) == 1);
+        target.insert_multi(-i - 1);
+    }
+    target.clear();
+    assert(target.empty());
+
+    //渐进式rehash中间merge，树化的桶
+    nano::hash_table<int, false, group_hash> groupSource;
+    nano::hash_table<int, false, group_hash> groupTarget;
+    groupTarget.incremental_rehash(true);
+    for (int i = 0; i < static_cast<int>(N); ++i) {
+        (i % 2 ? groupSource : groupTarget).insert_unique(i);
+    }
+    groupTarget.merge_unique(groupSource);
+    assert(groupSource.empty() && groupTarget.size() == N);
+    for (int i = 0; i < static_cast<int>(N); ++i) {
+        assert(groupTarget.find(i) != groupTarget.end());
+    }
+}
+
+void bench_merge() {
+    constexpr static size_t M = 1 << 20;
+    auto run = [](auto& cold, const char* name) {
+        using table_type = std::remove_reference_t<decltype(cold)>;
+        table_type hot;
+        double copyTime = nano::run_time([&cold, &hot]() {
+            hot.insert_multi(cold.begin(), cold.end(), 1);
+            cold.clear();
+        });
+        cold.swap(hot);
+        table_type target;
+        double mergeTime = nano::run_time([&cold, &target]() {
+            target.merge_multi(cold);
+        });
+        std::cout << name << ": insert + clear " << copyTime << "ms, merge " 
+                  << mergeTime << "ms " << target.size() % 2 << std::endl;
+    };
+    nano::hash_table<int, true> ints;
+    nano::hash_table<std::string, true> strs;
+    for (size_t i = 0; i < M; ++i) {
+        int num = u(e);
+        ints.insert_multi(num);
+        strs.insert_multi(std::string(22, 's') + std::to_string(num));
+    }
+    run(ints, "int");
+    run(strs, "std::string");
+}
+
+void test_shrink() {
+    //默认不缩容，shrink_to_fit缩到刚好放得下
+    nano::hash_table<int> table;
+    std::set<int> intSet;
+    for (size_t i = 0; i < N; ++i) {
+        int num = u(e);
+        table.insert_unique(num);
+        intSet.insert(num);
+    }
+    size_t bucketCount = table.bucket_count();
+    while (intSet.size() > N / 20) {
+        assert(table.erase_unique(*intSet.begin()) == 1);
+        intSet.erase(intSet.begin());
+    }
+    assert(table.bucket_count() == bucketCount);
+    table.shrink_to_fit();
+    assert(table.bucket_count() == std::bit_ceil(intSet.size() + 1));
+    assert(std::set<int>(table.begin(), table.end()) == intSet);
+    table.shrink_to_fit();
+    assert(table.bucket_count() == std::bit_ceil(intSet.size() + 1));
+
+    //按key删除时自动缩容，插入、删除来回交替时不会反复扩容、缩容
+    for (bool incremental : { false, true }) {
+        nano::hash_table<int> shrinking;
+        shrinking.incremental_rehash(incremental);
+        shrinking.min_load_factor(0.1f);
+        for (int i = 0; i < static_cast<int>(N); ++i) {
+            shrinking.insert_unique(i);
+        }
+        size_t resizeCount = 0;
+        for (int i = 0; i < static_cast<int>(N); ++i) {
+            size_t before = shrinking.bucket_count();
+            assert(shrinking.erase_unique(i) == 1);
+            resizeCount += shrinking.bucket_count() != before;
+            assert(shrinking.bucket_count() == 16 ||
+                shrinking.load_factor() >= 0.1f || shrinking.rehashing());
+            if (i == static_cast<int>(N / 2)) {
+                before = shrinking.bucket_count();
+                for (int j = 0; j < 1000; ++j) {
+                    shrinking.insert_unique(-1);
+                    shrinking.erase_unique(-1);
+                }
+                assert(shrinking.bucket_count() == before);
+            }
+        }
+        assert(shrinking.empty() && shrinking.bucket_count() == 16);
+        assert(resizeCount < 16);
+        for (int i = 0; i < 1000; ++i) {
+            shrinking.insert_unique(i);
+        }
+        for (int i = 0; i < 1000; ++i) {
+            assert(shrinking.find(i) != shrinking.end());
+        }
+        shrinking.clear();
+        assert(shrinking.bucket_count() == 16);
+    }
+
+    //树桶删到UNTREEFY_THRESHOLD个以下退化回链表，链表查找要比较
+    nano::hash_table<int, false, collide_hash, std::less<int>, counted_equal> treeTable;
+    for (int i = 0; i < 20; ++i) {
+        treeTable.insert_unique(i);
+    }
+    for (int i = 0; i < 14; ++i) {
+        treeTable.erase_unique(i);
+    }
+    equalCount = 0;
+    assert(treeTable.find(19) != treeTable.end());
+    assert(0 == equalCount);
+    treeTable.erase_unique(14);
+    assert(treeTable.find(19) != treeTable.end());
+    assert(equalCount > 0);
+    for (int i = 15; i < 20; ++i) {
+        assert(treeTable.count_unique(i) == 1);
+    }
+
+    //multi: 退化以后相等的元素还挨在一起
+    nano::hash_table<int, true, collide_hash> multiTable;
+    for (int i = 0; i < 30; ++i) {
+        multiTable.insert_multi(i % 6);
+    }
+    for (int i = 0; i < 6; ++i) {
+        auto range = multiTable.equal_range_multi(i);
+        assert(std::distance(range.first, range.second) == 5);
+    }
+    for (int i = 0; i < 4; ++i) {
+        assert(multiTable.erase_multi(i) == 5);
+    }
+    assert(multiTable.size() == 10);
+    for (int i = 4; i < 6; ++i) {
+        auto range = multiTable.equal_range_multi(i);
+        assert(std::distance(range.first, range.second) == 5);
+        assert(multiTable.count_multi(i) == 5);
+    }
+}
+
+void test_stats() {
+    using inline_table = nano::hash_table<int, false, nano::hash_value<int>,
+        std::less<int>, std::equal_to<int>, nano::ht_inline_bucket>;
+    nano::hash_table<int> table;
+    inline_table inlineTable;
+    for (size_t i = 0; i < N; ++i) {
+        int num = u(e);
+        table.insert_unique(num);
+        inlineTable.insert_unique(num);
+        table.find(num);
+    }
+    //没有定义HASH_TABLE_STATS，计数器都是0，桶的分布照样有
+    static_assert(!nano::ht_stats_enabled);
+    nano::ht_stats stats = table.stats();
+    assert(!stats.counters_enabled && 0 == stats.hit_count && 0 == stats.rehash_count);
+    assert(stats.size == table.size() && stats.bucket_count == table.bucket_count());
+    assert(stats.max_chain > 0 && stats.live_node_bytes > 0);
+    size_t buckets = 0;
+    for (size_t count : stats.chain_histogram) {
+        buckets += count;
+    }
+    assert(buckets == stats.bucket_count);
+
+    //内联桶的第一个元素不在节点池里
+    nano::ht_stats inlineStats = inlineTable.stats();
+    assert(inlineStats.size == stats.size);
+    assert(inlineStats.live_node_bytes < stats.live_node_bytes);
+    assert(inlineStats.bucket_bytes > stats.bucket_bytes);
+}
+
+void test_sorted_bucket() {
+    using sorted_multi = nano::hash_table<int, true, collide_hash, std::less<int>,
+        std::equal_to<int>, nano::ht_sorted_bucket>;
+    sorted_multi table;
+    std::multiset<int> intSet;
+    std::uniform_int_distribution<int> small(0, 200);
+    for (size_t i = 0; i < N / 10; ++i) {
+        int num = small(e);
+        switch (u(e) % 3) {
+            case 0:
+                assert(table.erase_multi(num) == intSet.erase(num));
+                break;
+            case 1: {
+                //按迭代器删除，数组跟着删
+                auto iter = table.find(num);
+                assert((iter != table.end()) == static_cast<bool>(intSet.count(num)));
+                if (iter != table.end()) {
+                    table.erase(iter);
+                    intSet.erase(intSet.find(num));
+                }
+                break;
+            }
+            default:
+                assert(*table.insert_multi(num) == num);
+                intSet.insert(num);
+        }
+        assert(table.count_multi(num) == intSet.count(num));
+        auto range = table.equal_range_multi(num);
+        assert(static_cast<size_t>(std::distance(range.first, range.second)) == intSet.count(num));
+        for (; range.first != range.second; ++range.first) {
+            assert(*range.first == num);
+        }
+    }
+    //只有一个桶，遍历就是按顺序的
+    assert(std::vector<int>(table.begin(), table.end()) == std::vector<int>(intSet.begin(), intSet.end()));
+    sorted_multi copy(table);
+    assert(std::vector<int>(copy.begin(), copy.end()) == std::vector<int>(intSet.begin(), intSet.end()));
+    for (int num = 0; num <= 200; ++num) {
+        assert(table.erase_multi(num) == intSet.erase(num));
+    }
+    assert(table.empty() && table.begin() == table.end());
+
+    //建数组时节点不换，之前的迭代器和指针还能用
+    nano::hash_table<int, false, collide_hash, std::less<int>, std::equal_to<int>,
+        nano::ht_sorted_bucket> uniqueTable;
+    std::vector<const int*> addresses;
+    for (int num = 0; num < 40; ++num) {
+        auto result = uniqueTable.insert_unique(39 - num);
+        assert(result.second && *result.first == 39 - num);
+        assert(!uniqueTable.insert_unique(39 - num).second);
+        addresses.push_back(&*result.first);
+    }
+    for (int num = 0; num < 40; ++num) {
+        assert(&*uniqueTable.find(39 - num) == addresses[num]);
+    }
+    nano::ht_stats stats = uniqueTable.stats();
+    assert(1 == stats.tree_buckets && 40 == stats.max_chain);
+    for (int num = 0; num < 36; ++num) {
+        assert(uniqueTable.erase_unique(num) == 1);
+    }
+    assert(0 == uniqueTable.stats().tree_buckets && uniqueTable.size() == 4);
+    assert(uniqueTable.count_unique(36) == 1 && uniqueTable.count_unique(0) == 0);
+
+    //很多桶都建了数组，扩容、渐进式rehash、拷贝、并行建表都要带上
+    using sorted_table = nano::hash_table<int, false, group_hash, std::less<int>,
+        std::equal_to<int>, nano::ht_sorted_bucket>;
+    sorted_table grouped;
+    check_inline_unique(grouped, N);
+    sorted_table incremental;
+    incremental.incremental_rehash(true);
+    check_inline_unique(incremental, N);
+    sorted_table groupCopy;
+    groupCopy = grouped;
+    assert(groupCopy.size() == grouped.size() && groupCopy.stats().tree_buckets > 0);
+    for (int v : grouped) {
+        assert(groupCopy.count_unique(v) == 1);
+    }
+    std::vector<int> nums;
+    for (int i = 0; i < static_cast<int>(N); ++i) {
+        nums.push_back(i);
+        nums.push_back(i);
+    }
+    sorted_table parallel;
+    parallel.insert_unique(nums.begin(), nums.end(), 4);
+    assert(parallel.size() == N && parallel.stats().tree_buckets > 0);
+    parallel.rehash(parallel.bucket_count() * 4, 4);
+    for (int i = 0; i < static_cast<int>(N); ++i) {
+        assert(*parallel.find(i) == i);
+    }
+
+    //节点搬到别的表
+    sorted_table source;
+    for (int i = 0; i < 1000; ++i) {
+        source.insert_unique(i);
+    }
+    sorted_table target;
+    auto node = source.extract(500);
+    assert(node && node.value() == 500 && source.count_unique(500) == 0);
+    assert(target.insert_unique(std::move(node)).inserted);
+    target.merge_unique(source);
+    assert(target.size() == 1000 && source.empty());
+    for (int i = 0; i < 1000; ++i) {
+        assert(target.count_unique(i) == 1);
+    }
+
+    //元素不能放在数组里，比较时要跳到节点上
+    nano::hash_table<std::string, false, collide_hash, std::less<std::string>,
+        std::equal_to<std::string>, nano::ht_sorted_bucket> strings;
+    for (int i = 0; i < 100; ++i) {
+        strings.insert_unique(std::to_string(i));
+    }
+    for (int i = 0; i < 100; i += 2) {
+        assert(strings.erase_unique(std::to_string(i)) == 1);
+    }
+    for (int i = 0; i < 100; ++i) {
+        assert(strings.count_unique(std::to_string(i)) == static_cast<size_t>(i & 1));
+    }
+}
+
+static size_t groupSize = 1;
+/**
+ * @brief 每groupSize个连续的int hash值相同
+ */
+struct grouped_hash {
+    size_t operator()(int v) const noexcept {
+        return nano::hash_value<int>()(v / static_cast<int>(groupSize));
+    }
+};
+
+template<typename Table>
+void run_sorted_bucket(const char* name, const std::vector<int>& keys) {
+    Table table;
+    double buildTime = nano::run_time([&table, &keys]() {
+        for (int key : keys) {
+            table.insert_unique(key);
+        }
+    });
+    size_t found = 0;
+    double findTime = nano::run_time([&table, &keys, &found]() {
+        for (int key : keys) {
+            found += table.find(key) != table.end();
+        }
+    });
+    long long sum = 0;
+    double iterateTime = nano::run_time([&table, &sum]() {
+        for (int v : table) {
+            sum += v;
+        }
+    });
+    nano::ht_stats stats = table.stats();
+    std::cout << "k = " << groupSize << " " << name << " build " << buildTime << "ms, find "
+              << findTime << "ms, iterate " << iterateTime << "ms, "
+              << (stats.bucket_bytes + stats.node_bytes) / (1 << 20) << "MB "
+              << found + sum % 2 << std::endl;
+}
+
+void bench_sorted_bucket() {
+    std::vector<int> keys(1 << 20);
+    for (size_t i = 0; i < keys.size(); ++i) {
+        keys[i] = static_cast<int>(i);
+    }
+    std::shuffle(keys.begin(), keys.end(), e);
+    for (size_t k : { 16, 64 }) {
+        groupSize = k;
+        run_sorted_bucket<nano::hash_table<int, false, grouped_hash>>("rb tree", keys);
+        run_sorted_bucket<nano::hash_table<int, false, grouped_hash, std::less<int>,
+            std::equal_to<int>, nano::ht_sorted_bucket>>("sorted array", keys);
+    }
+    std::vector<int> collided(keys.begin(), keys.begin() + (1 << 15));
+    groupSize = 1 << 30;
+    run_sorted_bucket<nano::hash_table<int, false, grouped_hash>>("rb tree", collided);
+    run_sorted_bucket<nano::hash_table<int, false, grouped_hash, std::less<int>,
+        std::equal_to<int>, nano::ht_sorted_bucket>>("sorted array", collided);
+}
@@ -0,0 +1,264 @@
+#include "lockfree_hash_table.h"
+#include "concurrent_hash_table.h"
+#include "utility.h"
+#include <iostream>
+#include <random>
+#include <vector>
+#include <thread>
+#include <mutex>
+#include <atomic>
+#include <string>
+#include <unordered_set>
+#include <assert.h>
+#include <stdlib.h>
+#include <time.h>
+
+static std::default_random_engine e;
+static std::uniform_int_distribution<int> u;
+constexpr static size_t N = 100000;
+
+/**
+ * @brief 只有4个不同的hash值，所有桶都会树化
+ */
+struct collide_hash {
+    size_t operator()(int v) const noexcept {
+        return static_cast<size_t>(v & 3);
+    }
+};
+
+void test_single_thread();
+void test_tree_bucket();
+template<typename Hash>
+void test_concurrent_readers(int stable, size_t writes);
+void test_reclaim();
+/**
+ * @brief 1~64个线程，每个线程N次操作，其中千分之一是插入删除，其余都是查找
+ * 		  对比一把全局锁的hash_table、64个分片的concurrent_hash_table和
+ * 		  lockfree_hash_table，输出的是读的总吞吐(万次查找/秒)
+ */
+void bench_readers();
+
+int main(int argc, char** argv) {
+    e.seed(time(nullptr));
+    test_single_thread();
+    test_tree_bucket();
+    test_concurrent_readers<nano::hash_value<int>>(N / 10, N / 2);
+    //树桶每次改动都要整棵复制，少一点
+    test_concurrent_readers<collide_hash>(200, N / 20);
+    test_reclaim();
+    bench_readers();
+
+    return 0;
+}
+
+void test_single_thread() {
+    nano::lockfree_hash_table<int> table;
+    std::unordered_set<int> stdSet;
+    std::uniform_int_distribution<int> small(0, 20000);
+    for (size_t i = 0; i < N; ++i) {
+        int value = small(e);
+        switch (u(e) % 3) {
+            case 0:
+                assert(table.insert_unique(value) == stdSet.insert(value).second);
+                break;
+            case 1:
+                assert(table.erase_unique(value) == stdSet.erase(value));
+                break;
+            default:
+                assert(table.count_unique(value) == stdSet.count(value));
+                assert(table.find(value).has_value() == (stdSet.count(value) == 1));
+                break;
+        }
+        assert(table.size() == stdSet.size());
+    }
+    size_t count = 0;
+    table.for_each([&count, &stdSet](int v) {
+        assert(stdSet.count(v) == 1);
+        ++count;
+    });
+    assert(count == stdSet.size());
+    table.rehash(table.bucket_count() * 4);
+    for (int v : stdSet) {
+        assert(table.contains(v));
+    }
+    table.clear();
+    assert(table.empty());
+    for (int v : stdSet) {
+        assert(!table.contains(v));
+    }
+}
+
+void test_tree_bucket() {
+    nano::lockfree_hash_table<std::string, std::hash<std::string>> strTable;
+    nano::lockfree_hash_table<int, collide_hash> table;
+    std::unordered_set<int> stdSet;
+    std::uniform_int_distribution<int> small(0, 500);
+    for (size_t i = 0; i < N / 10; ++i) {
+        int value = small(e);
+        if (u(e) % 3) {
+            assert(table.insert_unique(value) == stdSet.insert(value).second);
+            strTable.emplace_unique(std::to_string(value));
+        } else {
+            assert(table.erase_unique(value) == stdSet.erase(value));
+        }
+        assert(table.size() == stdSet.size());
+    }
+    for (int v = 0; v <= 500; ++v) {
+        assert(table.contains(v) == (stdSet.count(v) == 1));
+    }
+    //树桶删到很小以后变回链表
+    for (int v : stdSet) {
+        assert(table.erase_unique(v) == 1);
+    }
+    assert(table.empty());
+    assert(strTable.visit("1", [](const std::string& s) { assert(s == "1"); }) == strTable.contains("1"));
+}
+
+/**
+ * @brief [0, stable)一直在表里，写线程不停地插入删除[stable, 2 * stable)，
+ *        期间会扩容和树化，读线程检查[0, stable)每次都能找到
+ */
+template<typename Hash>
+void test_concurrent_readers(int stable, size_t writes) {
+    nano::lockfree_hash_table<int, Hash> table(16);
+    for (int i = 0; i < stable; ++i) {
+        table.insert_unique(i);
+    }
+    std::atomic<bool> stop(false);
+    std::vector<std::thread> readers;
+    for (int t = 0; t < 4; ++t) {
+        readers.emplace_back([&table, &stop, stable, t]() {
+            std::default_random_engine engine(t);
+            std::uniform_int_distribution<int> key(0, stable - 1);
+            while (!stop.load(std::memory_order_relaxed)) {
+                int k = key(engine);
+                assert(table.contains(k));
+                assert(table.visit(k, [k](int v) { assert(v == k); }));
+                table.contains(k + stable);
+            }
+        });
+    }
+    std::default_random_engine engine(time(nullptr));
+    std::uniform_int_distribution<int> key(stable, 2 * stable - 1);
+    for (size_t i = 0; i < writes; ++i) {
+        int k = key(engine);
+        if (i % 3) {
+            table.insert_unique(k);
+        } else {
+            table.erase_unique(k);
+        }
+    }
+    stop = true;
+    for (std::thread& t : readers) {
+        t.join();
+    }
+    for (int i = 0; i < stable; ++i) {
+        assert(table.contains(i));
+    }
+}
+
+void test_reclaim() {
+    nano::lockfree_hash_table<int> table;
+    for (size_t i = 0; i < N; ++i) {
+        table.insert_unique(static_cast<int>(i));
+        table.erase_unique(static_cast<int>(i));
+    }
+    //没有读者时退休的对象不会一直堆着
+    assert(table.retired_count() <= 3 * nano::retire_list::RECLAIM_BATCH);
+}
+
+/**
+ * @brief 一把全局锁保护的hash_table
+ */
+class locked_table {
+public:
+    bool insert_unique(int value) {
+        std::lock_guard<std::mutex> guard(m_lock);
+        return m_table.insert_unique(value).second;
+    }
+    bool contains(int value) const {
+        std::lock_guard<std::mutex> guard(m_lock);
+        return m_table.find(value) != m_table.end();
+    }
+    size_t erase_unique(int value) {
+        std::lock_guard<std::mutex> guard(m_lock);
+        return m_table.erase_unique(value);
+    }
+    void reserve(size_t n) {
+        std::lock_guard<std::mutex> guard(m_lock);
+        m_table.reserve(n);
+    }
+
+private:
+    mutable std::mutex m_lock;
+    nano::hash_table<int> m_table;
+};
+
+template<typename Table>
+double run_readers(Table& table, int threadCount) {
+    //只看读，计时期间不扩容
+    table.reserve(2 * N);
+    for (size_t i = 0; i < N; ++i) {
+        table.insert_unique(static_cast<int>(i));
+    }
+    //随机数在计时之外生成，只测表本身
+    std::vector<std::vector<int>> keys(threadCount);
+    for (int i = 0; i < threadCount; ++i) {
+        std::default_random_engine engine(i);
+        std::uniform_int_distribution<int> key(0, 2 * N - 1);
+        for (size_t j = 0; j < N; ++j) {
+            keys[i].push_back(key(engine));
+        }
+    }
+    std::atomic<size_t> reads(0);
+    double t = nano::run_time([&table, &keys, &reads, threadCount]() {
+        std::vector<std::thread> threads;
+        for (int i = 0; i < threadCount; ++i) {
+            threads.emplace_back([&table, &reads, &keys = keys[i]]() {
+                size_t found = 0;
+                for (size_t j = 0; j < N; ++j) {
+                    int k = keys[j];
+                    //读线程自己承担千分之一的写
+                    if (0 == j % 1000) {
+                        if (k & 1) {
+                            table.insert_unique(k);
+                        } else {
+                            table.erase_unique(k);
+                        }
+                    } else {
+                        found += table.contains(k);
+                    }
+                }
+                reads += N;
+                static_cast<void>(found);
+            });
+        }
+        for (std::thread& thread : threads) {
+            thread.join();
+        }
+    });
+    return reads / t / 10.0;
+}
+
+/**
+ * @brief 单核机器上锁从来不会被抢，也没有cache line在核之间来回传，
+ * 		  所以看不出无锁读的好处，只看得到节点多存了hash值、epoch进出的固定开销，
+ * 		  要在多核机器上才有意义, -O2 单核
+ * threads  global mutex  sharded  lockfree
+ * 1        3130          2513     929
+ * 8        3088          2624     1018
+ * 64       3204          2591     891
+ */
+void bench_readers() {
+    std::cout << "threads\tglobal mutex\tsharded\tlockfree" << std::endl;
+    for (int threadCount = 1; threadCount <= 64; threadCount *= 2) {
+        locked_table locked;
+        nano::concurrent_hash_table<int> sharded(64);
+        nano::lockfree_hash_table<int> lockfree;
+        double lockedOps = run_readers(locked, threadCount);
+        double shardedOps = run_readers(sharded, threadCount);
+        double lockfreeOps = run_readers(lockfree, threadCount);
+        std::cout << threadCount << "\t" << lockedOps << "\t" << shardedOps << "\t"
+            << lockfreeOps << std::endl;
+    }
+}
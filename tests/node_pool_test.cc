@@ -0,0 +1,108 @@
+#include "node_pool.h"
+#include <iostream>
+#include <vector>
+#include <set>
+#include <assert.h>
+#include <stdint.h>
+
+struct node {
+    node* next;
+    int value;
+};
+
+struct alignas(64) aligned_node {
+    char data[100];
+};
+
+void test_reuse();
+void test_align();
+void test_merge();
+void test_reserve();
+
+int main(int argc, char** argv) {
+    test_reuse();
+    test_align();
+    test_merge();
+    test_reserve();
+
+    return 0;
+}
+
+void test_reuse() {
+    nano::node_pool<node> pool;
+    std::vector<node*> nodes;
+    for (int i = 0; i < 1000; ++i) {
+        node* n = pool.allocate();
+        n->value = i;
+        nodes.push_back(n);
+    }
+    //每个节点都不重叠
+    std::set<node*> addrs(nodes.begin(), nodes.end());
+    assert(addrs.size() == nodes.size());
+    for (int i = 0; i < 1000; ++i) {
+        assert(nodes[i]->value == i);
+    }
+    size_t slabCount = pool.slab_count();
+    //释放之后再申请，用的是释放掉的节点，不会申请新的slab
+    for (node* n : nodes) {
+        pool.deallocate(n);
+    }
+    for (int i = 0; i < 1000; ++i) {
+        assert(addrs.count(pool.allocate()) == 1);
+    }
+    assert(pool.slab_count() == slabCount);
+    assert(pool.bytes() >= 1000 * sizeof(node));
+    pool.release();
+    assert(pool.slab_count() == 0 && pool.bytes() == 0);
+}
+
+void test_align() {
+    nano::node_pool<aligned_node> pool;
+    for (int i = 0; i < 100; ++i) {
+        aligned_node* n = pool.allocate();
+        assert(reinterpret_cast<uintptr_t>(n) % alignof(aligned_node) == 0);
+        n->data[99] = 1;
+    }
+}
+
+void test_merge() {
+    nano::node_pool<node> p1;
+    nano::node_pool<node> p2;
+    node* n1 = p1.allocate();
+    node* n2 = p2.allocate();
+    n1->value = 1;
+    n2->value = 2;
+    p1.deallocate(n1);
+    size_t bytes = p1.bytes() + p2.bytes();
+    p1.merge(p2);
+    assert(p2.slab_count() == 0 && p1.slab_count() == 2);
+    assert(p2.bytes() == 0 && p1.bytes() == bytes);
+    //p2申请出去的节点现在归p1管，还能正常使用和释放
+    assert(n2->value == 2);
+    p1.deallocate(n2);
+    node* a = p1.allocate();
+    node* b = p1.allocate();
+    assert((a == n1 && b == n2) || (a == n2 && b == n1));
+    //被合并的池还能继续用
+    node* n3 = p2.allocate();
+    n3->value = 3;
+    nano::node_pool<node> p3(std::move(p2));
+    assert(p3.slab_count() == 1 && p2.slab_count() == 0);
+}
+
+void test_reserve() {
+    nano::node_pool<node> pool;
+    node* first = pool.allocate();
+    pool.deallocate(first);
+    //空闲链表里的节点也算，预留之后再申请不会有新的slab
+    pool.reserve(100);
+    size_t slabCount = pool.slab_count();
+    std::set<node*> addrs;
+    for (int i = 0; i < 100; ++i) {
+        addrs.insert(pool.allocate());
+    }
+    assert(addrs.size() == 100 && addrs.count(first) == 1);
+    assert(pool.slab_count() == slabCount);
+    pool.reserve(0);
+    assert(pool.slab_count() == slabCount);
+}
@@ -0,0 +1,497 @@
+#include "sketch.h"
+#include "utility.h"
+#include <iostream>
+#include <random>
+#include <vector>
+#include <string>
+#include <assert.h>
+#include <stddef.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+static std::default_random_engine e;
+static std::uniform_int_distribution<uint64_t> u;
+
+//记下全局operator new申请过的最大字节数，检查伪造的头部不会让deserialize申请大块内存
+static size_t maxAllocSize = 0;
+void* operator new(size_t n) {
+    if (n > maxAllocSize) {
+        maxAllocSize = n;
+    }
+    void* p = ::malloc(n ? n : 1);
+    if (nullptr == p) {
+        throw std::bad_alloc();
+    }
+    return p;
+}
+void operator delete(void* p) noexcept {
+    ::free(p);
+}
+void operator delete(void* p, size_t) noexcept {
+    ::free(p);
+}
+
+void test_bloom();
+void test_cuckoo();
+void test_hyperloglog();
+void test_count_min();
+void test_serialize();
+/**
+ * @brief 插入1 << 20个随机uint64_t，再查1 << 20个没插入过的, -O2,
+ *        单核机器上跑了6次取中位数，单位百万次/秒
+ *                          误判率     占用     insert   contains   contains_batch
+ * bloom(fpp = 1%)          0.95%      1.33MB   45.7     39.2       128
+ * bloom(fpp = 0.1%)        0.094%     2.13MB   35.0     30.2       115
+ * cuckoo                   0.0068%    4MB      21.0     32.5
+ *        contains_batch先预取一组块，再用AVX2一次检查一个块；没有-mavx2时contains是标量的
+ *        cuckoo的桶数取2的幂，这里装载率只有50%
+ */
+void bench_filter();
+/**
+ * @brief 插入1 << 22个随机uint64_t，把一个sketch合并到另一个上10000次, -O2,
+ *        单核机器上跑了6次取中位数
+ *                              误差           insert(百万次/秒)    merge(us/次)
+ * hyperloglog(14, 16KB)        0.48%          234                  0.79
+ * count_min(2^14 * 4, 256KB)   +270(最大)     78                   62
+ *        hyperloglog的merge是AVX2的逐字节取最大值
+ */
+void bench_counting();
+
+int main(int argc, char** argv) {
+    e.seed(time(nullptr));
+    test_bloom();
+    test_cuckoo();
+    test_hyperloglog();
+    test_count_min();
+    test_serialize();
+    bench_filter();
+    bench_counting();
+
+    return 0;
+}
+
+void test_bloom() {
+    constexpr static size_t N = 100000;
+    nano::blocked_bloom_filter<uint64_t> filter(N, 0.01);
+    std::vector<uint64_t> keys;
+    for (size_t i = 0; i < N; ++i) {
+        keys.push_back(u(e));
+        filter.insert(keys.back());
+    }
+    for (uint64_t key : keys) {
+        assert(filter.contains(key));
+    }
+    std::vector<char> out(N);
+    filter.contains_batch(keys.data(), N, reinterpret_cast<bool*>(out.data()));
+    for (char found : out) {
+        assert(found);
+    }
+    //误判率不会比要求的高太多
+    size_t falsePositive = 0;
+    std::vector<uint64_t> others;
+    for (size_t i = 0; i < N; ++i) {
+        others.push_back(u(e));
+        falsePositive += filter.contains(others.back());
+    }
+    assert(falsePositive < N * 2 / 100);
+    filter.contains_batch(others.data(), N, reinterpret_cast<bool*>(out.data()));
+    for (size_t i = 0; i < N; ++i) {
+        assert(static_cast<bool>(out[i]) == filter.contains(others[i]));
+    }
+
+    //合并以后两边的元素都在
+    nano::blocked_bloom_filter<uint64_t> other(N, 0.01);
+    for (uint64_t key : others) {
+        other.insert(key);
+    }
+    filter.merge(other);
+    for (size_t i = 0; i < N; ++i) {
+        assert(filter.contains(keys[i]) && filter.contains(others[i]));
+    }
+    bool thrown = false;
+    try {
+        filter.merge(nano::blocked_bloom_filter<uint64_t>(N, 0.01, 1));
+    } catch (const std::invalid_argument&) {
+        thrown = true;
+    }
+    assert(thrown);
+    filter.clear();
+    assert(!filter.contains(keys[0]));
+
+    thrown = false;
+    try {
+        nano::blocked_bloom_filter<int> bad(N, 1.0);
+    } catch (const std::invalid_argument&) {
+        thrown = true;
+    }
+    assert(thrown);
+
+    nano::blocked_bloom_filter<std::string> strings(100);
+    strings.insert("hello");
+    assert(strings.contains("hello") && strings.block_count() >= 1);
+}
+
+void test_cuckoo() {
+    constexpr static size_t N = 100000;
+    nano::cuckoo_filter<uint64_t> filter(N);
+    std::vector<uint64_t> keys;
+    for (size_t i = 0; i < N; ++i) {
+        keys.push_back(u(e));
+        assert(filter.insert(keys.back()));
+    }
+    assert(filter.size() == N);
+    for (uint64_t key : keys) {
+        assert(filter.contains(key));
+    }
+    //删掉一半，另一半还在
+    for (size_t i = 0; i < N; i += 2) {
+        assert(filter.erase(keys[i]));
+    }
+    assert(filter.size() == N / 2);
+    for (size_t i = 1; i < N; i += 2) {
+        assert(filter.contains(keys[i]));
+    }
+    size_t falsePositive = 0;
+    for (size_t i = 0; i < N; i += 2) {
+        falsePositive += filter.contains(keys[i]);
+    }
+    assert(falsePositive < N / 2 / 100);
+
+    //同一个元素插入两次要删两次
+    nano::cuckoo_filter<int> twice(16);
+    twice.insert(7);
+    twice.insert(7);
+    assert(twice.erase(7) && twice.contains(7));
+    assert(twice.erase(7) && !twice.contains(7) && !twice.erase(7));
+
+    //插满以后返回false，已经插入的都还能查到
+    nano::cuckoo_filter<int> small(100);
+    int inserted = 0;
+    while (small.insert(inserted)) {
+        ++inserted;
+    }
+    assert(static_cast<size_t>(inserted) >= small.capacity() * 9 / 10);
+    assert(small.size() == static_cast<size_t>(inserted));
+    for (int i = 0; i < inserted; ++i) {
+        assert(small.contains(i));
+    }
+    //删掉一个就能再插入
+    assert(small.erase(0) && small.insert(-1));
+    for (int i = 1; i < inserted; ++i) {
+        assert(small.contains(i));
+    }
+
+    //合并
+    nano::cuckoo_filter<uint64_t> a(N), b(N);
+    for (size_t i = 0; i < N / 2; ++i) {
+        a.insert(keys[i]);
+        b.insert(keys[N / 2 + i]);
+    }
+    a.merge(b);
+    assert(a.size() == N);
+    for (uint64_t key : keys) {
+        assert(a.contains(key));
+    }
+    bool thrown = false;
+    try {
+        a.merge(nano::cuckoo_filter<uint64_t>(N * 4));
+    } catch (const std::invalid_argument&) {
+        thrown = true;
+    }
+    assert(thrown);
+    thrown = false;
+    try {
+        nano::cuckoo_filter<uint64_t> copy = a;
+        a.merge(copy);
+        a.merge(copy);
+    } catch (const std::length_error&) {
+        thrown = true;
+    }
+    assert(thrown);
+    a.clear();
+    assert(a.empty() && !a.contains(keys[0]));
+}
+
+void test_hyperloglog() {
+    nano::hyperloglog<uint64_t> hll;
+    assert(hll.estimate() == 0.0 && hll.bytes() == 1 << 14);
+    //小范围线性计数几乎是准的
+    for (uint64_t i = 0; i < 100; ++i) {
+        hll.insert(i);
+        hll.insert(i);
+    }
+    assert(std::abs(hll.estimate() - 100) < 2);
+    //标准误差0.81%，放宽到4%
+    for (size_t n : { 10000, 100000, 1000000 }) {
+        nano::hyperloglog<uint64_t> h;
+        for (size_t i = 0; i < n; ++i) {
+            h.insert(u(e));
+        }
+        assert(std::abs(h.estimate() - n) < n * 0.04);
+    }
+
+    //并集
+    nano::hyperloglog<uint64_t> a(12), b(12), all(12);
+    for (uint64_t i = 0; i < 200000; ++i) {
+        uint64_t key = u(e);
+        (i % 3 ? a : b).insert(key);
+        all.insert(key);
+    }
+    a.merge(b);
+    assert(a.estimate() == all.estimate());
+    bool thrown = false;
+    try {
+        a.merge(nano::hyperloglog<uint64_t>(14));
+    } catch (const std::invalid_argument&) {
+        thrown = true;
+    }
+    assert(thrown);
+    thrown = false;
+    try {
+        nano::hyperloglog<int> bad(3);
+    } catch (const std::invalid_argument&) {
+        thrown = true;
+    }
+    assert(thrown);
+
+    nano::hyperloglog<std::string> strings(nano::hyperloglog<std::string>::MIN_PRECISION);
+    strings.insert("a");
+    strings.insert("b");
+    strings.insert("a");
+    assert(std::abs(strings.estimate() - 2) < 1);
+    strings.clear();
+    assert(strings.estimate() == 0.0);
+}
+
+void test_count_min() {
+    auto sketch = nano::count_min_sketch<int>::from_error(0.001, 0.01);
+    assert(sketch.width() == 2719 && sketch.depth() == 5);
+    //Zipf分布，少数key很多
+    std::vector<uint32_t> counts(10000);
+    for (size_t i = 0; i < counts.size(); ++i) {
+        counts[i] = static_cast<uint32_t>(100000 / (i + 1));
+        sketch.insert(static_cast<int>(i), counts[i]);
+    }
+    uint64_t total = 0;
+    for (uint32_t count : counts) {
+        total += count;
+    }
+    assert(sketch.total() == total);
+    size_t bad = 0;
+    for (size_t i = 0; i < counts.size(); ++i) {
+        uint32_t estimate = sketch.estimate(static_cast<int>(i));
+        assert(estimate >= counts[i]);
+        bad += estimate - counts[i] > total / 1000;
+    }
+    assert(bad < counts.size() / 100);
+    assert(sketch.estimate(1 << 30) <= total / 1000);
+
+    nano::count_min_sketch<int> a(1024, 4), b(1024, 4);
+    for (int i = 0; i < 1000; ++i) {
+        a.insert(i, 2);
+        b.insert(i, 3);
+    }
+    a.merge(b);
+    assert(a.total() == 5000);
+    for (int i = 0; i < 1000; ++i) {
+        assert(a.estimate(i) >= 5);
+    }
+    //计数器溢出时停在最大值
+    nano::count_min_sketch<int> sat(16, 2);
+    sat.insert(1, UINT32_MAX - 1);
+    sat.insert(1, 5);
+    assert(sat.estimate(1) == UINT32_MAX);
+    sat.merge(sat);
+    assert(sat.estimate(1) == UINT32_MAX);
+
+    bool thrown = false;
+    try {
+        a.merge(nano::count_min_sketch<int>(1024, 5));
+    } catch (const std::invalid_argument&) {
+        thrown = true;
+    }
+    assert(thrown);
+    thrown = false;
+    try {
+        nano::count_min_sketch<int> zero(0, 4);
+    } catch (const std::invalid_argument&) {
+        thrown = true;
+    }
+    assert(thrown);
+}
+
+template<typename Sketch>
+void expect_bad_input(std::string data) {
+    bool thrown = false;
+    try {
+        Sketch::deserialize(data);
+    } catch (const std::invalid_argument&) {
+        thrown = true;
+    }
+    assert(thrown);
+}
+
+/**
+ * @brief 把data头部的第i个参数改成value，数据只留前payloadSize个字节
+ */
+std::string forge(std::string data, size_t i, uint64_t value, size_t payloadSize) {
+    using header = nano::sketch_detail::sketch_header;
+    uint64_t size = payloadSize;
+    memcpy(data.data() + offsetof(header, params) + i * sizeof(uint64_t), &value, sizeof(value));
+    memcpy(data.data() + offsetof(header, payload_size), &size, sizeof(size));
+    return data.substr(0, sizeof(header) + payloadSize);
+}
+
+void test_serialize() {
+    using bloom = nano::blocked_bloom_filter<int>;
+    using cuckoo = nano::cuckoo_filter<int>;
+    using hll = nano::hyperloglog<int>;
+    using count_min = nano::count_min_sketch<int>;
+    bloom b(1000, 0.01, 3);
+    cuckoo c(1000, 3);
+    hll h(10, 3);
+    count_min cm(100, 3, 3);
+    for (int i = 0; i < 1000; ++i) {
+        b.insert(i);
+        c.insert(i);
+        h.insert(i);
+        cm.insert(i, i);
+    }
+    assert(c.size() == 1000);
+
+    bloom b2 = bloom::deserialize(b.serialize());
+    assert(b2.seed() == 3 && b2.block_count() == b.block_count());
+    cuckoo c2 = cuckoo::deserialize(c.serialize());
+    assert(c2.size() == c.size() && c2.bucket_count() == c.bucket_count());
+    hll h2 = hll::deserialize(h.serialize());
+    assert(h2.estimate() == h.estimate() && h2.precision() == 10);
+    count_min cm2 = count_min::deserialize(cm.serialize());
+    assert(cm2.total() == cm.total() && cm2.width() == 100 && cm2.depth() == 3);
+    for (int i = 0; i < 1200; ++i) {
+        assert(b2.contains(i) == b.contains(i));
+        assert(c2.contains(i) == c.contains(i));
+        assert(cm2.estimate(i) == cm.estimate(i));
+    }
+    //读回来的可以和原来的合并
+    b2.merge(b);
+    h2.merge(h);
+    assert(h2.estimate() == h.estimate());
+    cm2.merge(cm);
+    assert(cm2.estimate(999) >= 2 * 999);
+
+    //种类、长度、魔数不对
+    expect_bad_input<hll>(b.serialize());
+    expect_bad_input<bloom>(h.serialize());
+    std::string data = h.serialize();
+    expect_bad_input<hll>(data.substr(0, data.size() - 1));
+    expect_bad_input<hll>(data.substr(0, 10));
+    data[0] = 'X';
+    expect_bad_input<hll>(data);
+    expect_bad_input<count_min>("");
+
+    //伪造的头部: 先核对数据长度，不按头部申请内存；乘出来溢出时也对不上
+    maxAllocSize = 0;
+    count_min small(4, 1, 3);
+    expect_bad_input<count_min>(forge(small.serialize(), 0, uint64_t(1) << 32, 16));
+    expect_bad_input<count_min>(forge(small.serialize(), 1, uint64_t(1) << 40, 16));
+    std::string bloomData = b.serialize();
+    size_t bloomPayload = bloomData.size() - sizeof(nano::sketch_detail::sketch_header);
+    expect_bad_input<bloom>(forge(bloomData, 0, b.block_count() + (uint64_t(1) << 58), bloomPayload));
+    expect_bad_input<cuckoo>(forge(c.serialize(), 0, uint64_t(1) << 61, 0));
+    assert(maxAllocSize < (size_t(1) << 20));
+}
+
+void bench_filter() {
+    constexpr static size_t N = 1 << 20;
+    std::vector<uint64_t> keys;
+    std::vector<uint64_t> others;
+    for (size_t i = 0; i < N; ++i) {
+        keys.push_back(u(e));
+        others.push_back(u(e));
+    }
+    std::vector<char> out(N);
+    auto report = [&out](const std::string& name, size_t falsePositive, size_t bytes,
+            double insertTime, double containsTime, double batchTime) {
+        std::cout << name << ": fpp " << 100.0 * falsePositive / N << "%, "
+                  << bytes / 1024.0 / 1024.0 << "MB, insert " << N / insertTime / 1000
+                  << "M/s, contains " << N / containsTime / 1000 << "M/s";
+        if (batchTime > 0.0) {
+            std::cout << ", contains_batch " << N / batchTime / 1000 << "M/s";
+        }
+        std::cout << std::endl;
+    };
+    for (double fpp : { 0.01, 0.001 }) {
+        nano::blocked_bloom_filter<uint64_t> filter(N, fpp);
+        double insertTime = nano::run_time([&filter, &keys]() {
+            for (uint64_t key : keys) {
+                filter.insert(key);
+            }
+        });
+        size_t falsePositive = 0;
+        double containsTime = nano::run_time([&filter, &others, &falsePositive]() {
+            for (uint64_t key : others) {
+                falsePositive += filter.contains(key);
+            }
+        });
+        double batchTime = nano::run_time([&filter, &others, &out]() {
+            filter.contains_batch(others.data(), N, reinterpret_cast<bool*>(out.data()));
+        });
+        report("bloom(fpp = " + std::to_string(fpp) + ")", falsePositive, filter.bytes(),
+               insertTime, containsTime, batchTime);
+    }
+    nano::cuckoo_filter<uint64_t> filter(N);
+    double insertTime = nano::run_time([&filter, &keys]() {
+        for (uint64_t key : keys) {
+            filter.insert(key);
+        }
+    });
+    size_t falsePositive = 0;
+    double containsTime = nano::run_time([&filter, &others, &falsePositive]() {
+        for (uint64_t key : others) {
+            falsePositive += filter.contains(key);
+        }
+    });
+    report("cuckoo", falsePositive, filter.bytes(), insertTime, containsTime, 0.0);
+}
+
+void bench_counting() {
+    constexpr static size_t N = 1 << 22;
+    constexpr static size_t MERGES = 10000;
+    std::vector<uint64_t> keys;
+    for (size_t i = 0; i < N; ++i) {
+        keys.push_back(u(e));
+    }
+    nano::hyperloglog<uint64_t> hll, other;
+    double insertTime = nano::run_time([&hll, &keys]() {
+        for (uint64_t key : keys) {
+            hll.insert(key);
+        }
+    });
+    double mergeTime = nano::run_time([&hll, &other]() {
+        for (size_t i = 0; i < MERGES; ++i) {
+            other.merge(hll);
+        }
+    });
+    std::cout << "hyperloglog: error " << 100.0 * std::abs(hll.estimate() - N) / N
+              << "%, insert " << N / insertTime / 1000 << "M/s, merge "
+              << mergeTime * 1000 / MERGES << "us" << std::endl;
+
+    nano::count_min_sketch<uint64_t> sketch(1 << 14, 4), sketch2(1 << 14, 4);
+    insertTime = nano::run_time([&sketch, &keys]() {
+        for (uint64_t key : keys) {
+            sketch.insert(key);
+        }
+    });
+    mergeTime = nano::run_time([&sketch, &sketch2]() {
+        for (size_t i = 0; i < MERGES; ++i) {
+            sketch2.merge(sketch);
+        }
+    });
+    uint64_t maxError = 0;
+    for (size_t i = 0; i < 1000; ++i) {
+        maxError = std::max<uint64_t>(maxError, sketch.estimate(keys[i]) - 1);
+    }
+    std::cout << "count_min: max error " << maxError << ", insert " << N / insertTime / 1000
+              << "M/s, merge " << mergeTime * 1000 / MERGES << "us" << std::endl;
+}